@@ -0,0 +1,131 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * Compares the cost of reading the clocks in twine::chrono. fast_now() should
+ * come in at a fraction of now() and monotonic_now() when the time stamp
+ * counter is usable; otherwise it costs the same as monotonic_now(). The same
+ * goes for coarse_steady_clock where the system provides a coarse clock.
+ **/
+
+#include <twine/chrono.h>
+#include <twine/tsc_clock.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace tc = twine::chrono;
+
+namespace {
+
+static int const ITERATIONS = 10000000;
+
+// Accumulates results, so the compiler cannot drop the clock reads.
+static volatile int64_t sink = 0;
+
+
+void report(char const * name, tc::nanoseconds const & elapsed, int iterations)
+{
+  ::printf("%-44s %8.2f ns/op\n", name,
+      double(elapsed.raw()) / double(iterations));
+}
+
+
+template <tc::nanoseconds (*clockT)()>
+void bench_clock(char const * name)
+{
+  int64_t sum = 0;
+  tc::nanoseconds start = tc::monotonic_now();
+  for (int i = 0 ; i < ITERATIONS ; ++i) {
+    sum += clockT().raw();
+  }
+  report(name, tc::monotonic_now() - start, ITERATIONS);
+  sink = sum;
+}
+
+
+template <typename clockT>
+void bench_clock_type(char const * name)
+{
+  int64_t sum = 0;
+  tc::nanoseconds start = tc::monotonic_now();
+  for (int i = 0 ; i < ITERATIONS ; ++i) {
+    sum += clockT::now().time_since_epoch().raw();
+  }
+  report(name, tc::monotonic_now() - start, ITERATIONS);
+  sink = sum;
+}
+
+
+void bench_ticks()
+{
+  uint64_t sum = 0;
+  tc::nanoseconds start = tc::monotonic_now();
+  for (int i = 0 ; i < ITERATIONS ; ++i) {
+    sum += tc::tsc_clock::ticks();
+  }
+  report("tsc_clock::ticks()", tc::monotonic_now() - start, ITERATIONS);
+  sink = int64_t(sum);
+}
+
+
+void report_drift()
+{
+  // Over a longer interval, see how far fast_now() strays from the clock it
+  // was calibrated against.
+  tc::nanoseconds fast_start = tc::fast_now();
+  tc::nanoseconds mono_start = tc::monotonic_now();
+  tc::sleep(tc::milliseconds(500).convert<tc::nanoseconds>());
+  tc::nanoseconds fast = tc::fast_now() - fast_start;
+  tc::nanoseconds mono = tc::monotonic_now() - mono_start;
+
+  ::printf("%-44s %8lld ns\n", "fast_now() drift over 500ms",
+      static_cast<long long>((fast - mono).raw()));
+}
+
+} // anonymous namespace
+
+
+int main(int, char **)
+{
+  bool usable = tc::tsc_clock::calibrate();
+  if (usable) {
+    ::printf("time stamp counter: %llu ticks/s\n",
+        static_cast<unsigned long long>(tc::tsc_clock::frequency()));
+  }
+  else {
+    ::printf("time stamp counter not usable; fast_now() falls back to "
+        "monotonic_now()\n");
+  }
+
+  bench_clock<tc::now>("now()");
+  bench_clock<tc::monotonic_now>("monotonic_now()");
+  bench_clock<tc::fast_now>("fast_now()");
+  bench_clock_type<tc::steady_clock>("steady_clock::now()");
+  bench_clock_type<tc::coarse_steady_clock>("coarse_steady_clock::now()");
+  bench_clock_type<tc::thread_cpu_clock>("thread_cpu_clock::now()");
+  bench_clock_type<tc::process_cpu_clock>("process_cpu_clock::now()");
+  if (usable) {
+    bench_ticks();
+    report_drift();
+  }
+  return EXIT_SUCCESS;
+}
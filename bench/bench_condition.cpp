@@ -0,0 +1,144 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+/**
+ * Measures the cost of notifying a condition nobody waits on, which is what
+ * waking a busy tasklet boils down to. Compare the first two lines against the
+ * baselines, which show what notifying costs without the waiter count.
+ **/
+
+#include <twine/condition.h>
+#include <twine/tasklet.h>
+#include <twine/atomic.h>
+#include <twine/chrono.h>
+
+#if defined(TWINE_HAVE_LINUX_FUTEX_H)
+#  include <twine/linux/futex.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace tc = twine::chrono;
+
+namespace {
+
+static int const ITERATIONS = 10000000;
+
+
+void report(char const * name, tc::nanoseconds const & elapsed, int iterations)
+{
+  ::printf("%-44s %8.2f ns/op\n", name,
+      double(elapsed.raw()) / double(iterations));
+}
+
+
+void bench_notify_one()
+{
+  twine::condition cond;
+
+  tc::nanoseconds start = tc::now();
+  for (int i = 0 ; i < ITERATIONS ; ++i) {
+    cond.notify_one();
+  }
+  report("condition::notify_one(), no waiters", tc::now() - start, ITERATIONS);
+}
+
+
+void busy_tasklet(twine::tasklet & t, void * baton)
+{
+  twine::atomic<uint32_t> * done = static_cast<twine::atomic<uint32_t> *>(baton);
+  while (!done->load(twine::memory_order_relaxed)) {
+    twine::detail::cpu_relax();
+  }
+  (void) t;
+}
+
+
+void bench_tasklet_wakeup()
+{
+  twine::atomic<uint32_t> done(0);
+  twine::tasklet t(busy_tasklet, &done, true);
+
+  tc::nanoseconds start = tc::now();
+  for (int i = 0 ; i < ITERATIONS ; ++i) {
+    t.wakeup();
+  }
+  tc::nanoseconds elapsed = tc::now() - start;
+
+  done.store(1);
+  t.stop();
+  t.wait();
+
+  report("tasklet::wakeup(), busy tasklet", elapsed, ITERATIONS);
+}
+
+
+#if defined(TWINE_POSIX)
+void bench_pthread_cond_signal()
+{
+  pthread_cond_t cond;
+  pthread_cond_init(&cond, nullptr);
+
+  tc::nanoseconds start = tc::now();
+  for (int i = 0 ; i < ITERATIONS ; ++i) {
+    pthread_cond_signal(&cond);
+  }
+  report("baseline: pthread_cond_signal(), no waiters", tc::now() - start,
+      ITERATIONS);
+
+  pthread_cond_destroy(&cond);
+}
+#endif
+
+
+#if defined(TWINE_HAVE_LINUX_FUTEX_H)
+void bench_futex_wake()
+{
+  // Waking a futex unconditionally makes a system call each time; use fewer
+  // iterations.
+  int const iterations = ITERATIONS / 10;
+  int32_t volatile word = 0;
+
+  tc::nanoseconds start = tc::now();
+  for (int i = 0 ; i < iterations ; ++i) {
+    __atomic_fetch_add(&word, 1, __ATOMIC_SEQ_CST);
+    twine::detail::futex_wake(&word, 1);
+  }
+  report("baseline: FUTEX_WAKE, no waiters", tc::now() - start, iterations);
+}
+#endif
+
+} // anonymous namespace
+
+
+int main(int, char **)
+{
+  bench_notify_one();
+  bench_tasklet_wakeup();
+#if defined(TWINE_POSIX)
+  bench_pthread_cond_signal();
+#endif
+#if defined(TWINE_HAVE_LINUX_FUTEX_H)
+  bench_futex_wake();
+#endif
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+/**
+ * Compares handing values between producer and consumer threads through an
+ * mpmc_queue against the std::deque, mutex and condition combination it
+ * replaces. Both queues are bounded to the same capacity and use blocking
+ * push() and pop(); with more threads, the baseline's throughput should
+ * collapse while mpmc_queue's degrades gracefully.
+ **/
+
+#include <twine/mpmc_queue.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+#include <twine/scoped_lock.h>
+#include <twine/thread.h>
+#include <twine/chrono.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <deque>
+
+namespace tc = twine::chrono;
+
+namespace {
+
+static int const ITEMS = 2000000;
+static size_t const CAPACITY = 1024;
+
+
+/**
+ * The baseline: a deque guarded by a mutex, with conditions for waiting on
+ * room and values.
+ **/
+class locked_queue
+{
+public:
+  explicit locked_queue(size_t capacity)
+    : m_capacity(capacity)
+  {
+  }
+
+  bool push(uint64_t const & value)
+  {
+    twine::scoped_lock<twine::mutex> lock(m_mutex);
+    while (m_queue.size() >= m_capacity) {
+      m_not_full.wait(lock);
+    }
+    m_queue.push_back(value);
+    m_not_empty.notify_one();
+    return true;
+  }
+
+  bool pop(uint64_t & value)
+  {
+    twine::scoped_lock<twine::mutex> lock(m_mutex);
+    while (m_queue.empty()) {
+      m_not_empty.wait(lock);
+    }
+    value = m_queue.front();
+    m_queue.pop_front();
+    m_not_full.notify_one();
+    return true;
+  }
+
+private:
+  size_t                m_capacity;
+  std::deque<uint64_t>  m_queue;
+  twine::mutex          m_mutex;
+  twine::condition      m_not_full;
+  twine::condition      m_not_empty;
+};
+
+
+template <typename queueT>
+struct context
+{
+  queueT &                queue;
+  int                     items;
+  twine::atomic<uint64_t> sum;
+
+  context(queueT & q, int i)
+    : queue(q)
+    , items(i)
+    , sum(0)
+  {
+  }
+};
+
+
+template <typename queueT>
+void produce(void * baton)
+{
+  context<queueT> * ctx = static_cast<context<queueT> *>(baton);
+  for (int i = 0 ; i < ctx->items ; ++i) {
+    ctx->queue.push(uint64_t(i));
+  }
+}
+
+
+template <typename queueT>
+void consume(void * baton)
+{
+  context<queueT> * ctx = static_cast<context<queueT> *>(baton);
+  uint64_t sum = 0;
+  for (int i = 0 ; i < ctx->items ; ++i) {
+    uint64_t value = 0;
+    ctx->queue.pop(value);
+    sum += value;
+  }
+  ctx->sum.fetch_add(sum);
+}
+
+
+template <typename queueT>
+void bench_queue(char const * name, int threads)
+{
+  queueT queue(CAPACITY);
+  context<queueT> ctx(queue, ITEMS / threads);
+
+  twine::thread * producers[16];
+  twine::thread * consumers[16];
+
+  tc::nanoseconds start = tc::monotonic_now();
+  for (int i = 0 ; i < threads ; ++i) {
+    producers[i] = new twine::thread(&produce<queueT>, &ctx);
+    consumers[i] = new twine::thread(&consume<queueT>, &ctx);
+  }
+  for (int i = 0 ; i < threads ; ++i) {
+    producers[i]->join();
+    consumers[i]->join();
+    delete producers[i];
+    delete consumers[i];
+  }
+  tc::nanoseconds elapsed = tc::monotonic_now() - start;
+
+  int items = ctx.items * threads;
+  ::printf("%-24s %2dP/%2dC %8.2f ns/item %8.2f Mitems/s\n", name, threads,
+      threads, double(elapsed.raw()) / double(items),
+      double(items) * 1000.0 / double(elapsed.raw()));
+}
+
+} // anonymous namespace
+
+
+int main(int, char **)
+{
+  int const threads[] = { 1, 2, 4, 8 };
+  for (size_t i = 0 ; i < sizeof(threads) / sizeof(threads[0]) ; ++i) {
+    bench_queue<twine::mpmc_queue<uint64_t> >("mpmc_queue", threads[i]);
+    bench_queue<locked_queue>("baseline: deque+mutex", threads[i]);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,213 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/latch.h>
+#include <twine/barrier.h>
+#include <twine/thread.h>
+
+#include "compare_times.h"
+
+#define BARRIER_TEST_DELAY  twine::chrono::milliseconds(50)
+#define BARRIER_TEST_PHASES 200
+
+namespace {
+
+void thread_count_down(void * arg)
+{
+  twine::latch * l = static_cast<twine::latch *>(arg);
+  twine::this_thread::sleep_for(BARRIER_TEST_DELAY);
+  l->count_down();
+}
+
+
+void thread_latch_wait(void * arg)
+{
+  twine::latch * l = static_cast<twine::latch *>(arg);
+  l->wait();
+}
+
+
+/**
+ * Each thread adds its phase number to its own slot; the completion function
+ * checks that all slots agree, i.e. that no thread ran ahead.
+ **/
+template <typename barrierT>
+struct phases
+{
+  barrierT    bar;
+  int         slots[4];
+  int         completed;
+  int         serial;
+  bool        consistent;
+
+  phases()
+    : bar(4, completion, this)
+    , completed(0)
+    , serial(0)
+    , consistent(true)
+  {
+    for (int i = 0 ; i < 4 ; ++i) {
+      slots[i] = 0;
+    }
+  }
+
+  static void completion(void * baton)
+  {
+    phases * p = static_cast<phases *>(baton);
+    ++p->completed;
+    for (int i = 0 ; i < 4 ; ++i) {
+      if (p->slots[i] != p->completed) {
+        p->consistent = false;
+      }
+    }
+  }
+};
+
+
+template <typename barrierT>
+struct worker
+{
+  phases<barrierT> *  p;
+  int                 slot;
+  int                 serial;
+};
+
+
+template <typename barrierT>
+void thread_phases(void * arg)
+{
+  worker<barrierT> * w = static_cast<worker<barrierT> *>(arg);
+  for (int i = 0 ; i < BARRIER_TEST_PHASES ; ++i) {
+    ++w->p->slots[w->slot];
+    if (w->p->bar.arrive_and_wait()) {
+      ++w->serial;
+    }
+  }
+}
+
+
+template <typename barrierT>
+void run_phases()
+{
+  phases<barrierT> p;
+  worker<barrierT> w[4];
+  for (int i = 0 ; i < 4 ; ++i) {
+    w[i].p = &p;
+    w[i].slot = i;
+    w[i].serial = 0;
+  }
+
+  twine::thread th1(thread_phases<barrierT>, &w[0]);
+  twine::thread th2(thread_phases<barrierT>, &w[1]);
+  twine::thread th3(thread_phases<barrierT>, &w[2]);
+  twine::thread th4(thread_phases<barrierT>, &w[3]);
+  th1.join();
+  th2.join();
+  th3.join();
+  th4.join();
+
+  CPPUNIT_ASSERT_EQUAL(true, p.consistent);
+  CPPUNIT_ASSERT_EQUAL(BARRIER_TEST_PHASES, p.completed);
+  CPPUNIT_ASSERT_EQUAL(uint32_t(BARRIER_TEST_PHASES), p.bar.generation());
+  CPPUNIT_ASSERT_EQUAL(BARRIER_TEST_PHASES,
+      w[0].serial + w[1].serial + w[2].serial + w[3].serial);
+}
+
+} // anonymous namespace
+
+
+class BarrierTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(BarrierTest);
+
+      CPPUNIT_TEST(testLatch);
+      CPPUNIT_TEST(testLatchTimedWait);
+      CPPUNIT_TEST(testLatchDestruction);
+      CPPUNIT_TEST(testBarrier);
+      CPPUNIT_TEST(testSpinBarrier);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testLatch()
+  {
+    twine::latch l(3);
+    CPPUNIT_ASSERT_EQUAL(false, l.try_wait());
+    l.count_down(2);
+    CPPUNIT_ASSERT_EQUAL(false, l.try_wait());
+
+    namespace tc = twine::chrono;
+    tc::nanoseconds before = tc::now();
+    twine::thread th(thread_count_down, &l);
+    l.wait();
+    tc::nanoseconds after = tc::now();
+    compare_times(before, after, BARRIER_TEST_DELAY);
+    CPPUNIT_ASSERT_EQUAL(true, l.try_wait());
+
+    // Stays open
+    l.wait();
+    th.join();
+  }
+
+
+  void testLatchTimedWait()
+  {
+    twine::latch l(1);
+    CPPUNIT_ASSERT_EQUAL(false, l.timed_wait(BARRIER_TEST_DELAY));
+
+    twine::thread th(thread_count_down, &l);
+    CPPUNIT_ASSERT_EQUAL(true, l.timed_wait(twine::chrono::seconds(5)));
+    th.join();
+  }
+
+
+  void testLatchDestruction()
+  {
+    // Waiters may destroy the latch as soon as it opens.
+    for (int i = 0 ; i < 50 ; ++i) {
+      twine::latch * l = new twine::latch(1);
+      twine::thread th(thread_latch_wait, l);
+      l->arrive_and_wait();
+      th.join();
+      delete l;
+    }
+  }
+
+
+  void testBarrier()
+  {
+    run_phases<twine::barrier>();
+  }
+
+
+  void testSpinBarrier()
+  {
+    run_phases<twine::spin_barrier>();
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BarrierTest);
@@ -26,6 +26,7 @@
 #include "compare_times.h"
 
 #include <cstdlib>
+#include <algorithm>
 
 #include <sstream>
 
@@ -44,10 +45,16 @@ public:
       CPPUNIT_TEST(testRaw);
       CPPUNIT_TEST(testConversion);
       CPPUNIT_TEST(testStreaming);
+      CPPUNIT_TEST(testFormat);
       CPPUNIT_TEST(testNow);
+      CPPUNIT_TEST(testMonotonicNow);
       CPPUNIT_TEST(testSleep);
+      CPPUNIT_TEST(testPreciseSleep);
       CPPUNIT_TEST(testArithmetic);
       CPPUNIT_TEST(testComparison);
+      CPPUNIT_TEST(testTimePoint);
+      CPPUNIT_TEST(testClocks);
+      CPPUNIT_TEST(testCPUClocks);
 
     CPPUNIT_TEST_SUITE_END();
 
@@ -228,6 +235,68 @@ private:
       testStreamingImpl<tc::hours, 25>("25:00:00.000000000");
 
       testStreamingImpl<tc::nanoseconds, 3612345678901>("1:00:12.345678901");
+      testStreamingImpl<tc::milliseconds, -1500>("-0:00:01.500000000");
+    }
+
+
+
+    template <typename durationT>
+    std::string format(durationT const & d, twine::chrono::duration_format f)
+    {
+      char buf[twine::chrono::MAX_DURATION_CHARS];
+      char * end = twine::chrono::to_chars(buf, buf + sizeof(buf), d, f);
+      CPPUNIT_ASSERT(end);
+      return std::string(buf, end);
+    }
+
+    void testFormat()
+    {
+      namespace tc = twine::chrono;
+
+      // Clock layout
+      CPPUNIT_ASSERT_EQUAL(std::string("0:00:00.000000000"),
+          format(tc::nanoseconds(0), tc::FORMAT_CLOCK));
+      CPPUNIT_ASSERT_EQUAL(std::string("25:01:02.000000003"),
+          format(tc::nanoseconds(3) + tc::hours(25) + tc::minutes(1)
+            + tc::seconds(2), tc::FORMAT_CLOCK));
+
+      // Human-scaled layout
+      CPPUNIT_ASSERT_EQUAL(std::string("0ns"),
+          format(tc::nanoseconds(0), tc::FORMAT_HUMAN));
+      CPPUNIT_ASSERT_EQUAL(std::string("999ns"),
+          format(tc::nanoseconds(999), tc::FORMAT_HUMAN));
+      CPPUNIT_ASSERT_EQUAL(std::string("1us"),
+          format(tc::nanoseconds(1000), tc::FORMAT_HUMAN));
+      CPPUNIT_ASSERT_EQUAL(std::string("1.25ms"),
+          format(tc::microseconds(1250), tc::FORMAT_HUMAN));
+      CPPUNIT_ASSERT_EQUAL(std::string("1.001ms"),
+          format(tc::nanoseconds(1001999), tc::FORMAT_HUMAN));
+      CPPUNIT_ASSERT_EQUAL(std::string("3s"),
+          format(tc::seconds(3), tc::FORMAT_HUMAN));
+      CPPUNIT_ASSERT_EQUAL(std::string("3600s"),
+          format(tc::hours(1), tc::FORMAT_HUMAN));
+      CPPUNIT_ASSERT_EQUAL(std::string("-12.5us"),
+          format(tc::nanoseconds(-12500), tc::FORMAT_HUMAN));
+
+      // Raw nanoseconds
+      CPPUNIT_ASSERT_EQUAL(std::string("1250000"),
+          format(tc::microseconds(1250), tc::FORMAT_NANOSECONDS));
+      CPPUNIT_ASSERT_EQUAL(std::string("-9223372036854775808"),
+          format(tc::nanoseconds(INT64_MIN), tc::FORMAT_NANOSECONDS));
+
+      // The extremes fit into MAX_DURATION_CHARS in every layout.
+      CPPUNIT_ASSERT_EQUAL(std::string("-2562047:47:16.854775808"),
+          format(tc::nanoseconds(INT64_MIN), tc::FORMAT_CLOCK));
+      CPPUNIT_ASSERT_EQUAL(std::string("9223372036.854s"),
+          format(tc::nanoseconds(INT64_MAX), tc::FORMAT_HUMAN));
+
+      // Buffers that are too small are rejected.
+      char small[4];
+      CPPUNIT_ASSERT(!tc::to_chars(small, small + sizeof(small),
+            tc::seconds(1)));
+      CPPUNIT_ASSERT_EQUAL(small + 3, tc::to_chars(small,
+            small + sizeof(small), tc::milliseconds(1), tc::FORMAT_HUMAN));
+      CPPUNIT_ASSERT_EQUAL(std::string("1ms"), std::string(small, small + 3));
     }
 
 
@@ -245,6 +314,24 @@ private:
 
 
 
+    void testMonotonicNow()
+    {
+      // The epoch is unspecified, but time must not go backwards, and must
+      // advance by at least as much as we sleep.
+      namespace tc = twine::chrono;
+
+      tc::nanoseconds first = tc::monotonic_now();
+      tc::nanoseconds second = tc::monotonic_now();
+      CPPUNIT_ASSERT(second >= first);
+
+      tc::sleep(tc::milliseconds(25).convert<tc::nanoseconds>());
+      tc::nanoseconds after = tc::monotonic_now();
+
+      compare_times(second, after, tc::milliseconds(25));
+    }
+
+
+
     void testSleep()
     {
       // Using now(), we can test that we sleep at least as long as specified.
@@ -259,6 +346,48 @@ private:
 
 
 
+    void testPreciseSleep()
+    {
+      namespace tc = twine::chrono;
+
+      // The wakeup latency is measured when the library is loaded, so even
+      // the first sleep doesn't pay for measuring it.
+      tc::nanoseconds const duration = tc::microseconds(100);
+      {
+        tc::nanoseconds start = tc::monotonic_now();
+        CPPUNIT_ASSERT(tc::precise_sleep(duration));
+        tc::nanoseconds elapsed = tc::monotonic_now() - start;
+        CPPUNIT_ASSERT(elapsed >= duration);
+        CPPUNIT_ASSERT_MESSAGE("may fail under high CPU load",
+            elapsed - duration < tc::microseconds(50));
+      }
+
+      CPPUNIT_ASSERT(tc::precise_sleep_margin() > tc::nanoseconds(0));
+      CPPUNIT_ASSERT(tc::precise_sleep_margin()
+          <= tc::microseconds(TWINE_PRECISE_SLEEP_MAX_SPIN));
+
+      // Precise sleeps never return early, and typically overshoot by far
+      // less than the default timer slack. Use the median, because the odd
+      // sleep may be preempted.
+      tc::default_repr_t late[11];
+      for (int i = 0 ; i < 11 ; ++i) {
+        tc::nanoseconds start = tc::monotonic_now();
+        CPPUNIT_ASSERT(tc::precise_sleep(duration));
+        tc::nanoseconds elapsed = tc::monotonic_now() - start;
+        CPPUNIT_ASSERT(elapsed >= duration);
+        late[i] = (elapsed - duration).raw();
+      }
+      std::sort(late, late + 11);
+      CPPUNIT_ASSERT_MESSAGE("may fail under high CPU load",
+          late[5] < tc::microseconds(50).as<tc::nanoseconds>());
+
+      // A deadline in the past returns immediately.
+      CPPUNIT_ASSERT(tc::precise_sleep_until(tc::monotonic_now()
+            - tc::milliseconds(1)));
+    }
+
+
+
     void testArithmetic()
     {
       // We support very simple arithmetic on durations: addition and subtraction
@@ -336,6 +465,96 @@ private:
       CPPUNIT_ASSERT(h == tc::minutes(3 * 60));
       CPPUNIT_ASSERT(h == tc::seconds(3 * 60 * 60));
     }
+
+
+    void testTimePoint()
+    {
+      namespace tc = twine::chrono;
+      typedef tc::steady_clock::time_point time_point;
+
+      time_point t1(tc::seconds(10));
+      CPPUNIT_ASSERT(t1.time_since_epoch() == tc::seconds(10));
+
+      // Adding a duration yields a time point, subtracting two time points a
+      // duration.
+      time_point t2 = t1 + tc::milliseconds(500);
+      CPPUNIT_ASSERT(t2 - t1 == tc::milliseconds(500));
+      CPPUNIT_ASSERT(t1 - t2 == tc::milliseconds(-500));
+      CPPUNIT_ASSERT(t2 - tc::milliseconds(500) == t1);
+
+      t2 -= tc::seconds(1);
+      CPPUNIT_ASSERT(t2 < t1);
+      CPPUNIT_ASSERT(t2 <= t1);
+      CPPUNIT_ASSERT(t1 > t2);
+      CPPUNIT_ASSERT(t1 >= t2);
+      CPPUNIT_ASSERT(t1 != t2);
+
+      t2 += tc::milliseconds(500);
+      CPPUNIT_ASSERT(t1 == t2);
+
+      // Time points with coarser durations convert to finer ones.
+      tc::time_point<tc::steady_clock, tc::seconds> t3(tc::seconds(10));
+      time_point t4 = t3;
+      CPPUNIT_ASSERT(t4 == t1);
+      CPPUNIT_ASSERT(t3 == t1);
+    }
+
+
+    void testClocks()
+    {
+      namespace tc = twine::chrono;
+
+      CPPUNIT_ASSERT(!tc::system_clock::is_steady);
+      CPPUNIT_ASSERT(tc::steady_clock::is_steady);
+      CPPUNIT_ASSERT(tc::coarse_steady_clock::is_steady);
+
+      // The system clock has the same epoch as now(), the steady clock the
+      // same as monotonic_now().
+      tc::nanoseconds diff = tc::system_clock::now().time_since_epoch()
+        - tc::now();
+      CPPUNIT_ASSERT(diff < tc::milliseconds(100));
+      CPPUNIT_ASSERT(diff > tc::milliseconds(-100));
+
+      diff = tc::steady_clock::now().time_since_epoch() - tc::monotonic_now();
+      CPPUNIT_ASSERT(diff < tc::milliseconds(100));
+      CPPUNIT_ASSERT(diff > tc::milliseconds(-100));
+
+      // Steady clocks measure sleeps correctly; the coarse one only to within
+      // its resolution.
+      tc::steady_clock::time_point s1 = tc::steady_clock::now();
+      tc::coarse_steady_clock::time_point c1 = tc::coarse_steady_clock::now();
+      tc::sleep(tc::milliseconds(50).convert<tc::nanoseconds>());
+      tc::steady_clock::time_point s2 = tc::steady_clock::now();
+      tc::coarse_steady_clock::time_point c2 = tc::coarse_steady_clock::now();
+
+      compare_times(s1.time_since_epoch(), s2.time_since_epoch(),
+          tc::milliseconds(50));
+      CPPUNIT_ASSERT(c2 - c1 > tc::milliseconds(30));
+      CPPUNIT_ASSERT(c2 - c1 < tc::milliseconds(100));
+    }
+
+
+    void testCPUClocks()
+    {
+      namespace tc = twine::chrono;
+
+      // Sleeping consumes next to no CPU time, spinning does.
+      tc::thread_cpu_clock::time_point t1 = tc::thread_cpu_clock::now();
+      tc::process_cpu_clock::time_point p1 = tc::process_cpu_clock::now();
+      tc::sleep(tc::milliseconds(50).convert<tc::nanoseconds>());
+      tc::thread_cpu_clock::time_point t2 = tc::thread_cpu_clock::now();
+      CPPUNIT_ASSERT(t2 - t1 < tc::milliseconds(20));
+
+      tc::steady_clock::time_point end = tc::steady_clock::now()
+        + tc::milliseconds(50);
+      while (tc::steady_clock::now() < end) {
+        // Spin
+      }
+      tc::thread_cpu_clock::time_point t3 = tc::thread_cpu_clock::now();
+      tc::process_cpu_clock::time_point p3 = tc::process_cpu_clock::now();
+      CPPUNIT_ASSERT(t3 - t2 > tc::milliseconds(25));
+      CPPUNIT_ASSERT(p3 - p1 >= t3 - t2);
+    }
 };
 
 
@@ -21,6 +21,8 @@
 
 #include <cppunit/extensions/HelperMacros.h>
 
+#include "compare_times.h"
+
 #include <twine/condition.h>
 #include <twine/mutex.h>
 #include <twine/thread.h>
@@ -95,6 +97,39 @@ private:
       CPPUNIT_ASSERT_EQUAL(false, ret);
     }
 
+    // Waiting for an absolute deadline times out at that deadline.
+    {
+      namespace tc = twine::chrono;
+
+      mutexT m;
+      m.lock();
+      tc::nanoseconds start = tc::monotonic_now();
+      tc::nanoseconds deadline = start
+        + COND_TEST_LONG_DELAY.template convert<tc::nanoseconds>();
+      bool ret = cond.wait_until(m, deadline);
+      tc::nanoseconds end = tc::monotonic_now();
+      m.unlock();
+
+      CPPUNIT_ASSERT_EQUAL(false, ret);
+      CPPUNIT_ASSERT(end >= deadline);
+      compare_times(start, end, COND_TEST_LONG_DELAY);
+
+      // A deadline in the past times out immediately.
+      m.lock();
+      ret = cond.wait_until(m, start);
+      m.unlock();
+      CPPUNIT_ASSERT_EQUAL(false, ret);
+
+      // Deadlines may also be steady_clock time points.
+      tc::steady_clock::time_point tp = tc::steady_clock::now()
+        + COND_TEST_SHORT_DELAY;
+      m.lock();
+      ret = cond.wait_until(m, tp);
+      m.unlock();
+      CPPUNIT_ASSERT_EQUAL(false, ret);
+      CPPUNIT_ASSERT(tc::steady_clock::now() >= tp);
+    }
+
     // The same with a lock
     {
       mutexT m;
@@ -0,0 +1,153 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include <twine/cpu_set.h>
+#include <twine/numa.h>
+
+class CPUSetTest
+  : public CppUnit::TestFixture
+{
+public:
+  CPPUNIT_TEST_SUITE(CPUSetTest);
+
+    CPPUNIT_TEST(testBits);
+    CPPUNIT_TEST(testParse);
+    CPPUNIT_TEST(testOperations);
+    CPPUNIT_TEST(testNuma);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testBits()
+  {
+    twine::cpu_set cpus;
+    CPPUNIT_ASSERT(cpus.empty());
+    CPPUNIT_ASSERT_EQUAL(uint32_t(0), cpus.count());
+
+    cpus.set(0);
+    cpus.set(63);
+    cpus.set(64);
+    cpus.set(twine::cpu_set::MAX_CPUS - 1);
+    cpus.set(twine::cpu_set::MAX_CPUS);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(4), cpus.count());
+    CPPUNIT_ASSERT(cpus.test(63));
+    CPPUNIT_ASSERT(cpus.test(64));
+    CPPUNIT_ASSERT(!cpus.test(65));
+    CPPUNIT_ASSERT(!cpus.test(twine::cpu_set::MAX_CPUS));
+
+    cpus.clear(63);
+    CPPUNIT_ASSERT(!cpus.test(63));
+    CPPUNIT_ASSERT_EQUAL(uint32_t(3), cpus.count());
+
+    cpus.reset();
+    CPPUNIT_ASSERT(cpus.empty());
+  }
+
+
+  void testParse()
+  {
+    twine::cpu_set cpus;
+    CPPUNIT_ASSERT(cpus.parse("0-3,8,10-11\n"));
+    CPPUNIT_ASSERT_EQUAL(uint32_t(7), cpus.count());
+    CPPUNIT_ASSERT(cpus.test(2));
+    CPPUNIT_ASSERT(!cpus.test(4));
+    CPPUNIT_ASSERT(cpus.test(11));
+    CPPUNIT_ASSERT_EQUAL(std::string("0-3,8,10-11"), cpus.to_string());
+
+    CPPUNIT_ASSERT(cpus.parse(""));
+    CPPUNIT_ASSERT(cpus.empty());
+    CPPUNIT_ASSERT_EQUAL(std::string(""), cpus.to_string());
+
+    CPPUNIT_ASSERT(!cpus.parse("3-1"));
+    CPPUNIT_ASSERT(!cpus.parse("1,a"));
+    CPPUNIT_ASSERT(!cpus.parse("1-"));
+    CPPUNIT_ASSERT(!cpus.parse("-3"));
+    CPPUNIT_ASSERT(!cpus.parse("+3"));
+    CPPUNIT_ASSERT(!cpus.parse("1--3"));
+    CPPUNIT_ASSERT(!cpus.parse("1- 3"));
+    CPPUNIT_ASSERT(cpus.empty());
+  }
+
+
+  void testOperations()
+  {
+    twine::cpu_set a;
+    a.parse("0-7");
+    twine::cpu_set b;
+    b.parse("4-11");
+
+    twine::cpu_set c = a;
+    c &= b;
+    CPPUNIT_ASSERT_EQUAL(std::string("4-7"), c.to_string());
+
+    c = a;
+    c |= b;
+    CPPUNIT_ASSERT_EQUAL(std::string("0-11"), c.to_string());
+
+    CPPUNIT_ASSERT(a != b);
+    b.parse("0-7");
+    CPPUNIT_ASSERT(a == b);
+  }
+
+
+  void testNuma()
+  {
+    std::vector<uint32_t> nodes;
+    if (!twine::numa::online_nodes(nodes)) {
+      // No topology information on this system.
+      CPPUNIT_ASSERT_EQUAL(uint32_t(0), twine::numa::node_count());
+      return;
+    }
+
+    CPPUNIT_ASSERT_EQUAL(uint32_t(nodes.size()), twine::numa::node_count());
+
+    // Each online CPU belongs to exactly one node.
+    twine::cpu_set all;
+    for (size_t i = 0 ; i < nodes.size() ; ++i) {
+      twine::cpu_set cpus;
+      CPPUNIT_ASSERT(twine::numa::node_cpus(nodes[i], cpus));
+
+      twine::cpu_set overlap = all;
+      overlap &= cpus;
+      CPPUNIT_ASSERT(overlap.empty());
+      all |= cpus;
+
+      for (uint32_t cpu = 0 ; cpu < twine::cpu_set::MAX_CPUS ; ++cpu) {
+        if (cpus.test(cpu)) {
+          CPPUNIT_ASSERT_EQUAL(int32_t(nodes[i]),
+              twine::numa::node_of_cpu(cpu));
+        }
+      }
+    }
+
+    CPPUNIT_ASSERT(twine::numa::current_node() >= 0);
+    CPPUNIT_ASSERT(!twine::numa::pin_this_thread_to_node(
+          twine::cpu_set::MAX_CPUS));
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CPUSetTest);
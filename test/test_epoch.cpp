@@ -0,0 +1,341 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/epoch.h>
+#include <twine/thread.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+#include <twine/scoped_lock.h>
+
+namespace {
+
+static twine::atomic<int> freed(0);
+
+struct node
+{
+  static uint32_t const MAGIC = 0xdeadbeef;
+
+  uint32_t  magic;
+  int       value;
+
+  node(int v)
+    : magic(MAGIC)
+    , value(v)
+  {
+  }
+
+  ~node()
+  {
+    magic = 0;
+    freed.fetch_add(1);
+  }
+};
+
+
+void count_free(void *)
+{
+  freed.fetch_add(1);
+}
+
+
+struct retire_args
+{
+  twine::epoch_domain * domain;
+  int                   count;
+};
+
+void thread_retire(void * arg)
+{
+  retire_args * args = static_cast<retire_args *>(arg);
+  for (int i = 0 ; i < args->count ; ++i) {
+    args->domain->retire(new node(i));
+  }
+}
+
+
+// Holds a critical section open on another thread until released.
+struct pinned_reader
+{
+  twine::epoch_domain &     domain;
+  twine::mutex              mutex;
+  twine::condition          cond;
+  bool                      entered;
+  bool                      release;
+
+  pinned_reader(twine::epoch_domain & d)
+    : domain(d)
+    , entered(false)
+    , release(false)
+  {
+  }
+};
+
+void thread_pin(void * arg)
+{
+  pinned_reader * reader = static_cast<pinned_reader *>(arg);
+  twine::epoch_domain::guard g(reader->domain);
+
+  twine::scoped_lock<twine::mutex> lock(reader->mutex);
+  reader->entered = true;
+  reader->cond.notify_all();
+  while (!reader->release) {
+    reader->cond.wait(lock);
+  }
+}
+
+
+static int const STRESS_READERS = 3;
+static int const STRESS_SWAPS = 20000;
+
+struct shared_state
+{
+  twine::epoch_domain   domain;
+  twine::atomic<node *> current;
+  twine::atomic<int>    done;
+  twine::atomic<int>    corrupt;
+
+  shared_state()
+    : domain(16)
+    , current(new node(0))
+    , done(0)
+    , corrupt(0)
+  {
+  }
+};
+
+void thread_read(void * arg)
+{
+  shared_state * state = static_cast<shared_state *>(arg);
+  while (!state->done.load()) {
+    twine::epoch_domain::guard g(state->domain);
+    node * n = state->current.load(twine::memory_order_acquire);
+    if (n->magic != node::MAGIC) {
+      state->corrupt.fetch_add(1);
+    }
+  }
+}
+
+void thread_write(void * arg)
+{
+  shared_state * state = static_cast<shared_state *>(arg);
+  for (int i = 1 ; i <= STRESS_SWAPS ; ++i) {
+    node * old = state->current.exchange(new node(i));
+    state->domain.retire(old);
+  }
+  state->done.store(1);
+}
+
+} // anonymous namespace
+
+
+class EpochTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(EpochTest);
+
+      CPPUNIT_TEST(testCollect);
+      CPPUNIT_TEST(testGuard);
+      CPPUNIT_TEST(testOtherThreadGuard);
+      CPPUNIT_TEST(testBatch);
+      CPPUNIT_TEST(testThreadExit);
+      CPPUNIT_TEST(testDomainDestruction);
+      CPPUNIT_TEST(testStress);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testCollect()
+  {
+    twine::epoch_domain domain;
+    freed.store(0);
+
+    domain.retire(new node(1));
+    domain.retire(static_cast<void *>(&domain), count_free);
+    domain.retire<node>(nullptr);
+    CPPUNIT_ASSERT_EQUAL(0, freed.load());
+
+    // Nobody is in a critical section, so collect() can advance far enough.
+    uint64_t epoch = domain.epoch();
+    domain.collect();
+    CPPUNIT_ASSERT_EQUAL(2, freed.load());
+    CPPUNIT_ASSERT(domain.epoch() >= epoch + 2);
+
+    CPPUNIT_ASSERT(domain.unregister_thread());
+    CPPUNIT_ASSERT(!domain.unregister_thread());
+  }
+
+
+  void testGuard()
+  {
+    twine::epoch_domain domain;
+    freed.store(0);
+
+    {
+      twine::epoch_domain::guard outer(domain);
+      node * n = new node(1);
+      domain.retire(n);
+
+      {
+        twine::epoch_domain::guard inner(domain);
+      }
+
+      // Still inside the outer critical section; n must survive.
+      domain.collect();
+      domain.collect();
+      CPPUNIT_ASSERT_EQUAL(0, freed.load());
+      CPPUNIT_ASSERT_EQUAL(node::MAGIC, n->magic);
+
+      // Can't unregister from within a critical section.
+      CPPUNIT_ASSERT(!domain.unregister_thread());
+    }
+
+    domain.collect();
+    CPPUNIT_ASSERT_EQUAL(1, freed.load());
+  }
+
+
+  void testOtherThreadGuard()
+  {
+    twine::epoch_domain domain;
+    freed.store(0);
+
+    pinned_reader reader(domain);
+    twine::thread th(thread_pin, &reader);
+    {
+      twine::scoped_lock<twine::mutex> lock(reader.mutex);
+      while (!reader.entered) {
+        reader.cond.wait(lock);
+      }
+    }
+
+    domain.retire(new node(1));
+    domain.collect();
+    domain.collect();
+    CPPUNIT_ASSERT_EQUAL(0, freed.load());
+
+    {
+      twine::scoped_lock<twine::mutex> lock(reader.mutex);
+      reader.release = true;
+      reader.cond.notify_all();
+    }
+    th.join();
+
+    domain.collect();
+    CPPUNIT_ASSERT_EQUAL(1, freed.load());
+  }
+
+
+  void testBatch()
+  {
+    twine::epoch_domain domain(8);
+    freed.store(0);
+
+    for (int i = 0 ; i < 7 ; ++i) {
+      domain.retire(new node(i));
+    }
+    CPPUNIT_ASSERT_EQUAL(0, freed.load());
+
+    // The eighth node completes the batch and triggers reclamation.
+    domain.retire(new node(7));
+    CPPUNIT_ASSERT_EQUAL(8, freed.load());
+  }
+
+
+  void testThreadExit()
+  {
+    twine::epoch_domain domain;
+    freed.store(0);
+
+    // The thread retires fewer nodes than the batch size; they are freed
+    // when it exits.
+    retire_args args = { &domain, 10 };
+    twine::thread th(thread_retire, &args);
+    th.join();
+    CPPUNIT_ASSERT_EQUAL(10, freed.load());
+  }
+
+
+  void testDomainDestruction()
+  {
+    freed.store(0);
+    {
+      twine::epoch_domain domain;
+
+      pinned_reader reader(domain);
+      twine::thread th(thread_pin, &reader);
+      {
+        twine::scoped_lock<twine::mutex> lock(reader.mutex);
+        while (!reader.entered) {
+          reader.cond.wait(lock);
+        }
+      }
+
+      // The reader blocks reclamation, so the nodes survive this thread
+      // unregistering, and the reader exiting.
+      domain.retire(new node(1));
+      domain.retire(new node(2));
+      CPPUNIT_ASSERT(domain.unregister_thread());
+      CPPUNIT_ASSERT_EQUAL(0, freed.load());
+
+      {
+        twine::scoped_lock<twine::mutex> lock(reader.mutex);
+        reader.release = true;
+        reader.cond.notify_all();
+      }
+      th.join();
+    }
+    CPPUNIT_ASSERT_EQUAL(2, freed.load());
+  }
+
+
+  void testStress()
+  {
+    freed.store(0);
+    {
+      shared_state state;
+
+      twine::thread * readers[STRESS_READERS];
+      for (int i = 0 ; i < STRESS_READERS ; ++i) {
+        readers[i] = new twine::thread(thread_read, &state);
+      }
+      twine::thread writer(thread_write, &state);
+
+      writer.join();
+      for (int i = 0 ; i < STRESS_READERS ; ++i) {
+        readers[i]->join();
+        delete readers[i];
+      }
+
+      CPPUNIT_ASSERT_EQUAL(0, state.corrupt.load());
+
+      // Nodes may still be pending if a reader was inside a critical section
+      // when the writer exited; destroying the domain frees them.
+      delete state.current.load();
+    }
+    CPPUNIT_ASSERT_EQUAL(STRESS_SWAPS + 1, freed.load());
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(EpochTest);
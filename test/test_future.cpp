@@ -0,0 +1,344 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include <twine/future.h>
+#include <twine/thread.h>
+#include <twine/thread_pool.h>
+#include <twine/atomic.h>
+
+#define FUTURE_TEST_DELAY twine::chrono::milliseconds(50)
+
+namespace {
+
+struct delayed_value
+{
+  twine::promise<int> * p;
+  int                   value;
+};
+
+
+void set_delayed(void * baton)
+{
+  delayed_value * dv = static_cast<delayed_value *>(baton);
+  twine::this_thread::sleep_for(FUTURE_TEST_DELAY);
+  dv->p->set_value(dv->value);
+}
+
+
+int add_one(twine::future<int> const & f, void *)
+{
+  return f.get() + 1;
+}
+
+
+int report_broken(twine::future<int> const & f, void *)
+{
+  return f.is_broken() ? -1 : f.get();
+}
+
+
+void count_calls(twine::future<int> const &, void * baton)
+{
+  static_cast<twine::atomic<uint32_t> *>(baton)->fetch_add(1);
+}
+
+
+bool check_worker(twine::future<int> const &, void * baton)
+{
+  return static_cast<twine::thread_pool *>(baton)->is_worker();
+}
+
+
+struct multi_producer
+{
+  std::vector<twine::promise<int> *> * promises;
+  size_t                              start;
+  size_t                              step;
+};
+
+
+void produce(void * baton)
+{
+  multi_producer * mp = static_cast<multi_producer *>(baton);
+  for (size_t i = mp->start ; i < mp->promises->size() ; i += mp->step) {
+    (*mp->promises)[i]->set_value(int(i));
+  }
+}
+
+} // anonymous namespace
+
+
+class FutureTest
+  : public CppUnit::TestFixture
+{
+public:
+  CPPUNIT_TEST_SUITE(FutureTest);
+
+    CPPUNIT_TEST(testReady);
+    CPPUNIT_TEST(testBlockingGet);
+    CPPUNIT_TEST(testWaitFor);
+    CPPUNIT_TEST(testBrokenPromise);
+    CPPUNIT_TEST(testInvalid);
+    CPPUNIT_TEST(testVoid);
+    CPPUNIT_TEST(testThen);
+    CPPUNIT_TEST(testThenBroken);
+    CPPUNIT_TEST(testThenExecutor);
+    CPPUNIT_TEST(testWhenAll);
+    CPPUNIT_TEST(testWhenAny);
+    CPPUNIT_TEST(testManyProducers);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testReady()
+  {
+    twine::promise<int> p;
+    twine::future<int> f = p.get_future();
+    CPPUNIT_ASSERT(f.valid());
+    CPPUNIT_ASSERT(!f.is_ready());
+
+    CPPUNIT_ASSERT(p.set_value(42));
+    CPPUNIT_ASSERT(!p.set_value(23));
+
+    CPPUNIT_ASSERT(f.is_ready());
+    CPPUNIT_ASSERT(!f.is_broken());
+    CPPUNIT_ASSERT_EQUAL(42, f.get());
+
+    // Copies share the result.
+    twine::future<int> copy = f;
+    CPPUNIT_ASSERT_EQUAL(42, copy.get());
+    CPPUNIT_ASSERT_EQUAL(42, p.get_future().get());
+  }
+
+
+  void testBlockingGet()
+  {
+    twine::promise<int> p;
+    twine::future<int> f = p.get_future();
+
+    delayed_value dv = { &p, 123 };
+    twine::thread th(set_delayed, &dv);
+
+    CPPUNIT_ASSERT_EQUAL(123, f.get());
+    th.join();
+  }
+
+
+  void testWaitFor()
+  {
+    twine::promise<int> p;
+    twine::future<int> f = p.get_future();
+    CPPUNIT_ASSERT(!f.wait_for(twine::chrono::milliseconds(10)));
+
+    delayed_value dv = { &p, 1 };
+    twine::thread th(set_delayed, &dv);
+    CPPUNIT_ASSERT(f.wait_for(twine::chrono::seconds(5)));
+    CPPUNIT_ASSERT_EQUAL(1, f.get());
+    th.join();
+  }
+
+
+  void testBrokenPromise()
+  {
+    twine::future<int> f;
+    {
+      twine::promise<int> p;
+      f = p.get_future();
+    }
+    CPPUNIT_ASSERT(f.is_ready());
+    CPPUNIT_ASSERT(f.is_broken());
+    f.wait();
+    CPPUNIT_ASSERT_THROW(f.get(), std::runtime_error);
+  }
+
+
+  void testInvalid()
+  {
+    twine::future<int> f;
+    CPPUNIT_ASSERT(!f.valid());
+    CPPUNIT_ASSERT(!f.is_ready());
+    CPPUNIT_ASSERT(!f.wait_for(twine::chrono::milliseconds(1)));
+    CPPUNIT_ASSERT_THROW(f.get(), std::runtime_error);
+    CPPUNIT_ASSERT(!f.then(add_one).valid());
+  }
+
+
+  void testVoid()
+  {
+    twine::promise<void> p;
+    twine::future<void> f = p.get_future();
+    CPPUNIT_ASSERT(!f.is_ready());
+    CPPUNIT_ASSERT(p.set_value());
+    CPPUNIT_ASSERT(!p.set_value());
+    f.get();
+    CPPUNIT_ASSERT(f.is_ready());
+  }
+
+
+  void testThen()
+  {
+    // Attached before the value is set
+    twine::promise<int> p;
+    twine::future<int> f = p.get_future().then(add_one).then(add_one);
+    CPPUNIT_ASSERT(!f.is_ready());
+    p.set_value(1);
+    CPPUNIT_ASSERT(f.is_ready());
+    CPPUNIT_ASSERT_EQUAL(3, f.get());
+
+    // Attached after the value is set
+    twine::future<int> g = p.get_future().then(add_one);
+    CPPUNIT_ASSERT(g.is_ready());
+    CPPUNIT_ASSERT_EQUAL(2, g.get());
+
+    // Continuations returning void; each runs exactly once.
+    twine::atomic<uint32_t> calls(0);
+    twine::promise<int> q;
+    twine::future<void> v1 = q.get_future().then(count_calls, &calls);
+    twine::future<void> v2 = q.get_future().then(count_calls, &calls);
+    q.set_value(0);
+    v1.get();
+    v2.get();
+    CPPUNIT_ASSERT_EQUAL(uint32_t(2), calls.load());
+  }
+
+
+  void testThenBroken()
+  {
+    twine::future<int> f;
+    {
+      twine::promise<int> p;
+      f = p.get_future().then(report_broken);
+    }
+    CPPUNIT_ASSERT_EQUAL(-1, f.get());
+  }
+
+
+  void testThenExecutor()
+  {
+    twine::thread_pool pool(2);
+    twine::promise<int> p;
+    twine::future<bool> on_worker = p.get_future().then(check_worker, &pool,
+        &pool);
+    twine::future<bool> inline_run = p.get_future().then(check_worker, &pool);
+
+    p.set_value(0);
+    CPPUNIT_ASSERT(on_worker.get());
+    CPPUNIT_ASSERT(!inline_run.get());
+    pool.wait();
+  }
+
+
+  void testWhenAll()
+  {
+    std::vector<twine::promise<int> *> promises;
+    std::vector<twine::future<int> > futures;
+    for (int i = 0 ; i < 10 ; ++i) {
+      promises.push_back(new twine::promise<int>());
+      futures.push_back(promises.back()->get_future());
+    }
+
+    twine::future<void> all = twine::when_all(futures.begin(), futures.end());
+    for (size_t i = 0 ; i < promises.size() ; ++i) {
+      CPPUNIT_ASSERT(!all.is_ready());
+      promises[i]->set_value(int(i));
+    }
+    CPPUNIT_ASSERT(all.is_ready());
+    CPPUNIT_ASSERT(!all.is_broken());
+
+    for (size_t i = 0 ; i < promises.size() ; ++i) {
+      delete promises[i];
+    }
+
+    // An empty range is ready immediately.
+    CPPUNIT_ASSERT(twine::when_all(futures.end(), futures.end()).is_ready());
+  }
+
+
+  void testWhenAny()
+  {
+    std::vector<twine::promise<int> *> promises;
+    std::vector<twine::future<int> > futures;
+    for (int i = 0 ; i < 10 ; ++i) {
+      promises.push_back(new twine::promise<int>());
+      futures.push_back(promises.back()->get_future());
+    }
+
+    twine::future<size_t> any = twine::when_any(futures.begin(),
+        futures.end());
+    CPPUNIT_ASSERT(!any.is_ready());
+    promises[7]->set_value(7);
+    CPPUNIT_ASSERT(any.is_ready());
+    CPPUNIT_ASSERT_EQUAL(size_t(7), any.get());
+
+    promises[3]->set_value(3);
+    CPPUNIT_ASSERT_EQUAL(size_t(7), any.get());
+
+    for (size_t i = 0 ; i < promises.size() ; ++i) {
+      delete promises[i];
+    }
+
+    // An empty range can never become ready with an index.
+    CPPUNIT_ASSERT(twine::when_any(futures.end(), futures.end()).is_broken());
+  }
+
+
+  void testManyProducers()
+  {
+    std::vector<twine::promise<int> *> promises;
+    std::vector<twine::future<int> > futures;
+    for (int i = 0 ; i < 10000 ; ++i) {
+      promises.push_back(new twine::promise<int>());
+      futures.push_back(promises.back()->get_future().then(add_one));
+    }
+    twine::future<void> all = twine::when_all(futures.begin(), futures.end());
+
+    multi_producer mp[4];
+    twine::thread threads[4];
+    for (size_t i = 0 ; i < 4 ; ++i) {
+      mp[i].promises = &promises;
+      mp[i].start = i;
+      mp[i].step = 4;
+      threads[i].set_func(produce, &mp[i]);
+      threads[i].start();
+    }
+
+    all.wait();
+    for (size_t i = 0 ; i < futures.size() ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(int(i) + 1, futures[i].get());
+    }
+
+    for (size_t i = 0 ; i < 4 ; ++i) {
+      threads[i].join();
+    }
+    for (size_t i = 0 ; i < promises.size() ; ++i) {
+      delete promises[i];
+    }
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(FutureTest);
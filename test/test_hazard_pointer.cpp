@@ -0,0 +1,336 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/hazard_pointer.h>
+#include <twine/tasklet.h>
+#include <twine/thread.h>
+
+namespace {
+
+static twine::atomic<int> freed(0);
+
+struct node
+{
+  static uint32_t const MAGIC = 0xdeadbeef;
+
+  uint32_t  magic;
+  int       value;
+
+  node(int v)
+    : magic(MAGIC)
+    , value(v)
+  {
+  }
+
+  ~node()
+  {
+    magic = 0;
+    freed.fetch_add(1);
+  }
+};
+
+
+struct retire_args
+{
+  twine::hazard_domain *  domain;
+  int                     count;
+};
+
+void thread_retire(void * arg)
+{
+  retire_args * args = static_cast<retire_args *>(arg);
+  for (int i = 0 ; i < args->count ; ++i) {
+    args->domain->retire(new node(i));
+  }
+}
+
+
+// A reader that protects a node, then goes to sleep until told to check it.
+struct sleepy_reader
+{
+  twine::hazard_domain &  domain;
+  twine::atomic<node *> & src;
+  twine::atomic<int>      protecting;
+  twine::atomic<int>      release;
+  bool                    intact;
+
+  sleepy_reader(twine::hazard_domain & d, twine::atomic<node *> & s)
+    : domain(d)
+    , src(s)
+    , protecting(0)
+    , release(0)
+    , intact(false)
+  {
+  }
+};
+
+void tasklet_read(twine::tasklet & t, void * arg)
+{
+  sleepy_reader * reader = static_cast<sleepy_reader *>(arg);
+  twine::hazard_pointer hp(reader->domain);
+  node * n = hp.protect(reader->src);
+  reader->protecting.store(1);
+
+  while (!reader->release.load() && t.sleep()) {
+  }
+  reader->intact = (n->magic == node::MAGIC);
+}
+
+
+void wait_for(twine::atomic<int> const & flag)
+{
+  while (!flag.load()) {
+    twine::this_thread::yield();
+  }
+}
+
+
+static int const STRESS_READERS = 3;
+static int const STRESS_WRITERS = 2;
+static int const STRESS_SWAPS = 20000;
+
+struct shared_state
+{
+  twine::hazard_domain  domain;
+  twine::atomic<node *> current;
+  twine::atomic<int>    writers_done;
+  twine::atomic<int>    corrupt;
+
+  shared_state()
+    : domain(16)
+    , current(new node(0))
+    , writers_done(0)
+    , corrupt(0)
+  {
+  }
+};
+
+void thread_read(void * arg)
+{
+  shared_state * state = static_cast<shared_state *>(arg);
+  twine::hazard_pointer hp(state->domain);
+  while (state->writers_done.load() < STRESS_WRITERS) {
+    node * n = hp.protect(state->current);
+    if (n->magic != node::MAGIC) {
+      state->corrupt.fetch_add(1);
+    }
+    hp.reset();
+  }
+}
+
+void thread_write(void * arg)
+{
+  shared_state * state = static_cast<shared_state *>(arg);
+  for (int i = 1 ; i <= STRESS_SWAPS ; ++i) {
+    node * old = state->current.exchange(new node(i));
+    state->domain.retire(old);
+  }
+  state->writers_done.fetch_add(1);
+}
+
+} // anonymous namespace
+
+
+class HazardPointerTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(HazardPointerTest);
+
+      CPPUNIT_TEST(testProtect);
+      CPPUNIT_TEST(testTryProtect);
+      CPPUNIT_TEST(testThreshold);
+      CPPUNIT_TEST(testThreadExit);
+      CPPUNIT_TEST(testBoundedGrowth);
+      CPPUNIT_TEST(testTaskletReader);
+      CPPUNIT_TEST(testStress);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testProtect()
+  {
+    twine::hazard_domain domain;
+    freed.store(0);
+
+    node * n = new node(1);
+    twine::atomic<node *> src(n);
+
+    {
+      twine::hazard_pointer hp(domain);
+      CPPUNIT_ASSERT_EQUAL(n, hp.protect(src));
+
+      src.store(nullptr);
+      domain.retire(n);
+      domain.collect();
+      CPPUNIT_ASSERT_EQUAL(0, freed.load());
+      CPPUNIT_ASSERT_EQUAL(size_t(1), domain.pending());
+      CPPUNIT_ASSERT_EQUAL(node::MAGIC, n->magic);
+
+      hp.reset();
+      domain.collect();
+      CPPUNIT_ASSERT_EQUAL(1, freed.load());
+      CPPUNIT_ASSERT_EQUAL(size_t(0), domain.pending());
+    }
+
+    CPPUNIT_ASSERT(domain.unregister_thread());
+    CPPUNIT_ASSERT(!domain.unregister_thread());
+  }
+
+
+  void testTryProtect()
+  {
+    twine::hazard_domain domain;
+    node a(1);
+    node b(2);
+    twine::atomic<node *> src(&a);
+
+    twine::hazard_pointer hp(domain);
+    node * ptr = src.load();
+    src.store(&b);
+    CPPUNIT_ASSERT(!hp.try_protect(ptr, src));
+    CPPUNIT_ASSERT_EQUAL(&b, ptr);
+    CPPUNIT_ASSERT(hp.try_protect(ptr, src));
+    CPPUNIT_ASSERT_EQUAL(&b, ptr);
+  }
+
+
+  void testThreshold()
+  {
+    twine::hazard_domain domain(8);
+    freed.store(0);
+
+    for (int i = 0 ; i < 7 ; ++i) {
+      domain.retire(new node(i));
+    }
+    CPPUNIT_ASSERT_EQUAL(0, freed.load());
+    CPPUNIT_ASSERT_EQUAL(size_t(7), domain.pending());
+
+    // The eighth node reaches the threshold and triggers a scan.
+    domain.retire(new node(7));
+    CPPUNIT_ASSERT_EQUAL(8, freed.load());
+    CPPUNIT_ASSERT_EQUAL(size_t(0), domain.pending());
+  }
+
+
+  void testThreadExit()
+  {
+    twine::hazard_domain domain;
+    freed.store(0);
+
+    // The thread retires fewer nodes than the threshold; they are freed when
+    // it exits.
+    retire_args args = { &domain, 10 };
+    twine::thread th(thread_retire, &args);
+    th.join();
+    CPPUNIT_ASSERT_EQUAL(10, freed.load());
+  }
+
+
+  void testBoundedGrowth()
+  {
+    twine::hazard_domain domain(8);
+    freed.store(0);
+
+    // A reader that never lets go keeps exactly its node alive, no matter
+    // how many nodes are retired after it.
+    node * slow = new node(0);
+    twine::atomic<node *> src(slow);
+    twine::hazard_pointer hp(domain);
+    hp.protect(src);
+
+    domain.retire(slow);
+    for (int i = 1 ; i <= 1000 ; ++i) {
+      domain.retire(new node(i));
+      CPPUNIT_ASSERT(domain.pending() <= 8 + 1);
+    }
+    CPPUNIT_ASSERT_EQUAL(node::MAGIC, slow->magic);
+
+    hp.reset();
+    domain.collect();
+    CPPUNIT_ASSERT_EQUAL(1001, freed.load());
+  }
+
+
+  void testTaskletReader()
+  {
+    twine::hazard_domain domain;
+    freed.store(0);
+
+    twine::atomic<node *> src(new node(1));
+    sleepy_reader reader(domain, src);
+    twine::tasklet t(tasklet_read, &reader);
+    CPPUNIT_ASSERT(t.start());
+    wait_for(reader.protecting);
+
+    // The node stays alive while the tasklet sleeps on it.
+    domain.retire(src.exchange(nullptr));
+    domain.collect();
+    CPPUNIT_ASSERT_EQUAL(0, freed.load());
+
+    reader.release.store(1);
+    t.notify();
+    CPPUNIT_ASSERT(t.wait());
+    CPPUNIT_ASSERT(reader.intact);
+
+    domain.collect();
+    CPPUNIT_ASSERT_EQUAL(1, freed.load());
+  }
+
+
+  void testStress()
+  {
+    freed.store(0);
+    {
+      shared_state state;
+
+      twine::thread * readers[STRESS_READERS];
+      for (int i = 0 ; i < STRESS_READERS ; ++i) {
+        readers[i] = new twine::thread(thread_read, &state);
+      }
+      twine::thread * writers[STRESS_WRITERS];
+      for (int i = 0 ; i < STRESS_WRITERS ; ++i) {
+        writers[i] = new twine::thread(thread_write, &state);
+      }
+
+      for (int i = 0 ; i < STRESS_WRITERS ; ++i) {
+        writers[i]->join();
+        delete writers[i];
+      }
+      for (int i = 0 ; i < STRESS_READERS ; ++i) {
+        readers[i]->join();
+        delete readers[i];
+      }
+
+      CPPUNIT_ASSERT_EQUAL(0, state.corrupt.load());
+
+      // Nodes may still be pending if a reader protected them when their
+      // writer exited; destroying the domain frees them.
+      delete state.current.load();
+    }
+    CPPUNIT_ASSERT_EQUAL(STRESS_WRITERS * STRESS_SWAPS + 1, freed.load());
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(HazardPointerTest);
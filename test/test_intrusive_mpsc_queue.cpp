@@ -0,0 +1,245 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/intrusive_mpsc_queue.h>
+#include <twine/tasklet.h>
+#include <twine/thread.h>
+
+#include "compare_times.h"
+
+#define QUEUE_TEST_DELAY twine::chrono::milliseconds(50)
+
+namespace {
+
+struct event
+{
+  int                         producer;
+  int                         sequence;
+  twine::intrusive_mpsc_hook  hook;
+};
+
+typedef twine::intrusive_mpsc_queue<event, &event::hook> event_queue;
+
+static int const EVENT_PRODUCERS = 4;
+static int const EVENTS = 20000;
+
+struct fan_in
+{
+  event_queue           queue;
+  event *               events;
+  int                   received;
+  bool                  ordered;
+  int                   last[EVENT_PRODUCERS];
+
+  fan_in()
+    : events(new event[EVENT_PRODUCERS * EVENTS])
+    , received(0)
+    , ordered(true)
+  {
+    for (int i = 0 ; i < EVENT_PRODUCERS ; ++i) {
+      last[i] = -1;
+    }
+    for (int i = 0 ; i < EVENT_PRODUCERS * EVENTS ; ++i) {
+      events[i].producer = i / EVENTS;
+      events[i].sequence = i % EVENTS;
+    }
+  }
+
+  ~fan_in()
+  {
+    delete [] events;
+  }
+
+  void operator()(event * e)
+  {
+    if (e->sequence != last[e->producer] + 1) {
+      ordered = false;
+    }
+    last[e->producer] = e->sequence;
+    ++received;
+  }
+};
+
+struct producer_args
+{
+  fan_in *  f;
+  int       producer;
+};
+
+
+void thread_produce(void * arg)
+{
+  producer_args * args = static_cast<producer_args *>(arg);
+  event * events = &args->f->events[args->producer * EVENTS];
+  for (int i = 0 ; i < EVENTS ; ++i) {
+    args->f->queue.push(&events[i]);
+  }
+}
+
+
+void tasklet_consume(twine::tasklet & t, void * arg)
+{
+  fan_in * f = static_cast<fan_in *>(arg);
+  while (f->received < EVENT_PRODUCERS * EVENTS) {
+    if (!f->queue.wait_readable(t)) {
+      return;
+    }
+    f->queue.drain(*f);
+  }
+}
+
+
+static int drained = 0;
+
+void count_event(event *)
+{
+  ++drained;
+}
+
+} // anonymous namespace
+
+
+class IntrusiveMPSCQueueTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(IntrusiveMPSCQueueTest);
+
+      CPPUNIT_TEST(testOrdering);
+      CPPUNIT_TEST(testDrain);
+      CPPUNIT_TEST(testTimedPop);
+      CPPUNIT_TEST(testBlockingConsumer);
+      CPPUNIT_TEST(testTaskletConsumer);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testOrdering()
+  {
+    event_queue q;
+    event events[3];
+    CPPUNIT_ASSERT(q.empty());
+    CPPUNIT_ASSERT(!q.try_pop());
+
+    q.push(&events[0]);
+    q.push(&events[1]);
+    CPPUNIT_ASSERT(!q.empty());
+    CPPUNIT_ASSERT_EQUAL(&events[0], q.try_pop());
+
+    // Values can be pushed again once popped.
+    q.push(&events[2]);
+    q.push(&events[0]);
+    CPPUNIT_ASSERT_EQUAL(&events[1], q.try_pop());
+    CPPUNIT_ASSERT_EQUAL(&events[2], q.try_pop());
+    CPPUNIT_ASSERT_EQUAL(&events[0], q.try_pop());
+    CPPUNIT_ASSERT(!q.try_pop());
+    CPPUNIT_ASSERT(q.empty());
+  }
+
+
+  void testDrain()
+  {
+    event_queue q;
+    event events[10];
+    for (int i = 0 ; i < 10 ; ++i) {
+      q.push(&events[i]);
+    }
+
+    drained = 0;
+    CPPUNIT_ASSERT_EQUAL(size_t(4), q.drain(count_event, 4));
+    CPPUNIT_ASSERT_EQUAL(4, drained);
+    CPPUNIT_ASSERT_EQUAL(size_t(6), q.drain(count_event));
+    CPPUNIT_ASSERT_EQUAL(10, drained);
+    CPPUNIT_ASSERT_EQUAL(size_t(0), q.drain(count_event));
+  }
+
+
+  void testTimedPop()
+  {
+    namespace tc = twine::chrono;
+    event_queue q;
+
+    tc::nanoseconds before = tc::now();
+    CPPUNIT_ASSERT(!q.timed_pop(QUEUE_TEST_DELAY));
+    tc::nanoseconds after = tc::now();
+    compare_times(before, after, QUEUE_TEST_DELAY);
+
+    event e;
+    q.push(&e);
+    CPPUNIT_ASSERT_EQUAL(&e, q.timed_pop(QUEUE_TEST_DELAY));
+  }
+
+
+  void testBlockingConsumer()
+  {
+    fan_in f;
+
+    producer_args args[EVENT_PRODUCERS];
+    twine::thread * producers[EVENT_PRODUCERS];
+    for (int i = 0 ; i < EVENT_PRODUCERS ; ++i) {
+      args[i].f = &f;
+      args[i].producer = i;
+      producers[i] = new twine::thread(thread_produce, &args[i]);
+    }
+
+    for (int i = 0 ; i < EVENT_PRODUCERS * EVENTS ; ++i) {
+      f(f.queue.pop());
+    }
+
+    for (int i = 0 ; i < EVENT_PRODUCERS ; ++i) {
+      producers[i]->join();
+      delete producers[i];
+    }
+
+    CPPUNIT_ASSERT_EQUAL(EVENT_PRODUCERS * EVENTS, f.received);
+    CPPUNIT_ASSERT(f.ordered);
+    CPPUNIT_ASSERT(f.queue.empty());
+  }
+
+
+  void testTaskletConsumer()
+  {
+    fan_in f;
+    twine::tasklet consumer(tasklet_consume, &f);
+    CPPUNIT_ASSERT(consumer.start());
+
+    producer_args args[EVENT_PRODUCERS];
+    twine::thread * producers[EVENT_PRODUCERS];
+    for (int i = 0 ; i < EVENT_PRODUCERS ; ++i) {
+      args[i].f = &f;
+      args[i].producer = i;
+      producers[i] = new twine::thread(thread_produce, &args[i]);
+    }
+    for (int i = 0 ; i < EVENT_PRODUCERS ; ++i) {
+      producers[i]->join();
+      delete producers[i];
+    }
+    CPPUNIT_ASSERT(consumer.wait());
+
+    CPPUNIT_ASSERT_EQUAL(EVENT_PRODUCERS * EVENTS, f.received);
+    CPPUNIT_ASSERT(f.ordered);
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(IntrusiveMPSCQueueTest);
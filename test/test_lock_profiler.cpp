@@ -0,0 +1,240 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <sstream>
+
+#include <twine/lock_profiler.h>
+#include <twine/condition.h>
+#include <twine/thread.h>
+
+#define PROFILER_TEST_DELAY twine::chrono::milliseconds(20)
+
+namespace {
+
+typedef twine::instrumented_mutex<twine::mutex> test_mutex;
+
+struct baton
+{
+  test_mutex        m;
+  twine::condition  cond;
+  bool              done;
+
+  baton()
+    : m("test baton")
+    , done(false)
+  {
+  }
+};
+
+
+void thread_lock(void * arg)
+{
+  baton * b = static_cast<baton *>(arg);
+  twine::scoped_lock<test_mutex> lock(b->m);
+  b->done = true;
+  b->cond.notify_all();
+}
+
+
+static int const WAKER_LOCKS = 100;
+
+void thread_lock_repeatedly(void * arg)
+{
+  baton * b = static_cast<baton *>(arg);
+  for (int i = 0 ; i < WAKER_LOCKS ; ++i) {
+    twine::scoped_lock<test_mutex> lock(b->m);
+  }
+  thread_lock(arg);
+}
+
+
+bool find_stats(std::string const & name, twine::lock_stats & result)
+{
+  std::vector<twine::lock_stats> stats;
+  twine::lock_profiler::collect(stats);
+  for (size_t i = 0 ; i < stats.size() ; ++i) {
+    if (stats[i].name == name) {
+      result = stats[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+} // anonymous namespace
+
+
+class LockProfilerTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(LockProfilerTest);
+
+      CPPUNIT_TEST(testForwarding);
+      CPPUNIT_TEST(testCondition);
+      CPPUNIT_TEST(testStatistics);
+      CPPUNIT_TEST(testReport);
+      CPPUNIT_TEST(testPercentile);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testForwarding()
+  {
+    {
+      test_mutex m("forwarding");
+      CPPUNIT_ASSERT_EQUAL(true, m.try_lock());
+      CPPUNIT_ASSERT_EQUAL(false, m.try_lock());
+      m.unlock();
+      {
+        twine::scoped_lock<test_mutex> lock(m);
+        CPPUNIT_ASSERT_EQUAL(false, m.try_lock());
+      }
+      CPPUNIT_ASSERT_EQUAL(true, m.try_lock());
+      m.unlock();
+    }
+
+    {
+      twine::instrumented_mutex<twine::recursive_mutex> m;
+      m.lock();
+      CPPUNIT_ASSERT_EQUAL(true, m.try_lock());
+      m.unlock();
+      m.unlock();
+    }
+
+    // Without profiling, there must be no overhead.
+    if (!twine::lock_profiler::enabled()) {
+      CPPUNIT_ASSERT_EQUAL(sizeof(twine::mutex), sizeof(test_mutex));
+    }
+  }
+
+
+  void testCondition()
+  {
+    baton b;
+    twine::scoped_lock<test_mutex> lock(b.m);
+    twine::thread th(thread_lock_repeatedly, &b);
+
+    // Other threads lock the mutex while we wait on it, and waking up
+    // reacquires it.
+    uint64_t wakeups = 0;
+    while (!b.done) {
+      b.cond.wait(lock);
+      ++wakeups;
+    }
+
+    twine::lock_stats stats;
+    bool found = find_stats("test baton", stats);
+
+    lock.unlock();
+    th.join();
+    lock.lock();
+
+    CPPUNIT_ASSERT_EQUAL(twine::lock_profiler::enabled(), found);
+    if (found) {
+      CPPUNIT_ASSERT_EQUAL(uint64_t(1 + WAKER_LOCKS + 1 + wakeups),
+          stats.acquisitions);
+    }
+  }
+
+
+  void testStatistics()
+  {
+    if (!twine::lock_profiler::enabled()) {
+      twine::lock_stats stats;
+      test_mutex m("disabled");
+      CPPUNIT_ASSERT_EQUAL(false, find_stats("disabled", stats));
+      return;
+    }
+
+    baton b;
+    for (int i = 0 ; i < 10 ; ++i) {
+      twine::scoped_lock<test_mutex> lock(b.m);
+    }
+
+    twine::lock_stats stats;
+    CPPUNIT_ASSERT_EQUAL(true, find_stats("test baton", stats));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(10), stats.acquisitions);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), stats.contentions);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), stats.total_wait);
+
+    // Force contention; the other thread waits while we hold the lock.
+    b.m.lock();
+    twine::thread th(thread_lock, &b);
+    twine::this_thread::sleep_for(PROFILER_TEST_DELAY);
+    b.m.unlock();
+    th.join();
+
+    CPPUNIT_ASSERT_EQUAL(true, find_stats("test baton", stats));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(12), stats.acquisitions);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(1), stats.contentions);
+    CPPUNIT_ASSERT(stats.max_wait >= uint64_t(PROFILER_TEST_DELAY.raw()) / 2);
+    CPPUNIT_ASSERT(stats.max_hold >= uint64_t(PROFILER_TEST_DELAY.raw()));
+
+    uint64_t samples = 0;
+    for (size_t i = 0 ; i < twine::lock_stats::HISTOGRAM_BUCKETS ; ++i) {
+      samples += stats.hold_histogram[i];
+    }
+    CPPUNIT_ASSERT_EQUAL(uint64_t(12), samples);
+
+    twine::lock_profiler::reset();
+    CPPUNIT_ASSERT_EQUAL(true, find_stats("test baton", stats));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), stats.acquisitions);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), stats.contentions);
+  }
+
+
+  void testReport()
+  {
+    test_mutex m("reported lock");
+    m.lock();
+    m.unlock();
+
+    std::ostringstream os;
+    twine::lock_profiler::report(os);
+    CPPUNIT_ASSERT_EQUAL(twine::lock_profiler::enabled(),
+        std::string::npos != os.str().find("reported lock"));
+  }
+
+
+  void testPercentile()
+  {
+    twine::lock_stats stats;
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0),
+        twine::lock_stats::percentile(stats.wait_histogram, 50));
+
+    // 90 samples in [16, 32), 10 in [1024, 2048)
+    stats.wait_histogram[4] = 90;
+    stats.wait_histogram[10] = 10;
+    CPPUNIT_ASSERT_EQUAL(uint64_t(31),
+        twine::lock_stats::percentile(stats.wait_histogram, 50));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(31),
+        twine::lock_stats::percentile(stats.wait_histogram, 90));
+    CPPUNIT_ASSERT_EQUAL(uint64_t(2047),
+        twine::lock_stats::percentile(stats.wait_histogram, 99));
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LockProfilerTest);
@@ -0,0 +1,197 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/mpmc_queue.h>
+#include <twine/atomic.h>
+#include <twine/thread.h>
+
+#include "compare_times.h"
+
+#define QUEUE_TEST_DELAY twine::chrono::milliseconds(50)
+
+namespace {
+
+static int const QUEUE_PRODUCERS = 4;
+static int const QUEUE_CONSUMERS = 4;
+static int const QUEUE_ITEMS = 20000;
+
+struct transfer
+{
+  twine::mpmc_queue<uint64_t> queue;
+  twine::atomic<uint64_t>     sum;
+  twine::atomic<uint32_t>     count;
+
+  transfer()
+    : queue(16)
+    , sum(0)
+    , count(0)
+  {
+  }
+};
+
+
+void thread_produce(void * arg)
+{
+  transfer * t = static_cast<transfer *>(arg);
+  for (int i = 1 ; i <= QUEUE_ITEMS ; ++i) {
+    t->queue.push(uint64_t(i));
+  }
+}
+
+
+void thread_consume(void * arg)
+{
+  transfer * t = static_cast<transfer *>(arg);
+  for (int i = 0 ; i < QUEUE_ITEMS ; ++i) {
+    uint64_t value = 0;
+    t->queue.pop(value);
+    t->sum.fetch_add(value);
+    t->count.fetch_add(1);
+  }
+}
+
+
+void thread_pop_one(void * arg)
+{
+  twine::mpmc_queue<int> * q = static_cast<twine::mpmc_queue<int> *>(arg);
+  int value = 0;
+  q->pop(value);
+}
+
+} // anonymous namespace
+
+
+class MPMCQueueTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(MPMCQueueTest);
+
+      CPPUNIT_TEST(testCapacity);
+      CPPUNIT_TEST(testOrdering);
+      CPPUNIT_TEST(testTimed);
+      CPPUNIT_TEST(testBlocking);
+      CPPUNIT_TEST(testConcurrent);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testCapacity()
+  {
+    CPPUNIT_ASSERT_EQUAL(size_t(2), twine::mpmc_queue<int>(0).capacity());
+    CPPUNIT_ASSERT_EQUAL(size_t(2), twine::mpmc_queue<int>(2).capacity());
+    CPPUNIT_ASSERT_EQUAL(size_t(8), twine::mpmc_queue<int>(5).capacity());
+    CPPUNIT_ASSERT_EQUAL(size_t(64), twine::mpmc_queue<int>(64).capacity());
+  }
+
+
+  void testOrdering()
+  {
+    twine::mpmc_queue<int> q(4);
+    int value = -1;
+    CPPUNIT_ASSERT_EQUAL(false, q.try_pop(value));
+
+    // Go around the array a few times.
+    for (int lap = 0 ; lap < 3 ; ++lap) {
+      for (int i = 0 ; i < 4 ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, q.try_push(lap * 4 + i));
+      }
+      CPPUNIT_ASSERT_EQUAL(false, q.try_push(42));
+      CPPUNIT_ASSERT_EQUAL(size_t(4), q.size());
+
+      for (int i = 0 ; i < 4 ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, q.try_pop(value));
+        CPPUNIT_ASSERT_EQUAL(lap * 4 + i, value);
+      }
+      CPPUNIT_ASSERT_EQUAL(false, q.try_pop(value));
+      CPPUNIT_ASSERT_EQUAL(size_t(0), q.size());
+    }
+  }
+
+
+  void testTimed()
+  {
+    namespace tc = twine::chrono;
+    twine::mpmc_queue<int> q(2);
+    int value = -1;
+
+    tc::nanoseconds before = tc::now();
+    CPPUNIT_ASSERT_EQUAL(false, q.timed_pop(value, QUEUE_TEST_DELAY));
+    tc::nanoseconds after = tc::now();
+    compare_times(before, after, QUEUE_TEST_DELAY);
+
+    CPPUNIT_ASSERT_EQUAL(true, q.timed_push(1, QUEUE_TEST_DELAY));
+    CPPUNIT_ASSERT_EQUAL(true, q.timed_push(2, QUEUE_TEST_DELAY));
+
+    before = tc::now();
+    CPPUNIT_ASSERT_EQUAL(false, q.timed_push(3, QUEUE_TEST_DELAY));
+    after = tc::now();
+    compare_times(before, after, QUEUE_TEST_DELAY);
+
+    CPPUNIT_ASSERT_EQUAL(true, q.timed_pop(value, QUEUE_TEST_DELAY));
+    CPPUNIT_ASSERT_EQUAL(1, value);
+  }
+
+
+  void testBlocking()
+  {
+    twine::mpmc_queue<int> q(2);
+
+    // Both threads wait on the empty queue; each push wakes one of them.
+    twine::thread th1(thread_pop_one, &q);
+    twine::thread th2(thread_pop_one, &q);
+    twine::this_thread::sleep_for(QUEUE_TEST_DELAY);
+
+    CPPUNIT_ASSERT_EQUAL(true, q.try_push(1));
+    CPPUNIT_ASSERT_EQUAL(true, q.push(2));
+    th1.join();
+    th2.join();
+    CPPUNIT_ASSERT_EQUAL(size_t(0), q.size());
+  }
+
+
+  void testConcurrent()
+  {
+    // A small queue keeps producers and consumers blocking frequently.
+    transfer t;
+
+    twine::thread * threads[QUEUE_PRODUCERS + QUEUE_CONSUMERS];
+    for (int i = 0 ; i < QUEUE_PRODUCERS + QUEUE_CONSUMERS ; ++i) {
+      threads[i] = new twine::thread(
+          i < QUEUE_PRODUCERS ? thread_produce : thread_consume, &t);
+    }
+    for (int i = 0 ; i < QUEUE_PRODUCERS + QUEUE_CONSUMERS ; ++i) {
+      threads[i]->join();
+      delete threads[i];
+    }
+
+    uint64_t per_producer = uint64_t(QUEUE_ITEMS) * (QUEUE_ITEMS + 1) / 2;
+    CPPUNIT_ASSERT_EQUAL(uint32_t(QUEUE_CONSUMERS * QUEUE_ITEMS),
+        t.count.load());
+    CPPUNIT_ASSERT_EQUAL(QUEUE_PRODUCERS * per_producer, t.sum.load());
+    CPPUNIT_ASSERT_EQUAL(size_t(0), t.queue.size());
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MPMCQueueTest);
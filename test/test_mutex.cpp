@@ -22,6 +22,33 @@
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <twine/mutex.h>
+#include <twine/scoped_lock.h>
+#include <twine/thread.h>
+
+namespace {
+
+struct counter
+{
+  twine::mutex  m;
+  int           value;
+
+  counter()
+    : value(0)
+  {
+  }
+};
+
+
+void thread_count(void * arg)
+{
+  counter * c = static_cast<counter *>(arg);
+  for (int i = 0 ; i < 10000 ; ++i) {
+    twine::scoped_lock<twine::mutex> lock(c->m);
+    ++c->value;
+  }
+}
+
+} // anonymous namespace
 
 
 class MutexTest
@@ -32,6 +59,7 @@ public:
 
       CPPUNIT_TEST(testMutex);
       CPPUNIT_TEST(testRecursiveMutex);
+      CPPUNIT_TEST(testContention);
 
     CPPUNIT_TEST_SUITE_END();
 
@@ -79,6 +107,27 @@ private:
       m.lock();
     }
   }
+
+
+  void testContention()
+  {
+#if defined(TWINE_USE_FUTEX)
+    // The futex mutex is just its lock word.
+    CPPUNIT_ASSERT_EQUAL(sizeof(int32_t), sizeof(twine::mutex));
+#endif
+
+    counter c;
+    twine::thread th1(thread_count, &c);
+    twine::thread th2(thread_count, &c);
+    twine::thread th3(thread_count, &c);
+    twine::thread th4(thread_count, &c);
+    th1.join();
+    th2.join();
+    th3.join();
+    th4.join();
+
+    CPPUNIT_ASSERT_EQUAL(40000, c.value);
+  }
 };
 
 
@@ -0,0 +1,294 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+#include <numeric>
+#include <string>
+
+#include <twine/parallel.h>
+#include <twine/atomic.h>
+
+namespace {
+
+struct mark_visited
+{
+  std::vector<twine::atomic<uint32_t> *> * visits;
+
+  void operator()(size_t begin, size_t end) const
+  {
+    for (size_t i = begin ; i < end ; ++i) {
+      (*visits)[i]->fetch_add(1);
+    }
+  }
+};
+
+
+struct square_elements
+{
+  void operator()(std::vector<int>::iterator begin,
+      std::vector<int>::iterator end) const
+  {
+    for ( ; begin != end ; ++begin) {
+      *begin *= *begin;
+    }
+  }
+};
+
+
+uint64_t sum_indices(int begin, int end, uint64_t init)
+{
+  for (int i = begin ; i < end ; ++i) {
+    init += uint64_t(i);
+  }
+  return init;
+}
+
+
+uint64_t add(uint64_t a, uint64_t b)
+{
+  return a + b;
+}
+
+
+// Non-commutative, but associative: the result depends on the order in which
+// partial results are combined.
+std::string concat_chunk(std::vector<std::string>::const_iterator begin,
+    std::vector<std::string>::const_iterator end, std::string init)
+{
+  for ( ; begin != end ; ++begin) {
+    init += *begin;
+  }
+  return init;
+}
+
+
+std::string concat(std::string const & a, std::string const & b)
+{
+  return a + b;
+}
+
+
+struct nested_sum
+{
+  twine::atomic<uint64_t> * total;
+
+  void operator()(int begin, int end) const
+  {
+    for (int i = begin ; i < end ; ++i) {
+      total->fetch_add(twine::parallel_reduce(0, 100, uint64_t(0),
+            sum_indices, add, 10));
+    }
+  }
+};
+
+
+int add_int(int a, int b)
+{
+  return a + b;
+}
+
+} // anonymous namespace
+
+
+class ParallelTest
+  : public CppUnit::TestFixture
+{
+public:
+  CPPUNIT_TEST_SUITE(ParallelTest);
+
+    CPPUNIT_TEST(testForIndices);
+    CPPUNIT_TEST(testForIterators);
+    CPPUNIT_TEST(testForEmpty);
+    CPPUNIT_TEST(testReduce);
+    CPPUNIT_TEST(testReduceOrder);
+    CPPUNIT_TEST(testInclusiveScan);
+    CPPUNIT_TEST(testExclusiveScan);
+    CPPUNIT_TEST(testScanInPlace);
+    CPPUNIT_TEST(testNested);
+    CPPUNIT_TEST(testPool);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testForIndices()
+  {
+    std::vector<twine::atomic<uint32_t> *> visits;
+    for (int i = 0 ; i < 100000 ; ++i) {
+      visits.push_back(new twine::atomic<uint32_t>(0));
+    }
+
+    mark_visited func = { &visits };
+    twine::parallel_for(size_t(0), visits.size(), func);
+
+    for (size_t i = 0 ; i < visits.size() ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(uint32_t(1), visits[i]->load());
+      delete visits[i];
+    }
+  }
+
+
+  void testForIterators()
+  {
+    std::vector<int> v;
+    for (int i = 0 ; i < 10000 ; ++i) {
+      v.push_back(i);
+    }
+
+    twine::parallel_for(v.begin(), v.end(), square_elements(), 7);
+
+    for (int i = 0 ; i < 10000 ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(i * i, v[i]);
+    }
+  }
+
+
+  void testForEmpty()
+  {
+    std::vector<int> v;
+    twine::parallel_for(v.begin(), v.end(), square_elements());
+    CPPUNIT_ASSERT_EQUAL(uint64_t(42), twine::parallel_reduce(5, 5,
+          uint64_t(42), sum_indices, add));
+    std::vector<int> out;
+    CPPUNIT_ASSERT(out.begin() == twine::parallel_inclusive_scan(v.begin(),
+          v.end(), out.begin(), add_int));
+  }
+
+
+  void testReduce()
+  {
+    int n = 1000000;
+    uint64_t expected = uint64_t(n) * uint64_t(n - 1) / 2;
+
+    CPPUNIT_ASSERT_EQUAL(expected, twine::parallel_reduce(0, n, uint64_t(0),
+          sum_indices, add));
+    CPPUNIT_ASSERT_EQUAL(expected, twine::parallel_reduce(0, n, uint64_t(0),
+          sum_indices, add, 1));
+    CPPUNIT_ASSERT_EQUAL(expected, twine::parallel_reduce(0, n, uint64_t(0),
+          sum_indices, add, size_t(n) * 2));
+  }
+
+
+  void testReduceOrder()
+  {
+    std::vector<std::string> parts;
+    std::string expected;
+    for (int i = 0 ; i < 5000 ; ++i) {
+      std::string part(1, char('a' + i % 26));
+      parts.push_back(part);
+      expected += part;
+    }
+
+    for (size_t grain = 0 ; grain < 100 ; grain += 13) {
+      std::string result = twine::parallel_reduce(
+          std::vector<std::string>::const_iterator(parts.begin()),
+          std::vector<std::string>::const_iterator(parts.end()),
+          std::string(), concat_chunk, concat, grain);
+      CPPUNIT_ASSERT(expected == result);
+    }
+  }
+
+
+  void testInclusiveScan()
+  {
+    std::vector<int> in;
+    for (int i = 0 ; i < 100000 ; ++i) {
+      in.push_back(i % 17 - 8);
+    }
+
+    std::vector<int> expected(in.size());
+    std::partial_sum(in.begin(), in.end(), expected.begin());
+
+    for (size_t grain = 0 ; grain < 5000 ; grain = grain * 10 + 1) {
+      std::vector<int> out(in.size());
+      std::vector<int>::iterator end = twine::parallel_inclusive_scan(
+          in.begin(), in.end(), out.begin(), add_int, grain);
+      CPPUNIT_ASSERT(end == out.end());
+      CPPUNIT_ASSERT(expected == out);
+    }
+  }
+
+
+  void testExclusiveScan()
+  {
+    std::vector<int> in;
+    for (int i = 0 ; i < 100000 ; ++i) {
+      in.push_back(i % 13);
+    }
+
+    std::vector<int> expected(in.size());
+    int acc = 100;
+    for (size_t i = 0 ; i < in.size() ; ++i) {
+      expected[i] = acc;
+      acc += in[i];
+    }
+
+    for (size_t grain = 0 ; grain < 5000 ; grain = grain * 10 + 1) {
+      std::vector<int> out(in.size());
+      twine::parallel_exclusive_scan(in.begin(), in.end(), out.begin(), 100,
+          add_int, grain);
+      CPPUNIT_ASSERT(expected == out);
+    }
+  }
+
+
+  void testScanInPlace()
+  {
+    std::vector<int> v(50000, 1);
+    twine::parallel_inclusive_scan(v.begin(), v.end(), v.begin(), add_int);
+    for (size_t i = 0 ; i < v.size() ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(int(i) + 1, v[i]);
+    }
+
+    std::vector<int> w(50000, 1);
+    twine::parallel_exclusive_scan(w.begin(), w.end(), w.begin(), 0, add_int);
+    for (size_t i = 0 ; i < w.size() ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(int(i), w[i]);
+    }
+  }
+
+
+  void testNested()
+  {
+    // Parallel algorithms called from within chunks must neither deadlock
+    // nor lose work.
+    twine::atomic<uint64_t> total(0);
+    nested_sum func = { &total };
+    twine::parallel_for(0, 200, func, 1);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(200 * 4950), total.load());
+  }
+
+
+  void testPool()
+  {
+    twine::thread_pool pool(3);
+    int n = 100000;
+    uint64_t expected = uint64_t(n) * uint64_t(n - 1) / 2;
+    CPPUNIT_ASSERT_EQUAL(expected, twine::parallel_reduce(0, n, uint64_t(0),
+          sum_indices, add, 0, &pool));
+    pool.wait();
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ParallelTest);
@@ -0,0 +1,158 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/semaphore.h>
+#include <twine/atomic.h>
+#include <twine/thread.h>
+
+#include "compare_times.h"
+
+#define SEMAPHORE_TEST_DELAY twine::chrono::milliseconds(50)
+
+namespace {
+
+struct slots
+{
+  twine::semaphore        sem;
+  twine::atomic<uint32_t> active;
+  twine::atomic<uint32_t> max_active;
+
+  slots()
+    : sem(3)
+    , active(0)
+    , max_active(0)
+  {
+  }
+};
+
+
+void thread_acquire(void * arg)
+{
+  twine::semaphore * sem = static_cast<twine::semaphore *>(arg);
+  sem->acquire();
+}
+
+
+void thread_slots(void * arg)
+{
+  slots * s = static_cast<slots *>(arg);
+  for (int i = 0 ; i < 1000 ; ++i) {
+    s->sem.acquire();
+
+    uint32_t cur = s->active.fetch_add(1) + 1;
+    uint32_t max = s->max_active.load();
+    while (cur > max && !s->max_active.compare_exchange(max, cur)) {
+    }
+    s->active.fetch_sub(1);
+
+    s->sem.release();
+  }
+}
+
+} // anonymous namespace
+
+
+class SemaphoreTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(SemaphoreTest);
+
+      CPPUNIT_TEST(testCounting);
+      CPPUNIT_TEST(testTimedAcquire);
+      CPPUNIT_TEST(testBlockingAcquire);
+      CPPUNIT_TEST(testBound);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testCounting()
+  {
+    twine::semaphore sem(2);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(2), sem.count());
+    CPPUNIT_ASSERT_EQUAL(true, sem.try_acquire());
+    CPPUNIT_ASSERT_EQUAL(true, sem.try_acquire());
+    CPPUNIT_ASSERT_EQUAL(false, sem.try_acquire());
+    CPPUNIT_ASSERT_EQUAL(uint32_t(0), sem.count());
+
+    sem.release(3);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(3), sem.count());
+    sem.acquire();
+    sem.acquire();
+    sem.acquire();
+    CPPUNIT_ASSERT_EQUAL(false, sem.try_acquire());
+  }
+
+
+  void testTimedAcquire()
+  {
+    twine::semaphore sem(1);
+    CPPUNIT_ASSERT_EQUAL(true, sem.timed_acquire(SEMAPHORE_TEST_DELAY));
+
+    namespace tc = twine::chrono;
+    tc::nanoseconds before = tc::now();
+    CPPUNIT_ASSERT_EQUAL(false, sem.timed_acquire(SEMAPHORE_TEST_DELAY));
+    tc::nanoseconds after = tc::now();
+    compare_times(before, after, SEMAPHORE_TEST_DELAY);
+  }
+
+
+  void testBlockingAcquire()
+  {
+    twine::semaphore sem;
+
+    twine::thread th1(thread_acquire, &sem);
+    twine::thread th2(thread_acquire, &sem);
+    twine::this_thread::sleep_for(SEMAPHORE_TEST_DELAY);
+
+    // Both threads are waiting; one release() wakes both.
+    sem.release(2);
+    th1.join();
+    th2.join();
+    CPPUNIT_ASSERT_EQUAL(uint32_t(0), sem.count());
+  }
+
+
+  void testBound()
+  {
+    slots s;
+
+    twine::thread th1(thread_slots, &s);
+    twine::thread th2(thread_slots, &s);
+    twine::thread th3(thread_slots, &s);
+    twine::thread th4(thread_slots, &s);
+    twine::thread th5(thread_slots, &s);
+    th1.join();
+    th2.join();
+    th3.join();
+    th4.join();
+    th5.join();
+
+    CPPUNIT_ASSERT(s.max_active.load() <= 3);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(3), s.sem.count());
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SemaphoreTest);
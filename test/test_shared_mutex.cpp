@@ -0,0 +1,264 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/shared_mutex.h>
+#include <twine/scoped_lock.h>
+#include <twine/scoped_shared_lock.h>
+#include <twine/thread.h>
+
+#define SHARED_MUTEX_TEST_DELAY twine::chrono::milliseconds(50)
+
+namespace {
+
+template <typename mutexT>
+void thread_write(void * arg)
+{
+  mutexT * m = static_cast<mutexT *>(arg);
+  twine::scoped_lock<mutexT> lock(*m);
+}
+
+
+struct shared_data
+{
+  twine::shared_mutex m;
+  int                 first;
+  int                 second;
+  bool                consistent;
+
+  shared_data()
+    : first(0)
+    , second(0)
+    , consistent(true)
+  {
+  }
+};
+
+
+void thread_reader(void * arg)
+{
+  shared_data * d = static_cast<shared_data *>(arg);
+  for (int i = 0 ; i < 2000 ; ++i) {
+    twine::scoped_shared_lock<twine::shared_mutex> lock(d->m);
+    if (d->first != d->second) {
+      d->consistent = false;
+    }
+  }
+}
+
+
+void thread_writer(void * arg)
+{
+  shared_data * d = static_cast<shared_data *>(arg);
+  for (int i = 0 ; i < 2000 ; ++i) {
+    twine::scoped_lock<twine::shared_mutex> lock(d->m);
+    ++d->first;
+    ++d->second;
+  }
+}
+
+
+void thread_upgrader(void * arg)
+{
+  shared_data * d = static_cast<shared_data *>(arg);
+  for (int i = 0 ; i < 2000 ; ++i) {
+    twine::scoped_upgrade_lock<twine::shared_mutex> lock(d->m);
+    if (d->first != d->second) {
+      d->consistent = false;
+    }
+    lock.upgrade();
+    ++d->first;
+    ++d->second;
+    lock.downgrade();
+  }
+}
+
+} // anonymous namespace
+
+
+class SharedMutexTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(SharedMutexTest);
+
+      CPPUNIT_TEST(testExclusiveAndShared);
+      CPPUNIT_TEST(testUpgradeAndDowngrade);
+      CPPUNIT_TEST(testWriterPreference);
+      CPPUNIT_TEST(testReaderPreference);
+      CPPUNIT_TEST(testScopedLocks);
+      CPPUNIT_TEST(testConcurrency);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testExclusiveAndShared()
+  {
+    twine::shared_mutex m;
+
+    // Exclusive locks exclude everything.
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock());
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock());
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock_shared());
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock_upgrade());
+    m.unlock();
+
+    // Shared locks only exclude exclusive locks.
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock_shared());
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock_shared());
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock_upgrade());
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock());
+    m.unlock_upgrade();
+    m.unlock_shared();
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock());
+    m.unlock_shared();
+
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock());
+    m.unlock();
+  }
+
+
+  void testUpgradeAndDowngrade()
+  {
+    twine::shared_mutex m;
+
+    // Only one upgradeable lock at a time
+    m.lock_upgrade();
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock_upgrade());
+
+    // Upgrading fails while there are other readers.
+    m.lock_shared();
+    CPPUNIT_ASSERT_EQUAL(false, m.try_upgrade());
+    m.unlock_shared();
+    CPPUNIT_ASSERT_EQUAL(true, m.try_upgrade());
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock_shared());
+
+    // Downgrade to upgradeable lets readers back in.
+    m.downgrade_to_upgrade();
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock_shared());
+    m.unlock_shared();
+
+    // Downgrade to a shared lock
+    m.upgrade();
+    m.downgrade();
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock_upgrade());
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock());
+    m.unlock_upgrade();
+    m.unlock_shared();
+
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock());
+    m.unlock();
+  }
+
+
+  void testWriterPreference()
+  {
+    twine::shared_mutex m;
+    m.lock_shared();
+
+    // While a writer waits, new readers are turned away.
+    twine::thread th(thread_write<twine::shared_mutex>, &m);
+    twine::this_thread::sleep_for(SHARED_MUTEX_TEST_DELAY);
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock_shared());
+    CPPUNIT_ASSERT_EQUAL(false, m.try_lock_upgrade());
+
+    m.unlock_shared();
+    th.join();
+
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock_shared());
+    m.unlock_shared();
+  }
+
+
+  void testReaderPreference()
+  {
+    twine::reader_preferring_shared_mutex m;
+    m.lock_shared();
+
+    // Readers still get in while a writer waits.
+    twine::thread th(thread_write<twine::reader_preferring_shared_mutex>, &m);
+    twine::this_thread::sleep_for(SHARED_MUTEX_TEST_DELAY);
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock_shared());
+    m.unlock_shared();
+
+    m.unlock_shared();
+    th.join();
+  }
+
+
+  void testScopedLocks()
+  {
+    twine::shared_mutex m;
+
+    {
+      twine::scoped_shared_lock<twine::shared_mutex> l1(m);
+      twine::scoped_shared_lock<twine::shared_mutex> l2(m);
+      CPPUNIT_ASSERT_EQUAL(false, m.try_lock());
+    }
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock());
+    m.unlock();
+
+    {
+      twine::scoped_upgrade_lock<twine::shared_mutex> l(m);
+      CPPUNIT_ASSERT_EQUAL(false, l.exclusive());
+      CPPUNIT_ASSERT_EQUAL(true, m.try_lock_shared());
+      CPPUNIT_ASSERT_EQUAL(false, l.try_upgrade());
+      m.unlock_shared();
+
+      l.upgrade();
+      CPPUNIT_ASSERT_EQUAL(true, l.exclusive());
+      CPPUNIT_ASSERT_EQUAL(false, m.try_lock_shared());
+    }
+    CPPUNIT_ASSERT_EQUAL(true, m.try_lock());
+    m.unlock();
+  }
+
+
+  void testConcurrency()
+  {
+    shared_data d;
+
+    twine::thread r1(thread_reader, &d);
+    twine::thread r2(thread_reader, &d);
+    twine::thread r3(thread_reader, &d);
+    twine::thread w1(thread_writer, &d);
+    twine::thread w2(thread_writer, &d);
+    twine::thread u1(thread_upgrader, &d);
+    twine::thread u2(thread_upgrader, &d);
+
+    r1.join();
+    r2.join();
+    r3.join();
+    w1.join();
+    w2.join();
+    u1.join();
+    u2.join();
+
+    CPPUNIT_ASSERT_EQUAL(true, d.consistent);
+    CPPUNIT_ASSERT_EQUAL(8000, d.first);
+    CPPUNIT_ASSERT_EQUAL(8000, d.second);
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedMutexTest);
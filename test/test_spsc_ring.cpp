@@ -0,0 +1,271 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/spsc_ring.h>
+#include <twine/tasklet.h>
+#include <twine/thread.h>
+
+#define RING_TEST_DELAY twine::chrono::milliseconds(50)
+
+namespace {
+
+static uint64_t const RING_ITEMS = 200000;
+
+struct ring_test
+{
+  twine::spsc_ring<uint64_t>  ring;
+  uint64_t                    received;
+  bool                        ordered;
+  bool                        stopped;
+
+  ring_test()
+    : ring(64)
+    , received(0)
+    , ordered(true)
+    , stopped(false)
+  {
+  }
+};
+
+
+void thread_produce(void * arg)
+{
+  ring_test * t = static_cast<ring_test *>(arg);
+
+  // Alternate between the interfaces, and pause now and then so the consumer
+  // runs out of values and has to sleep.
+  uint64_t next = 0;
+  while (next < RING_ITEMS) {
+    uint64_t batch[16];
+    size_t amount = 0;
+    switch (next % 3) {
+      case 0:
+        if (t->ring.try_push(next)) {
+          ++next;
+        }
+        break;
+
+      case 1:
+        for (amount = 0 ; amount < 16 ; ++amount) {
+          batch[amount] = next + amount;
+        }
+        next += t->ring.push_n(batch, RING_ITEMS - next < 16
+            ? size_t(RING_ITEMS - next) : 16);
+        break;
+
+      default:
+        {
+          amount = 8;
+          uint64_t * slots = t->ring.reserve(amount);
+          for (size_t i = 0 ; i < amount && next + i < RING_ITEMS ; ++i) {
+            slots[i] = next + i;
+          }
+          if (next + amount > RING_ITEMS) {
+            amount = size_t(RING_ITEMS - next);
+          }
+          t->ring.commit(amount);
+          next += amount;
+        }
+        break;
+    }
+
+    if (!(next % 10000)) {
+      twine::this_thread::sleep_for(twine::chrono::milliseconds(1));
+    }
+  }
+}
+
+
+void tasklet_consume(twine::tasklet & task, void * arg)
+{
+  ring_test * t = static_cast<ring_test *>(arg);
+
+  uint64_t buf[32];
+  while (t->received < RING_ITEMS) {
+    if (!t->ring.wait_readable(task)) {
+      t->stopped = true;
+      return;
+    }
+    size_t amount = t->ring.pop_n(buf, 32);
+    for (size_t i = 0 ; i < amount ; ++i) {
+      if (buf[i] != t->received) {
+        t->ordered = false;
+      }
+      ++t->received;
+    }
+  }
+}
+
+} // anonymous namespace
+
+
+class SPSCRingTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(SPSCRingTest);
+
+      CPPUNIT_TEST(testCapacity);
+      CPPUNIT_TEST(testOrdering);
+      CPPUNIT_TEST(testBatches);
+      CPPUNIT_TEST(testReserve);
+      CPPUNIT_TEST(testTasklet);
+      CPPUNIT_TEST(testStopWaiting);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testCapacity()
+  {
+    CPPUNIT_ASSERT_EQUAL(size_t(2), twine::spsc_ring<int>(0).capacity());
+    CPPUNIT_ASSERT_EQUAL(size_t(8), twine::spsc_ring<int>(7).capacity());
+    CPPUNIT_ASSERT_EQUAL(size_t(16), twine::spsc_ring<int>(16).capacity());
+  }
+
+
+  void testOrdering()
+  {
+    twine::spsc_ring<int> ring(4);
+    int value = -1;
+    CPPUNIT_ASSERT_EQUAL(false, ring.try_pop(value));
+
+    for (int lap = 0 ; lap < 3 ; ++lap) {
+      for (int i = 0 ; i < 4 ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, ring.try_push(lap * 4 + i));
+      }
+      CPPUNIT_ASSERT_EQUAL(false, ring.try_push(42));
+      CPPUNIT_ASSERT_EQUAL(size_t(4), ring.size());
+
+      for (int i = 0 ; i < 4 ; ++i) {
+        CPPUNIT_ASSERT_EQUAL(true, ring.try_pop(value));
+        CPPUNIT_ASSERT_EQUAL(lap * 4 + i, value);
+      }
+      CPPUNIT_ASSERT_EQUAL(false, ring.try_pop(value));
+    }
+  }
+
+
+  void testBatches()
+  {
+    twine::spsc_ring<int> ring(8);
+    int in[10] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    int out[10] = { 0 };
+
+    // Batches are cut short when the ring is full or empty.
+    CPPUNIT_ASSERT_EQUAL(size_t(5), ring.push_n(in, 5));
+    CPPUNIT_ASSERT_EQUAL(size_t(3), ring.pop_n(out, 3));
+    CPPUNIT_ASSERT_EQUAL(size_t(5), ring.push_n(in + 5, 5));
+    CPPUNIT_ASSERT_EQUAL(size_t(1), ring.push_n(in, 10));
+    CPPUNIT_ASSERT_EQUAL(size_t(0), ring.push_n(in, 10));
+
+    // The second batch wrapped around the end of the array.
+    CPPUNIT_ASSERT_EQUAL(size_t(8), ring.pop_n(out + 3, 10));
+    for (int i = 0 ; i < 10 ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(i, out[i]);
+    }
+    CPPUNIT_ASSERT_EQUAL(size_t(0), ring.pop_n(out, 10));
+  }
+
+
+  void testReserve()
+  {
+    twine::spsc_ring<int> ring(8);
+    int value = -1;
+
+    size_t count = 6;
+    int * slots = ring.reserve(count);
+    CPPUNIT_ASSERT(slots);
+    CPPUNIT_ASSERT_EQUAL(size_t(6), count);
+    for (int i = 0 ; i < 6 ; ++i) {
+      slots[i] = i;
+    }
+
+    // Nothing is visible before committing.
+    CPPUNIT_ASSERT_EQUAL(false, ring.try_pop(value));
+    ring.commit(6);
+    for (int i = 0 ; i < 6 ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(true, ring.try_pop(value));
+      CPPUNIT_ASSERT_EQUAL(i, value);
+    }
+
+    // Reservations stop at the end of the array.
+    count = 8;
+    slots = ring.reserve(count);
+    CPPUNIT_ASSERT_EQUAL(size_t(2), count);
+    slots[0] = 6;
+    slots[1] = 7;
+    ring.commit(2);
+
+    count = 8;
+    slots = ring.reserve(count);
+    CPPUNIT_ASSERT_EQUAL(size_t(6), count);
+    slots[0] = 8;
+    ring.commit(1);
+
+    for (int i = 6 ; i < 9 ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(true, ring.try_pop(value));
+      CPPUNIT_ASSERT_EQUAL(i, value);
+    }
+
+    // A full ring reserves nothing.
+    int in[8] = { 0 };
+    CPPUNIT_ASSERT_EQUAL(size_t(8), ring.push_n(in, 8));
+    count = 1;
+    CPPUNIT_ASSERT(!ring.reserve(count));
+    CPPUNIT_ASSERT_EQUAL(size_t(0), count);
+  }
+
+
+  void testTasklet()
+  {
+    ring_test t;
+    twine::tasklet consumer(tasklet_consume, &t);
+    CPPUNIT_ASSERT(consumer.start());
+
+    twine::thread producer(thread_produce, &t);
+    producer.join();
+    CPPUNIT_ASSERT(consumer.wait());
+
+    CPPUNIT_ASSERT_EQUAL(RING_ITEMS, t.received);
+    CPPUNIT_ASSERT(t.ordered);
+    CPPUNIT_ASSERT(!t.stopped);
+  }
+
+
+  void testStopWaiting()
+  {
+    // A consumer waiting on an empty ring wakes up when stopped.
+    ring_test t;
+    twine::tasklet consumer(tasklet_consume, &t);
+    CPPUNIT_ASSERT(consumer.start());
+    twine::this_thread::sleep_for(RING_TEST_DELAY);
+
+    CPPUNIT_ASSERT(consumer.stop());
+    CPPUNIT_ASSERT(consumer.wait());
+    CPPUNIT_ASSERT(t.stopped);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), t.received);
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SPSCRingTest);
@@ -24,8 +24,12 @@
 #include "compare_times.h"
 
 #include <cstdlib>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 #include <twine/tasklet.h>
+#include <twine/tasklet_scheduler.h>
 
 #define THREAD_TEST_SHORT_DELAY twine::chrono::milliseconds(1)
 #define THREAD_TEST_LONG_DELAY  twine::chrono::milliseconds(100)
@@ -43,12 +47,136 @@ void sleeper(twine::tasklet & t, void *)
   done = true;
 }
 
+void sleep_once(twine::tasklet & t, void *)
+{
+  if (t.sleep()) {
+    done = true;
+  }
+}
+
 void sleep_halfsec(twine::tasklet & t, void *)
 {
   t.sleep(twine::chrono::milliseconds(500));
   done = true;
 }
 
+void sleep_periodic(twine::tasklet & t, void *)
+{
+  // Three periods measured from a single deadline, so they don't drift.
+  twine::chrono::nanoseconds deadline = twine::chrono::monotonic_now();
+  for (int i = 0 ; i < 3 ; ++i) {
+    deadline += twine::chrono::milliseconds(50);
+    if (!t.sleep_until(deadline)) {
+      return;
+    }
+  }
+  done = true;
+}
+
+static int const PERIODS = 10;
+
+void run_periods(twine::tasklet & t, void *)
+{
+  // Each period does some work, which must not make the period drift.
+  t.set_period(twine::chrono::milliseconds(20));
+  for (int i = 0 ; i < PERIODS ; ++i) {
+    if (!t.sleep_until_next_period()) {
+      return;
+    }
+    twine::this_thread::sleep_for(twine::chrono::milliseconds(5));
+  }
+  done = true;
+}
+
+struct overrun_test
+{
+  twine::tasklet::overrun_policy      policy;
+  int                                 calls;
+  twine::tasklet::period_statistics   stats;
+};
+
+void overrun_period(twine::tasklet & t, void * baton)
+{
+  overrun_test * test = static_cast<overrun_test *>(baton);
+
+  // Overrun the second deadline by one and a half periods, then count the
+  // calls it takes to finish the next period on time.
+  t.set_period(twine::chrono::milliseconds(20), test->policy);
+  t.sleep_until_next_period();
+  t.sleep_until_next_period();
+  twine::this_thread::sleep_for(twine::chrono::milliseconds(50));
+
+  while (t.get_period_statistics().periods < 3 && test->calls < 10) {
+    ++test->calls;
+    if (!t.sleep_until_next_period()) {
+      return;
+    }
+  }
+  test->stats = t.get_period_statistics();
+}
+
+struct number_message : public twine::tasklet::message
+{
+  int value;
+};
+
+struct mailbox_test
+{
+  int   received;
+  int   sum;
+  bool  ordered;
+  int   last;
+};
+
+void receive_numbers(twine::tasklet & t, void * baton)
+{
+  mailbox_test * test = static_cast<mailbox_test *>(baton);
+
+  // Drain once more after being stopped, to catch the stragglers.
+  bool running = true;
+  do {
+    running = t.sleep();
+    for (twine::tasklet::message * msg = t.receive() ; msg ; msg = msg->next) {
+      int value = static_cast<number_message *>(msg)->value;
+      ++test->received;
+      test->sum += value;
+      if (value <= test->last) {
+        test->ordered = false;
+      }
+      test->last = value;
+    }
+  } while (running);
+}
+
+static int const MAILBOX_PRODUCERS = 4;
+static int const MAILBOX_MESSAGES = 2000;
+
+void post_numbers(void * baton)
+{
+  std::pair<twine::tasklet *, number_message *> * args =
+    static_cast<std::pair<twine::tasklet *, number_message *> *>(baton);
+  for (int i = 0 ; i < MAILBOX_MESSAGES ; ++i) {
+    args->first->post(args->second + i);
+  }
+}
+
+static int const PRECISE_SLEEPS = 11;
+
+void sleep_precisely(twine::tasklet & t, void * baton)
+{
+  namespace tc = twine::chrono;
+  tc::default_repr_t * late = static_cast<tc::default_repr_t *>(baton);
+
+  tc::nanoseconds const duration = tc::microseconds(200);
+  for (int i = 0 ; i < PRECISE_SLEEPS ; ++i) {
+    tc::nanoseconds start = tc::monotonic_now();
+    if (!t.sleep(duration, tc::SLEEP_PRECISE)) {
+      return;
+    }
+    late[i] = (tc::monotonic_now() - start - duration).raw();
+  }
+}
+
 static int count = 0;
 
 void counter(twine::tasklet & t, void *)
@@ -87,9 +215,17 @@ public:
   CPPUNIT_TEST_SUITE(TaskletTest);
 
     CPPUNIT_TEST(testTaskletSleep);
+    CPPUNIT_TEST(testTaskletSleepUntil);
+    CPPUNIT_TEST(testTaskletPreciseSleep);
+    CPPUNIT_TEST(testTaskletPeriodic);
+    CPPUNIT_TEST(testTaskletOverrun);
+    CPPUNIT_TEST(testTaskletMailbox);
+    CPPUNIT_TEST(testTaskletMailboxProducers);
+    CPPUNIT_TEST(testTaskletNotify);
     CPPUNIT_TEST(testTaskletMemFun);
     CPPUNIT_TEST(testTaskletScope);
     CPPUNIT_TEST(testSharedCondition);
+    CPPUNIT_TEST(testTaskletAttributes);
 
   CPPUNIT_TEST_SUITE_END();
 private:
@@ -165,6 +301,216 @@ private:
 
 
 
+  void testTaskletSleepUntil()
+  {
+    namespace tc = twine::chrono;
+
+    // Sleeping until consecutive deadlines takes the sum of the periods.
+    {
+      done = false;
+      twine::tasklet task(sleep_periodic);
+
+      tc::nanoseconds t1 = tc::monotonic_now();
+      CPPUNIT_ASSERT(task.start());
+      CPPUNIT_ASSERT(task.wait());
+      tc::nanoseconds t2 = tc::monotonic_now();
+
+      CPPUNIT_ASSERT(done);
+      compare_times(t1, t2, tc::milliseconds(150));
+    }
+
+    // Stopping interrupts the sleep.
+    {
+      done = false;
+      twine::tasklet task(sleep_periodic);
+
+      CPPUNIT_ASSERT(task.start());
+      twine::this_thread::sleep_for(THREAD_TEST_SHORT_DELAY);
+      CPPUNIT_ASSERT(task.stop());
+      CPPUNIT_ASSERT(task.wait());
+      CPPUNIT_ASSERT(!done);
+    }
+  }
+
+
+
+  void testTaskletPreciseSleep()
+  {
+    // Precise sleeps must not return early, and should overshoot by far less
+    // than the default timer slack; use the median to ignore preemption.
+    twine::chrono::default_repr_t late[PRECISE_SLEEPS];
+    for (int i = 0 ; i < PRECISE_SLEEPS ; ++i) {
+      late[i] = -1;
+    }
+
+    twine::tasklet task(sleep_precisely, late);
+    CPPUNIT_ASSERT(task.start());
+    CPPUNIT_ASSERT(task.wait());
+
+    std::sort(late, late + PRECISE_SLEEPS);
+    CPPUNIT_ASSERT(late[0] >= 0);
+    CPPUNIT_ASSERT_MESSAGE("may fail under high CPU load",
+        late[PRECISE_SLEEPS / 2] < 50000);
+  }
+
+
+
+  void testTaskletPeriodic()
+  {
+    namespace tc = twine::chrono;
+
+    done = false;
+    twine::tasklet task(run_periods);
+
+    tc::nanoseconds t1 = tc::monotonic_now();
+    CPPUNIT_ASSERT(task.start());
+    CPPUNIT_ASSERT(task.wait());
+    tc::nanoseconds t2 = tc::monotonic_now();
+
+    CPPUNIT_ASSERT(done);
+    compare_times(t1, t2, tc::milliseconds(20 * PERIODS));
+
+    twine::tasklet::period_statistics stats = task.get_period_statistics();
+    CPPUNIT_ASSERT_EQUAL(uint64_t(PERIODS), stats.periods);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), stats.overruns);
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), stats.missed);
+    CPPUNIT_ASSERT(stats.min_jitter >= tc::nanoseconds(0));
+    CPPUNIT_ASSERT(stats.min_jitter <= stats.max_jitter);
+    CPPUNIT_ASSERT(stats.total_jitter >= stats.max_jitter);
+
+    task.reset_period_statistics();
+    CPPUNIT_ASSERT_EQUAL(uint64_t(0), task.get_period_statistics().periods);
+  }
+
+
+
+  void testTaskletOverrun()
+  {
+    // Skipping sleeps straight until the next deadline in the future.
+    {
+      overrun_test test = { twine::tasklet::OVERRUN_SKIP, 0,
+        twine::tasklet::period_statistics() };
+      twine::tasklet task(overrun_period, &test);
+      CPPUNIT_ASSERT(task.start());
+      CPPUNIT_ASSERT(task.wait());
+
+      CPPUNIT_ASSERT_EQUAL(1, test.calls);
+      CPPUNIT_ASSERT_EQUAL(uint64_t(1), test.stats.overruns);
+      CPPUNIT_ASSERT(test.stats.missed >= 1);
+    }
+
+    // Catching up returns immediately for every missed deadline.
+    {
+      overrun_test test = { twine::tasklet::OVERRUN_CATCH_UP, 0,
+        twine::tasklet::period_statistics() };
+      twine::tasklet task(overrun_period, &test);
+      CPPUNIT_ASSERT(task.start());
+      CPPUNIT_ASSERT(task.wait());
+
+      CPPUNIT_ASSERT(test.calls >= 2);
+      CPPUNIT_ASSERT_EQUAL(uint64_t(test.calls - 1), test.stats.overruns);
+      CPPUNIT_ASSERT_EQUAL(uint64_t(0), test.stats.missed);
+    }
+
+    // Coalescing returns immediately once, then sleeps a full period.
+    {
+      overrun_test test = { twine::tasklet::OVERRUN_COALESCE, 0,
+        twine::tasklet::period_statistics() };
+      twine::tasklet task(overrun_period, &test);
+      CPPUNIT_ASSERT(task.start());
+      CPPUNIT_ASSERT(task.wait());
+
+      CPPUNIT_ASSERT_EQUAL(2, test.calls);
+      CPPUNIT_ASSERT_EQUAL(uint64_t(1), test.stats.overruns);
+      CPPUNIT_ASSERT(test.stats.missed >= 1);
+    }
+  }
+
+
+
+  void testTaskletMailbox()
+  {
+    // Messages arrive in order and without any wakeup() calls, both on a
+    // tasklet's own thread and on a scheduler.
+    std::vector<number_message> messages(MAILBOX_MESSAGES);
+    for (int i = 0 ; i < MAILBOX_MESSAGES ; ++i) {
+      messages[i].value = i;
+    }
+
+    for (int run = 0 ; run < 2 ; ++run) {
+      mailbox_test test = { 0, 0, true, -1 };
+      twine::tasklet_scheduler sched(1);
+      twine::tasklet * task = run
+        ? new twine::tasklet(sched, receive_numbers, &test)
+        : new twine::tasklet(receive_numbers, &test);
+      CPPUNIT_ASSERT(task->start());
+
+      for (int i = 0 ; i < MAILBOX_MESSAGES ; ++i) {
+        task->post(&messages[i]);
+        if (!(i % 100)) {
+          twine::this_thread::sleep_for(THREAD_TEST_SHORT_DELAY);
+        }
+      }
+
+      CPPUNIT_ASSERT(task->stop());
+      CPPUNIT_ASSERT(task->wait());
+      delete task;
+
+      CPPUNIT_ASSERT_EQUAL(MAILBOX_MESSAGES, test.received);
+      CPPUNIT_ASSERT(test.ordered);
+    }
+  }
+
+
+
+  void testTaskletMailboxProducers()
+  {
+    mailbox_test test = { 0, 0, true, -1 };
+    twine::tasklet task(receive_numbers, &test);
+    CPPUNIT_ASSERT(task.start());
+
+    std::vector<number_message> messages(MAILBOX_PRODUCERS * MAILBOX_MESSAGES);
+    for (size_t i = 0 ; i < messages.size() ; ++i) {
+      messages[i].value = int(i % MAILBOX_MESSAGES);
+    }
+
+    std::pair<twine::tasklet *, number_message *> args[MAILBOX_PRODUCERS];
+    twine::thread * producers[MAILBOX_PRODUCERS];
+    for (int i = 0 ; i < MAILBOX_PRODUCERS ; ++i) {
+      args[i] = std::make_pair(&task, &messages[i * MAILBOX_MESSAGES]);
+      producers[i] = new twine::thread(post_numbers, &args[i]);
+    }
+    for (int i = 0 ; i < MAILBOX_PRODUCERS ; ++i) {
+      producers[i]->join();
+      delete producers[i];
+    }
+
+    CPPUNIT_ASSERT(task.stop());
+    CPPUNIT_ASSERT(task.wait());
+
+    int expected = MAILBOX_PRODUCERS
+      * (MAILBOX_MESSAGES * (MAILBOX_MESSAGES - 1) / 2);
+    CPPUNIT_ASSERT_EQUAL(MAILBOX_PRODUCERS * MAILBOX_MESSAGES, test.received);
+    CPPUNIT_ASSERT_EQUAL(expected, test.sum);
+  }
+
+
+
+  void testTaskletNotify()
+  {
+    // A notification sent before the tasklet sleeps is not lost, unlike
+    // wakeup().
+    done = false;
+    twine::tasklet task(sleep_once);
+    task.notify();
+    CPPUNIT_ASSERT(task.start());
+    twine::this_thread::sleep_for(THREAD_TEST_LONG_DELAY);
+    CPPUNIT_ASSERT(done);
+    CPPUNIT_ASSERT(task.wait());
+  }
+
+
+
   void testTaskletMemFun()
   {
     // Binding member functions is done pretty much manually in twine.
@@ -187,6 +533,28 @@ private:
 
 
 
+  void testTaskletAttributes()
+  {
+    twine::thread::attributes attrs;
+    attrs.set_stack_size(128 * 1024);
+    attrs.set_nice(5);
+
+    bind_test test;
+    twine::tasklet task(
+        twine::tasklet::binder<bind_test, &bind_test::sleep_member>::function,
+        &test, attrs);
+    CPPUNIT_ASSERT_EQUAL(size_t(128 * 1024),
+        task.get_attributes().stack_size());
+
+    CPPUNIT_ASSERT(task.start());
+    twine::this_thread::sleep_for(THREAD_TEST_SHORT_DELAY);
+    CPPUNIT_ASSERT(task.stop());
+    CPPUNIT_ASSERT(task.wait());
+    CPPUNIT_ASSERT(test.finished);
+  }
+
+
+
   void testTaskletScope()
   {
     // Checks to determine whether tasklets that are destroyed before being
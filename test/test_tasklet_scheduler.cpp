@@ -0,0 +1,239 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "compare_times.h"
+
+#include <vector>
+
+#include <twine/tasklet.h>
+#include <twine/tasklet_scheduler.h>
+#include <twine/atomic.h>
+
+#define SCHED_TEST_SHORT_DELAY twine::chrono::milliseconds(1)
+#define SCHED_TEST_LONG_DELAY  twine::chrono::milliseconds(100)
+
+namespace {
+
+struct counter
+{
+  twine::atomic<uint32_t> count;
+  twine::atomic<uint32_t> done;
+
+  counter()
+    : count(0)
+    , done(0)
+  {
+  }
+};
+
+
+void count_wakeups(twine::tasklet & t, void * baton)
+{
+  counter * c = static_cast<counter *>(baton);
+  while (t.sleep()) {
+    c->count.fetch_add(1);
+  }
+  c->done.fetch_add(1);
+}
+
+
+void sleep_halfsec(twine::tasklet & t, void * baton)
+{
+  counter * c = static_cast<counter *>(baton);
+  t.sleep(twine::chrono::milliseconds(500));
+  c->done.fetch_add(1);
+}
+
+
+void sleep_repeatedly(twine::tasklet & t, void * baton)
+{
+  counter * c = static_cast<counter *>(baton);
+  for (int i = 0 ; i < 10 ; ++i) {
+    if (!t.sleep(SCHED_TEST_SHORT_DELAY)) {
+      break;
+    }
+    c->count.fetch_add(1);
+  }
+  c->done.fetch_add(1);
+}
+
+
+struct bind_test
+{
+  bool finished;
+
+  bind_test()
+    : finished(false)
+  {
+  }
+
+  void sleep_member(twine::tasklet & t, void *)
+  {
+    while (t.sleep()) {
+      // tum-tee-tum.
+    }
+    finished = true;
+  }
+};
+
+} // anonymous namespace
+
+
+class TaskletSchedulerTest
+  : public CppUnit::TestFixture
+{
+public:
+  CPPUNIT_TEST_SUITE(TaskletSchedulerTest);
+
+    CPPUNIT_TEST(testSize);
+    CPPUNIT_TEST(testWakeupAndStop);
+    CPPUNIT_TEST(testTimedSleep);
+    CPPUNIT_TEST(testManyTasklets);
+    CPPUNIT_TEST(testRestart);
+    CPPUNIT_TEST(testMemFun);
+    CPPUNIT_TEST(testScope);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testSize()
+  {
+    twine::tasklet_scheduler sched(3);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(3), sched.size());
+    CPPUNIT_ASSERT_EQUAL(twine::tasklet_scheduler::DEFAULT_STACK_SIZE,
+        sched.stack_size());
+  }
+
+
+  void testWakeupAndStop()
+  {
+    twine::tasklet_scheduler sched(1);
+    counter c;
+    twine::tasklet task(sched, count_wakeups, &c);
+
+    CPPUNIT_ASSERT(task.start());
+    CPPUNIT_ASSERT(!task.start());
+    twine::this_thread::sleep_for(SCHED_TEST_LONG_DELAY);
+
+    task.wakeup();
+    twine::this_thread::sleep_for(SCHED_TEST_LONG_DELAY);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1), c.count.load());
+
+    CPPUNIT_ASSERT(task.stop());
+    CPPUNIT_ASSERT(task.wait());
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1), c.count.load());
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1), c.done.load());
+    CPPUNIT_ASSERT(!task.stop());
+  }
+
+
+  void testTimedSleep()
+  {
+    twine::tasklet_scheduler sched(1);
+    counter c;
+    twine::tasklet task(sched, sleep_halfsec, &c);
+
+    twine::chrono::nanoseconds t1 = twine::chrono::now();
+    CPPUNIT_ASSERT(task.start());
+    CPPUNIT_ASSERT(task.wait());
+    twine::chrono::nanoseconds t2 = twine::chrono::now();
+
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1), c.done.load());
+    compare_times(t1, t2, twine::chrono::milliseconds(500));
+  }
+
+
+  void testManyTasklets()
+  {
+    // Far more tasklets than workers; each sleeps ten times.
+    twine::tasklet_scheduler sched(2);
+    counter c;
+
+    std::vector<twine::tasklet *> tasks;
+    for (int i = 0 ; i < 1000 ; ++i) {
+      tasks.push_back(new twine::tasklet(sched, sleep_repeatedly, &c, true));
+    }
+    for (size_t i = 0 ; i < tasks.size() ; ++i) {
+      CPPUNIT_ASSERT(tasks[i]->wait());
+      delete tasks[i];
+    }
+
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1000), c.done.load());
+    CPPUNIT_ASSERT_EQUAL(uint32_t(10000), c.count.load());
+  }
+
+
+  void testRestart()
+  {
+    twine::tasklet_scheduler sched(2);
+    counter c;
+    twine::tasklet task(sched, count_wakeups, &c);
+
+    for (int i = 0 ; i < 3 ; ++i) {
+      CPPUNIT_ASSERT(task.start());
+      CPPUNIT_ASSERT(task.stop());
+      CPPUNIT_ASSERT(task.wait());
+    }
+    CPPUNIT_ASSERT_EQUAL(uint32_t(3), c.done.load());
+  }
+
+
+  void testMemFun()
+  {
+    twine::tasklet_scheduler sched(1);
+    bind_test test;
+    twine::tasklet task(sched,
+        twine::tasklet::binder<bind_test, &bind_test::sleep_member>::function,
+        &test);
+
+    CPPUNIT_ASSERT(task.start());
+    twine::this_thread::sleep_for(SCHED_TEST_SHORT_DELAY);
+    CPPUNIT_ASSERT(task.stop());
+    CPPUNIT_ASSERT(task.wait());
+    CPPUNIT_ASSERT(test.finished);
+  }
+
+
+  void testScope()
+  {
+    // Destroying tasklets in any state must not hang or crash.
+    twine::tasklet_scheduler sched(1);
+    counter c;
+    {
+      twine::tasklet task(sched, count_wakeups, &c);
+    }
+    {
+      twine::tasklet task(sched, count_wakeups, &c);
+      task.start();
+    }
+    {
+      twine::tasklet task(sched, count_wakeups, &c);
+      task.start();
+      task.stop();
+    }
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TaskletSchedulerTest);
@@ -28,6 +28,8 @@
 #include <twine/chrono.h>
 #include <twine/scoped_lock.h>
 
+#include <vector>
+
 #define THREAD_TEST_SHORT_DELAY twine::chrono::milliseconds(20)
 #define THREAD_TEST_LONG_DELAY  twine::chrono::milliseconds(100)
 
@@ -64,6 +66,78 @@ void thread_sleep(void *)
   twine::this_thread::sleep_for(THREAD_TEST_LONG_DELAY);
 }
 
+struct affinity_check
+{
+  twine::cpu_set  expected;
+  bool            pinned;
+  int32_t         cpu;
+
+  affinity_check()
+    : expected()
+    , pinned(false)
+    , cpu(-1)
+  {
+  }
+};
+
+void thread_check_affinity(void * arg)
+{
+  affinity_check * check = static_cast<affinity_check *>(arg);
+  twine::cpu_set actual;
+  check->pinned = twine::this_thread::get_affinity(actual)
+    && actual == check->expected;
+  check->cpu = twine::this_thread::get_cpu();
+}
+
+struct stack_check
+{
+  char const *  low;
+  char const *  high;
+  bool          inside;
+
+  stack_check(char const * _low, size_t size)
+    : low(_low)
+    , high(_low + size)
+    , inside(false)
+  {
+  }
+};
+
+void thread_check_stack(void * arg)
+{
+  stack_check * check = static_cast<stack_check *>(arg);
+  char local = 0;
+  check->inside = (&local >= check->low && &local < check->high);
+}
+
+struct exit_slot
+{
+  int * counter;
+  int   order;
+};
+
+void record_exit(void * arg)
+{
+  exit_slot * slot = static_cast<exit_slot *>(arg);
+  slot->order = ++(*slot->counter);
+}
+
+struct exit_test
+{
+  int       counter;
+  exit_slot slots[3];
+};
+
+void thread_at_exit(void * arg)
+{
+  exit_test * test = static_cast<exit_test *>(arg);
+  for (int i = 0 ; i < 3 ; ++i) {
+    test->slots[i].counter = &test->counter;
+    test->slots[i].order = 0;
+    CPPUNIT_ASSERT(twine::this_thread::at_exit(record_exit, &test->slots[i]));
+  }
+}
+
 struct bind_test
 {
   bool called;
@@ -94,6 +168,10 @@ public:
       CPPUNIT_TEST(testMultipleThreads);
       CPPUNIT_TEST(testBinder);
       CPPUNIT_TEST(testHardwareConcurrency);
+      CPPUNIT_TEST(testAffinity);
+      CPPUNIT_TEST(testAttributes);
+      CPPUNIT_TEST(testTimerSlack);
+      CPPUNIT_TEST(testAtExit);
 
     CPPUNIT_TEST_SUITE_END();
 
@@ -311,6 +389,210 @@ private:
       // platform the tests run, some sort of concurrency can be determined.
       CPPUNIT_ASSERT(twine::thread::hardware_concurrency() > 0);
     }
+
+
+
+    void testAffinity()
+    {
+      // The calling thread may run on some set of CPUs; pick the first.
+      twine::cpu_set allowed;
+      if (!twine::this_thread::get_affinity(allowed)) {
+        // Not supported on this platform.
+        return;
+      }
+      CPPUNIT_ASSERT(!allowed.empty());
+      CPPUNIT_ASSERT(twine::this_thread::get_cpu() >= 0);
+
+      uint32_t first = 0;
+      while (!allowed.test(first)) {
+        ++first;
+      }
+
+      // Set before starting; applies before the thread function runs.
+      {
+        affinity_check check;
+        check.expected.set(first);
+
+        twine::thread th(thread_check_affinity, &check, false);
+        CPPUNIT_ASSERT(th.set_affinity(check.expected));
+
+        twine::cpu_set pending;
+        CPPUNIT_ASSERT(th.get_affinity(pending));
+        CPPUNIT_ASSERT(pending == check.expected);
+
+        th.start();
+        th.join();
+        CPPUNIT_ASSERT(check.pinned);
+        CPPUNIT_ASSERT_EQUAL(int32_t(first), check.cpu);
+      }
+
+      // Change at runtime
+      {
+        twine::thread th(thread_sleep, nullptr);
+        twine::cpu_set single;
+        single.set(first);
+        CPPUNIT_ASSERT(th.set_affinity(single));
+
+        twine::cpu_set actual;
+        CPPUNIT_ASSERT(th.get_affinity(actual));
+        CPPUNIT_ASSERT(actual == single);
+
+        // Empty sets can't be applied to running threads.
+        CPPUNIT_ASSERT(!th.set_affinity(twine::cpu_set()));
+        th.join();
+      }
+
+      // Change right after starting; pinning the new thread to the affinity
+      // it was started with must not undo the change.
+      {
+        twine::thread th(thread_sleep, nullptr, false);
+        CPPUNIT_ASSERT(th.set_affinity(allowed));
+        th.start();
+
+        twine::cpu_set single;
+        single.set(first);
+        CPPUNIT_ASSERT(th.set_affinity(single));
+        twine::this_thread::sleep_for(THREAD_TEST_SHORT_DELAY);
+
+        twine::cpu_set actual;
+        CPPUNIT_ASSERT(th.get_affinity(actual));
+        CPPUNIT_ASSERT(actual == single);
+        th.join();
+      }
+
+      // Restore the calling thread's affinity after pinning it.
+      twine::cpu_set single;
+      single.set(first);
+      CPPUNIT_ASSERT(twine::this_thread::set_affinity(single));
+      CPPUNIT_ASSERT_EQUAL(int32_t(first), twine::this_thread::get_cpu());
+      CPPUNIT_ASSERT(twine::this_thread::set_affinity(allowed));
+    }
+
+
+
+    void testTimerSlack()
+    {
+      namespace tc = twine::chrono;
+
+      tc::nanoseconds old;
+      if (!twine::this_thread::get_timer_slack(old)) {
+        // Not supported on this platform.
+        CPPUNIT_ASSERT(!twine::this_thread::set_timer_slack(tc::nanoseconds(1)));
+        return;
+      }
+
+      CPPUNIT_ASSERT(twine::this_thread::set_timer_slack(tc::microseconds(1)));
+      tc::nanoseconds slack;
+      CPPUNIT_ASSERT(twine::this_thread::get_timer_slack(slack));
+      CPPUNIT_ASSERT_EQUAL(tc::default_repr_t(1000), slack.raw());
+
+      // Zero is clamped to the minimum rather than resetting to the default.
+      CPPUNIT_ASSERT(twine::this_thread::set_timer_slack(tc::nanoseconds(0)));
+      CPPUNIT_ASSERT(twine::this_thread::get_timer_slack(slack));
+      CPPUNIT_ASSERT_EQUAL(tc::default_repr_t(1), slack.raw());
+
+      CPPUNIT_ASSERT(twine::this_thread::set_timer_slack(old));
+    }
+
+
+
+    void testAtExit()
+    {
+      // Only threads started by twine have exit handlers.
+      CPPUNIT_ASSERT(!twine::this_thread::at_exit(record_exit, nullptr));
+
+      // Handlers run when the thread function returns, most recent first.
+      exit_test test;
+      test.counter = 0;
+      twine::thread th(thread_at_exit, &test);
+      th.join();
+
+      CPPUNIT_ASSERT_EQUAL(3, test.counter);
+      CPPUNIT_ASSERT_EQUAL(3, test.slots[0].order);
+      CPPUNIT_ASSERT_EQUAL(2, test.slots[1].order);
+      CPPUNIT_ASSERT_EQUAL(1, test.slots[2].order);
+    }
+
+
+
+    void testAttributes()
+    {
+      // Stack and guard sizes; too small sizes get rounded up.
+      {
+        baton b;
+        twine::thread::attributes attrs;
+        attrs.set_stack_size(1);
+        attrs.set_guard_size(0);
+
+        twine::thread th(thread_incr, &b, attrs);
+        th.join();
+        CPPUNIT_ASSERT_EQUAL(int(1), b.count);
+
+      }
+
+      // Attributes can be set on a thread before it is started.
+      {
+        baton b;
+        twine::thread::attributes attrs;
+        attrs.set_stack_size(256 * 1024);
+
+        twine::thread th(thread_incr, &b, false);
+        CPPUNIT_ASSERT(th.set_attributes(attrs));
+        CPPUNIT_ASSERT_EQUAL(size_t(256 * 1024),
+            th.get_attributes().stack_size());
+        th.start();
+        th.join();
+        CPPUNIT_ASSERT_EQUAL(int(1), b.count);
+      }
+
+      // Attributes can't be changed while the thread runs.
+      {
+        twine::thread th(thread_sleep, nullptr);
+        CPPUNIT_ASSERT(!th.set_attributes(twine::thread::attributes()));
+        th.join();
+      }
+
+#if defined(TWINE_POSIX)
+      // Caller provided stack
+      {
+        size_t size = 256 * 1024;
+        std::vector<uint64_t> buffer(size / sizeof(uint64_t));
+        char const * low = reinterpret_cast<char const *>(&buffer[0]);
+
+        twine::thread::attributes attrs;
+        attrs.set_stack(&buffer[0], size);
+        CPPUNIT_ASSERT(&buffer[0] == attrs.stack());
+
+        stack_check check(low, size);
+        twine::thread th(thread_check_stack, &check, attrs);
+        th.join();
+        CPPUNIT_ASSERT(check.inside);
+      }
+#endif
+
+      // Scheduling and nice levels are best effort; threads must start
+      // whether or not we're privileged enough.
+      {
+        baton b;
+        twine::thread::attributes attrs;
+        attrs.set_scheduling(twine::thread::SCHEDULING_FIFO, 10);
+        attrs.set_nice(-20);
+
+        twine::thread th(thread_incr, &b, attrs);
+        th.join();
+        CPPUNIT_ASSERT_EQUAL(int(1), b.count);
+      }
+      {
+        baton b;
+        twine::thread::attributes attrs;
+        attrs.set_scheduling(twine::thread::SCHEDULING_BATCH);
+        attrs.set_nice(5);
+
+        twine::thread th(thread_incr, &b, attrs);
+        th.join();
+        CPPUNIT_ASSERT_EQUAL(int(1), b.count);
+      }
+    }
 };
 
 
@@ -0,0 +1,243 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <twine/thread_pool.h>
+
+#include <twine/atomic.h>
+#include <twine/chrono.h>
+
+namespace {
+
+struct counter
+{
+  twine::atomic<uint32_t> count;
+
+  counter()
+    : count(0)
+  {
+  }
+};
+
+
+void increment(void * arg)
+{
+  counter * c = static_cast<counter *>(arg);
+  c->count.fetch_add(1);
+}
+
+
+void increment_slowly(void * arg)
+{
+  twine::this_thread::sleep_for(twine::chrono::milliseconds(1));
+  increment(arg);
+}
+
+
+struct fan_out
+{
+  twine::thread_pool *    pool;
+  twine::atomic<uint32_t> leaves;
+  twine::atomic<uint32_t> on_worker;
+  int                     depth;
+
+  fan_out(twine::thread_pool * _pool, int _depth)
+    : pool(_pool)
+    , leaves(0)
+    , on_worker(0)
+    , depth(_depth)
+  {
+  }
+};
+
+
+struct fan_out_node
+{
+  fan_out * shared;
+  int       level;
+};
+
+
+void fan_out_func(void * arg)
+{
+  fan_out_node * node = static_cast<fan_out_node *>(arg);
+  fan_out * shared = node->shared;
+
+  if (shared->pool->is_worker()) {
+    shared->on_worker.fetch_add(1);
+  }
+
+  if (node->level == shared->depth) {
+    shared->leaves.fetch_add(1);
+    delete node;
+    return;
+  }
+
+  // Each node spawns two children from within the pool.
+  for (int i = 0 ; i < 2 ; ++i) {
+    fan_out_node * child = new fan_out_node();
+    child->shared = shared;
+    child->level = node->level + 1;
+    shared->pool->submit(fan_out_func, child);
+  }
+  delete node;
+}
+
+
+struct bind_test
+{
+  twine::atomic<uint32_t> called;
+
+  bind_test()
+    : called(0)
+  {
+  }
+
+  void member(void * baton)
+  {
+    CPPUNIT_ASSERT_EQUAL(static_cast<void*>(this), baton);
+    called.fetch_add(1);
+  }
+};
+
+} // anonymous namespace
+
+
+class ThreadPoolTest
+  : public CppUnit::TestFixture
+{
+public:
+  CPPUNIT_TEST_SUITE(ThreadPoolTest);
+
+    CPPUNIT_TEST(testSize);
+    CPPUNIT_TEST(testSubmit);
+    CPPUNIT_TEST(testNestedSubmit);
+    CPPUNIT_TEST(testBinder);
+    CPPUNIT_TEST(testRunOne);
+    CPPUNIT_TEST(testDestructorDrains);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testSize()
+  {
+    twine::thread_pool pool(3);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(3), pool.size());
+    CPPUNIT_ASSERT(!pool.is_worker());
+
+    // Zero means hardware concurrency, but there is always one worker.
+    twine::thread_pool pool2;
+    CPPUNIT_ASSERT(pool2.size() >= 1);
+  }
+
+
+  void testSubmit()
+  {
+    counter c;
+    twine::thread_pool pool(4);
+
+    CPPUNIT_ASSERT_EQUAL(false, pool.submit(nullptr, &c));
+
+    for (int i = 0 ; i < 10000 ; ++i) {
+      CPPUNIT_ASSERT(pool.submit(increment, &c));
+    }
+    pool.wait();
+    CPPUNIT_ASSERT_EQUAL(uint32_t(10000), c.count.load());
+
+    // The pool is reusable after waiting.
+    for (int i = 0 ; i < 100 ; ++i) {
+      CPPUNIT_ASSERT(pool.submit(increment_slowly, &c));
+    }
+    pool.wait();
+    CPPUNIT_ASSERT_EQUAL(uint32_t(10100), c.count.load());
+  }
+
+
+  void testNestedSubmit()
+  {
+    // Jobs submitted from workers go onto the workers' own deques and get
+    // stolen from there.
+    twine::thread_pool pool(4);
+    fan_out shared(&pool, 12);
+
+    fan_out_node * root = new fan_out_node();
+    root->shared = &shared;
+    root->level = 0;
+    pool.submit(fan_out_func, root);
+    pool.wait();
+
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1 << 12), shared.leaves.load());
+    CPPUNIT_ASSERT_EQUAL(uint32_t((1 << 13) - 1), shared.on_worker.load());
+  }
+
+
+  void testBinder()
+  {
+    // Member functions bound for threads run unchanged in the pool.
+    bind_test test;
+    twine::thread_pool pool(2);
+    for (int i = 0 ; i < 10 ; ++i) {
+      pool.submit(twine::thread::binder<bind_test, &bind_test::member>::function,
+          &test);
+    }
+    pool.wait();
+    CPPUNIT_ASSERT_EQUAL(uint32_t(10), test.called.load());
+  }
+
+
+  void testRunOne()
+  {
+    counter c;
+    twine::thread_pool pool(1);
+
+    // Keep the only worker busy, then help out from this thread.
+    for (int i = 0 ; i < 100 ; ++i) {
+      pool.submit(increment_slowly, &c);
+    }
+    int helped = 0;
+    while (pool.run_one()) {
+      ++helped;
+    }
+    pool.wait();
+
+    CPPUNIT_ASSERT(helped > 0);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(100), c.count.load());
+    CPPUNIT_ASSERT_EQUAL(false, pool.run_one());
+  }
+
+
+  void testDestructorDrains()
+  {
+    counter c;
+    {
+      twine::thread_pool pool(2);
+      for (int i = 0 ; i < 50 ; ++i) {
+        pool.submit(increment_slowly, &c);
+      }
+    }
+    CPPUNIT_ASSERT_EQUAL(uint32_t(50), c.count.load());
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ThreadPoolTest);
@@ -0,0 +1,313 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "compare_times.h"
+
+#include <vector>
+
+#include <twine/timer_wheel.h>
+#include <twine/tasklet.h>
+#include <twine/tasklet_scheduler.h>
+#include <twine/atomic.h>
+
+#define WHEEL_TEST_SHORT_DELAY twine::chrono::milliseconds(10)
+#define WHEEL_TEST_LONG_DELAY  twine::chrono::milliseconds(100)
+
+namespace {
+
+struct fired
+{
+  twine::mutex                      mutex;
+  std::vector<int>                  order;
+  twine::chrono::nanoseconds        last;
+};
+
+
+struct fire_record
+{
+  fired * f;
+  int     id;
+};
+
+
+void record_fire(void * baton)
+{
+  fire_record * rec = static_cast<fire_record *>(baton);
+  twine::scoped_lock<twine::mutex> lock(rec->f->mutex);
+  rec->f->order.push_back(rec->id);
+  rec->f->last = twine::chrono::now();
+}
+
+
+void count_fire(void * baton)
+{
+  static_cast<twine::atomic<uint32_t> *>(baton)->fetch_add(1);
+}
+
+
+void count_wakeups(twine::tasklet & t, void * baton)
+{
+  twine::atomic<uint32_t> * c = static_cast<twine::atomic<uint32_t> *>(baton);
+  while (t.sleep()) {
+    c->fetch_add(1);
+  }
+}
+
+
+void sleep_repeatedly(twine::tasklet & t, void * baton)
+{
+  twine::atomic<uint32_t> * c = static_cast<twine::atomic<uint32_t> *>(baton);
+  for (int i = 0 ; i < 10 ; ++i) {
+    if (!t.sleep(WHEEL_TEST_SHORT_DELAY)) {
+      break;
+    }
+    c->fetch_add(1);
+  }
+}
+
+} // anonymous namespace
+
+
+class TimerWheelTest
+  : public CppUnit::TestFixture
+{
+public:
+  CPPUNIT_TEST_SUITE(TimerWheelTest);
+
+    CPPUNIT_TEST(testFireOrder);
+    CPPUNIT_TEST(testTiming);
+    CPPUNIT_TEST(testCancel);
+    CPPUNIT_TEST(testReschedule);
+    CPPUNIT_TEST(testManyTimers);
+    CPPUNIT_TEST(testCascade);
+    CPPUNIT_TEST(testWakeupTasklet);
+    CPPUNIT_TEST(testThreadTaskletSleep);
+    CPPUNIT_TEST(testScheduledTaskletSleep);
+
+  CPPUNIT_TEST_SUITE_END();
+
+private:
+
+  void testFireOrder()
+  {
+    twine::timer_wheel wheel;
+    fired f;
+
+    fire_record recs[3] = { { &f, 0 }, { &f, 1 }, { &f, 2 } };
+    twine::timer_wheel::timer timers[3];
+
+    CPPUNIT_ASSERT(wheel.schedule(timers[2], twine::chrono::milliseconds(60),
+          record_fire, &recs[2]));
+    CPPUNIT_ASSERT(wheel.schedule(timers[0], twine::chrono::milliseconds(20),
+          record_fire, &recs[0]));
+    CPPUNIT_ASSERT(wheel.schedule(timers[1], twine::chrono::milliseconds(40),
+          record_fire, &recs[1]));
+    CPPUNIT_ASSERT_EQUAL(size_t(3), wheel.size());
+
+    twine::this_thread::sleep_for(WHEEL_TEST_LONG_DELAY);
+
+    CPPUNIT_ASSERT_EQUAL(size_t(0), wheel.size());
+    twine::scoped_lock<twine::mutex> lock(f.mutex);
+    CPPUNIT_ASSERT_EQUAL(size_t(3), f.order.size());
+    for (int i = 0 ; i < 3 ; ++i) {
+      CPPUNIT_ASSERT_EQUAL(i, f.order[i]);
+      CPPUNIT_ASSERT(!timers[i].pending());
+    }
+  }
+
+
+  void testTiming()
+  {
+    twine::timer_wheel wheel;
+    fired f;
+    fire_record rec = { &f, 0 };
+    twine::timer_wheel::timer t;
+
+    twine::chrono::nanoseconds t1 = twine::chrono::now();
+    wheel.schedule(t, WHEEL_TEST_LONG_DELAY, record_fire, &rec);
+    twine::this_thread::sleep_for(twine::chrono::milliseconds(200));
+
+    twine::scoped_lock<twine::mutex> lock(f.mutex);
+    CPPUNIT_ASSERT_EQUAL(size_t(1), f.order.size());
+    CPPUNIT_ASSERT(f.last - t1 >= WHEEL_TEST_LONG_DELAY);
+    compare_times(t1, f.last, WHEEL_TEST_LONG_DELAY);
+  }
+
+
+  void testCancel()
+  {
+    twine::timer_wheel wheel;
+    twine::atomic<uint32_t> count(0);
+    twine::timer_wheel::timer t;
+
+    CPPUNIT_ASSERT(!wheel.cancel(t));
+
+    wheel.schedule(t, WHEEL_TEST_SHORT_DELAY, count_fire, &count);
+    CPPUNIT_ASSERT(t.pending());
+    CPPUNIT_ASSERT(wheel.cancel(t));
+    CPPUNIT_ASSERT(!t.pending());
+    CPPUNIT_ASSERT(!wheel.cancel(t));
+    CPPUNIT_ASSERT_EQUAL(size_t(0), wheel.size());
+
+    twine::this_thread::sleep_for(twine::chrono::milliseconds(30));
+    CPPUNIT_ASSERT_EQUAL(uint32_t(0), count.load());
+
+    // A timer going out of scope cancels itself.
+    {
+      twine::timer_wheel::timer scoped;
+      wheel.schedule(scoped, WHEEL_TEST_SHORT_DELAY, count_fire, &count);
+      CPPUNIT_ASSERT_EQUAL(size_t(1), wheel.size());
+    }
+    CPPUNIT_ASSERT_EQUAL(size_t(0), wheel.size());
+  }
+
+
+  void testReschedule()
+  {
+    twine::timer_wheel wheel;
+    twine::atomic<uint32_t> count(0);
+    twine::timer_wheel::timer t;
+
+    // Rescheduling a pending timer moves it rather than adding a second one.
+    wheel.schedule(t, twine::chrono::seconds(10), count_fire, &count);
+    wheel.schedule(t, WHEEL_TEST_SHORT_DELAY, count_fire, &count);
+    CPPUNIT_ASSERT_EQUAL(size_t(1), wheel.size());
+
+    twine::this_thread::sleep_for(WHEEL_TEST_LONG_DELAY);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1), count.load());
+
+    // Fired timers can be reused.
+    wheel.schedule(t, WHEEL_TEST_SHORT_DELAY, count_fire, &count);
+    twine::this_thread::sleep_for(WHEEL_TEST_LONG_DELAY);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(2), count.load());
+  }
+
+
+  void testManyTimers()
+  {
+    twine::timer_wheel wheel;
+    twine::atomic<uint32_t> count(0);
+
+    std::vector<twine::timer_wheel::timer *> timers;
+    for (int i = 0 ; i < 10000 ; ++i) {
+      timers.push_back(new twine::timer_wheel::timer());
+      wheel.schedule(*timers.back(), twine::chrono::milliseconds(i % 50),
+          count_fire, &count);
+    }
+
+    twine::this_thread::sleep_for(twine::chrono::milliseconds(200));
+    CPPUNIT_ASSERT_EQUAL(uint32_t(10000), count.load());
+    CPPUNIT_ASSERT_EQUAL(size_t(0), wheel.size());
+
+    for (size_t i = 0 ; i < timers.size() ; ++i) {
+      delete timers[i];
+    }
+  }
+
+
+  void testCascade()
+  {
+    // With a 1ms resolution, 300ms lies beyond the first level and must
+    // cascade down before firing.
+    twine::timer_wheel wheel(twine::chrono::milliseconds(1));
+    fired f;
+    fire_record rec = { &f, 0 };
+    twine::timer_wheel::timer t;
+
+    twine::chrono::nanoseconds t1 = twine::chrono::now();
+    wheel.schedule(t, twine::chrono::milliseconds(300), record_fire, &rec);
+
+    twine::this_thread::sleep_for(twine::chrono::milliseconds(400));
+
+    twine::scoped_lock<twine::mutex> lock(f.mutex);
+    CPPUNIT_ASSERT_EQUAL(size_t(1), f.order.size());
+    compare_times(t1, f.last, twine::chrono::milliseconds(300));
+  }
+
+
+  void testWakeupTasklet()
+  {
+    twine::timer_wheel wheel;
+    twine::atomic<uint32_t> count(0);
+    twine::tasklet task(count_wakeups, &count, true);
+    twine::timer_wheel::timer t;
+
+    twine::this_thread::sleep_for(WHEEL_TEST_SHORT_DELAY);
+    wheel.schedule_wakeup(t, WHEEL_TEST_SHORT_DELAY, task);
+    twine::this_thread::sleep_for(WHEEL_TEST_LONG_DELAY);
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1), count.load());
+
+    CPPUNIT_ASSERT(task.stop());
+    CPPUNIT_ASSERT(task.wait());
+  }
+
+
+  void testThreadTaskletSleep()
+  {
+    twine::timer_wheel wheel;
+    twine::atomic<uint32_t> count(0);
+    twine::tasklet task(sleep_repeatedly, &count);
+    task.set_timer_wheel(&wheel);
+
+    twine::chrono::nanoseconds t1 = twine::chrono::now();
+    CPPUNIT_ASSERT(task.start());
+    CPPUNIT_ASSERT(task.wait());
+    twine::chrono::nanoseconds t2 = twine::chrono::now();
+
+    CPPUNIT_ASSERT_EQUAL(uint32_t(10), count.load());
+    compare_times(t1, t2, twine::chrono::milliseconds(100));
+
+    // Stopping interrupts a sleep on the wheel.
+    twine::tasklet sleeper(count_wakeups, &count);
+    sleeper.set_timer_wheel(&wheel);
+    CPPUNIT_ASSERT(sleeper.start());
+    CPPUNIT_ASSERT(sleeper.stop());
+    CPPUNIT_ASSERT(sleeper.wait());
+  }
+
+
+  void testScheduledTaskletSleep()
+  {
+    twine::timer_wheel wheel;
+    twine::tasklet_scheduler sched(2);
+    twine::atomic<uint32_t> count(0);
+
+    std::vector<twine::tasklet *> tasks;
+    for (int i = 0 ; i < 100 ; ++i) {
+      twine::tasklet * task = new twine::tasklet(sched, sleep_repeatedly,
+          &count);
+      task->set_timer_wheel(&wheel);
+      CPPUNIT_ASSERT(task->start());
+      tasks.push_back(task);
+    }
+    for (size_t i = 0 ; i < tasks.size() ; ++i) {
+      CPPUNIT_ASSERT(tasks[i]->wait());
+      delete tasks[i];
+    }
+
+    CPPUNIT_ASSERT_EQUAL(uint32_t(1000), count.load());
+  }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimerWheelTest);
@@ -0,0 +1,120 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "compare_times.h"
+
+#include <twine/tsc_clock.h>
+
+namespace tc = twine::chrono;
+
+class TSCClockTest
+    : public CppUnit::TestFixture
+{
+public:
+    CPPUNIT_TEST_SUITE(TSCClockTest);
+
+      CPPUNIT_TEST(testCalibration);
+      CPPUNIT_TEST(testMonotonic);
+      CPPUNIT_TEST(testTracksMonotonicClock);
+      CPPUNIT_TEST(testScale);
+
+    CPPUNIT_TEST_SUITE_END();
+
+private:
+
+    void testCalibration()
+    {
+      // Whether the counter is usable depends on the CPU; but calibration must
+      // terminate, and be consistent with the reported frequency.
+      bool usable = tc::tsc_clock::calibrate();
+      CPPUNIT_ASSERT_EQUAL(usable, tc::tsc_clock::usable());
+      if (usable) {
+        CPPUNIT_ASSERT(tc::tsc_clock::ticks() > 0);
+        // Counters tick at least in the MHz range.
+        CPPUNIT_ASSERT(tc::tsc_clock::frequency() > 1000000);
+      }
+      else {
+        CPPUNIT_ASSERT_EQUAL(uint64_t(0), tc::tsc_clock::frequency());
+      }
+    }
+
+
+
+    void testMonotonic()
+    {
+      tc::tsc_clock::calibrate();
+
+      tc::nanoseconds prev = tc::fast_now();
+      for (int i = 0 ; i < 100000 ; ++i) {
+        tc::nanoseconds now = tc::fast_now();
+        CPPUNIT_ASSERT(now >= prev);
+        prev = now;
+      }
+    }
+
+
+
+    void testTracksMonotonicClock()
+    {
+      tc::tsc_clock::calibrate();
+
+      // Intervals must match the monotonic clock's.
+      tc::nanoseconds start = tc::fast_now();
+      tc::sleep(tc::milliseconds(25).convert<tc::nanoseconds>());
+      tc::nanoseconds end = tc::fast_now();
+      compare_times(start, end, tc::milliseconds(25));
+
+      // And both clocks share an epoch, give or take a millisecond.
+      tc::nanoseconds diff = tc::fast_now() - tc::monotonic_now();
+      if (diff < tc::nanoseconds(0)) {
+        diff = tc::nanoseconds(0) - diff;
+      }
+      CPPUNIT_ASSERT(diff < tc::milliseconds(1).convert<tc::nanoseconds>());
+    }
+
+
+
+    void testScale()
+    {
+      // 1.5 in 32.32 fixed point
+      uint64_t const one_and_a_half = 3ULL << 31;
+
+      CPPUNIT_ASSERT_EQUAL(uint64_t(0),
+          tc::detail::tsc_scale(0, one_and_a_half));
+      CPPUNIT_ASSERT_EQUAL(uint64_t(3),
+          tc::detail::tsc_scale(2, one_and_a_half));
+
+      // Large tick counts must not overflow in intermediate results.
+      uint64_t const ticks = 1ULL << 50;
+      CPPUNIT_ASSERT_EQUAL(uint64_t(3) << 49,
+          tc::detail::tsc_scale(ticks, one_and_a_half));
+
+      // 41.666ns per tick, as with a 24MHz counter.
+      uint64_t const slow = uint64_t(41.6666666667 * 4294967296.0);
+      uint64_t const second = tc::detail::tsc_scale(24000000, slow);
+      CPPUNIT_ASSERT(second > 999999990 && second <= 1000000000);
+    }
+};
+
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TSCClockTest);
@@ -0,0 +1,135 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_ATOMIC_H
+#define TWINE_ATOMIC_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+
+/**
+ * Size of a cache line. Data that is written by different threads should be
+ * kept this far apart to avoid false sharing.
+ **/
+#if !defined(TWINE_CACHE_LINE_SIZE)
+#  define TWINE_CACHE_LINE_SIZE 64
+#endif
+
+namespace twine {
+
+/**
+ * Memory ordering constraints, modelled after the C++11 standard's. Platforms
+ * that cannot express weaker orderings treat everything as
+ * memory_order_seq_cst.
+ **/
+enum memory_order
+{
+  memory_order_relaxed,
+  memory_order_acquire,
+  memory_order_release,
+  memory_order_acq_rel,
+  memory_order_seq_cst
+};
+
+
+/**
+ * Minimal atomic value wrapper.
+ *
+ * Twine supports compilers without C++11's <atomic>, so this class provides
+ * the small subset of std::atomic that the library itself requires. For
+ * portability, the value type must be a 32 or 64 bit integral type or a
+ * pointer. The fetch_*() family of functions is only defined for integral
+ * types.
+ *
+ * All operations default to memory_order_seq_cst, just like the standard's.
+ **/
+template <
+  typename valueT
+>
+class atomic
+  : public twine::noncopyable
+{
+public:
+  typedef valueT value_type;
+
+  // Constructor
+  explicit atomic(valueT const & value = valueT());
+
+  // Load/store
+  inline valueT load(memory_order order = memory_order_seq_cst) const;
+  inline void store(valueT value, memory_order order = memory_order_seq_cst);
+
+  // Read-modify-write operations; all return the previous value.
+  inline valueT exchange(valueT value,
+      memory_order order = memory_order_seq_cst);
+
+  inline valueT fetch_add(valueT value,
+      memory_order order = memory_order_seq_cst);
+  inline valueT fetch_sub(valueT value,
+      memory_order order = memory_order_seq_cst);
+  inline valueT fetch_or(valueT value,
+      memory_order order = memory_order_seq_cst);
+  inline valueT fetch_and(valueT value,
+      memory_order order = memory_order_seq_cst);
+
+  /**
+   * Replaces the value with desired if it is equal to expected, and returns
+   * true. Otherwise the current value is written to expected and false is
+   * returned. This corresponds to the standard's compare_exchange_strong().
+   **/
+  inline bool compare_exchange(valueT & expected, valueT desired,
+      memory_order order = memory_order_seq_cst);
+
+private:
+  volatile valueT m_value;
+};
+
+
+/**
+ * Fence with the given memory ordering.
+ **/
+inline void atomic_thread_fence(memory_order order = memory_order_seq_cst);
+
+
+namespace detail {
+
+/**
+ * Hint to the CPU that the calling thread is spinning; on SMT systems this
+ * yields pipeline resources to the sibling thread.
+ **/
+inline void cpu_relax();
+
+} // namespace detail
+
+} // namespace twine
+
+
+#if defined(TWINE_WIN32)
+  #include <twine/win32/atomic.h>
+#elif defined(TWINE_POSIX)
+  #include <twine/posix/atomic.h>
+#endif
+
+#endif // guard
@@ -0,0 +1,140 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/barrier.h>
+
+#include <twine/scoped_lock.h>
+
+namespace twine {
+
+barrier::barrier(uint32_t count, completion_function completion /* = nullptr */,
+    void * baton /* = nullptr */)
+  : m_count(count)
+  , m_completion(completion)
+  , m_baton(baton)
+  , m_remaining(count)
+  , m_generation(0)
+  , m_waiters(0)
+  , m_mutex()
+  , m_cond()
+{
+}
+
+
+
+barrier::~barrier()
+{
+  // Wait for the last arriving thread to release the mutex.
+  scoped_lock<mutex> lock(m_mutex);
+}
+
+
+
+bool
+barrier::arrive_and_wait()
+{
+  // The generation can't change before we've arrived, so this is ours.
+  uint32_t generation = m_generation.load();
+
+  if (1 == m_remaining.fetch_sub(1)) {
+    if (m_completion) {
+      m_completion(m_baton);
+    }
+
+    // Start the next phase under the lock, so that no waiter can return and
+    // destroy the barrier while we're still using it.
+    scoped_lock<mutex> lock(m_mutex);
+    m_remaining.store(m_count);
+    m_generation.fetch_add(1);
+    if (m_waiters) {
+      m_cond.notify_all();
+    }
+    return true;
+  }
+
+  scoped_lock<mutex> lock(m_mutex);
+  ++m_waiters;
+  while (generation == m_generation.load()) {
+    m_cond.wait(lock);
+  }
+  --m_waiters;
+  return false;
+}
+
+
+
+uint32_t
+barrier::generation() const
+{
+  return m_generation.load();
+}
+
+
+
+spin_barrier::spin_barrier(uint32_t count,
+    completion_function completion /* = nullptr */,
+    void * baton /* = nullptr */)
+  : m_count(count)
+  , m_completion(completion)
+  , m_baton(baton)
+  , m_remaining(count)
+  , m_generation(0)
+{
+}
+
+
+
+spin_barrier::~spin_barrier()
+{
+}
+
+
+
+bool
+spin_barrier::arrive_and_wait()
+{
+  uint32_t generation = m_generation.load(memory_order_acquire);
+
+  if (1 == m_remaining.fetch_sub(1, memory_order_acq_rel)) {
+    if (m_completion) {
+      m_completion(m_baton);
+    }
+
+    // Bumping the generation is the last access to the barrier.
+    m_remaining.store(m_count, memory_order_relaxed);
+    m_generation.fetch_add(1, memory_order_release);
+    return true;
+  }
+
+  while (generation == m_generation.load(memory_order_acquire)) {
+    detail::cpu_relax();
+  }
+  return false;
+}
+
+
+
+uint32_t
+spin_barrier::generation() const
+{
+  return m_generation.load(memory_order_acquire);
+}
+
+} // namespace twine
@@ -0,0 +1,133 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_BARRIER_H
+#define TWINE_BARRIER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <meta/nullptr.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+
+namespace twine {
+
+/**
+ * Reusable thread barrier.
+ *
+ * A fixed number of threads call arrive_and_wait() in each phase; all of them
+ * block until the last one arrives. The last arriving thread runs the optional
+ * completion function before anyone is released, then starts the next phase
+ * and wakes the others with a single notification.
+ *
+ * Phases are told apart by a generation counter, so the barrier can be reused
+ * immediately without re-initialization.
+ *
+ * Example:
+ *
+ *   barrier phase(workers);
+ *
+ *   void worker()
+ *   {
+ *     for (;;) {
+ *       compute_step();
+ *       phase.arrive_and_wait();
+ *     }
+ *   }
+ **/
+class barrier
+  : public twine::noncopyable
+{
+public:
+  typedef void (*completion_function)(void * baton);
+
+  explicit barrier(uint32_t count, completion_function completion = nullptr,
+      void * baton = nullptr);
+  ~barrier();
+
+  // Arrive at the barrier, and wait for the other threads of this phase.
+  // Returns true in exactly one thread per phase, namely the last to arrive.
+  bool arrive_and_wait();
+
+  // Number of completed phases.
+  uint32_t generation() const;
+
+private:
+  uint32_t                m_count;
+  completion_function     m_completion;
+  void *                  m_baton;
+
+  twine::atomic<uint32_t> m_remaining;
+  twine::atomic<uint32_t> m_generation;
+
+  // Protected by m_mutex
+  uint32_t                m_waiters;
+  mutex                   m_mutex;
+  condition               m_cond;
+};
+
+
+
+/**
+ * Spinning variant of barrier.
+ *
+ * Waiting threads busy-wait on the generation counter instead of blocking, so
+ * releasing them takes no system calls. This makes for much shorter phase
+ * transitions when each thread has a dedicated core, but wastes CPU time and
+ * degrades badly if there are more threads than cores.
+ **/
+class spin_barrier
+  : public twine::noncopyable
+{
+public:
+  typedef barrier::completion_function completion_function;
+
+  explicit spin_barrier(uint32_t count,
+      completion_function completion = nullptr, void * baton = nullptr);
+  ~spin_barrier();
+
+  // See barrier::arrive_and_wait()
+  bool arrive_and_wait();
+
+  // Number of completed phases.
+  uint32_t generation() const;
+
+private:
+  uint32_t                m_count;
+  completion_function     m_completion;
+  void *                  m_baton;
+
+  // Arriving threads write m_remaining, while waiting threads poll
+  // m_generation; keep them apart.
+  twine::atomic<uint32_t> m_remaining;
+  char                    m_padding[TWINE_CACHE_LINE_SIZE];
+  twine::atomic<uint32_t> m_generation;
+};
+
+} // namespace twine
+
+#endif // guard
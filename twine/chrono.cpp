@@ -0,0 +1,210 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/chrono.h>
+
+#include <string.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+namespace chrono {
+
+TWINE_ANONS_START
+
+static uint64_t const NSECS_PER_USEC = 1000ULL;
+static uint64_t const NSECS_PER_MSEC = 1000000ULL;
+static uint64_t const NSECS_PER_SEC = 1000000000ULL;
+static uint64_t const NSECS_PER_MIN = 60ULL * NSECS_PER_SEC;
+static uint64_t const NSECS_PER_HOUR = 60ULL * NSECS_PER_MIN;
+
+// Two digit pairs at a time halve the number of divisions.
+static char const DIGIT_PAIRS[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+
+/**
+ * Writes exactly width digits of value, backwards from end.
+ **/
+static inline void
+write_digits(char * end, uint64_t value, int width)
+{
+  while (width >= 2) {
+    uint64_t const pair = (value % 100) * 2;
+    value /= 100;
+    *--end = DIGIT_PAIRS[pair + 1];
+    *--end = DIGIT_PAIRS[pair];
+    width -= 2;
+  }
+  if (width) {
+    *--end = char('0' + (value % 10));
+  }
+}
+
+
+static inline int
+count_digits(uint64_t value)
+{
+  int digits = 1;
+  while (value >= 10000) {
+    value /= 10000;
+    digits += 4;
+  }
+  return digits + (value >= 10) + (value >= 100) + (value >= 1000);
+}
+
+
+/**
+ * Writes value without padding at p, returning the end.
+ **/
+static inline char *
+write_uint(char * p, uint64_t value)
+{
+  int const digits = count_digits(value);
+  write_digits(p + digits, value, digits);
+  return p + digits;
+}
+
+
+static char *
+format_clock(char * p, uint64_t nsecs)
+{
+  p = write_uint(p, nsecs / NSECS_PER_HOUR);
+  nsecs %= NSECS_PER_HOUR;
+
+  *p++ = ':';
+  write_digits(p + 2, nsecs / NSECS_PER_MIN, 2);
+  p += 2;
+  nsecs %= NSECS_PER_MIN;
+
+  *p++ = ':';
+  write_digits(p + 2, nsecs / NSECS_PER_SEC, 2);
+  p += 2;
+  nsecs %= NSECS_PER_SEC;
+
+  *p++ = '.';
+  write_digits(p + 9, nsecs, 9);
+  return p + 9;
+}
+
+
+static char *
+format_human(char * p, uint64_t nsecs)
+{
+  static struct
+  {
+    uint64_t    divisor;
+    char const  unit[3];
+  } const units[] = {
+    { NSECS_PER_SEC,  "s" },
+    { NSECS_PER_MSEC, "ms" },
+    { NSECS_PER_USEC, "us" },
+  };
+
+  size_t i = 0;
+  for ( ; i < sizeof(units) / sizeof(units[0]) ; ++i) {
+    if (nsecs >= units[i].divisor) {
+      break;
+    }
+  }
+
+  if (i == sizeof(units) / sizeof(units[0])) {
+    p = write_uint(p, nsecs);
+    *p++ = 'n';
+    *p++ = 's';
+    return p;
+  }
+
+  uint64_t const divisor = units[i].divisor;
+  p = write_uint(p, nsecs / divisor);
+
+  // Three decimals, without trailing zeroes.
+  uint64_t millis = (nsecs % divisor) / (divisor / 1000);
+  if (millis) {
+    int decimals = 3;
+    while (!(millis % 10)) {
+      millis /= 10;
+      --decimals;
+    }
+    *p++ = '.';
+    write_digits(p + decimals, millis, decimals);
+    p += decimals;
+  }
+
+  for (char const * unit = units[i].unit ; *unit ; ++unit) {
+    *p++ = *unit;
+  }
+  return p;
+}
+
+TWINE_ANONS_END
+
+
+
+char *
+to_chars(char * first, char * last, nanoseconds const & d,
+    duration_format format /* = FORMAT_CLOCK */)
+{
+  // Format into a scratch buffer that is always large enough, so that the
+  // formatting functions need no bounds checks.
+  char buf[MAX_DURATION_CHARS];
+  char * p = buf;
+
+  // Negating in unsigned arithmetic works for the most negative value, too.
+  default_repr_t const raw = d.raw();
+  uint64_t magnitude = uint64_t(raw);
+  if (raw < 0) {
+    *p++ = '-';
+    magnitude = uint64_t(0) - magnitude;
+  }
+
+  switch (format) {
+    case FORMAT_HUMAN:
+      p = TWINE_ANONS(format_human)(p, magnitude);
+      break;
+
+    case FORMAT_NANOSECONDS:
+      p = TWINE_ANONS(write_uint)(p, magnitude);
+      break;
+
+    case FORMAT_CLOCK:
+    default:
+      p = TWINE_ANONS(format_clock)(p, magnitude);
+      break;
+  }
+
+  size_t const length = size_t(p - buf);
+  if (size_t(last - first) < length) {
+    return nullptr;
+  }
+  ::memcpy(first, buf, length);
+  return first + length;
+}
+
+}} // namespace twine::chrono
@@ -39,6 +39,13 @@
 
 #include <meta/math.h>
 
+/**
+ * Upper bound for the time precise_sleep() spins, in microseconds.
+ **/
+#if !defined(TWINE_PRECISE_SLEEP_MAX_SPIN)
+#  define TWINE_PRECISE_SLEEP_MAX_SPIN 200
+#endif
+
 
 namespace twine {
 namespace chrono {
@@ -272,6 +279,55 @@ typedef detail::duration<default_repr_t, detail::minute_ratio>      minutes;
 typedef detail::duration<default_repr_t, detail::hour_ratio>        hours;        // Duration with the unit hours.
 
 
+/**
+ * Layouts for formatting durations with to_chars():
+ *
+ * - FORMAT_CLOCK is hours, minutes, seconds and nanoseconds, e.g.
+ *   "1:00:12.345678901". This is what operator<< produces.
+ * - FORMAT_HUMAN scales the value to the largest of ns, us, ms and s that
+ *   keeps it at or above 1, with up to three decimals and no trailing zeroes,
+ *   e.g. "1.25ms" or "3s". Further digits are truncated, not rounded.
+ * - FORMAT_NANOSECONDS is the raw nanosecond count, e.g. "1250000".
+ *
+ * Negative durations are prefixed with a minus sign in all layouts.
+ **/
+enum duration_format
+{
+  FORMAT_CLOCK = 0,
+  FORMAT_HUMAN,
+  FORMAT_NANOSECONDS
+};
+
+/**
+ * No duration formats to more characters than this, in any layout.
+ **/
+size_t const MAX_DURATION_CHARS = 32;
+
+/**
+ * Formats the duration into the buffer [first, last) in the given layout,
+ * modelled after C++17's std::to_chars(). Returns a pointer one past the last
+ * character written, or nullptr if the buffer is too small, in which case
+ * the buffer contents are unspecified. The output is not NUL-terminated.
+ *
+ * This neither allocates nor touches any stream state, and is meant for hot
+ * logging paths; use a buffer of MAX_DURATION_CHARS to never fail.
+ **/
+char * to_chars(char * first, char * last, nanoseconds const & d,
+    duration_format format = FORMAT_CLOCK);
+
+template <
+  typename reprT,
+  typename ratioT
+>
+inline char *
+to_chars(char * first, char * last, detail::duration<reprT, ratioT> const & d,
+    duration_format format = FORMAT_CLOCK)
+{
+  return to_chars(first, last,
+      nanoseconds(d.template as<detail::nanosecond_ratio>()), format);
+}
+
+
 namespace detail {
 
 
@@ -282,47 +338,9 @@ template <
 std::ostream &
 operator<<(std::ostream & os, duration<reprT, ratioT> const & d)
 {
-  default_repr_t tmp = d.template as<twine::chrono::nanoseconds>();
-
-  static const struct
-  {
-    reprT limit;
-    char  sep;
-    int   pad;
-  } conv[] = {
-    { 3600000000000, ':', -1 },
-    {   60000000000, ':', 1 },
-    {    1000000000, '.', 1 },
-    {             1, '\0', 8 },
-  };
-
-  for (size_t i = 0 ; i < sizeof(conv) / sizeof(conv[0]) ; ++i) {
-    // Get the value for the current position
-    reprT val = tmp / conv[i].limit;
-    tmp = tmp % conv[i].limit;
-
-    // Display value with padding.
-    reprT p = 1;
-    for (int j = 0 ; j < conv[i].pad ; ++j) {
-      p *= 10;
-    }
-    for (int j = 0 ; j < conv[i].pad ; ++j) {
-      if (val < p) {
-        os << "0";
-      }
-      p /= 10;
-    }
-
-    // Display value and separator
-    os << val;
-    if (conv[i].sep > 0) {
-      os << conv[i].sep;
-    }
-    else {
-      break;
-    }
-  }
-
+  char buf[MAX_DURATION_CHARS];
+  char * end = ::twine::chrono::to_chars(buf, buf + sizeof(buf), d);
+  os.write(buf, end - buf);
   return os;
 }
 
@@ -336,6 +354,14 @@ operator<<(std::ostream & os, duration<reprT, ratioT> const & d)
  **/
 nanoseconds now();
 
+/**
+ * Get a timestamp from a monotonic clock. Its epoch is unspecified, so the
+ * result is only useful for measuring intervals and computing deadlines, e.g.
+ * for condition::wait_until(). Unlike now(), it is unaffected by changes to
+ * the system time, such as NTP steps.
+ **/
+nanoseconds monotonic_now();
+
 /**
  * Sleep for the specified nanoseconds. Returns true if woken up after the
  * specified time, false on error. Note that the underlying system call may
@@ -343,6 +369,222 @@ nanoseconds now();
  **/
 bool sleep(nanoseconds const & nsec);
 
+/**
+ * How to sleep. SLEEP_DEFAULT leaves timing to the kernel, which may wake
+ * the thread considerably later than requested; on Linux, that is the thread's
+ * timer slack (50us by default) plus the scheduling latency. SLEEP_PRECISE
+ * uses precise_sleep() below instead.
+ **/
+enum sleep_mode
+{
+  SLEEP_DEFAULT = 0,
+  SLEEP_PRECISE
+};
+
+/**
+ * Precise sleep. The thread blocks in the kernel until shortly before the
+ * deadline, using an absolute deadline where the system supports it, and then
+ * spins for the remainder. The time spent spinning is the kernel's wakeup
+ * latency, measured on first use, plus the calling thread's timer slack; see
+ * this_thread::set_timer_slack() for reducing the latter.
+ *
+ * The spinning is capped at TWINE_PRECISE_SLEEP_MAX_SPIN microseconds, so the
+ * CPU cost stays bounded on systems with large wakeup latencies.
+ *
+ * precise_sleep_until() takes a deadline measured against monotonic_now().
+ * Both return false on error.
+ **/
+bool precise_sleep(nanoseconds const & nsec);
+bool precise_sleep_until(nanoseconds const & deadline);
+
+/**
+ * The time precise_sleep() would spin before a deadline on the calling
+ * thread; useful for implementing precise sleeps on top of other blocking
+ * primitives.
+ **/
+nanoseconds precise_sleep_margin();
+
+
+/**
+ * A point in time, measured as a duration since the epoch of the given clock.
+ *
+ * Time points of different clocks cannot be mixed: there is no conversion
+ * between them, and subtracting one from the other does not compile. The
+ * difference between two time points of the same clock is a duration, and
+ * adding a duration to a time point yields another time point.
+ **/
+template <
+  typename clockT,
+  typename durationT = typename clockT::duration
+>
+class time_point
+{
+public:
+  typedef clockT    clock;
+  typedef durationT duration;
+
+  explicit time_point(durationT const & since_epoch = durationT())
+    : m_since_epoch(since_epoch)
+  {
+  }
+
+
+  template <typename other_durationT>
+  time_point(time_point<clockT, other_durationT> const & other)
+    : m_since_epoch(other.time_since_epoch())
+  {
+  }
+
+
+  inline durationT time_since_epoch() const
+  {
+    return m_since_epoch;
+  }
+
+  /***************************************************************************
+   * Arithmetic operators
+   **/
+  template <typename reprT, typename ratioT>
+  inline time_point & operator+=(detail::duration<reprT, ratioT> const & d)
+  {
+    m_since_epoch += d;
+    return *this;
+  }
+
+  template <typename reprT, typename ratioT>
+  inline time_point & operator-=(detail::duration<reprT, ratioT> const & d)
+  {
+    m_since_epoch -= d;
+    return *this;
+  }
+
+  template <typename reprT, typename ratioT>
+  inline time_point operator+(detail::duration<reprT, ratioT> const & d) const
+  {
+    return time_point(m_since_epoch + d);
+  }
+
+  template <typename reprT, typename ratioT>
+  inline time_point operator-(detail::duration<reprT, ratioT> const & d) const
+  {
+    return time_point(m_since_epoch - d);
+  }
+
+  template <typename other_durationT>
+  inline durationT operator-(time_point<clockT, other_durationT> const & other) const
+  {
+    return m_since_epoch - other.time_since_epoch();
+  }
+
+  /***************************************************************************
+   * Comparison operators
+   **/
+  template <typename other_durationT>
+  inline bool operator>(time_point<clockT, other_durationT> const & other) const
+  {
+    return (m_since_epoch > other.time_since_epoch());
+  }
+
+  template <typename other_durationT>
+  inline bool operator<(time_point<clockT, other_durationT> const & other) const
+  {
+    return (m_since_epoch < other.time_since_epoch());
+  }
+
+  template <typename other_durationT>
+  inline bool operator>=(time_point<clockT, other_durationT> const & other) const
+  {
+    return (m_since_epoch >= other.time_since_epoch());
+  }
+
+  template <typename other_durationT>
+  inline bool operator<=(time_point<clockT, other_durationT> const & other) const
+  {
+    return (m_since_epoch <= other.time_since_epoch());
+  }
+
+  template <typename other_durationT>
+  inline bool operator==(time_point<clockT, other_durationT> const & other) const
+  {
+    return (m_since_epoch == other.time_since_epoch());
+  }
+
+  template <typename other_durationT>
+  inline bool operator!=(time_point<clockT, other_durationT> const & other) const
+  {
+    return (m_since_epoch != other.time_since_epoch());
+  }
+
+private:
+  durationT m_since_epoch;
+};
+
+
+/**
+ * Clock types. Each provides a now() function returning its time_point type;
+ * is_steady is true for clocks that never go backwards.
+ *
+ * - system_clock is the wall clock, the same as now(). Its epoch is the UNIX
+ *   epoch.
+ * - steady_clock is the monotonic clock, the same as monotonic_now(). Deadlines
+ *   for condition::wait_until() and tasklet::sleep_until() are measured
+ *   against it.
+ * - coarse_steady_clock is a monotonic clock that trades resolution (typically
+ *   a few milliseconds) for speed; on Linux, reading CLOCK_MONOTONIC_COARSE is
+ *   an order of magnitude cheaper than CLOCK_MONOTONIC. Where no such clock
+ *   exists, it has the same resolution as steady_clock.
+ * - thread_cpu_clock measures the CPU time consumed by the calling thread.
+ * - process_cpu_clock measures the CPU time consumed by the whole process.
+ **/
+struct system_clock
+{
+  typedef nanoseconds                       duration;
+  typedef chrono::time_point<system_clock>  time_point;
+  static bool const                         is_steady = false;
+
+  static time_point now();
+};
+
+
+struct steady_clock
+{
+  typedef nanoseconds                       duration;
+  typedef chrono::time_point<steady_clock>  time_point;
+  static bool const                         is_steady = true;
+
+  static time_point now();
+};
+
+
+struct coarse_steady_clock
+{
+  typedef nanoseconds                               duration;
+  typedef chrono::time_point<coarse_steady_clock>   time_point;
+  static bool const                                 is_steady = true;
+
+  static time_point now();
+};
+
+
+struct thread_cpu_clock
+{
+  typedef nanoseconds                           duration;
+  typedef chrono::time_point<thread_cpu_clock>  time_point;
+  static bool const                             is_steady = true;
+
+  static time_point now();
+};
+
+
+struct process_cpu_clock
+{
+  typedef nanoseconds                           duration;
+  typedef chrono::time_point<process_cpu_clock> time_point;
+  static bool const                             is_steady = true;
+
+  static time_point now();
+};
+
 }} // namespace twine::chrono
 
 
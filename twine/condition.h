@@ -30,6 +30,7 @@
 #include <twine/mutex.h>
 #include <twine/scoped_lock.h>
 #include <twine/chrono.h>
+#include <twine/atomic.h>
 
 namespace twine {
 
@@ -68,7 +69,25 @@ public:
   template <typename lockableT, typename durationT>
   inline bool timed_wait(lockableT & lockable, durationT const & duration);
 
-  // Notify waiting threads
+  // Wait until the absolute deadline passes. The deadline is measured against
+  // chrono::monotonic_now(), so it is unaffected by changes to the system
+  // time. Retry loops can compute the deadline once and pass it to every
+  // wait, rather than recomputing the remaining time. Returns false if the
+  // deadline passed.
+  //
+  // Prefer passing a chrono::steady_clock time point; deadlines computed
+  // against any other clock then fail to compile.
+  template <typename lockableT, typename durationT>
+  inline bool wait_until(lockableT & lockable, durationT const & deadline);
+
+  template <typename lockableT, typename durationT>
+  inline bool wait_until(lockableT & lockable,
+      chrono::time_point<chrono::steady_clock, durationT> const & deadline);
+
+  // Notify waiting threads. If no thread is waiting, notifying is a single
+  // atomic load. Waiting threads are counted while the lockable is locked, so
+  // as long as the waited-for state is changed with the lockable locked,
+  // notifying after unlocking it is safe.
   inline void notify_one();
   inline void notify_all();
 
@@ -79,16 +98,33 @@ private:
   CRITICAL_SECTION      m_waiters_lock;
   volatile unsigned int m_waiters;
   HANDLE                m_events[2];
+#elif defined(TWINE_USE_FUTEX)
+  // Sequence number, bumped by every notification.
+  int32_t volatile        m_handle;
+  twine::atomic<uint32_t> m_waiters;
 #elif defined(TWINE_POSIX)
-  pthread_cond_t        m_handle;
+  pthread_cond_t          m_handle;
+  twine::atomic<uint32_t> m_waiters;
 #endif
 };
 
 
+
+template <typename lockableT, typename durationT>
+bool
+condition::wait_until(lockableT & lockable,
+    chrono::time_point<chrono::steady_clock, durationT> const & deadline)
+{
+  return wait_until(lockable,
+      deadline.time_since_epoch().template convert<chrono::nanoseconds>());
+}
+
 } // namespace twine
 
 #if defined(TWINE_WIN32)
   #include <twine/win32/condition.h>
+#elif defined(TWINE_USE_FUTEX)
+  #include <twine/linux/condition.h>
 #elif defined(TWINE_POSIX)
   #include <twine/posix/condition.h>
 #endif
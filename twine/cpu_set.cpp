@@ -0,0 +1,248 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/cpu_set.h>
+
+#include <sstream>
+
+#include <stdlib.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+
+TWINE_ANONS_START
+
+// strtoul() accepts leading whitespace and signs; CPU lists don't.
+static bool
+parse_number(char const *& cur, unsigned long & result)
+{
+  if (*cur < '0' || *cur > '9') {
+    return false;
+  }
+  char * end = nullptr;
+  result = strtoul(cur, &end, 10);
+  cur = end;
+  return true;
+}
+
+TWINE_ANONS_END
+
+
+
+cpu_set::cpu_set()
+{
+  reset();
+}
+
+
+
+void
+cpu_set::set(uint32_t cpu)
+{
+  if (cpu < MAX_CPUS) {
+    m_bits[cpu / WORD_BITS] |= uint64_t(1) << (cpu % WORD_BITS);
+  }
+}
+
+
+
+void
+cpu_set::clear(uint32_t cpu)
+{
+  if (cpu < MAX_CPUS) {
+    m_bits[cpu / WORD_BITS] &= ~(uint64_t(1) << (cpu % WORD_BITS));
+  }
+}
+
+
+
+bool
+cpu_set::test(uint32_t cpu) const
+{
+  if (cpu >= MAX_CPUS) {
+    return false;
+  }
+  return m_bits[cpu / WORD_BITS] & (uint64_t(1) << (cpu % WORD_BITS));
+}
+
+
+
+void
+cpu_set::reset()
+{
+  for (int i = 0 ; i < WORDS ; ++i) {
+    m_bits[i] = 0;
+  }
+}
+
+
+
+uint32_t
+cpu_set::count() const
+{
+  uint32_t result = 0;
+  for (int i = 0 ; i < WORDS ; ++i) {
+    uint64_t word = m_bits[i];
+    while (word) {
+      word &= word - 1;
+      ++result;
+    }
+  }
+  return result;
+}
+
+
+
+bool
+cpu_set::empty() const
+{
+  for (int i = 0 ; i < WORDS ; ++i) {
+    if (m_bits[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+bool
+cpu_set::parse(std::string const & list)
+{
+  reset();
+
+  char const * cur = list.c_str();
+  while (*cur) {
+    // Skip whitespace, including the trailing newline of sysfs files.
+    if (' ' == *cur || '\t' == *cur || '\n' == *cur) {
+      ++cur;
+      continue;
+    }
+
+    unsigned long first = 0;
+    if (!TWINE_ANONS(parse_number)(cur, first)) {
+      reset();
+      return false;
+    }
+    unsigned long last = first;
+
+    if ('-' == *cur) {
+      ++cur;
+      if (!TWINE_ANONS(parse_number)(cur, last) || last < first) {
+        reset();
+        return false;
+      }
+    }
+
+    for (unsigned long cpu = first ; cpu <= last && cpu < MAX_CPUS ; ++cpu) {
+      set(uint32_t(cpu));
+    }
+
+    if (',' == *cur) {
+      ++cur;
+    }
+    else if (*cur && ' ' != *cur && '\t' != *cur && '\n' != *cur) {
+      reset();
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+std::string
+cpu_set::to_string() const
+{
+  std::ostringstream os;
+  bool first = true;
+
+  uint32_t cpu = 0;
+  while (cpu < MAX_CPUS) {
+    if (!test(cpu)) {
+      ++cpu;
+      continue;
+    }
+
+    uint32_t last = cpu;
+    while (last + 1 < MAX_CPUS && test(last + 1)) {
+      ++last;
+    }
+
+    if (!first) {
+      os << ",";
+    }
+    first = false;
+
+    os << cpu;
+    if (last != cpu) {
+      os << "-" << last;
+    }
+    cpu = last + 1;
+  }
+
+  return os.str();
+}
+
+
+
+cpu_set &
+cpu_set::operator|=(cpu_set const & other)
+{
+  for (int i = 0 ; i < WORDS ; ++i) {
+    m_bits[i] |= other.m_bits[i];
+  }
+  return *this;
+}
+
+
+
+cpu_set &
+cpu_set::operator&=(cpu_set const & other)
+{
+  for (int i = 0 ; i < WORDS ; ++i) {
+    m_bits[i] &= other.m_bits[i];
+  }
+  return *this;
+}
+
+
+
+bool
+cpu_set::operator==(cpu_set const & other) const
+{
+  for (int i = 0 ; i < WORDS ; ++i) {
+    if (m_bits[i] != other.m_bits[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+
+bool
+cpu_set::operator!=(cpu_set const & other) const
+{
+  return !(*this == other);
+}
+
+} // namespace twine
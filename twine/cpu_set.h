@@ -0,0 +1,105 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_CPU_SET_H
+#define TWINE_CPU_SET_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <string>
+
+namespace twine {
+
+/**
+ * Set of CPUs, e.g. for pinning threads via thread::set_affinity().
+ *
+ * CPUs are numbered as the operating system numbers them. Sets can be built
+ * bit by bit, or parsed from the list format that Linux uses in sysfs and
+ * procfs, e.g. "0-3,8,10-11".
+ **/
+class cpu_set
+{
+public:
+  // The highest CPU number a set can hold is MAX_CPUS - 1; this matches the
+  // size of glibc's cpu_set_t.
+  enum
+  {
+    MAX_CPUS = 1024
+  };
+
+  /**
+   * Creates an empty set.
+   **/
+  cpu_set();
+
+  /**
+   * Add, remove or test individual CPUs. CPU numbers beyond MAX_CPUS are
+   * ignored, and never part of the set.
+   **/
+  void set(uint32_t cpu);
+  void clear(uint32_t cpu);
+  bool test(uint32_t cpu) const;
+
+  /**
+   * Remove all CPUs.
+   **/
+  void reset();
+
+  /**
+   * Returns the number of CPUs in the set.
+   **/
+  uint32_t count() const;
+  bool empty() const;
+
+  /**
+   * Parse a CPU list, replacing the set's contents. Returns false if the list
+   * is malformed, in which case the set is left empty.
+   **/
+  bool parse(std::string const & list);
+
+  /**
+   * Returns the set in the same list format that parse() accepts.
+   **/
+  std::string to_string() const;
+
+  // Set operations
+  cpu_set & operator|=(cpu_set const & other);
+  cpu_set & operator&=(cpu_set const & other);
+
+  bool operator==(cpu_set const & other) const;
+  bool operator!=(cpu_set const & other) const;
+
+private:
+  enum
+  {
+    WORD_BITS = 64,
+    WORDS     = MAX_CPUS / WORD_BITS
+  };
+
+  uint64_t  m_bits[WORDS];
+};
+
+} // namespace twine
+
+#endif // guard
@@ -0,0 +1,55 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_FIBER_H
+#define TWINE_DETAIL_FIBER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+namespace twine {
+namespace detail {
+
+/**
+ * Minimal fibers (user-level execution contexts) for the tasklet scheduler.
+ *
+ * A thread must obtain its own fiber via fiber_for_thread() before it can
+ * switch to other fibers. Fibers created with fiber_create() run the given
+ * function on their own stack; that function must never return, but switch
+ * away for the last time instead.
+ **/
+struct fiber;
+
+typedef void (*fiber_function)(void *);
+
+fiber * fiber_for_thread();
+
+fiber * fiber_create(size_t stack_size, fiber_function func, void * arg);
+
+void fiber_switch(fiber * from, fiber * to);
+
+void fiber_destroy(fiber * f);
+
+}} // namespace twine::detail
+
+#endif // guard
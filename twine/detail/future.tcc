@@ -0,0 +1,515 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_FUTURE_TCC
+#define TWINE_DETAIL_FUTURE_TCC
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <stdexcept>
+
+#include <twine/thread_pool.h>
+
+namespace twine {
+namespace detail {
+
+/**
+ * Access to a future's shared state, for when_all() and when_any().
+ **/
+struct future_access
+{
+  template <typename valueT>
+  static future_state_base * state(future<valueT> const & f)
+  {
+    return f.m_state;
+  }
+};
+
+
+/**
+ * Invokes a then() continuation and stores its result; void results need
+ * special treatment.
+ **/
+template <
+  typename valueT,
+  typename resultT
+>
+struct continuation_invoker
+{
+  static void invoke(resultT (*func)(future<valueT> const &, void *),
+      future<valueT> const & source, void * baton, promise<resultT> & result)
+  {
+    result.set_value(func(source, baton));
+  }
+};
+
+
+template <
+  typename valueT
+>
+struct continuation_invoker<valueT, void>
+{
+  static void invoke(void (*func)(future<valueT> const &, void *),
+      future<valueT> const & source, void * baton, promise<void> & result)
+  {
+    func(source, baton);
+    result.set_value();
+  }
+};
+
+
+/**
+ * Continuation created by then().
+ **/
+template <
+  typename valueT,
+  typename resultT
+>
+struct then_continuation
+  : public future_continuation
+{
+  typedef resultT (*function)(future<valueT> const &, void *);
+
+  future<valueT>    m_source;
+  function          m_func;
+  void *            m_baton;
+  thread_pool *     m_executor;
+  promise<resultT>  m_result;
+
+  then_continuation(future<valueT> const & source, function func,
+      void * baton, thread_pool * executor)
+    : m_source(source)
+    , m_func(func)
+    , m_baton(baton)
+    , m_executor(executor)
+    , m_result()
+  {
+    m_next = nullptr;
+    m_run = &then_continuation::run;
+  }
+
+  static void run(future_continuation * cont)
+  {
+    then_continuation * self = static_cast<then_continuation *>(cont);
+    if (self->m_executor
+        && self->m_executor->submit(&then_continuation::execute, self))
+    {
+      return;
+    }
+    execute(self);
+  }
+
+  static void execute(void * baton)
+  {
+    then_continuation * self = static_cast<then_continuation *>(baton);
+    continuation_invoker<valueT, resultT>::invoke(self->m_func, self->m_source,
+        self->m_baton, self->m_result);
+    delete self;
+  }
+};
+
+
+/**
+ * Shared context and per-future continuations for when_all().
+ **/
+struct when_all_context
+{
+  twine::atomic<uint32_t> m_remaining;
+  promise<void>           m_result;
+
+  when_all_context()
+    : m_remaining(1)
+    , m_result()
+  {
+  }
+
+  void done()
+  {
+    if (1 == m_remaining.fetch_sub(1, memory_order_acq_rel)) {
+      m_result.set_value();
+      delete this;
+    }
+  }
+};
+
+
+struct when_all_continuation
+  : public future_continuation
+{
+  when_all_context *  m_context;
+
+  explicit when_all_continuation(when_all_context * context)
+    : m_context(context)
+  {
+    m_next = nullptr;
+    m_run = &when_all_continuation::run;
+  }
+
+  static void run(future_continuation * cont)
+  {
+    when_all_continuation * self = static_cast<when_all_continuation *>(cont);
+    when_all_context * context = self->m_context;
+    delete self;
+    context->done();
+  }
+};
+
+
+/**
+ * Shared context and per-future continuations for when_any().
+ **/
+struct when_any_context
+{
+  twine::atomic<uint32_t> m_refs;
+  twine::atomic<uint32_t> m_fired;
+  promise<size_t>         m_result;
+
+  when_any_context()
+    : m_refs(1)
+    , m_fired(0)
+    , m_result()
+  {
+  }
+
+  void release()
+  {
+    if (1 == m_refs.fetch_sub(1, memory_order_acq_rel)) {
+      delete this;
+    }
+  }
+};
+
+
+struct when_any_continuation
+  : public future_continuation
+{
+  when_any_context *  m_context;
+  size_t              m_index;
+
+  when_any_continuation(when_any_context * context, size_t index)
+    : m_context(context)
+    , m_index(index)
+  {
+    m_next = nullptr;
+    m_run = &when_any_continuation::run;
+  }
+
+  static void run(future_continuation * cont)
+  {
+    when_any_continuation * self = static_cast<when_any_continuation *>(cont);
+    when_any_context * context = self->m_context;
+
+    uint32_t expected = 0;
+    if (context->m_fired.compare_exchange(expected, 1, memory_order_acq_rel)) {
+      context->m_result.set_value(self->m_index);
+    }
+
+    delete self;
+    context->release();
+  }
+};
+
+} // namespace detail
+
+
+
+/*****************************************************************************
+ * future
+ **/
+template <
+  typename valueT
+>
+future<valueT>::future()
+  : m_state(nullptr)
+{
+}
+
+
+
+template <
+  typename valueT
+>
+future<valueT>::future(detail::future_state<valueT> * state)
+  : m_state(state)
+{
+  m_state->add_ref();
+}
+
+
+
+template <
+  typename valueT
+>
+future<valueT>::future(future const & other)
+  : m_state(other.m_state)
+{
+  if (m_state) {
+    m_state->add_ref();
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+future<valueT> &
+future<valueT>::operator=(future const & other)
+{
+  if (other.m_state) {
+    other.m_state->add_ref();
+  }
+  if (m_state) {
+    m_state->release();
+  }
+  m_state = other.m_state;
+  return *this;
+}
+
+
+
+template <
+  typename valueT
+>
+future<valueT>::~future()
+{
+  if (m_state) {
+    m_state->release();
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+future<valueT>::valid() const
+{
+  return (nullptr != m_state);
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+future<valueT>::is_ready() const
+{
+  return m_state && m_state->is_ready();
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+future<valueT>::is_broken() const
+{
+  return m_state && m_state->is_broken();
+}
+
+
+
+template <
+  typename valueT
+>
+void
+future<valueT>::wait() const
+{
+  if (m_state) {
+    m_state->wait();
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+typename future<valueT>::const_reference
+future<valueT>::get() const
+{
+  if (!m_state) {
+    throw std::runtime_error("get() called on an invalid future.");
+  }
+  m_state->wait();
+  if (m_state->is_broken()) {
+    throw std::runtime_error("The promise was broken.");
+  }
+  return m_state->value();
+}
+
+
+
+template <
+  typename valueT
+>
+template <
+  typename resultT
+>
+future<resultT>
+future<valueT>::then(resultT (*func)(future const &, void *),
+    void * baton /* = nullptr */, thread_pool * executor /* = nullptr */) const
+{
+  if (!m_state || !func) {
+    return future<resultT>();
+  }
+
+  detail::then_continuation<valueT, resultT> * cont =
+    new detail::then_continuation<valueT, resultT>(*this, func, baton,
+        executor);
+  future<resultT> result = cont->m_result.get_future();
+  m_state->add_continuation(cont);
+  return result;
+}
+
+
+
+/*****************************************************************************
+ * promise
+ **/
+namespace detail {
+
+template <
+  typename valueT
+>
+promise_base<valueT>::promise_base()
+  : m_state(new future_state<valueT>())
+{
+}
+
+
+
+template <
+  typename valueT
+>
+promise_base<valueT>::~promise_base()
+{
+  if (m_state->claim()) {
+    m_state->make_ready(true);
+  }
+  m_state->release();
+}
+
+
+
+template <
+  typename valueT
+>
+future<valueT>
+promise_base<valueT>::get_future() const
+{
+  return future<valueT>(m_state);
+}
+
+} // namespace detail
+
+
+
+template <
+  typename valueT
+>
+bool
+promise<valueT>::set_value(valueT const & value)
+{
+  if (!this->m_state->claim()) {
+    return false;
+  }
+  this->m_state->set_value(value);
+  return true;
+}
+
+
+
+inline bool
+promise<void>::set_value()
+{
+  if (!m_state->claim()) {
+    return false;
+  }
+  m_state->set_value();
+  return true;
+}
+
+
+
+/*****************************************************************************
+ * Combinators
+ **/
+template <
+  typename iterT
+>
+future<void>
+when_all(iterT first, iterT last)
+{
+  // The context starts out with one reference of its own, so that it can't
+  // complete before all continuations are attached.
+  detail::when_all_context * context = new detail::when_all_context();
+  future<void> result = context->m_result.get_future();
+
+  for ( ; first != last ; ++first) {
+    detail::future_state_base * state = detail::future_access::state(*first);
+    if (!state) {
+      continue;
+    }
+    context->m_remaining.fetch_add(1, memory_order_relaxed);
+    state->add_continuation(new detail::when_all_continuation(context));
+  }
+
+  context->done();
+  return result;
+}
+
+
+
+template <
+  typename iterT
+>
+future<size_t>
+when_any(iterT first, iterT last)
+{
+  detail::when_any_context * context = new detail::when_any_context();
+  future<size_t> result = context->m_result.get_future();
+
+  for (size_t index = 0 ; first != last ; ++first, ++index) {
+    detail::future_state_base * state = detail::future_access::state(*first);
+    if (!state) {
+      continue;
+    }
+    context->m_refs.fetch_add(1, memory_order_relaxed);
+    state->add_continuation(new detail::when_any_continuation(context,
+          index));
+  }
+
+  // If nothing fired, releasing the last reference breaks the promise.
+  context->release();
+  return result;
+}
+
+} // namespace twine
+
+#endif // guard
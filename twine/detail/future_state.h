@@ -0,0 +1,180 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_FUTURE_STATE_H
+#define TWINE_DETAIL_FUTURE_STATE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <new>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+#include <twine/chrono.h>
+
+namespace twine {
+namespace detail {
+
+/**
+ * Continuations are intrusively stacked on the shared state until it becomes
+ * ready. The run function gets invoked exactly once, and is responsible for
+ * freeing the continuation.
+ **/
+struct future_continuation
+{
+  future_continuation * m_next;
+  void                  (*m_run)(future_continuation *);
+};
+
+
+/**
+ * Untyped part of the state shared between a promise and its futures.
+ *
+ * The state word holds the READY and WAITERS flags in its low bits, and the
+ * head of the continuation stack in the remaining bits. Becoming ready is a
+ * single exchange that also detaches all continuations. Only consumers that
+ * actually need to block set WAITERS, and only then does the producer touch
+ * the mutex and condition.
+ **/
+class future_state_base
+  : public twine::noncopyable
+{
+public:
+  future_state_base();
+  virtual ~future_state_base();
+
+  // Reference counting; the last release() deletes the state.
+  void add_ref();
+  void release();
+
+  // Returns true exactly once, for whoever gets to satisfy the state.
+  bool claim();
+
+  bool is_ready() const;
+  bool is_broken() const;
+
+  void wait();
+  bool wait_for(chrono::nanoseconds const & timeout);
+
+  // Publish the result (or the lack of one) and run continuations.
+  void make_ready(bool broken);
+
+  // Run the continuation right away if the state is ready, else queue it.
+  void add_continuation(future_continuation * cont);
+
+private:
+  enum
+  {
+    READY     = 1,
+    WAITERS   = 2,
+    FLAG_MASK = 3
+  };
+
+  bool set_waiters();
+
+  twine::atomic<uintptr_t>  m_state;
+  twine::atomic<uint32_t>   m_refs;
+  twine::atomic<uint32_t>   m_claimed;
+  bool                      m_broken;  // Written before READY is published.
+
+  twine::mutex              m_mutex;
+  twine::condition          m_condition;
+};
+
+
+/**
+ * Typed state; the value is constructed in place when the promise is
+ * satisfied.
+ **/
+template <
+  typename valueT
+>
+class future_state
+  : public future_state_base
+{
+public:
+  typedef valueT const & const_reference;
+
+  future_state()
+    : future_state_base()
+    , m_has_value(false)
+  {
+  }
+
+  ~future_state()
+  {
+    if (m_has_value) {
+      reinterpret_cast<valueT *>(m_storage.m_buf)->~valueT();
+    }
+  }
+
+  void set_value(valueT const & value)
+  {
+    new (m_storage.m_buf) valueT(value);
+    m_has_value = true;
+    make_ready(false);
+  }
+
+  const_reference value() const
+  {
+    return *reinterpret_cast<valueT const *>(m_storage.m_buf);
+  }
+
+private:
+  union storage
+  {
+    char        m_buf[sizeof(valueT)];
+    long double m_align_ld;
+    long long   m_align_ll;
+    void *      m_align_ptr;
+  };
+
+  storage m_storage;
+  bool    m_has_value;
+};
+
+
+template <>
+class future_state<void>
+  : public future_state_base
+{
+public:
+  typedef void const_reference;
+
+  void set_value()
+  {
+    make_ready(false);
+  }
+
+  void value() const
+  {
+  }
+};
+
+} // namespace detail
+} // namespace twine
+
+#endif // guard
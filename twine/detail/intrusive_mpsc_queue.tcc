@@ -0,0 +1,293 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_INTRUSIVE_MPSC_QUEUE_TCC
+#define TWINE_DETAIL_INTRUSIVE_MPSC_QUEUE_TCC
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/scoped_lock.h>
+
+namespace twine {
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+intrusive_mpsc_queue<valueT, hookT>::intrusive_mpsc_queue()
+  : m_head(&m_stub)
+  , m_tail(&m_stub)
+  , m_stub()
+  , m_waiting(0)
+  , m_consumer(nullptr)
+  , m_mutex()
+  , m_cond()
+{
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+intrusive_mpsc_queue<valueT, hookT>::~intrusive_mpsc_queue()
+{
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+valueT *
+intrusive_mpsc_queue<valueT, hookT>::owner(intrusive_mpsc_hook * hook)
+{
+  // The hook's offset within valueT, determined from an address aligned
+  // suitably for valueT, without touching an actual object.
+  valueT * base = reinterpret_cast<valueT *>(TWINE_CACHE_LINE_SIZE);
+  size_t offset = reinterpret_cast<char *>(&(base->*hookT))
+    - reinterpret_cast<char *>(base);
+  return reinterpret_cast<valueT *>(reinterpret_cast<char *>(hook) - offset);
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+void
+intrusive_mpsc_queue<valueT, hookT>::push_hook(intrusive_mpsc_hook * hook)
+{
+  hook->m_next.store(nullptr, memory_order_relaxed);
+  intrusive_mpsc_hook * prev = m_head.exchange(hook, memory_order_acq_rel);
+  // Until this store, the consumer can't see hook or anything pushed after
+  // it.
+  prev->m_next.store(hook, memory_order_release);
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+void
+intrusive_mpsc_queue<valueT, hookT>::push(valueT * value)
+{
+  push_hook(&(value->*hookT));
+  notify_consumer();
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+void
+intrusive_mpsc_queue<valueT, hookT>::notify_consumer()
+{
+  // The consumer registers before checking for values, and we link our value
+  // before checking for the consumer, so one of us sees the other. The fence
+  // orders the linking store before the loads.
+  atomic_thread_fence(memory_order_seq_cst);
+
+  if (m_waiting.load(memory_order_relaxed)) {
+    // Clear the flag, so that producers don't take the lock again until the
+    // consumer has run and waits again.
+    scoped_lock<mutex> lock(m_mutex);
+    if (m_waiting.load(memory_order_relaxed)) {
+      m_waiting.store(0, memory_order_relaxed);
+      m_cond.notify_one();
+    }
+  }
+
+  tasklet * consumer = m_consumer.load(memory_order_relaxed);
+  if (consumer) {
+    consumer->notify();
+  }
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+valueT *
+intrusive_mpsc_queue<valueT, hookT>::try_pop()
+{
+  intrusive_mpsc_hook * tail = m_tail;
+  intrusive_mpsc_hook * next = tail->m_next.load(memory_order_acquire);
+
+  // Skip the stub.
+  if (tail == &m_stub) {
+    if (!next) {
+      return nullptr;
+    }
+    m_tail = next;
+    tail = next;
+    next = next->m_next.load(memory_order_acquire);
+  }
+
+  if (next) {
+    m_tail = next;
+    return owner(tail);
+  }
+
+  // tail is the last linked value. If it isn't the last pushed, a producer
+  // has yet to link its value after it.
+  if (tail != m_head.load(memory_order_acquire)) {
+    return nullptr;
+  }
+
+  // Push the stub behind tail, so that tail can be unlinked.
+  push_hook(&m_stub);
+  next = tail->m_next.load(memory_order_acquire);
+  if (next) {
+    m_tail = next;
+    return owner(tail);
+  }
+  return nullptr;
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+valueT *
+intrusive_mpsc_queue<valueT, hookT>::pop()
+{
+  valueT * value = try_pop();
+  if (value) {
+    return value;
+  }
+
+  scoped_lock<mutex> lock(m_mutex);
+  for (;;) {
+    // Register before retrying, so that every push from now on notifies us.
+    // The fence orders the registration before the retry's loads; it pairs
+    // with the one in notify_consumer().
+    m_waiting.store(1);
+    atomic_thread_fence(memory_order_seq_cst);
+    value = try_pop();
+    if (value) {
+      break;
+    }
+    m_cond.wait(lock);
+  }
+  m_waiting.store(0, memory_order_relaxed);
+  return value;
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+valueT *
+intrusive_mpsc_queue<valueT, hookT>::timed_pop_internal(
+    chrono::nanoseconds const & duration)
+{
+  valueT * value = try_pop();
+  if (value) {
+    return value;
+  }
+
+  chrono::nanoseconds deadline = chrono::monotonic_now() + duration;
+
+  scoped_lock<mutex> lock(m_mutex);
+  for (;;) {
+    m_waiting.store(1);
+    atomic_thread_fence(memory_order_seq_cst);
+    value = try_pop();
+    if (value) {
+      break;
+    }
+    if (!m_cond.wait_until(lock, deadline)) {
+      value = try_pop();
+      break;
+    }
+  }
+  m_waiting.store(0, memory_order_relaxed);
+  return value;
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+bool
+intrusive_mpsc_queue<valueT, hookT>::wait_readable(tasklet & consumer)
+{
+  for (;;) {
+    if (!empty()) {
+      return true;
+    }
+
+    // Register, then look again; see notify_consumer().
+    m_consumer.store(&consumer);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!empty()) {
+      m_consumer.store(nullptr, memory_order_relaxed);
+      return true;
+    }
+
+    bool running = consumer.sleep();
+    m_consumer.store(nullptr, memory_order_relaxed);
+    if (!running) {
+      return false;
+    }
+  }
+}
+
+
+
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+bool
+intrusive_mpsc_queue<valueT, hookT>::empty() const
+{
+  // Values pushed but not yet linked count as well; the consumer can expect
+  // them to become visible momentarily.
+  intrusive_mpsc_hook * tail = m_tail;
+  if (tail->m_next.load(memory_order_acquire)) {
+    return false;
+  }
+  return tail == m_head.load(memory_order_acquire) && tail == &m_stub;
+}
+
+} // namespace twine
+
+#endif // guard
@@ -0,0 +1,276 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_LOCK_PROFILER_TCC
+#define TWINE_DETAIL_LOCK_PROFILER_TCC
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+namespace twine {
+namespace detail {
+
+void
+lock_profile::increment(twine::atomic<uint64_t> & counter,
+    uint64_t amount /* = 1 */)
+{
+  counter.store(counter.load(memory_order_relaxed) + amount,
+      memory_order_relaxed);
+}
+
+
+
+void
+lock_profile::maximize(twine::atomic<uint64_t> & counter, uint64_t value)
+{
+  if (value > counter.load(memory_order_relaxed)) {
+    counter.store(value, memory_order_relaxed);
+  }
+}
+
+
+
+uint32_t
+lock_profile::bucket(uint64_t value)
+{
+  uint32_t result = 0;
+#if defined(__GNUC__)
+  if (value) {
+    result = 63 - uint32_t(__builtin_clzll(value));
+  }
+#else
+  while (value >>= 1) {
+    ++result;
+  }
+#endif
+  if (result >= lock_stats::HISTOGRAM_BUCKETS) {
+    result = lock_stats::HISTOGRAM_BUCKETS - 1;
+  }
+  return result;
+}
+
+
+
+void
+lock_profile::record_acquire(bool contended, uint64_t wait)
+{
+  increment(m_acquisitions);
+  if (!contended) {
+    return;
+  }
+
+  increment(m_contentions);
+  increment(m_total_wait, wait);
+  maximize(m_max_wait, wait);
+  increment(m_wait_histogram[bucket(wait)]);
+}
+
+
+
+void
+lock_profile::record_release(uint64_t hold)
+{
+  increment(m_total_hold, hold);
+  maximize(m_max_hold, hold);
+  increment(m_hold_histogram[bucket(hold)]);
+}
+
+} // namespace detail
+
+
+
+template <
+  typename mutexT
+>
+instrumented_mutex<mutexT>::instrumented_mutex(
+    char const * name /* = nullptr */)
+  : m_mutex()
+#if defined(TWINE_LOCK_PROFILING)
+  , m_depth(0)
+  , m_acquired(0)
+  , m_profile(name)
+#endif
+{
+#if !defined(TWINE_LOCK_PROFILING)
+  (void) name;
+#endif
+}
+
+
+
+template <
+  typename mutexT
+>
+instrumented_mutex<mutexT>::~instrumented_mutex()
+{
+}
+
+
+
+#if defined(TWINE_LOCK_PROFILING)
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::lock()
+{
+  if (m_mutex.try_lock()) {
+    acquired(false, 0);
+    return;
+  }
+
+  int64_t start = chrono::monotonic_now().raw();
+  m_mutex.lock();
+  acquired(true, start);
+}
+
+
+
+template <
+  typename mutexT
+>
+bool
+instrumented_mutex<mutexT>::try_lock()
+{
+  if (!m_mutex.try_lock()) {
+    return false;
+  }
+  acquired(false, 0);
+  return true;
+}
+
+
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::unlock()
+{
+  // Only the outermost unlock of a recursive mutex ends the hold.
+  if (0 == --m_depth) {
+    m_profile.record_release(uint64_t(chrono::monotonic_now().raw() - m_acquired));
+  }
+  m_mutex.unlock();
+}
+
+
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::before_wait()
+{
+  // The wait releases the mutex, so the hold ends here.
+  m_depth = 0;
+  m_profile.record_release(uint64_t(chrono::monotonic_now().raw() - m_acquired));
+}
+
+
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::after_wait()
+{
+  acquired(false, 0);
+}
+
+
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::acquired(bool contended, int64_t start)
+{
+  if (m_depth++) {
+    return;
+  }
+
+  m_acquired = chrono::monotonic_now().raw();
+  m_profile.record_acquire(contended,
+      contended ? uint64_t(m_acquired - start) : 0);
+}
+
+#else // TWINE_LOCK_PROFILING
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::lock()
+{
+  m_mutex.lock();
+}
+
+
+
+template <
+  typename mutexT
+>
+bool
+instrumented_mutex<mutexT>::try_lock()
+{
+  return m_mutex.try_lock();
+}
+
+
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::unlock()
+{
+  m_mutex.unlock();
+}
+
+
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::before_wait()
+{
+}
+
+
+
+template <
+  typename mutexT
+>
+void
+instrumented_mutex<mutexT>::after_wait()
+{
+}
+
+#endif // TWINE_LOCK_PROFILING
+
+} // namespace twine
+
+#endif // guard
@@ -0,0 +1,393 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_MPMC_QUEUE_TCC
+#define TWINE_DETAIL_MPMC_QUEUE_TCC
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <new>
+
+#include <twine/scoped_lock.h>
+
+namespace twine {
+
+template <
+  typename valueT
+>
+mpmc_queue<valueT>::mpmc_queue(size_t capacity)
+  : m_tail(0)
+  , m_head(0)
+  , m_mask(1)
+  , m_buffer(nullptr)
+  , m_slots(nullptr)
+  , m_push_waiters(0)
+  , m_pop_waiters(0)
+  , m_push_signals(0)
+  , m_pop_signals(0)
+  , m_mutex()
+  , m_not_full()
+  , m_not_empty()
+{
+  while (m_mask + 1 < capacity) {
+    m_mask = (m_mask << 1) | 1;
+  }
+
+  // Align the slots to a cache line.
+  m_buffer = new char[SLOT_SIZE * size_t(m_mask + 1) + TWINE_CACHE_LINE_SIZE];
+  size_t misalignment = reinterpret_cast<size_t>(m_buffer)
+    % TWINE_CACHE_LINE_SIZE;
+  m_slots = m_buffer + (misalignment ? TWINE_CACHE_LINE_SIZE - misalignment : 0);
+
+  for (uint64_t i = 0 ; i <= m_mask ; ++i) {
+    slot * s = new (&slot_at(i)) slot();
+    s->m_sequence.store(i, memory_order_relaxed);
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+mpmc_queue<valueT>::~mpmc_queue()
+{
+  for (uint64_t i = 0 ; i <= m_mask ; ++i) {
+    slot_at(i).~slot();
+  }
+  delete [] m_buffer;
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::enqueue(valueT const & value)
+{
+  uint64_t pos = m_tail.load(memory_order_relaxed);
+  for (;;) {
+    slot & s = slot_at(pos);
+    uint64_t seq = s.m_sequence.load(memory_order_acquire);
+    int64_t diff = int64_t(seq - pos);
+
+    if (!diff) {
+      // The slot is free in this lap; claim it.
+      if (m_tail.compare_exchange(pos, pos + 1, memory_order_relaxed)) {
+        s.m_value = value;
+        s.m_sequence.store(pos + 1, memory_order_release);
+        return true;
+      }
+      // pos now holds the updated tail.
+    }
+    else if (diff < 0) {
+      // The slot still holds a value from the previous lap.
+      return false;
+    }
+    else {
+      // Another producer claimed the slot already.
+      pos = m_tail.load(memory_order_relaxed);
+    }
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::dequeue(valueT & value)
+{
+  uint64_t pos = m_head.load(memory_order_relaxed);
+  for (;;) {
+    slot & s = slot_at(pos);
+    uint64_t seq = s.m_sequence.load(memory_order_acquire);
+    int64_t diff = int64_t(seq - (pos + 1));
+
+    if (!diff) {
+      // The slot was filled in this lap; claim it.
+      if (m_head.compare_exchange(pos, pos + 1, memory_order_relaxed)) {
+        value = s.m_value;
+        // Hand the slot to the producer in the next lap.
+        s.m_sequence.store(pos + m_mask + 1, memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0) {
+      // The slot has not been filled yet.
+      return false;
+    }
+    else {
+      // Another consumer claimed the slot already.
+      pos = m_head.load(memory_order_relaxed);
+    }
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+void
+mpmc_queue<valueT>::wake(twine::atomic<uint32_t> & waiters, uint32_t & signals,
+    condition & cond)
+{
+  // Waiters register, then fence, then retry; we release a slot, then fence,
+  // then look for waiters. The two fences order each side's store before its
+  // load, so either the waiter sees the slot we just released, or we see the
+  // waiter here.
+  atomic_thread_fence(memory_order_seq_cst);
+  if (!waiters.load(memory_order_relaxed)) {
+    return;
+  }
+
+  // Signalling a waiter unregisters it, so until it runs, further operations
+  // don't take the lock again just to notify it once more.
+  scoped_lock<mutex> lock(m_mutex);
+  if (waiters.load(memory_order_relaxed)) {
+    waiters.fetch_sub(1);
+    ++signals;
+    cond.notify_one();
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+void
+mpmc_queue<valueT>::unpark(twine::atomic<uint32_t> & waiters,
+    uint32_t & signals)
+{
+  // A waiter can't tell whether it was signalled or woke up for another
+  // reason; it doesn't matter which waiter consumes which, as long as each
+  // one either consumes a signal or unregisters.
+  if (signals) {
+    --signals;
+  }
+  else {
+    waiters.fetch_sub(1);
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::try_push(valueT const & value)
+{
+  if (!enqueue(value)) {
+    return false;
+  }
+  wake(m_pop_waiters, m_pop_signals, m_not_empty);
+  return true;
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::try_pop(valueT & value)
+{
+  if (!dequeue(value)) {
+    return false;
+  }
+  wake(m_push_waiters, m_push_signals, m_not_full);
+  return true;
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::push(valueT const & value)
+{
+  if (try_push(value)) {
+    return true;
+  }
+  return wait_push(value, nullptr);
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::pop(valueT & value)
+{
+  if (try_pop(value)) {
+    return true;
+  }
+  return wait_pop(value, nullptr);
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::timed_push_internal(valueT const & value,
+    chrono::nanoseconds const & duration)
+{
+  if (try_push(value)) {
+    return true;
+  }
+
+  chrono::nanoseconds deadline = chrono::monotonic_now() + duration;
+  return wait_push(value, &deadline);
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::wait_push(valueT const & value,
+    chrono::nanoseconds const * deadline)
+{
+  bool result = true;
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    for (;;) {
+      // Register before retrying, so that every pop from now on notifies us.
+      // The fence orders the registration before the retry's loads; it pairs
+      // with the one in wake().
+      m_push_waiters.fetch_add(1);
+      atomic_thread_fence(memory_order_seq_cst);
+      if (enqueue(value)) {
+        // Nobody could signal us without the lock.
+        m_push_waiters.fetch_sub(1);
+        break;
+      }
+
+      bool woken = true;
+      if (deadline) {
+        woken = m_not_full.wait_until(lock, *deadline);
+      }
+      else {
+        m_not_full.wait(lock);
+      }
+      unpark(m_push_waiters, m_push_signals);
+
+      if (!woken) {
+        result = enqueue(value);
+        break;
+      }
+    }
+  }
+
+  if (result) {
+    wake(m_pop_waiters, m_pop_signals, m_not_empty);
+  }
+  return result;
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::timed_pop_internal(valueT & value,
+    chrono::nanoseconds const & duration)
+{
+  if (try_pop(value)) {
+    return true;
+  }
+
+  chrono::nanoseconds deadline = chrono::monotonic_now() + duration;
+  return wait_pop(value, &deadline);
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+mpmc_queue<valueT>::wait_pop(valueT & value,
+    chrono::nanoseconds const * deadline)
+{
+  bool result = true;
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    for (;;) {
+      m_pop_waiters.fetch_add(1);
+      atomic_thread_fence(memory_order_seq_cst);
+      if (dequeue(value)) {
+        m_pop_waiters.fetch_sub(1);
+        break;
+      }
+
+      bool woken = true;
+      if (deadline) {
+        woken = m_not_empty.wait_until(lock, *deadline);
+      }
+      else {
+        m_not_empty.wait(lock);
+      }
+      unpark(m_pop_waiters, m_pop_signals);
+
+      if (!woken) {
+        result = dequeue(value);
+        break;
+      }
+    }
+  }
+
+  if (result) {
+    wake(m_push_waiters, m_push_signals, m_not_full);
+  }
+  return result;
+}
+
+
+
+template <
+  typename valueT
+>
+size_t
+mpmc_queue<valueT>::size() const
+{
+  uint64_t head = m_head.load(memory_order_relaxed);
+  uint64_t tail = m_tail.load(memory_order_relaxed);
+  return tail > head ? size_t(tail - head) : 0;
+}
+
+} // namespace twine
+
+#endif // guard
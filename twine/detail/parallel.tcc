@@ -0,0 +1,342 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_PARALLEL_TCC
+#define TWINE_DETAIL_PARALLEL_TCC
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <vector>
+#include <deque>
+
+namespace twine {
+namespace detail {
+
+// Invoked once per chunk with the chunk index.
+typedef void (*parallel_chunk_function)(void * baton, size_t chunk);
+
+
+/**
+ * Computes guided chunk boundaries for a range of the given size; chunk i
+ * covers [boundaries[i], boundaries[i + 1]).
+ **/
+void parallel_partition(std::vector<size_t> & boundaries, size_t size,
+    size_t grain, uint32_t workers);
+
+
+/**
+ * Runs func for all chunks in [0, chunks) on the pool and the calling thread,
+ * and returns once all chunks have been processed.
+ **/
+void parallel_run(thread_pool & pool, size_t chunks,
+    parallel_chunk_function func, void * baton);
+
+
+/**
+ * Chunk bodies for the individual algorithms; the baton is the body itself.
+ **/
+template <
+  typename rangeT,
+  typename funcT
+>
+struct parallel_for_body
+{
+  rangeT                      m_first;
+  funcT &                     m_func;
+  std::vector<size_t> const & m_bounds;
+
+  parallel_for_body(rangeT first, funcT & func,
+      std::vector<size_t> const & bounds)
+    : m_first(first)
+    , m_func(func)
+    , m_bounds(bounds)
+  {
+  }
+
+  static void run(void * baton, size_t chunk)
+  {
+    parallel_for_body * self = static_cast<parallel_for_body *>(baton);
+    self->m_func(rangeT(self->m_first + self->m_bounds[chunk]),
+        rangeT(self->m_first + self->m_bounds[chunk + 1]));
+  }
+};
+
+
+template <
+  typename rangeT,
+  typename valueT,
+  typename chunkT
+>
+struct parallel_reduce_body
+{
+  rangeT                      m_first;
+  valueT const &              m_identity;
+  chunkT &                    m_chunk;
+  std::vector<size_t> const & m_bounds;
+  std::deque<valueT>          m_partials;
+
+  parallel_reduce_body(rangeT first, valueT const & identity, chunkT & chunk,
+      std::vector<size_t> const & bounds)
+    : m_first(first)
+    , m_identity(identity)
+    , m_chunk(chunk)
+    , m_bounds(bounds)
+    , m_partials(bounds.size() - 1, identity)
+  {
+  }
+
+  static void run(void * baton, size_t chunk)
+  {
+    parallel_reduce_body * self = static_cast<parallel_reduce_body *>(baton);
+    self->m_partials[chunk] = self->m_chunk(
+        rangeT(self->m_first + self->m_bounds[chunk]),
+        rangeT(self->m_first + self->m_bounds[chunk + 1]),
+        self->m_identity);
+  }
+};
+
+
+/**
+ * Scans run in two passes: the first folds each chunk but the last, which
+ * yields each chunk's starting value. The second pass then scans each chunk
+ * from its starting value.
+ **/
+template <
+  typename inIterT,
+  typename outIterT,
+  typename valueT,
+  typename opT
+>
+struct parallel_scan_body
+{
+  inIterT                     m_first;
+  outIterT                    m_out;
+  opT &                       m_op;
+  std::vector<size_t> const & m_bounds;
+  std::deque<valueT>          m_sums;
+  std::deque<valueT>          m_starts;
+  bool                        m_inclusive;
+
+  parallel_scan_body(inIterT first, outIterT out, opT & op,
+      std::vector<size_t> const & bounds, valueT const & init, bool inclusive)
+    : m_first(first)
+    , m_out(out)
+    , m_op(op)
+    , m_bounds(bounds)
+    , m_sums(bounds.size() - 1, init)
+    , m_starts(bounds.size() - 1, init)
+    , m_inclusive(inclusive)
+  {
+  }
+
+  static void fold(void * baton, size_t chunk)
+  {
+    parallel_scan_body * self = static_cast<parallel_scan_body *>(baton);
+    inIterT it = self->m_first + self->m_bounds[chunk];
+    inIterT end = self->m_first + self->m_bounds[chunk + 1];
+
+    valueT acc = *it;
+    for (++it ; it != end ; ++it) {
+      acc = self->m_op(acc, *it);
+    }
+    self->m_sums[chunk] = acc;
+  }
+
+  void prefix()
+  {
+    // Turn chunk sums into chunk starting values. The exclusive scan's first
+    // chunk starts with the initial value, the inclusive scan's first chunk
+    // with its first element.
+    size_t chunks = m_starts.size();
+    if (chunks < 2) {
+      return;
+    }
+    valueT acc = m_inclusive ? m_sums[0] : m_op(m_starts[0], m_sums[0]);
+    m_starts[1] = acc;
+    for (size_t i = 2 ; i < chunks ; ++i) {
+      acc = m_op(acc, m_sums[i - 1]);
+      m_starts[i] = acc;
+    }
+  }
+
+  static void scan(void * baton, size_t chunk)
+  {
+    parallel_scan_body * self = static_cast<parallel_scan_body *>(baton);
+    inIterT it = self->m_first + self->m_bounds[chunk];
+    inIterT end = self->m_first + self->m_bounds[chunk + 1];
+    outIterT out = self->m_out + self->m_bounds[chunk];
+
+    if (self->m_inclusive) {
+      valueT acc = (0 == chunk) ? valueT(*it)
+        : self->m_op(self->m_starts[chunk], *it);
+      *out = acc;
+      for (++it, ++out ; it != end ; ++it, ++out) {
+        acc = self->m_op(acc, *it);
+        *out = acc;
+      }
+    }
+    else {
+      // Read each input before writing the output, in case they're the
+      // same.
+      valueT acc = self->m_starts[chunk];
+      for ( ; it != end ; ++it, ++out) {
+        valueT value = *it;
+        *out = acc;
+        acc = self->m_op(acc, value);
+      }
+    }
+  }
+};
+
+} // namespace detail
+
+
+
+template <
+  typename rangeT,
+  typename funcT
+>
+void
+parallel_for(rangeT first, rangeT last, funcT func, size_t grain /* = 0 */,
+    thread_pool * pool /* = nullptr */)
+{
+  if (!(first < last)) {
+    return;
+  }
+  if (!pool) {
+    pool = &detail::default_parallel_pool();
+  }
+
+  std::vector<size_t> bounds;
+  detail::parallel_partition(bounds, size_t(last - first), grain,
+      pool->size());
+
+  detail::parallel_for_body<rangeT, funcT> body(first, func, bounds);
+  detail::parallel_run(*pool, bounds.size() - 1, body.run, &body);
+}
+
+
+
+template <
+  typename rangeT,
+  typename valueT,
+  typename chunkT,
+  typename combineT
+>
+valueT
+parallel_reduce(rangeT first, rangeT last, valueT const & identity,
+    chunkT chunk, combineT combine, size_t grain /* = 0 */,
+    thread_pool * pool /* = nullptr */)
+{
+  if (!(first < last)) {
+    return identity;
+  }
+  if (!pool) {
+    pool = &detail::default_parallel_pool();
+  }
+
+  std::vector<size_t> bounds;
+  detail::parallel_partition(bounds, size_t(last - first), grain,
+      pool->size());
+
+  detail::parallel_reduce_body<rangeT, valueT, chunkT> body(first, identity,
+      chunk, bounds);
+  detail::parallel_run(*pool, bounds.size() - 1, body.run, &body);
+
+  valueT result = identity;
+  for (size_t i = 0 ; i < body.m_partials.size() ; ++i) {
+    result = combine(result, body.m_partials[i]);
+  }
+  return result;
+}
+
+
+
+template <
+  typename inIterT,
+  typename outIterT,
+  typename opT
+>
+outIterT
+parallel_inclusive_scan(inIterT first, inIterT last, outIterT out, opT op,
+    size_t grain /* = 0 */, thread_pool * pool /* = nullptr */)
+{
+  typedef typename std::iterator_traits<inIterT>::value_type value_type;
+
+  if (!(first < last)) {
+    return out;
+  }
+  if (!pool) {
+    pool = &detail::default_parallel_pool();
+  }
+
+  size_t size = size_t(last - first);
+  std::vector<size_t> bounds;
+  detail::parallel_partition(bounds, size, grain, pool->size());
+
+  detail::parallel_scan_body<inIterT, outIterT, value_type, opT> body(first,
+      out, op, bounds, *first, true);
+  detail::parallel_run(*pool, bounds.size() - 2, body.fold, &body);
+  body.prefix();
+  detail::parallel_run(*pool, bounds.size() - 1, body.scan, &body);
+
+  return out + size;
+}
+
+
+
+template <
+  typename inIterT,
+  typename outIterT,
+  typename valueT,
+  typename opT
+>
+outIterT
+parallel_exclusive_scan(inIterT first, inIterT last, outIterT out,
+    valueT const & init, opT op, size_t grain /* = 0 */,
+    thread_pool * pool /* = nullptr */)
+{
+  if (!(first < last)) {
+    return out;
+  }
+  if (!pool) {
+    pool = &detail::default_parallel_pool();
+  }
+
+  size_t size = size_t(last - first);
+  std::vector<size_t> bounds;
+  detail::parallel_partition(bounds, size, grain, pool->size());
+
+  detail::parallel_scan_body<inIterT, outIterT, valueT, opT> body(first,
+      out, op, bounds, init, false);
+  detail::parallel_run(*pool, bounds.size() - 2, body.fold, &body);
+  body.prefix();
+  detail::parallel_run(*pool, bounds.size() - 1, body.scan, &body);
+
+  return out + size;
+}
+
+} // namespace twine
+
+#endif // guard
@@ -0,0 +1,160 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_RECLAIM_REGISTRY_H
+#define TWINE_DETAIL_RECLAIM_REGISTRY_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <vector>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+
+namespace twine {
+namespace detail {
+
+/**
+ * A thread's state in a memory reclamation domain: the nodes it retired that
+ * have not been freed yet. Only the owning thread touches anything but
+ * m_in_use; domains derive from this to add state other threads read.
+ **/
+struct reclaim_record
+{
+  struct retired
+  {
+    void *    m_ptr;
+    void      (*m_deleter)(void *);
+    uint64_t  m_epoch;    // When the node was retired; epoch_domain only.
+  };
+
+  twine::atomic<uint32_t> m_in_use;
+  reclaim_record *        m_next;
+
+  size_t                  m_threshold;
+  std::vector<retired>    m_retired;
+
+  reclaim_record();
+  virtual ~reclaim_record();
+
+  /**
+   * Free the retired nodes keep() returns false for. The next threshold is
+   * batch_size on top of what is kept, so that nodes that can't be freed yet
+   * don't make every later retirement reclaim again.
+   **/
+  template <typename keepT>
+  inline void reclaim(keepT const & keep, size_t batch_size)
+  {
+    // Deleters may retire further nodes; work on a copy.
+    std::vector<retired> batch;
+    batch.swap(m_retired);
+    for (size_t i = 0 ; i < batch.size() ; ++i) {
+      if (keep(batch[i])) {
+        m_retired.push_back(batch[i]);
+      }
+      else {
+        batch[i].m_deleter(batch[i].m_ptr);
+      }
+    }
+    m_threshold = m_retired.size() + batch_size;
+  }
+};
+
+
+/**
+ * Per-thread bookkeeping shared by epoch_domain and hazard_domain.
+ *
+ * The registry keeps the domain's list of records. Records are never removed
+ * before the registry is destroyed, only released for reuse; nodes still
+ * pending in a released record are handed on to the next thread to register.
+ *
+ * Threads register the first time they acquire() a record. The calling
+ * thread's registrations with all domains are kept in a thread-local list,
+ * and a single exit handler releases them when a twine::thread's function
+ * returns. Releasing a record first passes it to the domain's release
+ * function, which should free whatever it can.
+ **/
+class reclaim_registry
+  : public twine::noncopyable
+{
+public:
+  typedef reclaim_record * (*create_function)();
+  typedef void (*release_function)(void * domain, reclaim_record * record);
+
+  reclaim_registry(void * domain, size_t batch_size, create_function create,
+      release_function release);
+
+  /**
+   * Frees all pending nodes and records. The domain must release the calling
+   * thread's record first; other threads must have released theirs.
+   **/
+  ~reclaim_registry();
+
+  /**
+   * The calling thread's record, or nullptr if it isn't registered.
+   **/
+  reclaim_record * current() const;
+
+  /**
+   * The calling thread's record, registering the thread if necessary.
+   **/
+  reclaim_record * acquire();
+
+  /**
+   * Release the calling thread's record; returns false if the thread isn't
+   * registered.
+   **/
+  bool release();
+
+  /**
+   * The head of the record list, for scanning.
+   **/
+  inline reclaim_record * records() const
+  {
+    return m_records.load(memory_order_acquire);
+  }
+
+  inline size_t batch_size() const
+  {
+    return m_batch_size;
+  }
+
+  /**
+   * Forward declarations
+   **/
+  struct registration;
+
+private:
+  static void thread_exit(void * baton);
+
+  void *                          m_domain;
+  size_t                          m_batch_size;
+  create_function                 m_create;
+  release_function                m_release;
+  twine::atomic<reclaim_record *> m_records;
+};
+
+}} // namespace twine::detail
+
+#endif // guard
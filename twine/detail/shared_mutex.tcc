@@ -0,0 +1,323 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_SHARED_MUTEX_TCC
+#define TWINE_DETAIL_SHARED_MUTEX_TCC
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/scoped_lock.h>
+
+namespace twine {
+namespace detail {
+
+/**
+ * Bits of shared_mutex_base's state word.
+ **/
+enum shared_mutex_state
+{
+  SHARED_MUTEX_EXCLUSIVE      = 0x80000000U,
+  SHARED_MUTEX_WRITER_WAITING = 0x40000000U,
+  SHARED_MUTEX_UPGRADEABLE    = 0x20000000U,
+  SHARED_MUTEX_READER_MASK    = 0x1fffffffU
+};
+
+} // namespace detail
+
+
+
+template <
+  typename preference_policyT
+>
+shared_mutex_base<preference_policyT>::shared_mutex_base()
+  : preference_policyT()
+  , m_state(0)
+  , m_waiters(0)
+  , m_waiting_writers(0)
+  , m_mutex()
+  , m_cond()
+{
+}
+
+
+
+template <
+  typename preference_policyT
+>
+shared_mutex_base<preference_policyT>::~shared_mutex_base()
+{
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::lock()
+{
+  if (!try_lock()) {
+    wait_for(&shared_mutex_base::try_lock, true);
+  }
+}
+
+
+
+template <
+  typename preference_policyT
+>
+bool
+shared_mutex_base<preference_policyT>::try_lock()
+{
+  uint32_t state = m_state.load();
+  do {
+    if (state & ~uint32_t(detail::SHARED_MUTEX_WRITER_WAITING)) {
+      return false;
+    }
+  } while (!m_state.compare_exchange(state,
+        state | detail::SHARED_MUTEX_EXCLUSIVE));
+  return true;
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::unlock()
+{
+  m_state.fetch_and(~uint32_t(detail::SHARED_MUTEX_EXCLUSIVE));
+  wake_waiters();
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::lock_shared()
+{
+  if (!try_lock_shared()) {
+    wait_for(&shared_mutex_base::try_lock_shared, false);
+  }
+}
+
+
+
+template <
+  typename preference_policyT
+>
+bool
+shared_mutex_base<preference_policyT>::try_lock_shared()
+{
+  uint32_t blocking = detail::SHARED_MUTEX_EXCLUSIVE;
+  if (preference_policyT::writers_block_readers()) {
+    blocking |= detail::SHARED_MUTEX_WRITER_WAITING;
+  }
+
+  uint32_t state = m_state.load();
+  do {
+    if (state & blocking) {
+      return false;
+    }
+  } while (!m_state.compare_exchange(state, state + 1));
+  return true;
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::unlock_shared()
+{
+  // Only the last reader can unblock anyone.
+  uint32_t prev = m_state.fetch_sub(1);
+  if (1 == (prev & detail::SHARED_MUTEX_READER_MASK)) {
+    wake_waiters();
+  }
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::lock_upgrade()
+{
+  if (!try_lock_upgrade()) {
+    wait_for(&shared_mutex_base::try_lock_upgrade, false);
+  }
+}
+
+
+
+template <
+  typename preference_policyT
+>
+bool
+shared_mutex_base<preference_policyT>::try_lock_upgrade()
+{
+  uint32_t blocking = detail::SHARED_MUTEX_EXCLUSIVE
+    | detail::SHARED_MUTEX_UPGRADEABLE;
+  if (preference_policyT::writers_block_readers()) {
+    blocking |= detail::SHARED_MUTEX_WRITER_WAITING;
+  }
+
+  uint32_t state = m_state.load();
+  do {
+    if (state & blocking) {
+      return false;
+    }
+  } while (!m_state.compare_exchange(state,
+        state | detail::SHARED_MUTEX_UPGRADEABLE));
+  return true;
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::unlock_upgrade()
+{
+  m_state.fetch_and(~uint32_t(detail::SHARED_MUTEX_UPGRADEABLE));
+  wake_waiters();
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::upgrade()
+{
+  if (!try_upgrade()) {
+    wait_for(&shared_mutex_base::try_upgrade, true);
+  }
+}
+
+
+
+template <
+  typename preference_policyT
+>
+bool
+shared_mutex_base<preference_policyT>::try_upgrade()
+{
+  // We hold the upgradeable lock, so no one else can hold an exclusive one.
+  uint32_t state = m_state.load();
+  do {
+    if (state & detail::SHARED_MUTEX_READER_MASK) {
+      return false;
+    }
+  } while (!m_state.compare_exchange(state,
+        (state & ~uint32_t(detail::SHARED_MUTEX_UPGRADEABLE))
+          | detail::SHARED_MUTEX_EXCLUSIVE));
+  return true;
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::downgrade()
+{
+  // Clears the exclusive flag and adds a reader in one step.
+  m_state.fetch_sub(uint32_t(detail::SHARED_MUTEX_EXCLUSIVE) - 1);
+  wake_waiters();
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::downgrade_to_upgrade()
+{
+  m_state.fetch_sub(uint32_t(detail::SHARED_MUTEX_EXCLUSIVE)
+      - uint32_t(detail::SHARED_MUTEX_UPGRADEABLE));
+  wake_waiters();
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::wait_for(acquire_func acquire,
+    bool writer)
+{
+  scoped_lock<mutex> lock(m_mutex);
+
+  // Register as a waiter before retrying, so that any thread releasing the
+  // lock from now on will take m_mutex and notify us.
+  m_waiters.fetch_add(1);
+  if (writer && preference_policyT::writers_block_readers()) {
+    if (1 == ++m_waiting_writers) {
+      m_state.fetch_or(detail::SHARED_MUTEX_WRITER_WAITING);
+    }
+  }
+
+  while (!(this->*acquire)()) {
+    m_cond.wait(lock);
+  }
+
+  if (writer && preference_policyT::writers_block_readers()) {
+    if (0 == --m_waiting_writers) {
+      m_state.fetch_and(~uint32_t(detail::SHARED_MUTEX_WRITER_WAITING));
+    }
+  }
+  m_waiters.fetch_sub(1);
+}
+
+
+
+template <
+  typename preference_policyT
+>
+void
+shared_mutex_base<preference_policyT>::wake_waiters()
+{
+  if (!m_waiters.load()) {
+    return;
+  }
+
+  scoped_lock<mutex> lock(m_mutex);
+  m_cond.notify_all();
+}
+
+} // namespace twine
+
+#endif // guard
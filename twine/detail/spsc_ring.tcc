@@ -0,0 +1,262 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_SPSC_RING_TCC
+#define TWINE_DETAIL_SPSC_RING_TCC
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+namespace twine {
+
+template <
+  typename valueT
+>
+spsc_ring<valueT>::spsc_ring(size_t capacity)
+  : m_tail(0)
+  , m_cached_head(0)
+  , m_head(0)
+  , m_cached_tail(0)
+  , m_consumer(nullptr)
+  , m_mask(1)
+  , m_slots(nullptr)
+{
+  while (m_mask + 1 < capacity) {
+    m_mask = (m_mask << 1) | 1;
+  }
+  m_slots = new valueT[size_t(m_mask + 1)];
+}
+
+
+
+template <
+  typename valueT
+>
+spsc_ring<valueT>::~spsc_ring()
+{
+  delete [] m_slots;
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+spsc_ring<valueT>::try_push(valueT const & value)
+{
+  size_t count = 1;
+  valueT * slot = reserve(count);
+  if (!slot) {
+    return false;
+  }
+  *slot = value;
+  commit(1);
+  return true;
+}
+
+
+
+template <
+  typename valueT
+>
+size_t
+spsc_ring<valueT>::push_n(valueT const * values, size_t count)
+{
+  uint64_t tail = m_tail.load(memory_order_relaxed);
+  uint64_t free = free_slots(tail, count);
+  if (count > free) {
+    count = size_t(free);
+  }
+
+  for (size_t i = 0 ; i < count ; ++i) {
+    m_slots[(tail + i) & m_mask] = values[i];
+  }
+  commit(count);
+  return count;
+}
+
+
+
+template <
+  typename valueT
+>
+valueT *
+spsc_ring<valueT>::reserve(size_t & count)
+{
+  uint64_t tail = m_tail.load(memory_order_relaxed);
+  uint64_t free = free_slots(tail, count);
+
+  // Don't wrap around the end of the array.
+  uint64_t offset = tail & m_mask;
+  uint64_t contiguous = m_mask + 1 - offset;
+  if (free > contiguous) {
+    free = contiguous;
+  }
+  if (count > free) {
+    count = size_t(free);
+  }
+
+  return count ? m_slots + offset : nullptr;
+}
+
+
+
+template <
+  typename valueT
+>
+void
+spsc_ring<valueT>::commit(size_t count)
+{
+  if (!count) {
+    return;
+  }
+  m_tail.store(m_tail.load(memory_order_relaxed) + count,
+      memory_order_release);
+  notify_consumer();
+}
+
+
+
+template <
+  typename valueT
+>
+uint64_t
+spsc_ring<valueT>::free_slots(uint64_t tail, size_t wanted)
+{
+  uint64_t free = (m_mask + 1) - (tail - m_cached_head);
+  if (free < wanted) {
+    // Only look at the consumer's index if the cached one says we're short.
+    m_cached_head = m_head.load(memory_order_acquire);
+    free = (m_mask + 1) - (tail - m_cached_head);
+  }
+  return free;
+}
+
+
+
+template <
+  typename valueT
+>
+void
+spsc_ring<valueT>::notify_consumer()
+{
+  // The consumer registers before checking for values, and we publish before
+  // checking for the consumer, so one of us sees the other. The fence orders
+  // our releasing store before the load.
+  atomic_thread_fence(memory_order_seq_cst);
+  tasklet * consumer = m_consumer.load(memory_order_relaxed);
+  if (consumer) {
+    consumer->notify();
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+spsc_ring<valueT>::try_pop(valueT & value)
+{
+  return 1 == pop_n(&value, 1);
+}
+
+
+
+template <
+  typename valueT
+>
+size_t
+spsc_ring<valueT>::pop_n(valueT * values, size_t count)
+{
+  uint64_t head = m_head.load(memory_order_relaxed);
+  uint64_t available = m_cached_tail - head;
+  if (available < count) {
+    // Only look at the producer's index if the cached one says we're short.
+    m_cached_tail = m_tail.load(memory_order_acquire);
+    available = m_cached_tail - head;
+  }
+  if (count > available) {
+    count = size_t(available);
+  }
+
+  for (size_t i = 0 ; i < count ; ++i) {
+    values[i] = m_slots[(head + i) & m_mask];
+  }
+  if (count) {
+    m_head.store(head + count, memory_order_release);
+  }
+  return count;
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+spsc_ring<valueT>::wait_readable(tasklet & consumer)
+{
+  for (;;) {
+    uint64_t head = m_head.load(memory_order_relaxed);
+    if (m_cached_tail != head) {
+      return true;
+    }
+
+    // Register, then look again; see notify_consumer(). The fence orders the
+    // registration before the load, as the producer's orders its publishing
+    // store before loading m_consumer.
+    m_consumer.store(&consumer);
+    atomic_thread_fence(memory_order_seq_cst);
+    m_cached_tail = m_tail.load(memory_order_acquire);
+    if (m_cached_tail != head) {
+      m_consumer.store(nullptr, memory_order_relaxed);
+      return true;
+    }
+
+    bool running = consumer.sleep();
+    m_consumer.store(nullptr, memory_order_relaxed);
+    if (!running) {
+      return false;
+    }
+    m_cached_tail = m_tail.load(memory_order_acquire);
+  }
+}
+
+
+
+template <
+  typename valueT
+>
+size_t
+spsc_ring<valueT>::size() const
+{
+  uint64_t head = m_head.load(memory_order_relaxed);
+  uint64_t tail = m_tail.load(memory_order_relaxed);
+  return tail > head ? size_t(tail - head) : 0;
+}
+
+} // namespace twine
+
+#endif // guard
@@ -45,12 +45,16 @@ struct thread::thread_info
   void *              m_baton;
   volatile thread *   m_thread;
   thread::id          m_id;
+  cpu_set             m_affinity;
+  thread::attributes  m_attributes;
 
   thread_info(thread::function func, void * baton, thread * thread)
     : m_func(func)
     , m_baton(baton)
     , m_thread(thread)
     , m_id(bad_thread_id)
+    , m_affinity()
+    , m_attributes()
   {
   }
 
@@ -59,6 +63,8 @@ struct thread::thread_info
     , m_baton(other->m_baton)
     , m_thread(other->m_thread)
     , m_id(bad_thread_id)
+    , m_affinity(const_cast<thread_info const *>(other)->m_affinity)
+    , m_attributes(const_cast<thread_info const *>(other)->m_attributes)
   {
   }
 
@@ -89,6 +95,26 @@ struct thread::thread_info
     m_id = detail::get_thread_id();
   }
 
+  inline void apply_affinity() const
+  {
+    // Without a thread object, nobody else can change the affinity.
+    thread * tmp_thread = const_cast<thread *>(m_thread);
+    if (!tmp_thread) {
+      if (!m_affinity.empty()) {
+        this_thread::set_affinity(m_affinity);
+      }
+      return;
+    }
+
+    // Otherwise, the thread object's affinity may have changed since start()
+    // copied it; thread::set_affinity() pins the running thread directly.
+    // Reading and applying it under the lock means the copy can't undo that.
+    scoped_lock<recursive_mutex> lock(tmp_thread->m_mutex);
+    if (!tmp_thread->m_affinity.empty()) {
+      this_thread::set_affinity(tmp_thread->m_affinity);
+    }
+  }
+
   inline void detach_from_thread_object() const
   {
     // If the thread object is a null pointer, we're already detached
@@ -46,9 +46,23 @@ static void * thread_wrapper(void * arg)
   // Get thread id.
   info->get_thread_id();
 
+  // Pin the thread before it does any work.
+  info->apply_affinity();
+
+  // Scheduling options are best effort; failure leaves the defaults.
+  thread::attributes const & attrs = info->m_attributes;
+  if (thread::SCHEDULING_DEFAULT != attrs.policy()) {
+    this_thread::set_scheduling(attrs.policy(), attrs.priority());
+  }
+  if (attrs.has_nice()) {
+    this_thread::set_nice(attrs.nice());
+  }
+
   // Run thread function safely - terminate the thread on any exception
+  begin_exit_handlers();
   try {
     info->m_func(info->m_baton);
+    run_exit_handlers();
   } catch (...) {
     delete info;
     std::terminate();
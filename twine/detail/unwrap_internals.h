@@ -35,7 +35,8 @@ namespace detail {
 
 /**
  * Helper construct for unwrapping the underlying raw mutex handle from a mutex
- * or lock object.
+ * or lock object. Backends that don't wait on the raw handle directly can use
+ * get_mutex() to access the mutex object itself.
  **/
 template <typename handleT, typename lockableT>
 struct unwrap_internals
@@ -46,37 +47,82 @@ struct unwrap_internals
 template <typename handleT>
 struct unwrap_internals<handleT, mutex>
 {
+  typedef mutex mutex_type;
+
   inline static handleT & get_mutex_handle(mutex & mutex)
   {
     return mutex.m_handle;
   }
+
+  inline static mutex_type & get_mutex(mutex & mutex)
+  {
+    return mutex;
+  }
 };
 
 template <typename handleT>
 struct unwrap_internals<handleT, recursive_mutex>
 {
+  typedef recursive_mutex mutex_type;
+
   inline static handleT & get_mutex_handle(recursive_mutex & mutex)
   {
     return mutex.m_handle;
   }
+
+  inline static mutex_type & get_mutex(recursive_mutex & mutex)
+  {
+    return mutex;
+  }
 };
 
 template <typename handleT>
 struct unwrap_internals<handleT, scoped_lock<mutex> >
 {
+  typedef mutex mutex_type;
+
   inline static handleT & get_mutex_handle(scoped_lock<mutex> & lock)
   {
     return lock.m_mutex.m_handle;
   }
+
+  inline static mutex_type & get_mutex(scoped_lock<mutex> & lock)
+  {
+    return lock.m_mutex;
+  }
 };
 
 template <typename handleT>
 struct unwrap_internals<handleT, scoped_lock<recursive_mutex> >
 {
+  typedef recursive_mutex mutex_type;
+
   inline static handleT & get_mutex_handle(scoped_lock<recursive_mutex> & lock)
   {
     return lock.m_mutex.m_handle;
   }
+
+  inline static mutex_type & get_mutex(scoped_lock<recursive_mutex> & lock)
+  {
+    return lock.m_mutex;
+  }
+};
+
+/**
+ * Backends that wait on the raw handle release and reacquire it behind the
+ * mutex object's back. Mutex wrappers that track their owner specialize this
+ * to be told about it; the lockable is locked before and after the wait.
+ **/
+template <typename lockableT>
+struct wait_hooks
+{
+  inline static void before_wait(lockableT &)
+  {
+  }
+
+  inline static void after_wait(lockableT &)
+  {
+  }
 };
 
 }} // namespace twine::detail
@@ -0,0 +1,229 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_DETAIL_WORK_STEALING_DEQUE_H
+#define TWINE_DETAIL_WORK_STEALING_DEQUE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/thread.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+namespace detail {
+
+/**
+ * A unit of work: the same function and baton a thread would run.
+ **/
+struct job
+{
+  thread::function  m_func;
+  void *            m_baton;
+};
+
+
+/**
+ * Chase-Lev work stealing deque, using the memory orderings described in
+ * Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models"
+ * (PPoPP 2013).
+ *
+ * The owning thread push()es and take()s at the bottom end; any other thread
+ * may steal() from the top end. Neither operation takes a lock. The deque
+ * grows when full; arrays that were replaced are kept until the deque is
+ * destroyed, since concurrent thieves may still read from them.
+ **/
+class work_stealing_deque
+  : public twine::noncopyable
+{
+public:
+  enum steal_result
+  {
+    STEAL_SUCCESS,
+    STEAL_EMPTY,
+    STEAL_ABORT   // Lost a race; the deque may not be empty.
+  };
+
+  explicit work_stealing_deque(int64_t capacity = 256)
+    : m_top(0)
+    , m_bottom(0)
+    , m_array(new array(capacity, nullptr))
+  {
+  }
+
+  ~work_stealing_deque()
+  {
+    array * a = m_array.load(memory_order_relaxed);
+    while (a) {
+      array * prev = a->m_previous;
+      delete a;
+      a = prev;
+    }
+  }
+
+  /**
+   * Owner only: push a job at the bottom end.
+   **/
+  inline void push(job const & j)
+  {
+    int64_t b = m_bottom.load(memory_order_relaxed);
+    int64_t t = m_top.load(memory_order_acquire);
+    array * a = m_array.load(memory_order_relaxed);
+    if (b - t > a->m_mask) {
+      a = grow(a, t, b);
+    }
+    a->put(b, j);
+    m_bottom.store(b + 1, memory_order_release);
+  }
+
+  /**
+   * Owner only: take the most recently pushed job. Returns false if the deque
+   * is empty.
+   **/
+  inline bool take(job & j)
+  {
+    int64_t b = m_bottom.load(memory_order_relaxed) - 1;
+    array * a = m_array.load(memory_order_relaxed);
+    m_bottom.store(b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t t = m_top.load(memory_order_relaxed);
+
+    if (t > b) {
+      // Empty
+      m_bottom.store(b + 1, memory_order_relaxed);
+      return false;
+    }
+
+    a->get(b, j);
+    if (t == b) {
+      // Last element; race against thieves for it.
+      bool won = m_top.compare_exchange(t, t + 1, memory_order_seq_cst);
+      m_bottom.store(b + 1, memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  /**
+   * Any thread: steal the least recently pushed job.
+   **/
+  inline steal_result steal(job & j)
+  {
+    int64_t t = m_top.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t b = m_bottom.load(memory_order_acquire);
+
+    if (t >= b) {
+      return STEAL_EMPTY;
+    }
+
+    array * a = m_array.load(memory_order_acquire);
+    a->get(t, j);
+    if (!m_top.compare_exchange(t, t + 1, memory_order_seq_cst)) {
+      return STEAL_ABORT;
+    }
+    return STEAL_SUCCESS;
+  }
+
+  /**
+   * Any thread: an estimate of whether there is work in the deque.
+   **/
+  inline bool empty() const
+  {
+    int64_t b = m_bottom.load(memory_order_relaxed);
+    int64_t t = m_top.load(memory_order_relaxed);
+    return b <= t;
+  }
+
+private:
+  /**
+   * Circular array of job cells. The cells are atomics so that a thief that
+   * loses the race for a cell never performs a plain racing read; the value
+   * it read is discarded in that case anyway.
+   **/
+  struct cell
+  {
+    twine::atomic<thread::function> m_func;
+    twine::atomic<void *>           m_baton;
+  };
+
+  struct array
+  {
+    int64_t   m_mask;
+    cell *    m_cells;
+    array *   m_previous;
+
+    array(int64_t capacity, array * previous)
+      : m_mask(capacity - 1)
+      , m_cells(new cell[capacity])
+      , m_previous(previous)
+    {
+    }
+
+    ~array()
+    {
+      delete [] m_cells;
+    }
+
+    inline void put(int64_t index, job const & j)
+    {
+      cell & c = m_cells[index & m_mask];
+      c.m_func.store(j.m_func, memory_order_relaxed);
+      c.m_baton.store(j.m_baton, memory_order_relaxed);
+    }
+
+    inline void get(int64_t index, job & j) const
+    {
+      cell & c = m_cells[index & m_mask];
+      j.m_func = c.m_func.load(memory_order_relaxed);
+      j.m_baton = c.m_baton.load(memory_order_relaxed);
+    }
+  };
+
+  array * grow(array * a, int64_t t, int64_t b)
+  {
+    array * bigger = new array((a->m_mask + 1) * 2, a);
+    for (int64_t i = t ; i < b ; ++i) {
+      job j;
+      a->get(i, j);
+      bigger->put(i, j);
+    }
+    m_array.store(bigger, memory_order_release);
+    return bigger;
+  }
+
+  // Thieves hammer m_top, the owner m_bottom; keep them on separate cache
+  // lines.
+  twine::atomic<int64_t>  m_top;
+  char                    m_pad0[TWINE_CACHE_LINE_SIZE - sizeof(int64_t)];
+  twine::atomic<int64_t>  m_bottom;
+  char                    m_pad1[TWINE_CACHE_LINE_SIZE - sizeof(int64_t)];
+  twine::atomic<array *>  m_array;
+};
+
+}} // namespace twine::detail
+
+#endif // guard
@@ -0,0 +1,242 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/epoch.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+
+/**
+ * Per-thread state. Other threads read m_state when trying to advance the
+ * epoch.
+ **/
+struct epoch_domain::record
+  : public detail::reclaim_record
+{
+  // Zero outside of critical sections, otherwise the epoch the thread
+  // observed when entering, shifted left by one, with ACTIVE set. Padded
+  // apart from the base's and neighbouring allocations' data.
+  char                    m_pad0[TWINE_CACHE_LINE_SIZE];
+  twine::atomic<uint64_t> m_state;
+  char                    m_pad1[TWINE_CACHE_LINE_SIZE - sizeof(uint64_t)];
+
+  uint32_t                m_nesting;
+
+  record()
+    : detail::reclaim_record()
+    , m_state(0)
+    , m_nesting(0)
+  {
+  }
+};
+
+
+TWINE_ANONS_START
+
+static uint64_t const ACTIVE = 1;
+
+// Nodes retired in epoch e are safe to free once the epoch reaches e + 2.
+struct retired_after
+{
+  uint64_t m_epoch;
+
+  bool operator()(detail::reclaim_record::retired const & r) const
+  {
+    return r.m_epoch + 2 > m_epoch;
+  }
+};
+
+TWINE_ANONS_END
+
+
+
+epoch_domain::epoch_domain(size_t batch_size /* = 64 */)
+  : m_epoch(0)
+  , m_registry(this, batch_size, &epoch_domain::create_record,
+      &epoch_domain::release_record)
+{
+}
+
+
+
+epoch_domain::~epoch_domain()
+{
+  // Drop the calling thread's registration; other threads must have
+  // unregistered already.
+  unregister_thread();
+}
+
+
+
+bool
+epoch_domain::register_thread()
+{
+  m_registry.acquire();
+  return true;
+}
+
+
+
+bool
+epoch_domain::unregister_thread()
+{
+  record * rec = static_cast<record *>(m_registry.current());
+  if (!rec || rec->m_nesting) {
+    return false;
+  }
+  return m_registry.release();
+}
+
+
+
+detail::reclaim_record *
+epoch_domain::create_record()
+{
+  return new record();
+}
+
+
+
+void
+epoch_domain::release_record(void * domain, detail::reclaim_record * rec)
+{
+  record * r = static_cast<record *>(rec);
+
+  // Exiting inside a critical section is a bug, but it must not block
+  // reclamation forever.
+  r->m_nesting = 0;
+  r->m_state.store(0, memory_order_release);
+
+  static_cast<epoch_domain *>(domain)->reclaim(r);
+}
+
+
+
+epoch_domain::record *
+epoch_domain::current_record()
+{
+  return static_cast<record *>(m_registry.acquire());
+}
+
+
+
+void
+epoch_domain::enter()
+{
+  record * rec = current_record();
+  if (rec->m_nesting++) {
+    return;
+  }
+
+  // Announce the epoch, then make sure the announcement is visible before
+  // reading anything protected by it; see try_advance().
+  uint64_t epoch = m_epoch.load(memory_order_relaxed);
+  rec->m_state.store((epoch << 1) | TWINE_ANONS(ACTIVE), memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+
+
+void
+epoch_domain::leave()
+{
+  record * rec = current_record();
+  if (!rec->m_nesting || --rec->m_nesting) {
+    return;
+  }
+  rec->m_state.store(0, memory_order_release);
+}
+
+
+
+void
+epoch_domain::retire(void * ptr, deleter del)
+{
+  if (!ptr) {
+    return;
+  }
+  record * rec = current_record();
+
+  // Order unlinking ptr before reading the epoch, so that any thread that
+  // advances past this epoch must see ptr unlinked.
+  atomic_thread_fence(memory_order_seq_cst);
+  record::retired r = { ptr, del, m_epoch.load(memory_order_relaxed) };
+  rec->m_retired.push_back(r);
+
+  if (rec->m_retired.size() >= rec->m_threshold) {
+    reclaim(rec);
+  }
+}
+
+
+
+void
+epoch_domain::collect()
+{
+  reclaim(current_record());
+}
+
+
+
+uint64_t
+epoch_domain::epoch() const
+{
+  return m_epoch.load(memory_order_relaxed);
+}
+
+
+
+bool
+epoch_domain::try_advance()
+{
+  // The epoch can only advance once every thread in a critical section has
+  // observed it.
+  uint64_t epoch = m_epoch.load();
+  for (detail::reclaim_record * rec = m_registry.records() ; rec ;
+      rec = rec->m_next)
+  {
+    uint64_t state = static_cast<record *>(rec)->m_state.load();
+    if ((state & TWINE_ANONS(ACTIVE)) && (state >> 1) != epoch) {
+      return false;
+    }
+  }
+  return m_epoch.compare_exchange(epoch, epoch + 1);
+}
+
+
+
+void
+epoch_domain::reclaim(record * rec)
+{
+  if (rec->m_retired.empty()) {
+    return;
+  }
+
+  // Try to get far enough to free the batch's newest nodes.
+  if (try_advance()) {
+    try_advance();
+  }
+
+  TWINE_ANONS(retired_after) keep = { m_epoch.load(memory_order_acquire) };
+  rec->reclaim(keep, m_registry.batch_size());
+}
+
+} // namespace twine
@@ -0,0 +1,181 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_EPOCH_H
+#define TWINE_EPOCH_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/detail/reclaim_registry.h>
+
+namespace twine {
+
+namespace detail {
+
+template <typename T>
+void epoch_delete(void * ptr)
+{
+  delete static_cast<T *>(ptr);
+}
+
+} // namespace detail
+
+
+/**
+ * Epoch-based memory reclamation.
+ *
+ * Lock-free data structures can't free a node as soon as they unlink it,
+ * since concurrent readers may still be looking at it. An epoch_domain
+ * defers freeing such nodes until no reader can hold a reference any
+ * longer:
+ *
+ * - Readers access the structure only within a critical section, i.e. while
+ *   holding an epoch_domain::guard.
+ * - Writers unlink nodes, then retire() them instead of deleting them.
+ * - The domain keeps a global epoch, which only advances once every thread
+ *   inside a critical section has observed the current epoch. Nodes retired
+ *   in an epoch are freed two epochs later, when every critical section that
+ *   could have seen them has ended.
+ *
+ * Example:
+ *
+ *   epoch_domain domain;
+ *
+ *   // Reader
+ *   {
+ *     epoch_domain::guard g(domain);
+ *     node * n = head.load(memory_order_acquire);
+ *     // n stays valid until g goes out of scope.
+ *   }
+ *
+ *   // Writer
+ *   node * old = head.exchange(new_node);
+ *   domain.retire(old);
+ *
+ * Threads register with the domain the first time they enter a critical
+ * section or retire a node. Threads started by twine::thread unregister
+ * automatically when their thread function returns; other threads need to
+ * call unregister_thread() themselves. The domain must outlive all threads
+ * registered with it.
+ *
+ * Retired nodes are collected in a per-thread batch. Once a batch reaches the
+ * domain's batch size, the thread tries to advance the epoch and frees those
+ * nodes of the batch that have become safe to free. Nodes still pending when
+ * a thread unregisters are handed on to the next thread to register, and the
+ * domain frees whatever is left when it is destroyed.
+ *
+ * Critical sections may nest, but must be left on the thread that entered
+ * them, so tasklets must not sleep inside them. Long critical sections stall
+ * reclamation for all threads.
+ **/
+class epoch_domain
+  : public twine::noncopyable
+{
+public:
+  typedef void (*deleter)(void *);
+
+  /**
+   * Enters a critical section on construction and leaves it on destruction.
+   **/
+  class guard
+    : public twine::noncopyable
+  {
+  public:
+    explicit guard(epoch_domain & domain)
+      : m_domain(domain)
+    {
+      m_domain.enter();
+    }
+
+    ~guard()
+    {
+      m_domain.leave();
+    }
+
+  private:
+    epoch_domain & m_domain;
+  };
+
+  explicit epoch_domain(size_t batch_size = 64);
+  ~epoch_domain();
+
+  /**
+   * Enter or leave a critical section; prefer guard.
+   **/
+  void enter();
+  void leave();
+
+  /**
+   * Retire an unlinked node, which is freed by passing it to the given
+   * deleter or, for the template version, deleting it once that is safe.
+   **/
+  void retire(void * ptr, deleter del);
+
+  template <typename T>
+  inline void retire(T * ptr)
+  {
+    retire(ptr, &detail::epoch_delete<T>);
+  }
+
+  /**
+   * Try to advance the epoch, and free what the calling thread retired that
+   * is safe to free by now, regardless of the batch size.
+   **/
+  void collect();
+
+  /**
+   * Register or unregister the calling thread explicitly. Unregistering
+   * while inside a critical section is an error and returns false.
+   **/
+  bool register_thread();
+  bool unregister_thread();
+
+  /**
+   * The current global epoch; mostly for diagnostics.
+   **/
+  uint64_t epoch() const;
+
+private:
+  struct record;
+
+  record * current_record();
+  bool try_advance();
+  void reclaim(record * rec);
+
+  static detail::reclaim_record * create_record();
+  static void release_record(void * domain, detail::reclaim_record * rec);
+
+  // Written whenever the epoch advances; keep it apart from the rest.
+  char                      m_pad0[TWINE_CACHE_LINE_SIZE];
+  twine::atomic<uint64_t>   m_epoch;
+  char                      m_pad1[TWINE_CACHE_LINE_SIZE - sizeof(uint64_t)];
+
+  detail::reclaim_registry  m_registry;
+};
+
+} // namespace twine
+
+#endif // guard
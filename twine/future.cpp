@@ -0,0 +1,200 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+
+#include <twine/detail/future_state.h>
+
+#include <twine/scoped_lock.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+namespace detail {
+
+future_state_base::future_state_base()
+  : m_state(0)
+  , m_refs(1)
+  , m_claimed(0)
+  , m_broken(false)
+  , m_mutex()
+  , m_condition()
+{
+}
+
+
+
+future_state_base::~future_state_base()
+{
+}
+
+
+
+void
+future_state_base::add_ref()
+{
+  m_refs.fetch_add(1, memory_order_relaxed);
+}
+
+
+
+void
+future_state_base::release()
+{
+  if (1 == m_refs.fetch_sub(1, memory_order_acq_rel)) {
+    delete this;
+  }
+}
+
+
+
+bool
+future_state_base::claim()
+{
+  uint32_t expected = 0;
+  return m_claimed.compare_exchange(expected, 1, memory_order_acq_rel);
+}
+
+
+
+bool
+future_state_base::is_ready() const
+{
+  return (m_state.load(memory_order_acquire) & READY);
+}
+
+
+
+bool
+future_state_base::is_broken() const
+{
+  return is_ready() && m_broken;
+}
+
+
+
+void
+future_state_base::wait()
+{
+  if (is_ready()) {
+    return;
+  }
+
+  scoped_lock<mutex> lock(m_mutex);
+  if (!set_waiters()) {
+    return;
+  }
+  while (!is_ready()) {
+    m_condition.wait(lock);
+  }
+}
+
+
+
+bool
+future_state_base::wait_for(chrono::nanoseconds const & timeout)
+{
+  if (is_ready()) {
+    return true;
+  }
+
+  chrono::nanoseconds deadline = chrono::monotonic_now() + timeout;
+
+  scoped_lock<mutex> lock(m_mutex);
+  if (!set_waiters()) {
+    return true;
+  }
+  while (!is_ready()) {
+    if (!m_condition.wait_until(lock, deadline)) {
+      return is_ready();
+    }
+  }
+  return true;
+}
+
+
+
+void
+future_state_base::make_ready(bool broken)
+{
+  m_broken = broken;
+  uintptr_t old = m_state.exchange(READY, memory_order_acq_rel);
+
+  // Waiters set their flag with the mutex held, so taking it here guarantees
+  // they're blocked on the condition by the time we notify.
+  if (old & WAITERS) {
+    scoped_lock<mutex> lock(m_mutex);
+    m_condition.notify_all();
+  }
+
+  // Continuations got stacked; run them in the order they were added.
+  future_continuation * list = reinterpret_cast<future_continuation *>(
+      old & ~uintptr_t(FLAG_MASK));
+  future_continuation * ordered = nullptr;
+  while (list) {
+    future_continuation * next = list->m_next;
+    list->m_next = ordered;
+    ordered = list;
+    list = next;
+  }
+  while (ordered) {
+    future_continuation * next = ordered->m_next;
+    ordered->m_run(ordered);
+    ordered = next;
+  }
+}
+
+
+
+void
+future_state_base::add_continuation(future_continuation * cont)
+{
+  uintptr_t old = m_state.load(memory_order_acquire);
+  do {
+    if (old & READY) {
+      cont->m_run(cont);
+      return;
+    }
+    cont->m_next = reinterpret_cast<future_continuation *>(
+        old & ~uintptr_t(FLAG_MASK));
+  } while (!m_state.compare_exchange(old,
+        reinterpret_cast<uintptr_t>(cont) | (old & FLAG_MASK),
+        memory_order_acq_rel));
+}
+
+
+
+bool
+future_state_base::set_waiters()
+{
+  uintptr_t old = m_state.load(memory_order_acquire);
+  do {
+    if (old & READY) {
+      return false;
+    }
+    if (old & WAITERS) {
+      return true;
+    }
+  } while (!m_state.compare_exchange(old, old | WAITERS,
+        memory_order_acq_rel));
+  return true;
+}
+
+} // namespace detail
+} // namespace twine
@@ -0,0 +1,256 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_FUTURE_H
+#define TWINE_FUTURE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/chrono.h>
+#include <twine/detail/future_state.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+
+/**
+ * Forward declarations
+ **/
+class thread_pool;
+
+template <typename valueT> class future;
+
+namespace detail {
+struct future_access;
+template <typename valueT> class promise_base;
+} // namespace detail
+
+
+/**
+ * Futures and promises
+ *
+ * A promise is the producing end of a one-shot channel for a single value; a
+ * future is the consuming end. Where you'd otherwise share a baton, a mutex
+ * and a condition with a thread just to get a result back, you can hand the
+ * thread a promise instead:
+ *
+ *   void compute(void * baton)
+ *   {
+ *     promise<int> * p = static_cast<promise<int> *>(baton);
+ *     p->set_value(42);
+ *   }
+ *
+ *   promise<int> p;
+ *   future<int> f = p.get_future();
+ *   thread th(compute, &p);
+ *   int result = f.get();
+ *
+ * Futures are cheap, reference counted handles; copies all refer to the same
+ * result. Continuations attached via then() run once the result is available,
+ * either on the thread that provides it or on a thread_pool. Their return
+ * value becomes the result of the future that then() returns.
+ *
+ * Checking or retrieving a result that is already available never takes a
+ * lock. Only consumers that actually block fall back to a condition.
+ *
+ * If a promise is destroyed without a value having been set, its futures
+ * become ready and broken; get() on a broken future throws.
+ *
+ * The value type may be void, for futures that merely signal completion.
+ **/
+template <
+  typename valueT
+>
+class future
+{
+public:
+  /***************************************************************************
+   * Typedefs
+   **/
+  typedef valueT value_type;
+  typedef typename detail::future_state<valueT>::const_reference
+    const_reference;
+
+  /***************************************************************************
+   * Constructor/destructor
+   **/
+  /**
+   * Default constructed futures are not valid(); they're placeholders to
+   * assign to.
+   **/
+  future();
+  future(future const & other);
+  future & operator=(future const & other);
+  ~future();
+
+  /***************************************************************************
+   * Main interface
+   **/
+  /**
+   * Returns true if the future refers to a promise's result.
+   **/
+  bool valid() const;
+
+  /**
+   * Returns true if the result is available, or the promise is broken.
+   **/
+  bool is_ready() const;
+
+  /**
+   * Returns true if the promise was destroyed without setting a value.
+   **/
+  bool is_broken() const;
+
+  /**
+   * Block until the future is ready.
+   **/
+  void wait() const;
+
+  /**
+   * Block until the future is ready or the timeout elapses. Returns true if
+   * the future is ready.
+   **/
+  template <typename durationT>
+  inline bool wait_for(durationT const & timeout) const
+  {
+    if (!m_state) {
+      return false;
+    }
+    return m_state->wait_for(
+        timeout.template convert<twine::chrono::nanoseconds>());
+  }
+
+  /**
+   * Block until the future is ready, and return the result. Throws
+   * std::runtime_error if the future is not valid() or is_broken().
+   **/
+  const_reference get() const;
+
+  /**
+   * Invoke func with this future and the baton once the future is ready,
+   * including when it turns out broken. The continuation runs on the thread
+   * that makes the future ready, or on the calling thread if the future is
+   * ready already. If an executor is given, the continuation gets submitted to
+   * it instead.
+   *
+   * Returns a future for the continuation's return value. Like thread
+   * functions, continuations must not throw.
+   **/
+  template <typename resultT>
+  future<resultT> then(resultT (*func)(future const &, void *),
+      void * baton = nullptr, thread_pool * executor = nullptr) const;
+
+private:
+  friend class detail::promise_base<valueT>;
+  friend struct detail::future_access;
+
+  explicit future(detail::future_state<valueT> * state);
+
+  detail::future_state<valueT> *  m_state;
+};
+
+
+
+namespace detail {
+
+/**
+ * Parts of promise shared by all value types.
+ **/
+template <
+  typename valueT
+>
+class promise_base
+  : public twine::noncopyable
+{
+public:
+  /**
+   * Returns a future for this promise's result. May be called any number of
+   * times.
+   **/
+  future<valueT> get_future() const;
+
+protected:
+  promise_base();
+
+  /**
+   * Breaks the promise if no value has been set.
+   **/
+  ~promise_base();
+
+  detail::future_state<valueT> *  m_state;
+};
+
+} // namespace detail
+
+
+/**
+ * Promise; see future for details.
+ **/
+template <
+  typename valueT
+>
+class promise
+  : public detail::promise_base<valueT>
+{
+public:
+  /**
+   * Set the result and wake up consumers. Returns false if a value has
+   * already been set.
+   **/
+  bool set_value(valueT const & value);
+};
+
+
+template <>
+class promise<void>
+  : public detail::promise_base<void>
+{
+public:
+  bool set_value();
+};
+
+
+
+/**
+ * Returns a future that becomes ready once all futures in the range
+ * [first, last) are ready. The range's futures themselves hold the results.
+ **/
+template <typename iterT>
+future<void> when_all(iterT first, iterT last);
+
+
+/**
+ * Returns a future holding the index of the first future in the range
+ * [first, last) that became ready. For an empty range, the returned future is
+ * broken.
+ **/
+template <typename iterT>
+future<size_t> when_any(iterT first, iterT last);
+
+} // namespace twine
+
+#include <twine/detail/future.tcc>
+
+#endif // guard
@@ -0,0 +1,243 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/hazard_pointer.h>
+
+#include <meta/nullptr.h>
+
+#include <vector>
+#include <algorithm>
+
+namespace twine {
+
+/**
+ * A hazard pointer's storage. Owned by one hazard_pointer at a time; other
+ * threads only read m_ptr when scanning.
+ **/
+struct hazard_domain::slot
+{
+  twine::atomic<void const *> m_ptr;
+  char                        m_pad[TWINE_CACHE_LINE_SIZE - sizeof(void *)];
+
+  twine::atomic<uint32_t>     m_in_use;
+  slot *                      m_next;
+
+  slot()
+    : m_ptr(nullptr)
+    , m_in_use(1)
+    , m_next(nullptr)
+  {
+  }
+};
+
+
+TWINE_ANONS_START
+
+// Keeps the retired nodes that some hazard pointer protects; m_hazards must
+// be sorted.
+struct hazardous
+{
+  std::vector<void const *> const & m_hazards;
+
+  bool operator()(detail::reclaim_record::retired const & r) const
+  {
+    return std::binary_search(m_hazards.begin(), m_hazards.end(),
+        static_cast<void const *>(r.m_ptr));
+  }
+};
+
+TWINE_ANONS_END
+
+
+
+hazard_domain::hazard_domain(size_t scan_threshold /* = 64 */)
+  : m_slots(nullptr)
+  , m_slot_count(0)
+  , m_registry(this, scan_threshold, &hazard_domain::create_record,
+      &hazard_domain::release_record)
+{
+}
+
+
+
+hazard_domain::~hazard_domain()
+{
+  // Drop the calling thread's registration; other threads must have
+  // unregistered already, and no hazard pointers may be left.
+  unregister_thread();
+
+  slot * s = m_slots.load();
+  while (s) {
+    slot * next = s->m_next;
+    delete s;
+    s = next;
+  }
+}
+
+
+
+void
+hazard_domain::retire(void * ptr, deleter del)
+{
+  if (!ptr) {
+    return;
+  }
+  detail::reclaim_record * rec = m_registry.acquire();
+
+  detail::reclaim_record::retired r = { ptr, del, 0 };
+  rec->m_retired.push_back(r);
+
+  if (rec->m_retired.size() >= rec->m_threshold) {
+    scan(rec);
+  }
+}
+
+
+
+void
+hazard_domain::collect()
+{
+  detail::reclaim_record * rec = m_registry.current();
+  if (rec) {
+    scan(rec);
+  }
+}
+
+
+
+size_t
+hazard_domain::pending() const
+{
+  detail::reclaim_record * rec = m_registry.current();
+  if (!rec) {
+    return 0;
+  }
+  return rec->m_retired.size();
+}
+
+
+
+bool
+hazard_domain::unregister_thread()
+{
+  return m_registry.release();
+}
+
+
+
+detail::reclaim_record *
+hazard_domain::create_record()
+{
+  return new detail::reclaim_record();
+}
+
+
+
+void
+hazard_domain::release_record(void * domain, detail::reclaim_record * rec)
+{
+  static_cast<hazard_domain *>(domain)->scan(rec);
+}
+
+
+
+hazard_domain::slot *
+hazard_domain::acquire_slot()
+{
+  slot * s = m_slots.load(memory_order_acquire);
+  for ( ; s ; s = s->m_next) {
+    uint32_t expected = 0;
+    if (!s->m_in_use.load(memory_order_relaxed)
+        && s->m_in_use.compare_exchange(expected, 1))
+    {
+      return s;
+    }
+  }
+
+  s = new slot();
+  slot * head = m_slots.load(memory_order_relaxed);
+  do {
+    s->m_next = head;
+  } while (!m_slots.compare_exchange(head, s));
+  m_slot_count.fetch_add(1, memory_order_relaxed);
+  return s;
+}
+
+
+
+void
+hazard_domain::release_slot(slot * s)
+{
+  s->m_ptr.store(nullptr, memory_order_release);
+  s->m_in_use.store(0, memory_order_release);
+}
+
+
+
+void
+hazard_domain::scan(detail::reclaim_record * rec)
+{
+  if (rec->m_retired.empty()) {
+    return;
+  }
+
+  // Order unlinking the retired nodes before reading the hazard pointers.
+  // Either a reader's hazard is visible here, or the reader sees the node
+  // unlinked when validating its hazard; see hazard_pointer::try_protect().
+  atomic_thread_fence(memory_order_seq_cst);
+
+  std::vector<void const *> hazards;
+  for (slot * s = m_slots.load(memory_order_acquire) ; s ; s = s->m_next) {
+    void const * ptr = s->m_ptr.load(memory_order_acquire);
+    if (ptr) {
+      hazards.push_back(ptr);
+    }
+  }
+  std::sort(hazards.begin(), hazards.end());
+
+  // At most one node per hazard pointer survives a scan, so scanning again
+  // only once at least that many more nodes were retired keeps the cost per
+  // retired node constant, and the list bounded.
+  size_t batch_size = m_slot_count.load(memory_order_relaxed);
+  if (batch_size < m_registry.batch_size()) {
+    batch_size = m_registry.batch_size();
+  }
+
+  TWINE_ANONS(hazardous) keep = { hazards };
+  rec->reclaim(keep, batch_size);
+}
+
+
+
+hazard_pointer::hazard_pointer(hazard_domain & domain)
+  : m_domain(domain)
+  , m_slot(domain.acquire_slot())
+  , m_hazard(&m_slot->m_ptr)
+{
+}
+
+
+
+hazard_pointer::~hazard_pointer()
+{
+  m_domain.release_slot(m_slot);
+}
+
+} // namespace twine
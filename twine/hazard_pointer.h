@@ -0,0 +1,214 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_HAZARD_POINTER_H
+#define TWINE_HAZARD_POINTER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <meta/nullptr.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/detail/reclaim_registry.h>
+
+namespace twine {
+
+namespace detail {
+
+template <typename T>
+void hazard_delete(void * ptr)
+{
+  delete static_cast<T *>(ptr);
+}
+
+} // namespace detail
+
+class hazard_pointer;
+
+/**
+ * Hazard pointer based memory reclamation.
+ *
+ * Like epoch_domain, a hazard_domain defers freeing nodes unlinked from a
+ * lock-free data structure until no reader can hold a reference any longer.
+ * Rather than tracking whole critical sections, readers publish each node
+ * they access in a hazard_pointer:
+ *
+ *   hazard_domain domain;
+ *
+ *   // Reader
+ *   {
+ *     hazard_pointer hp(domain);
+ *     node * n = hp.protect(head);
+ *     // n stays valid until hp is reset or goes out of scope.
+ *   }
+ *
+ *   // Writer
+ *   node * old = head.exchange(new_node);
+ *   domain.retire(old);
+ *
+ * Retired nodes are collected in a per-thread list. Once the list reaches
+ * its threshold, the thread scans all hazard pointers and frees every node
+ * of the list that is not protected. The threshold is the domain's scan
+ * threshold, or the number of hazard pointers if that is larger, on top of
+ * what the previous scan could not free. Since a reader can only protect
+ * as many nodes as it holds hazard pointers, a slow reader never keeps more
+ * than those nodes alive, and each thread's list stays bounded. This makes
+ * hazard pointers the better choice where readers may be descheduled for a
+ * long time; epoch_domain is cheaper for readers otherwise.
+ *
+ * Hazard pointers are not tied to a thread, so tasklets may sleep or
+ * migrate while holding them. Threads started by twine::thread unregister
+ * from the domain when their thread function returns; other threads that
+ * retired nodes need to call unregister_thread() themselves. Nodes still
+ * pending when a thread unregisters are handed on to the next thread to
+ * register, and the domain frees whatever is left when it is destroyed. The
+ * domain must outlive all hazard pointers and threads registered with it.
+ **/
+class hazard_domain
+  : public twine::noncopyable
+{
+public:
+  typedef void (*deleter)(void *);
+
+  explicit hazard_domain(size_t scan_threshold = 64);
+  ~hazard_domain();
+
+  /**
+   * Retire an unlinked node, which is freed by passing it to the given
+   * deleter or, for the template version, deleting it once no hazard pointer
+   * protects it.
+   **/
+  void retire(void * ptr, deleter del);
+
+  template <typename T>
+  inline void retire(T * ptr)
+  {
+    retire(ptr, &detail::hazard_delete<T>);
+  }
+
+  /**
+   * Scan the hazard pointers and free what the calling thread retired that
+   * is no longer protected, regardless of the threshold.
+   **/
+  void collect();
+
+  /**
+   * The number of nodes the calling thread retired that have not been freed
+   * yet.
+   **/
+  size_t pending() const;
+
+  /**
+   * Unregister the calling thread; returns false if it isn't registered.
+   **/
+  bool unregister_thread();
+
+private:
+  friend class hazard_pointer;
+
+  struct slot;
+
+  slot * acquire_slot();
+  void release_slot(slot * s);
+
+  void scan(detail::reclaim_record * rec);
+
+  static detail::reclaim_record * create_record();
+  static void release_record(void * domain, detail::reclaim_record * rec);
+
+  // Slots are never removed before the domain is destroyed, only released
+  // for reuse.
+  twine::atomic<slot *>     m_slots;
+  twine::atomic<size_t>     m_slot_count;
+  detail::reclaim_registry  m_registry;
+};
+
+
+
+/**
+ * A single hazard pointer. Protects at most one node at a time; use one
+ * hazard_pointer for each node that must be protected simultaneously.
+ **/
+class hazard_pointer
+  : public twine::noncopyable
+{
+public:
+  explicit hazard_pointer(hazard_domain & domain);
+  ~hazard_pointer();
+
+  /**
+   * Load the node src points to and protect it. The node remains valid
+   * until the hazard pointer is reset, even if it is unlinked from src and
+   * retired in the meantime.
+   **/
+  template <typename T>
+  inline T * protect(twine::atomic<T *> const & src)
+  {
+    T * ptr = src.load(memory_order_relaxed);
+    while (!try_protect(ptr, src)) {
+    }
+    return ptr;
+  }
+
+  /**
+   * Protect ptr, which was loaded from src. Returns false and updates ptr
+   * to the current value if src changed before the protection took effect.
+   **/
+  template <typename T>
+  inline bool try_protect(T * & ptr, twine::atomic<T *> const & src)
+  {
+    T * expected = ptr;
+    reset(expected);
+
+    // Publish the hazard before checking src; see hazard_domain::scan().
+    atomic_thread_fence(memory_order_seq_cst);
+    ptr = src.load(memory_order_acquire);
+    if (ptr != expected) {
+      reset();
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Protect ptr without validating it, or stop protecting anything. Only
+   * safe when the caller knows ptr can't have been retired yet.
+   **/
+  inline void reset(void const * ptr = nullptr)
+  {
+    // Release, so that all reads through a previous node happen before the
+    // node can be freed.
+    m_hazard->store(ptr, memory_order_release);
+  }
+
+private:
+  hazard_domain &                 m_domain;
+  hazard_domain::slot *           m_slot;
+  twine::atomic<void const *> *   m_hazard;
+};
+
+} // namespace twine
+
+#endif // guard
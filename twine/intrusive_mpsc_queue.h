@@ -0,0 +1,187 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_INTRUSIVE_MPSC_QUEUE_H
+#define TWINE_INTRUSIVE_MPSC_QUEUE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/chrono.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+#include <twine/tasklet.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+
+/**
+ * Hook that values need to carry to be linked into an intrusive_mpsc_queue.
+ * A value can be in at most one queue per hook at a time; its contents are
+ * for the queue's use only.
+ **/
+struct intrusive_mpsc_hook
+{
+  twine::atomic<intrusive_mpsc_hook *> m_next;
+
+  intrusive_mpsc_hook()
+    : m_next(nullptr)
+  {
+  }
+};
+
+
+/**
+ * Unbounded, intrusive multi-producer, single-consumer queue.
+ *
+ * This is Dmitry Vyukov's intrusive MPSC queue. The queue links values via
+ * a hook member, so pushing and popping never allocate:
+ *
+ *   struct event
+ *   {
+ *     int                 type;
+ *     intrusive_mpsc_hook hook;
+ *   };
+ *
+ *   intrusive_mpsc_queue<event, &event::hook> events;
+ *
+ * Pushing is a single atomic exchange, and may be done from any thread.
+ * Popping must only be done by one consumer thread at a time. The queue
+ * never copies or frees values; the consumer owns the values it pops.
+ *
+ * The consumer can wait for values on the queue's condition with pop() and
+ * timed_pop(), or, if it is a tasklet, sleep until values arrive with
+ * wait_readable(). Producers only take the queue's mutex or notify the
+ * tasklet if the consumer is waiting.
+ *
+ * A producer that is preempted between its exchange and linking its value
+ * temporarily hides the values pushed after it from the consumer; try_pop()
+ * may then return nullptr even though the queue isn't empty. Blocking pops
+ * wait until the value is linked.
+ **/
+template <
+  typename valueT,
+  intrusive_mpsc_hook valueT::*hookT
+>
+class intrusive_mpsc_queue
+  : public twine::noncopyable
+{
+public:
+  typedef valueT value_type;
+
+  intrusive_mpsc_queue();
+  ~intrusive_mpsc_queue();
+
+  /**
+   * Producers: push a value.
+   **/
+  void push(valueT * value);
+
+  /**
+   * Consumer: pop the oldest value, or return nullptr if there is none.
+   **/
+  valueT * try_pop();
+
+  /**
+   * Consumer: pop the oldest value, waiting for one if necessary.
+   **/
+  valueT * pop();
+
+  /**
+   * Consumer: as pop(), but give up after the given duration and return
+   * nullptr.
+   **/
+  template <typename durationT>
+  inline valueT * timed_pop(durationT const & duration)
+  {
+    return timed_pop_internal(duration.template convert<chrono::nanoseconds>());
+  }
+
+  /**
+   * Consumer: pop up to max values, oldest first, and pass each to func,
+   * which can be a function or a functor taking a valueT *. Functors are
+   * passed by reference, so they can accumulate state. Returns the number of
+   * values popped.
+   **/
+  template <typename funcT>
+  inline size_t drain(funcT & func, size_t max = ~size_t(0))
+  {
+    size_t count = 0;
+    for ( ; count < max ; ++count) {
+      valueT * value = try_pop();
+      if (!value) {
+        break;
+      }
+      func(value);
+    }
+    return count;
+  }
+
+  /**
+   * Consumer tasklet: sleep until the queue has values to pop. Returns true
+   * once it does, or false if the tasklet was stopped. The queue keeps a
+   * pointer to the tasklet only while it waits, but a producer may still
+   * notify the tasklet just after it stopped waiting, so the tasklet must
+   * outlive all pushes that may race with its last wait.
+   **/
+  bool wait_readable(tasklet & consumer);
+
+  /**
+   * Consumer: true if there is nothing to pop.
+   **/
+  bool empty() const;
+
+private:
+  static valueT * owner(intrusive_mpsc_hook * hook);
+
+  void push_hook(intrusive_mpsc_hook * hook);
+  void notify_consumer();
+  valueT * timed_pop_internal(chrono::nanoseconds const & duration);
+
+  // Producers exchange m_head; the consumer owns m_tail.
+  char                                  m_pad0[TWINE_CACHE_LINE_SIZE];
+  twine::atomic<intrusive_mpsc_hook *>  m_head;
+  char                                  m_pad1[TWINE_CACHE_LINE_SIZE
+                                            - sizeof(intrusive_mpsc_hook *)];
+  intrusive_mpsc_hook *                 m_tail;
+  intrusive_mpsc_hook                   m_stub;
+  char                                  m_pad2[TWINE_CACHE_LINE_SIZE
+                                            - 2 * sizeof(intrusive_mpsc_hook *)];
+
+  // Set while the consumer waits on m_cond or sleeps as a tasklet,
+  // respectively.
+  twine::atomic<uint32_t>               m_waiting;
+  twine::atomic<tasklet *>              m_consumer;
+
+  mutex                                 m_mutex;
+  condition                             m_cond;
+};
+
+} // namespace twine
+
+#include <twine/detail/intrusive_mpsc_queue.tcc>
+
+#endif // guard
@@ -0,0 +1,129 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/latch.h>
+
+#include <twine/scoped_lock.h>
+
+namespace twine {
+
+latch::latch(uint32_t count)
+  : m_count(count)
+  , m_waiters(0)
+  , m_mutex()
+  , m_cond()
+{
+}
+
+
+
+latch::~latch()
+{
+  // Wait for the final count_down() to release the mutex.
+  scoped_lock<mutex> lock(m_mutex);
+}
+
+
+
+void
+latch::count_down(uint32_t amount /* = 1 */)
+{
+  if (!amount) {
+    return;
+  }
+
+  uint32_t count = m_count.load();
+  while (count != amount) {
+    if (m_count.compare_exchange(count, count - amount)) {
+      return;
+    }
+  }
+
+  // We're opening the latch. Do so under the lock, so that no waiter can
+  // return and destroy the latch before we're done with it.
+  scoped_lock<mutex> lock(m_mutex);
+  m_count.fetch_sub(amount);
+  if (m_waiters) {
+    m_cond.notify_all();
+  }
+}
+
+
+
+bool
+latch::try_wait() const
+{
+  return 0 == m_count.load();
+}
+
+
+
+void
+latch::wait()
+{
+  if (try_wait()) {
+    return;
+  }
+
+  scoped_lock<mutex> lock(m_mutex);
+
+  ++m_waiters;
+  while (!try_wait()) {
+    m_cond.wait(lock);
+  }
+  --m_waiters;
+}
+
+
+
+bool
+latch::timed_wait_internal(chrono::nanoseconds const & duration)
+{
+  if (try_wait()) {
+    return true;
+  }
+
+  chrono::nanoseconds deadline = chrono::monotonic_now() + duration;
+
+  scoped_lock<mutex> lock(m_mutex);
+
+  ++m_waiters;
+  bool result = true;
+  while (!try_wait()) {
+    if (!m_cond.wait_until(lock, deadline)) {
+      result = try_wait();
+      break;
+    }
+  }
+  --m_waiters;
+
+  return result;
+}
+
+
+
+void
+latch::arrive_and_wait(uint32_t amount /* = 1 */)
+{
+  count_down(amount);
+  wait();
+}
+
+} // namespace twine
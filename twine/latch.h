@@ -0,0 +1,102 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_LATCH_H
+#define TWINE_LATCH_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/chrono.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+
+namespace twine {
+
+/**
+ * Single use countdown latch.
+ *
+ * Threads wait until the count reaches zero; once it does, the latch stays
+ * open. Counting down is a single atomic operation; only the final count down
+ * takes the internal mutex, and wakes waiting threads with a single
+ * notification.
+ *
+ * A thread returning from wait() may destroy the latch; the destructor waits
+ * for the final count_down() to finish.
+ *
+ * Example:
+ *
+ *   latch ready(workers);
+ *
+ *   void worker()
+ *   {
+ *     initialize();
+ *     ready.count_down();
+ *   }
+ *
+ *   ready.wait(); // all workers are initialized
+ **/
+class latch
+  : public twine::noncopyable
+{
+public:
+  explicit latch(uint32_t count);
+  ~latch();
+
+  // Decrement the count by amount, which must not exceed the current count.
+  void count_down(uint32_t amount = 1);
+
+  // Returns true if the count has reached zero.
+  bool try_wait() const;
+
+  // Wait for the count to reach zero.
+  void wait();
+
+  // Like wait(), but gives up after the given duration. Returns false if the
+  // count did not reach zero in time.
+  template <typename durationT>
+  inline bool timed_wait(durationT const & duration)
+  {
+    return timed_wait_internal(duration.template convert<chrono::nanoseconds>());
+  }
+
+  // Equivalent to count_down(amount) followed by wait().
+  void arrive_and_wait(uint32_t amount = 1);
+
+private:
+  bool timed_wait_internal(chrono::nanoseconds const & duration);
+
+  twine::atomic<uint32_t> m_count;
+
+  // Protected by m_mutex
+  uint32_t                m_waiters;
+
+  mutex                   m_mutex;
+  condition               m_cond;
+};
+
+} // namespace twine
+
+#endif // guard
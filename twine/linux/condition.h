@@ -0,0 +1,125 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_LINUX_CONDITION_H
+#define TWINE_LINUX_CONDITION_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/condition.h>
+
+#include <twine/linux/futex.h>
+
+#include <twine/detail/unwrap_internals.h>
+
+namespace twine {
+
+/**
+ * Waiters sleep on the sequence number they read while still holding the
+ * mutex. A notification that happens after that increments it, so the
+ * futex_wait() call returns immediately instead of missing the wakeup.
+ **/
+condition::condition()
+  : m_handle(0)
+  , m_waiters(0)
+{
+}
+
+
+
+condition::~condition()
+{
+}
+
+
+
+template <typename lockableT>
+void
+condition::wait(lockableT & lockable)
+{
+  typedef detail::unwrap_internals<int32_t volatile, lockableT> unwrap;
+
+  m_waiters.fetch_add(1);
+  int32_t seq = __atomic_load_n(&m_handle, __ATOMIC_RELAXED);
+  unwrap::get_mutex(lockable).unlock();
+  detail::futex_wait(&m_handle, seq);
+  unwrap::get_mutex(lockable).lock();
+  m_waiters.fetch_sub(1);
+}
+
+
+
+template <typename lockableT, typename durationT>
+bool
+condition::timed_wait(lockableT & lockable, durationT const & duration)
+{
+  return wait_until(lockable, chrono::monotonic_now()
+      + duration.template convert<chrono::nanoseconds>());
+}
+
+
+
+template <typename lockableT, typename durationT>
+bool
+condition::wait_until(lockableT & lockable, durationT const & deadline)
+{
+  typedef detail::unwrap_internals<int32_t volatile, lockableT> unwrap;
+
+  ::timespec wakeup;
+  deadline.template convert<chrono::nanoseconds>().as(wakeup);
+
+  m_waiters.fetch_add(1);
+  int32_t seq = __atomic_load_n(&m_handle, __ATOMIC_RELAXED);
+  unwrap::get_mutex(lockable).unlock();
+  int ret = detail::futex_wait_until(&m_handle, seq, wakeup);
+  unwrap::get_mutex(lockable).lock();
+  m_waiters.fetch_sub(1);
+  return !(ret == ETIMEDOUT);
+}
+
+
+
+void
+condition::notify_one()
+{
+  if (!m_waiters.load()) {
+    return;
+  }
+  __atomic_fetch_add(&m_handle, 1, __ATOMIC_SEQ_CST);
+  detail::futex_wake(&m_handle, 1);
+}
+
+
+
+void
+condition::notify_all()
+{
+  if (!m_waiters.load()) {
+    return;
+  }
+  __atomic_fetch_add(&m_handle, 1, __ATOMIC_SEQ_CST);
+  detail::futex_wake_all(&m_handle);
+}
+
+}
+
+#endif // guard
@@ -0,0 +1,107 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_LINUX_FUTEX_H
+#define TWINE_LINUX_FUTEX_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+
+#include <meta/nullptr.h>
+
+/**
+ * Number of times a contended lock spins before it sleeps in the kernel.
+ **/
+#if !defined(TWINE_FUTEX_SPIN_LIMIT)
+#  define TWINE_FUTEX_SPIN_LIMIT 100
+#endif
+
+namespace twine {
+namespace detail {
+
+/**
+ * Thin wrappers around the futex system call. Both only operate on futexes
+ * private to this process, which lets the kernel skip the shared mapping
+ * lookup.
+ *
+ * futex_wait() sleeps while *word == expected, and returns 0 when woken up
+ * or errno otherwise; that is EAGAIN if the word did not hold the expected
+ * value, ETIMEDOUT if the relative timeout expired, and EINTR if a signal
+ * interrupted the sleep.
+ *
+ * futex_wait_until() does the same, but with an absolute deadline measured
+ * against CLOCK_MONOTONIC, i.e. chrono::monotonic_now().
+ *
+ * futex_wake() wakes up to count waiters.
+ **/
+inline int
+futex_wait(int32_t volatile * word, int32_t expected,
+    ::timespec const * timeout = nullptr)
+{
+  if (0 == ::syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, timeout,
+        nullptr, 0))
+  {
+    return 0;
+  }
+  return errno;
+}
+
+
+
+inline int
+futex_wait_until(int32_t volatile * word, int32_t expected,
+    ::timespec const & deadline)
+{
+  if (0 == ::syscall(SYS_futex, word, FUTEX_WAIT_BITSET_PRIVATE, expected,
+        &deadline, nullptr, FUTEX_BITSET_MATCH_ANY))
+  {
+    return 0;
+  }
+  return errno;
+}
+
+
+
+inline void
+futex_wake(int32_t volatile * word, int32_t count)
+{
+  ::syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+
+
+inline void
+futex_wake_all(int32_t volatile * word)
+{
+  futex_wake(word, INT_MAX);
+}
+
+}} // namespace twine::detail
+
+#endif // guard
@@ -0,0 +1,158 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_LINUX_MUTEX_H
+#define TWINE_LINUX_MUTEX_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/atomic.h>
+#include <twine/linux/futex.h>
+
+
+namespace twine {
+
+/**
+ * The lock word follows the classic three state futex mutex: 0 is unlocked,
+ * 1 is locked, 2 is locked and other threads may be sleeping on the word.
+ * Only unlocking a mutex in state 2 requires a system call.
+ **/
+template <
+  typename recursion_policyT
+>
+mutex_base<recursion_policyT>::mutex_base()
+  : recursion_policyT()
+  , m_handle(0)
+{
+}
+
+
+
+template <
+  typename recursion_policyT
+>
+mutex_base<recursion_policyT>::~mutex_base()
+{
+}
+
+
+
+template <
+  typename recursion_policyT
+>
+void
+mutex_base<recursion_policyT>::lock()
+{
+  if (recursion_policyT::reenter()) {
+    return;
+  }
+
+  int32_t state = 0;
+  if (!__atomic_compare_exchange_n(&m_handle, &state, 1, false,
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+  {
+    lock_contended(state);
+  }
+
+  recursion_policyT::acquired();
+}
+
+
+
+template <
+  typename recursion_policyT
+>
+bool
+mutex_base<recursion_policyT>::try_lock()
+{
+  if (recursion_policyT::reenter()) {
+    return true;
+  }
+
+  int32_t state = 0;
+  if (!__atomic_compare_exchange_n(&m_handle, &state, 1, false,
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+  {
+    return false;
+  }
+
+  recursion_policyT::acquired();
+  return true;
+}
+
+
+
+template <
+  typename recursion_policyT
+>
+void
+mutex_base<recursion_policyT>::unlock()
+{
+  if (!recursion_policyT::release()) {
+    return;
+  }
+
+  if (1 != __atomic_fetch_sub(&m_handle, 1, __ATOMIC_RELEASE)) {
+    __atomic_store_n(&m_handle, 0, __ATOMIC_RELEASE);
+    detail::futex_wake(&m_handle, 1);
+  }
+}
+
+
+
+template <
+  typename recursion_policyT
+>
+void
+mutex_base<recursion_policyT>::lock_contended(int32_t state)
+{
+  // While the lock is held but nobody sleeps on it yet, the owner is likely
+  // running and about to release it, so spin for a bounded while. Once there
+  // are sleepers, spinning is unlikely to win against them - go straight to
+  // the kernel.
+  for (unsigned int i = 0 ; 1 == state && i < TWINE_FUTEX_SPIN_LIMIT ; ++i) {
+    detail::cpu_relax();
+    state = __atomic_load_n(&m_handle, __ATOMIC_RELAXED);
+    if (0 == state && __atomic_compare_exchange_n(&m_handle, &state, 1, false,
+          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+      return;
+    }
+  }
+
+  // Mark the lock as contended, and sleep until we find it released. Since
+  // we can't tell whether we were the last sleeper, we always take the lock in
+  // the contended state.
+  if (2 != state) {
+    state = __atomic_exchange_n(&m_handle, 2, __ATOMIC_ACQUIRE);
+  }
+  while (0 != state) {
+    detail::futex_wait(&m_handle, 2);
+    state = __atomic_exchange_n(&m_handle, 2, __ATOMIC_ACQUIRE);
+  }
+}
+
+} // namespace twine
+
+#endif // guard
@@ -0,0 +1,109 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_LINUX_MUTEX_POLICY_H
+#define TWINE_LINUX_MUTEX_POLICY_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+
+namespace twine {
+namespace detail {
+
+/**
+ * Policy for regular mutexes; there is no state to keep, so the mutex stays
+ * the size of its futex word.
+ **/
+struct nonrecursive_policy
+{
+  // Called before acquiring the lock word. Returns true if the calling thread
+  // already owns the mutex, and the lock word must not be touched.
+  inline bool reenter()
+  {
+    return false;
+  }
+
+  // Called after the lock word was acquired.
+  inline void acquired()
+  {
+  }
+
+  // Called before releasing the lock word. Returns true if the lock word must
+  // be released.
+  inline bool release()
+  {
+    return true;
+  }
+};
+
+
+
+/**
+ * Policy for recursive mutexes
+ **/
+struct recursive_policy
+{
+  inline recursive_policy()
+    : m_owner()
+    , m_count(0)
+  {
+  }
+
+  inline bool reenter()
+  {
+    // Other threads may race with the owner's stores here, but they can only
+    // ever read their own ID if they stored it themselves. The count is only
+    // touched by the owner.
+    pthread_t owner = __atomic_load_n(&m_owner, __ATOMIC_RELAXED);
+    if (!pthread_equal(owner, pthread_self())) {
+      return false;
+    }
+    ++m_count;
+    return true;
+  }
+
+  inline void acquired()
+  {
+    __atomic_store_n(&m_owner, pthread_self(), __ATOMIC_RELAXED);
+    m_count = 1;
+  }
+
+  inline bool release()
+  {
+    if (--m_count) {
+      return false;
+    }
+    __atomic_store_n(&m_owner, pthread_t(), __ATOMIC_RELAXED);
+    return true;
+  }
+
+  pthread_t volatile  m_owner;
+  uint32_t            m_count;
+};
+
+
+
+}} // namespace twine::detail
+
+#endif // guard
@@ -0,0 +1,344 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/lock_profiler.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace twine {
+
+lock_stats::lock_stats()
+  : name()
+  , acquisitions(0)
+  , contentions(0)
+  , total_wait(0)
+  , max_wait(0)
+  , total_hold(0)
+  , max_hold(0)
+{
+  for (size_t i = 0 ; i < HISTOGRAM_BUCKETS ; ++i) {
+    wait_histogram[i] = 0;
+    hold_histogram[i] = 0;
+  }
+}
+
+
+
+uint64_t
+lock_stats::percentile(uint64_t const (& histogram)[HISTOGRAM_BUCKETS],
+    uint32_t percent)
+{
+  uint64_t total = 0;
+  for (size_t i = 0 ; i < HISTOGRAM_BUCKETS ; ++i) {
+    total += histogram[i];
+  }
+  if (!total) {
+    return 0;
+  }
+
+  // Rank of the sample we're looking for, rounded up.
+  uint64_t rank = (total * percent + 99) / 100;
+  if (!rank) {
+    rank = 1;
+  }
+
+  uint64_t seen = 0;
+  for (size_t i = 0 ; i < HISTOGRAM_BUCKETS ; ++i) {
+    seen += histogram[i];
+    if (seen >= rank) {
+      return (uint64_t(2) << i) - 1;
+    }
+  }
+  return (uint64_t(2) << (HISTOGRAM_BUCKETS - 1)) - 1;
+}
+
+
+
+namespace detail {
+
+/**
+ * All live lock profiles. The registry is created on first use, so that
+ * instrumented mutexes with static storage duration can register themselves
+ * regardless of initialization order.
+ **/
+struct lock_profile_registry
+{
+  mutex           m_mutex;
+  lock_profile *  m_head;
+
+  lock_profile_registry()
+    : m_mutex()
+    , m_head(nullptr)
+  {
+  }
+
+  static lock_profile_registry & instance()
+  {
+    static lock_profile_registry registry;
+    return registry;
+  }
+
+  void add(lock_profile * profile)
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    profile->m_prev = nullptr;
+    profile->m_next = m_head;
+    if (m_head) {
+      m_head->m_prev = profile;
+    }
+    m_head = profile;
+  }
+
+  void remove(lock_profile * profile)
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    if (profile->m_prev) {
+      profile->m_prev->m_next = profile->m_next;
+    }
+    else {
+      m_head = profile->m_next;
+    }
+    if (profile->m_next) {
+      profile->m_next->m_prev = profile->m_prev;
+    }
+  }
+
+  void collect(std::vector<lock_stats> & result)
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    for (lock_profile * cur = m_head ; cur ; cur = cur->m_next) {
+      result.push_back(lock_stats());
+      cur->snapshot(result.back());
+    }
+  }
+
+  void reset()
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    for (lock_profile * cur = m_head ; cur ; cur = cur->m_next) {
+      cur->reset();
+    }
+  }
+};
+
+
+
+lock_profile::lock_profile(char const * name)
+  : m_name(name ? name : "")
+  , m_acquisitions(0)
+  , m_contentions(0)
+  , m_total_wait(0)
+  , m_max_wait(0)
+  , m_total_hold(0)
+  , m_max_hold(0)
+  , m_prev(nullptr)
+  , m_next(nullptr)
+{
+  lock_profile_registry::instance().add(this);
+}
+
+
+
+lock_profile::~lock_profile()
+{
+  lock_profile_registry::instance().remove(this);
+}
+
+
+
+void
+lock_profile::snapshot(lock_stats & stats) const
+{
+  stats.name = m_name;
+  stats.acquisitions = m_acquisitions.load(memory_order_relaxed);
+  stats.contentions = m_contentions.load(memory_order_relaxed);
+  stats.total_wait = m_total_wait.load(memory_order_relaxed);
+  stats.max_wait = m_max_wait.load(memory_order_relaxed);
+  stats.total_hold = m_total_hold.load(memory_order_relaxed);
+  stats.max_hold = m_max_hold.load(memory_order_relaxed);
+  for (size_t i = 0 ; i < lock_stats::HISTOGRAM_BUCKETS ; ++i) {
+    stats.wait_histogram[i] = m_wait_histogram[i].load(memory_order_relaxed);
+    stats.hold_histogram[i] = m_hold_histogram[i].load(memory_order_relaxed);
+  }
+}
+
+
+
+void
+lock_profile::reset()
+{
+  // Racing with a lock holder may lose an individual sample, but that's
+  // acceptable for statistics.
+  m_acquisitions.store(0, memory_order_relaxed);
+  m_contentions.store(0, memory_order_relaxed);
+  m_total_wait.store(0, memory_order_relaxed);
+  m_max_wait.store(0, memory_order_relaxed);
+  m_total_hold.store(0, memory_order_relaxed);
+  m_max_hold.store(0, memory_order_relaxed);
+  for (size_t i = 0 ; i < lock_stats::HISTOGRAM_BUCKETS ; ++i) {
+    m_wait_histogram[i].store(0, memory_order_relaxed);
+    m_hold_histogram[i].store(0, memory_order_relaxed);
+  }
+}
+
+} // namespace detail
+
+
+
+namespace lock_profiler {
+
+TWINE_ANONS_START
+
+struct rank_compare
+{
+  rank_by m_rank;
+
+  explicit rank_compare(rank_by rank)
+    : m_rank(rank)
+  {
+  }
+
+  uint64_t key(lock_stats const & stats) const
+  {
+    switch (m_rank) {
+      case RANK_BY_CONTENTIONS:
+        return stats.contentions;
+
+      case RANK_BY_HOLD_TIME:
+        return stats.total_hold;
+
+      case RANK_BY_ACQUISITIONS:
+        return stats.acquisitions;
+
+      default:
+        return stats.total_wait;
+    }
+  }
+
+  bool operator()(lock_stats const & first, lock_stats const & second) const
+  {
+    return key(first) > key(second);
+  }
+};
+
+
+
+// Formats nanoseconds with a suitable unit.
+static std::string
+format_time(uint64_t nsec)
+{
+  static char const * const units[] = { "ns", "us", "ms", "s" };
+
+  double value = double(nsec);
+  size_t unit = 0;
+  while (value >= 1000.0 && unit < (sizeof(units) / sizeof(units[0])) - 1) {
+    value /= 1000.0;
+    ++unit;
+  }
+
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(unit ? 1 : 0) << value << units[unit];
+  return os.str();
+}
+
+TWINE_ANONS_END
+
+
+
+bool
+enabled()
+{
+#if defined(TWINE_LOCK_PROFILING)
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+
+void
+collect(std::vector<lock_stats> & result,
+    rank_by rank /* = RANK_BY_WAIT_TIME */)
+{
+  result.clear();
+  detail::lock_profile_registry::instance().collect(result);
+  std::stable_sort(result.begin(), result.end(),
+      TWINE_ANONS(rank_compare)(rank));
+}
+
+
+
+void
+report(std::ostream & os, size_t limit /* = 0 */,
+    rank_by rank /* = RANK_BY_WAIT_TIME */)
+{
+  std::vector<lock_stats> stats;
+  collect(stats, rank);
+  if (limit && stats.size() > limit) {
+    stats.resize(limit);
+  }
+
+  os << std::left
+     << std::setw(4) << "#"
+     << std::setw(24) << "lock"
+     << std::right
+     << std::setw(12) << "acquired"
+     << std::setw(12) << "contended"
+     << std::setw(12) << "wait"
+     << std::setw(10) << "wait p99"
+     << std::setw(10) << "wait max"
+     << std::setw(12) << "hold"
+     << std::setw(10) << "hold p99"
+     << std::setw(10) << "hold max"
+     << std::endl;
+
+  for (size_t i = 0 ; i < stats.size() ; ++i) {
+    lock_stats const & s = stats[i];
+    os << std::left
+       << std::setw(4) << (i + 1)
+       << std::setw(24) << (s.name.empty() ? "(unnamed)" : s.name)
+       << std::right
+       << std::setw(12) << s.acquisitions
+       << std::setw(12) << s.contentions
+       << std::setw(12) << TWINE_ANONS(format_time)(s.total_wait)
+       << std::setw(10) << TWINE_ANONS(format_time)(
+           lock_stats::percentile(s.wait_histogram, 99))
+       << std::setw(10) << TWINE_ANONS(format_time)(s.max_wait)
+       << std::setw(12) << TWINE_ANONS(format_time)(s.total_hold)
+       << std::setw(10) << TWINE_ANONS(format_time)(
+           lock_stats::percentile(s.hold_histogram, 99))
+       << std::setw(10) << TWINE_ANONS(format_time)(s.max_hold)
+       << std::endl;
+  }
+}
+
+
+
+void
+reset()
+{
+  detail::lock_profile_registry::instance().reset();
+}
+
+} // namespace lock_profiler
+} // namespace twine
@@ -0,0 +1,312 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_LOCK_PROFILER_H
+#define TWINE_LOCK_PROFILER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#include <meta/nullptr.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/chrono.h>
+#include <twine/mutex.h>
+#include <twine/scoped_lock.h>
+#include <twine/detail/unwrap_internals.h>
+
+namespace twine {
+
+/**
+ * Snapshot of the statistics gathered for a single instrumented lock.
+ *
+ * Wait times are measured from the first failed attempt to acquire the lock
+ * until it is acquired; uncontended acquisitions don't wait. Hold times are
+ * measured from acquiring the lock until releasing it. All times are in
+ * nanoseconds.
+ *
+ * The histograms have logarithmic buckets: bucket i counts durations in
+ * [2^i, 2^(i+1)) nanoseconds, with the last bucket open ended.
+ **/
+struct lock_stats
+{
+  enum
+  {
+    HISTOGRAM_BUCKETS = 32
+  };
+
+  std::string name;
+
+  uint64_t    acquisitions;
+  uint64_t    contentions;
+
+  uint64_t    total_wait;
+  uint64_t    max_wait;
+  uint64_t    wait_histogram[HISTOGRAM_BUCKETS];
+
+  uint64_t    total_hold;
+  uint64_t    max_hold;
+  uint64_t    hold_histogram[HISTOGRAM_BUCKETS];
+
+  lock_stats();
+
+  // Upper bound of the bucket containing the given percentile (0-100) of the
+  // histogram's samples, or 0 if the histogram is empty.
+  static uint64_t percentile(uint64_t const (& histogram)[HISTOGRAM_BUCKETS],
+      uint32_t percent);
+};
+
+
+namespace detail {
+
+/**
+ * Per-lock profiling record, registered with the lock profiler for the
+ * record's lifetime. The recording functions must only be called while the
+ * lock is held, so they need no read-modify-write operations; the counters are
+ * atomic only so snapshots can read them concurrently.
+ **/
+class lock_profile
+  : public twine::noncopyable
+{
+public:
+  explicit lock_profile(char const * name);
+  ~lock_profile();
+
+  inline void record_acquire(bool contended, uint64_t wait);
+  inline void record_release(uint64_t hold);
+
+  void snapshot(lock_stats & stats) const;
+  void reset();
+
+private:
+  friend struct lock_profile_registry;
+
+  inline static void increment(twine::atomic<uint64_t> & counter,
+      uint64_t amount = 1);
+  inline static void maximize(twine::atomic<uint64_t> & counter,
+      uint64_t value);
+  inline static uint32_t bucket(uint64_t value);
+
+  std::string             m_name;
+
+  twine::atomic<uint64_t> m_acquisitions;
+  twine::atomic<uint64_t> m_contentions;
+
+  twine::atomic<uint64_t> m_total_wait;
+  twine::atomic<uint64_t> m_max_wait;
+  twine::atomic<uint64_t> m_wait_histogram[lock_stats::HISTOGRAM_BUCKETS];
+
+  twine::atomic<uint64_t> m_total_hold;
+  twine::atomic<uint64_t> m_max_hold;
+  twine::atomic<uint64_t> m_hold_histogram[lock_stats::HISTOGRAM_BUCKETS];
+
+  // Registry list, protected by the registry's mutex.
+  lock_profile *          m_prev;
+  lock_profile *          m_next;
+};
+
+} // namespace detail
+
+
+/**
+ * Mutex wrapper that records contention statistics for the lock profiler.
+ *
+ * Wrap any mutex_base with a name, and use it wherever the wrapped mutex would
+ * be used, including with scoped_lock and condition:
+ *
+ *   instrumented_mutex<mutex> m("routing table");
+ *   scoped_lock<instrumented_mutex<mutex> > lock(m);
+ *
+ * Profiling is compiled in only if the library is built with
+ * TWINE_LOCK_PROFILING. Otherwise instrumented_mutex just forwards to the
+ * wrapped mutex, ignores the name, and is the same size.
+ *
+ * Waiting on a condition ends the hold, and waking up counts as a new,
+ * uncontended acquisition.
+ **/
+template <
+  typename mutexT
+>
+class instrumented_mutex
+{
+public:
+  typedef mutexT mutex_type;
+
+  explicit instrumented_mutex(char const * name = nullptr);
+  ~instrumented_mutex();
+
+  inline void lock();
+  inline bool try_lock();
+  inline void unlock();
+
+private:
+  template <typename T, typename U>
+  friend struct detail::unwrap_internals;
+  template <typename T>
+  friend struct detail::wait_hooks;
+
+  // A condition is about to release the wrapped mutex, or has reacquired it.
+  inline void before_wait();
+  inline void after_wait();
+
+  // The wrapped mutex makes this class noncopyable; deriving from noncopyable
+  // as well would cost padding.
+  mutexT                m_mutex;
+#if defined(TWINE_LOCK_PROFILING)
+  inline void acquired(bool contended, int64_t start);
+
+  // Recursion depth and acquisition time; only accessed by the owner.
+  uint32_t              m_depth;
+  int64_t               m_acquired;
+  detail::lock_profile  m_profile;
+#endif
+};
+
+
+namespace lock_profiler {
+
+/**
+ * Sort orders for collect() and report().
+ **/
+enum rank_by
+{
+  RANK_BY_WAIT_TIME,
+  RANK_BY_CONTENTIONS,
+  RANK_BY_HOLD_TIME,
+  RANK_BY_ACQUISITIONS
+};
+
+/**
+ * Returns true if the library was built with TWINE_LOCK_PROFILING.
+ **/
+bool enabled();
+
+/**
+ * Retrieve statistics for all live instrumented locks, ranked in descending
+ * order by the given criterion.
+ **/
+void collect(std::vector<lock_stats> & result,
+    rank_by rank = RANK_BY_WAIT_TIME);
+
+/**
+ * Write a human readable report of at most limit locks (0 means all) to the
+ * given stream, ranked like collect().
+ **/
+void report(std::ostream & os, size_t limit = 0,
+    rank_by rank = RANK_BY_WAIT_TIME);
+
+/**
+ * Reset the statistics of all live instrumented locks.
+ **/
+void reset();
+
+} // namespace lock_profiler
+
+
+namespace detail {
+
+/**
+ * Unwrapping instrumented mutexes yields the wrapped mutex's handle, but the
+ * instrumented mutex itself, so that conditions waiting through get_mutex()
+ * keep the statistics accurate.
+ **/
+template <typename handleT, typename mutexT>
+struct unwrap_internals<handleT, instrumented_mutex<mutexT> >
+{
+  typedef instrumented_mutex<mutexT> mutex_type;
+
+  inline static handleT & get_mutex_handle(mutex_type & mutex)
+  {
+    return unwrap_internals<handleT, mutexT>::get_mutex_handle(mutex.m_mutex);
+  }
+
+  inline static mutex_type & get_mutex(mutex_type & mutex)
+  {
+    return mutex;
+  }
+};
+
+template <typename handleT, typename mutexT>
+struct unwrap_internals<handleT, scoped_lock<instrumented_mutex<mutexT> > >
+{
+  typedef instrumented_mutex<mutexT> mutex_type;
+
+  inline static handleT & get_mutex_handle(scoped_lock<mutex_type> & lock)
+  {
+    return unwrap_internals<handleT, mutex_type>::get_mutex_handle(
+        lock.m_mutex);
+  }
+
+  inline static mutex_type & get_mutex(scoped_lock<mutex_type> & lock)
+  {
+    return lock.m_mutex;
+  }
+};
+
+
+/**
+ * Conditions waiting on the wrapped mutex's handle bypass lock() and
+ * unlock(); tell the instrumented mutex about the wait instead.
+ **/
+template <typename mutexT>
+struct wait_hooks<instrumented_mutex<mutexT> >
+{
+  inline static void before_wait(instrumented_mutex<mutexT> & mutex)
+  {
+    mutex.before_wait();
+  }
+
+  inline static void after_wait(instrumented_mutex<mutexT> & mutex)
+  {
+    mutex.after_wait();
+  }
+};
+
+template <typename mutexT>
+struct wait_hooks<scoped_lock<instrumented_mutex<mutexT> > >
+{
+  typedef instrumented_mutex<mutexT> mutex_type;
+
+  inline static void before_wait(scoped_lock<mutex_type> & lock)
+  {
+    wait_hooks<mutex_type>::before_wait(lock.m_mutex);
+  }
+
+  inline static void after_wait(scoped_lock<mutex_type> & lock)
+  {
+    wait_hooks<mutex_type>::after_wait(lock.m_mutex);
+  }
+};
+
+} // namespace detail
+
+} // namespace twine
+
+#include <twine/detail/lock_profiler.tcc>
+
+#endif // guard
@@ -0,0 +1,198 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_MPMC_QUEUE_H
+#define TWINE_MPMC_QUEUE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/chrono.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+
+namespace twine {
+
+/**
+ * Bounded multi-producer, multi-consumer queue.
+ *
+ * This is Dmitry Vyukov's array-based queue: every slot carries a sequence
+ * number that tells producers and consumers whether the slot is theirs to
+ * fill or drain in the current lap around the array. Claiming a slot is a
+ * single compare-and-swap on the producers' or consumers' position, and
+ * producers and consumers never touch the same position, so neither side
+ * takes a lock. Each slot occupies its own cache lines, so threads working
+ * on neighbouring slots don't contend either.
+ *
+ * try_push() and try_pop() never block; they fail if the queue is full or
+ * empty respectively. push() and pop() and their timed variants wait on a
+ * condition - a futex, if twine is built with TWINE_USE_FUTEX - but only
+ * when they have to; as long as nobody waits, no operation takes the mutex.
+ *
+ * The value type must be default constructible and assignable. Popped slots
+ * keep a copy of their previous value until they're pushed to again.
+ *
+ * Example:
+ *
+ *   mpmc_queue<job *> queue(1024);
+ *
+ *   // Producers
+ *   queue.push(new job());
+ *
+ *   // Consumers
+ *   job * j = nullptr;
+ *   while (queue.pop(j)) {
+ *     ...
+ *   }
+ **/
+template <
+  typename valueT
+>
+class mpmc_queue
+  : public twine::noncopyable
+{
+public:
+  typedef valueT value_type;
+
+  /**
+   * The capacity is rounded up to the next power of two, and is at least two.
+   **/
+  explicit mpmc_queue(size_t capacity);
+  ~mpmc_queue();
+
+  /**
+   * Push a value if there is room; returns false if the queue is full.
+   **/
+  bool try_push(valueT const & value);
+
+  /**
+   * Pop the oldest value if there is one; returns false if the queue is empty.
+   **/
+  bool try_pop(valueT & value);
+
+  /**
+   * Push or pop, waiting for room or a value if necessary. These always
+   * return true; the return value exists for symmetry with the other
+   * functions.
+   **/
+  bool push(valueT const & value);
+  bool pop(valueT & value);
+
+  /**
+   * As push() and pop(), but give up after the given duration. Return false
+   * if the queue stayed full or empty respectively.
+   **/
+  template <typename durationT>
+  inline bool timed_push(valueT const & value, durationT const & duration)
+  {
+    return timed_push_internal(value,
+        duration.template convert<chrono::nanoseconds>());
+  }
+
+  template <typename durationT>
+  inline bool timed_pop(valueT & value, durationT const & duration)
+  {
+    return timed_pop_internal(value,
+        duration.template convert<chrono::nanoseconds>());
+  }
+
+  /**
+   * Number of slots in the queue.
+   **/
+  inline size_t capacity() const
+  {
+    return size_t(m_mask + 1);
+  }
+
+  /**
+   * Number of values in the queue. Only a snapshot, useful mostly for
+   * diagnostics.
+   **/
+  size_t size() const;
+
+private:
+  struct slot
+  {
+    twine::atomic<uint64_t> m_sequence;
+    valueT                  m_value;
+  };
+
+  // Slots are padded to a multiple of the cache line size.
+  static size_t const SLOT_SIZE = ((sizeof(slot) + TWINE_CACHE_LINE_SIZE - 1)
+      / TWINE_CACHE_LINE_SIZE) * TWINE_CACHE_LINE_SIZE;
+
+  inline slot & slot_at(uint64_t position) const
+  {
+    return *reinterpret_cast<slot *>(m_slots
+        + SLOT_SIZE * size_t(position & m_mask));
+  }
+
+  bool enqueue(valueT const & value);
+  bool dequeue(valueT & value);
+
+  bool timed_push_internal(valueT const & value,
+      chrono::nanoseconds const & duration);
+  bool timed_pop_internal(valueT & value,
+      chrono::nanoseconds const & duration);
+
+  // Wait for room or a value under the lock; a null deadline means waiting
+  // indefinitely.
+  bool wait_push(valueT const & value, chrono::nanoseconds const * deadline);
+  bool wait_pop(valueT & value, chrono::nanoseconds const * deadline);
+
+  void wake(twine::atomic<uint32_t> & waiters, uint32_t & signals,
+      condition & cond);
+  void unpark(twine::atomic<uint32_t> & waiters, uint32_t & signals);
+
+  // Producers hammer m_tail, consumers m_head; keep them on separate cache
+  // lines, and away from the read-only members.
+  char                    m_pad0[TWINE_CACHE_LINE_SIZE];
+  twine::atomic<uint64_t> m_tail;
+  char                    m_pad1[TWINE_CACHE_LINE_SIZE - sizeof(uint64_t)];
+  twine::atomic<uint64_t> m_head;
+  char                    m_pad2[TWINE_CACHE_LINE_SIZE - sizeof(uint64_t)];
+
+  uint64_t                m_mask;
+  char *                  m_buffer;
+  char *                  m_slots;
+
+  // Number of threads waiting in push() and pop(), respectively, that have
+  // not been signalled yet; and the number of signals not yet consumed by
+  // waking threads. The latter are protected by m_mutex.
+  twine::atomic<uint32_t> m_push_waiters;
+  twine::atomic<uint32_t> m_pop_waiters;
+  uint32_t                m_push_signals;
+  uint32_t                m_pop_signals;
+
+  mutex                   m_mutex;
+  condition               m_not_full;
+  condition               m_not_empty;
+};
+
+} // namespace twine
+
+#include <twine/detail/mpmc_queue.tcc>
+
+#endif // guard
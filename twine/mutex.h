@@ -50,6 +50,10 @@ struct unwrap_internals;
  *
  * There's a variant for recursive and a variant for non-recursive mutexes
  * called recursive_mutex and mutex respectively.
+ *
+ * On Linux, building with TWINE_USE_FUTEX replaces the pthread mutex with a
+ * single futex word. The non-recursive mutex then occupies four bytes, and
+ * locking or unlocking it without contention never enters the kernel.
  **/
 template <
   typename recursion_policyT
@@ -78,6 +82,11 @@ private:
 
 #if defined(TWINE_WIN32)
   CRITICAL_SECTION  m_handle;
+#elif defined(TWINE_USE_FUTEX)
+  inline void lock_contended(int32_t state);
+
+  // 0 is unlocked, 1 is locked, and 2 is locked with possible waiters.
+  int32_t volatile  m_handle;
 #elif defined(TWINE_POSIX)
   pthread_mutex_t   m_handle;
 #endif
@@ -89,6 +98,9 @@ private:
 #if defined(TWINE_WIN32)
   #include <twine/win32/mutex.h>
   #include <twine/win32/mutex_policy.h>
+#elif defined(TWINE_USE_FUTEX)
+  #include <twine/linux/mutex.h>
+  #include <twine/linux/mutex_policy.h>
 #elif defined(TWINE_POSIX)
   #include <twine/posix/mutex.h>
   #include <twine/posix/mutex_policy.h>
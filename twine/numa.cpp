@@ -0,0 +1,158 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/numa.h>
+
+#include <stdio.h>
+
+#include <string>
+#include <sstream>
+
+namespace twine {
+namespace numa {
+
+TWINE_ANONS_START
+
+static char const * const SYSFS_NODE_PATH = "/sys/devices/system/node";
+
+
+// Reads a sysfs list file such as "online" or "nodeN/cpulist".
+static bool
+read_list(std::string const & path, cpu_set & result)
+{
+  FILE * file = ::fopen(path.c_str(), "r");
+  if (!file) {
+    return false;
+  }
+
+  std::string contents;
+  char buf[256];
+  size_t amount = 0;
+  while ((amount = ::fread(buf, 1, sizeof(buf), file)) > 0) {
+    contents.append(buf, amount);
+  }
+  ::fclose(file);
+
+  return result.parse(contents);
+}
+
+TWINE_ANONS_END
+
+
+
+bool
+online_nodes(std::vector<uint32_t> & nodes)
+{
+  // Node lists use the same format as CPU lists.
+  cpu_set online;
+  if (!TWINE_ANONS(read_list)(std::string(TWINE_ANONS(SYSFS_NODE_PATH))
+        + "/online", online))
+  {
+    return false;
+  }
+
+  nodes.clear();
+  for (uint32_t node = 0 ; node < cpu_set::MAX_CPUS ; ++node) {
+    if (online.test(node)) {
+      nodes.push_back(node);
+    }
+  }
+  return !nodes.empty();
+}
+
+
+
+uint32_t
+node_count()
+{
+  std::vector<uint32_t> nodes;
+  if (!online_nodes(nodes)) {
+    return 0;
+  }
+  return uint32_t(nodes.size());
+}
+
+
+
+bool
+node_cpus(uint32_t node, cpu_set & cpus)
+{
+  std::ostringstream path;
+  path << TWINE_ANONS(SYSFS_NODE_PATH) << "/node" << node << "/cpulist";
+  return TWINE_ANONS(read_list)(path.str(), cpus);
+}
+
+
+
+int32_t
+node_of_cpu(uint32_t cpu)
+{
+  std::vector<uint32_t> nodes;
+  if (!online_nodes(nodes)) {
+    return -1;
+  }
+
+  for (size_t i = 0 ; i < nodes.size() ; ++i) {
+    cpu_set cpus;
+    if (node_cpus(nodes[i], cpus) && cpus.test(cpu)) {
+      return int32_t(nodes[i]);
+    }
+  }
+  return -1;
+}
+
+
+
+int32_t
+current_node()
+{
+  int32_t cpu = this_thread::get_cpu();
+  if (cpu < 0) {
+    return -1;
+  }
+  return node_of_cpu(uint32_t(cpu));
+}
+
+
+
+bool
+pin_to_node(thread & th, uint32_t node)
+{
+  cpu_set cpus;
+  if (!node_cpus(node, cpus) || cpus.empty()) {
+    return false;
+  }
+  return th.set_affinity(cpus);
+}
+
+
+
+bool
+pin_this_thread_to_node(uint32_t node)
+{
+  cpu_set cpus;
+  if (!node_cpus(node, cpus) || cpus.empty()) {
+    return false;
+  }
+  return this_thread::set_affinity(cpus);
+}
+
+} // namespace numa
+} // namespace twine
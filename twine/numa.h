@@ -0,0 +1,93 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_NUMA_H
+#define TWINE_NUMA_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <vector>
+
+#include <twine/cpu_set.h>
+#include <twine/thread.h>
+
+namespace twine {
+namespace numa {
+
+/**
+ * NUMA topology helpers
+ *
+ * On multi-socket machines, memory access is cheapest from CPUs on the node
+ * the memory is attached to. Pinning a thread to a node's CPUs keeps it close
+ * to the memory it allocates (first-touch), without tying it to a single CPU.
+ *
+ *   thread th(func, baton, false);
+ *   numa::pin_to_node(th, 1);
+ *   th.start();
+ *
+ * The topology is read from /sys/devices/system/node, so these functions are
+ * only functional on Linux. Elsewhere, they report no nodes and fail.
+ **/
+
+/**
+ * Retrieve the IDs of all online nodes. Node IDs need not be contiguous.
+ * Returns false if the topology cannot be determined.
+ **/
+bool online_nodes(std::vector<uint32_t> & nodes);
+
+/**
+ * Returns the number of online nodes, or 0 if the topology cannot be
+ * determined.
+ **/
+uint32_t node_count();
+
+/**
+ * Retrieve the CPUs belonging to the given node. Returns false if there is no
+ * such node.
+ **/
+bool node_cpus(uint32_t node, cpu_set & cpus);
+
+/**
+ * Returns the node the given CPU belongs to, or -1 if it cannot be
+ * determined.
+ **/
+int32_t node_of_cpu(uint32_t cpu);
+
+/**
+ * Returns the node of the CPU the calling thread runs on, or -1 if it cannot
+ * be determined.
+ **/
+int32_t current_node();
+
+/**
+ * Restrict a thread, or the calling thread, to the CPUs of the given node.
+ * See thread::set_affinity() for details.
+ **/
+bool pin_to_node(thread & th, uint32_t node);
+bool pin_this_thread_to_node(uint32_t node);
+
+} // namespace numa
+} // namespace twine
+
+#endif // guard
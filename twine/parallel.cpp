@@ -0,0 +1,194 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/parallel.h>
+
+#include <algorithm>
+
+#include <twine/mutex.h>
+#include <twine/condition.h>
+#include <twine/scoped_lock.h>
+#include <twine/atomic.h>
+
+namespace twine {
+namespace detail {
+
+TWINE_ANONS_START
+
+// The default pool is created on first use, and intentionally never
+// destroyed; it may still be in use during static destruction.
+static twine::mutex   default_pool_mutex;
+static thread_pool *  default_pool = nullptr;
+
+// Without an explicit grain, aim for this many chunks of the minimum size per
+// worker.
+static size_t const AUTO_GRAIN_CHUNKS = 16;
+
+// How long a waiting thread blocks before checking for work to help with.
+static twine::chrono::microseconds const HELP_INTERVAL(500);
+
+
+/**
+ * State shared between the calling thread and the helper jobs for a single
+ * parallel_run().
+ **/
+struct run_state
+{
+  parallel_chunk_function m_func;
+  void *                  m_baton;
+  size_t                  m_chunks;
+  twine::atomic<uint64_t> m_next;
+
+  twine::mutex            m_mutex;
+  twine::condition        m_condition;
+  size_t                  m_helpers;  // Guarded by m_mutex
+
+  run_state(parallel_chunk_function func, void * baton, size_t chunks)
+    : m_func(func)
+    , m_baton(baton)
+    , m_chunks(chunks)
+    , m_next(0)
+    , m_mutex()
+    , m_condition()
+    , m_helpers(0)
+  {
+  }
+
+  void work()
+  {
+    while (true) {
+      size_t chunk = size_t(m_next.fetch_add(1, memory_order_relaxed));
+      if (chunk >= m_chunks) {
+        return;
+      }
+      m_func(m_baton, chunk);
+    }
+  }
+
+  static void helper(void * baton)
+  {
+    run_state * state = static_cast<run_state *>(baton);
+    state->work();
+
+    // The caller may return as soon as it sees no helpers, so this must be
+    // the last access to the state.
+    scoped_lock<mutex> lock(state->m_mutex);
+    if (0 == --state->m_helpers) {
+      state->m_condition.notify_all();
+    }
+  }
+};
+
+TWINE_ANONS_END
+
+
+
+thread_pool &
+default_parallel_pool()
+{
+  scoped_lock<mutex> lock(TWINE_ANONS(default_pool_mutex));
+  if (!TWINE_ANONS(default_pool)) {
+    TWINE_ANONS(default_pool) = new thread_pool();
+  }
+  return *TWINE_ANONS(default_pool);
+}
+
+
+
+void
+parallel_partition(std::vector<size_t> & boundaries, size_t size,
+    size_t grain, uint32_t workers)
+{
+  // The calling thread works, too.
+  size_t threads = size_t(workers) + 1;
+  if (!grain) {
+    grain = std::max(size_t(1),
+        size / (threads * TWINE_ANONS(AUTO_GRAIN_CHUNKS)));
+  }
+
+  // Guided partitioning: each chunk takes a share of what remains, so chunks
+  // shrink towards the end of the range, but never below the grain.
+  boundaries.clear();
+  boundaries.push_back(0);
+  size_t offset = 0;
+  while (offset < size) {
+    size_t remaining = size - offset;
+    size_t chunk = std::max(grain, remaining / (2 * threads));
+    offset += std::min(chunk, remaining);
+    boundaries.push_back(offset);
+  }
+}
+
+
+
+void
+parallel_run(thread_pool & pool, size_t chunks, parallel_chunk_function func,
+    void * baton)
+{
+  if (!chunks) {
+    return;
+  }
+  if (1 == chunks) {
+    func(baton, 0);
+    return;
+  }
+
+  TWINE_ANONS(run_state) state(func, baton, chunks);
+
+  // Helpers beyond the number of workers or chunks would only find nothing
+  // left to do.
+  size_t helpers = std::min(size_t(pool.size()), chunks - 1);
+  for (size_t i = 0 ; i < helpers ; ++i) {
+    {
+      scoped_lock<mutex> lock(state.m_mutex);
+      ++state.m_helpers;
+    }
+    if (!pool.submit(TWINE_ANONS(run_state)::helper, &state)) {
+      scoped_lock<mutex> lock(state.m_mutex);
+      --state.m_helpers;
+      break;
+    }
+  }
+
+  state.work();
+
+  // Wait for all helpers to finish. Helpers may still sit in a queue, so
+  // rather than only blocking, help the pool run jobs in the meantime.
+  while (true) {
+    {
+      scoped_lock<mutex> lock(state.m_mutex);
+      if (!state.m_helpers) {
+        return;
+      }
+    }
+
+    if (pool.run_one()) {
+      continue;
+    }
+
+    scoped_lock<mutex> lock(state.m_mutex);
+    if (state.m_helpers) {
+      state.m_condition.timed_wait(lock, TWINE_ANONS(HELP_INTERVAL));
+    }
+  }
+}
+
+} // namespace detail
+} // namespace twine
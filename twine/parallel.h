@@ -0,0 +1,130 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_PARALLEL_H
+#define TWINE_PARALLEL_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <iterator>
+
+#include <twine/thread_pool.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+
+/**
+ * Parallel algorithms
+ *
+ * The algorithms below split a range into chunks and process the chunks on a
+ * thread_pool, with the calling thread pitching in. Ranges are given as a
+ * pair of integral indices or random access iterators; anything that supports
+ * subtraction and addition of an offset works.
+ *
+ * Chunk sizes are guided: the first chunks are large, and get smaller
+ * towards the end of the range, so that workers finishing early can balance
+ * the load with small chunks. The grain argument sets the minimum chunk size;
+ * if it is zero, a grain is picked based on the range and pool sizes. Ranges
+ * no larger than a single grain are processed on the calling thread.
+ *
+ * Chunk boundaries depend only on the range size, the grain and the pool
+ * size, never on timing. Partial results are combined in range order, so for
+ * associative operations the results are identical to those of the serial
+ * algorithm.
+ *
+ * If no pool is passed, the algorithms use an internal pool with
+ * thread::hardware_concurrency() workers, created on first use. The
+ * algorithms can be nested, or called from within pool jobs; waiting threads
+ * run other jobs instead of blocking.
+ *
+ * As with thread_pool jobs, the functions passed in must not throw.
+ **/
+
+/**
+ * Invoke func(begin, end) for subranges that together cover [first, last).
+ *
+ *   struct square
+ *   {
+ *     std::vector<int> * v;
+ *     void operator()(size_t begin, size_t end) const
+ *     {
+ *       for (size_t i = begin ; i < end ; ++i) {
+ *         (*v)[i] *= (*v)[i];
+ *       }
+ *     }
+ *   };
+ *
+ *   parallel_for(size_t(0), v.size(), square(&v));
+ **/
+template <typename rangeT, typename funcT>
+void parallel_for(rangeT first, rangeT last, funcT func, size_t grain = 0,
+    thread_pool * pool = nullptr);
+
+
+/**
+ * Reduce [first, last). Each chunk is reduced by chunk(begin, end, identity),
+ * and the chunk results are folded left to right with combine(a, b), starting
+ * with identity. The serial equivalent is chunk(first, last, identity).
+ **/
+template <typename rangeT, typename valueT, typename chunkT,
+         typename combineT>
+valueT parallel_reduce(rangeT first, rangeT last, valueT const & identity,
+    chunkT chunk, combineT combine, size_t grain = 0,
+    thread_pool * pool = nullptr);
+
+
+/**
+ * Inclusive and exclusive scans of the elements in [first, last) with the
+ * binary operation op; the semantics are those of std::partial_sum. The
+ * exclusive scan writes init to the first output, and the result of
+ * combining init with all preceding elements to the following ones. Both
+ * return the end of the output range.
+ *
+ * The input is read twice; the output may be the same as the input.
+ **/
+template <typename inIterT, typename outIterT, typename opT>
+outIterT parallel_inclusive_scan(inIterT first, inIterT last, outIterT out,
+    opT op, size_t grain = 0, thread_pool * pool = nullptr);
+
+template <typename inIterT, typename outIterT, typename valueT, typename opT>
+outIterT parallel_exclusive_scan(inIterT first, inIterT last, outIterT out,
+    valueT const & init, opT op, size_t grain = 0,
+    thread_pool * pool = nullptr);
+
+
+namespace detail {
+
+/**
+ * Returns the internal pool used when no pool is given.
+ **/
+thread_pool & default_parallel_pool();
+
+} // namespace detail
+
+} // namespace twine
+
+#include <twine/detail/parallel.tcc>
+
+#endif // guard
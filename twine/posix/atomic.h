@@ -0,0 +1,229 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_POSIX_ATOMIC_H
+#define TWINE_POSIX_ATOMIC_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/atomic.h>
+
+#if !defined(__GNUC__)
+#  error POSIX atomics require the GCC __atomic builtins (GCC >= 4.7, clang).
+#endif
+
+namespace twine {
+namespace detail {
+
+inline int
+gcc_memory_order(memory_order order)
+{
+  switch (order) {
+    case memory_order_relaxed:
+      return __ATOMIC_RELAXED;
+
+    case memory_order_acquire:
+      return __ATOMIC_ACQUIRE;
+
+    case memory_order_release:
+      return __ATOMIC_RELEASE;
+
+    case memory_order_acq_rel:
+      return __ATOMIC_ACQ_REL;
+
+    default:
+      return __ATOMIC_SEQ_CST;
+  }
+}
+
+
+
+// Loads may not use release semantics, stores may not use acquire semantics.
+inline int
+gcc_load_order(memory_order order)
+{
+  if (memory_order_release == order) {
+    return __ATOMIC_RELAXED;
+  }
+  if (memory_order_acq_rel == order) {
+    return __ATOMIC_ACQUIRE;
+  }
+  return gcc_memory_order(order);
+}
+
+
+
+inline int
+gcc_store_order(memory_order order)
+{
+  if (memory_order_acquire == order) {
+    return __ATOMIC_RELAXED;
+  }
+  if (memory_order_acq_rel == order) {
+    return __ATOMIC_RELEASE;
+  }
+  return gcc_memory_order(order);
+}
+
+
+
+// The failure order of a compare-and-swap may not be stronger than the
+// success order, and may not contain release semantics.
+inline int
+gcc_failure_order(memory_order order)
+{
+  return gcc_load_order(order);
+}
+
+
+
+void
+cpu_relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield" ::: "memory");
+#else
+  __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+} // namespace detail
+
+
+
+template <
+  typename valueT
+>
+atomic<valueT>::atomic(valueT const & value /* = valueT() */)
+  : m_value(value)
+{
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::load(memory_order order /* = memory_order_seq_cst */) const
+{
+  return __atomic_load_n(&m_value, detail::gcc_load_order(order));
+}
+
+
+
+template <
+  typename valueT
+>
+void
+atomic<valueT>::store(valueT value,
+    memory_order order /* = memory_order_seq_cst */)
+{
+  __atomic_store_n(&m_value, value, detail::gcc_store_order(order));
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::exchange(valueT value,
+    memory_order order /* = memory_order_seq_cst */)
+{
+  return __atomic_exchange_n(&m_value, value, detail::gcc_memory_order(order));
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::fetch_add(valueT value,
+    memory_order order /* = memory_order_seq_cst */)
+{
+  return __atomic_fetch_add(&m_value, value, detail::gcc_memory_order(order));
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::fetch_sub(valueT value,
+    memory_order order /* = memory_order_seq_cst */)
+{
+  return __atomic_fetch_sub(&m_value, value, detail::gcc_memory_order(order));
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::fetch_or(valueT value,
+    memory_order order /* = memory_order_seq_cst */)
+{
+  return __atomic_fetch_or(&m_value, value, detail::gcc_memory_order(order));
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::fetch_and(valueT value,
+    memory_order order /* = memory_order_seq_cst */)
+{
+  return __atomic_fetch_and(&m_value, value, detail::gcc_memory_order(order));
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+atomic<valueT>::compare_exchange(valueT & expected, valueT desired,
+    memory_order order /* = memory_order_seq_cst */)
+{
+  return __atomic_compare_exchange_n(&m_value, &expected, desired, false,
+      detail::gcc_memory_order(order), detail::gcc_failure_order(order));
+}
+
+
+
+void
+atomic_thread_fence(memory_order order /* = memory_order_seq_cst */)
+{
+  __atomic_thread_fence(detail::gcc_memory_order(order));
+}
+
+} // namespace twine
+
+#endif // guard
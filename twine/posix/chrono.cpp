@@ -19,6 +19,7 @@
  * PARTICULAR PURPOSE.
  **/
 #include <twine/chrono.h>
+#include <twine/tsc_clock.h>
 
 #if defined(TWINE_HAVE_SYS_TIME_H) && defined(TWINE_HAVE_SYS_TYPES_H) && defined(TWINE_HAVE_UNISTD_H)
 #  include <sys/time.h>
@@ -38,11 +39,41 @@
 
 #include <errno.h>
 
+#if defined(TWINE_HAVE_SYS_PRCTL_H)
+#  include <sys/prctl.h>
+#endif
+
+#include <twine/atomic.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#  include <cpuid.h>
+#endif
+
 #include <meta/nullptr.h>
 
 namespace twine {
 namespace chrono {
 
+#if defined(TWINE_HAVE_CLOCK_GETTIME)
+TWINE_ANONS_START
+
+static nanoseconds
+read_clock(clockid_t clock)
+{
+  ::timespec ts;
+  ::clock_gettime(clock, &ts);
+
+  return nanoseconds(
+    (default_repr_t(ts.tv_sec) * 1000000000)
+    + (default_repr_t(ts.tv_nsec))
+  );
+}
+
+TWINE_ANONS_END
+#endif
+
+
+
 nanoseconds now()
 {
 #if defined(TWINE_HAVE_CLOCK_GETTIME)
@@ -70,6 +101,18 @@ nanoseconds now()
 
 
 
+nanoseconds monotonic_now()
+{
+#if defined(TWINE_HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  return TWINE_ANONS(read_clock)(CLOCK_MONOTONIC);
+#else
+  // No monotonic clock available; the best we can do is the system time.
+  return now();
+#endif
+}
+
+
+
 bool
 sleep(nanoseconds const & nsec)
 {
@@ -131,4 +174,239 @@ sleep(nanoseconds const & nsec)
 }
 
 
+
+TWINE_ANONS_START
+
+static int const LATENCY_SAMPLES = 8;
+
+// Kernel wakeup latency without timer slack, in nanoseconds; zero until
+// measured when the library is loaded.
+static twine::atomic<int64_t> wakeup_latency(0);
+
+
+static nanoseconds
+timer_slack()
+{
+#if defined(TWINE_HAVE_SYS_PRCTL_H) && defined(PR_GET_TIMERSLACK)
+  int slack = ::prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+  if (slack > 0) {
+    return nanoseconds(slack);
+  }
+#endif
+  return nanoseconds(0);
+}
+
+
+// Blocks until the deadline on the monotonic clock.
+static bool
+block_until(nanoseconds const & deadline)
+{
+#if defined(TWINE_HAVE_CLOCK_NANOSLEEP) && defined(CLOCK_MONOTONIC) && defined(TIMER_ABSTIME)
+  ::timespec spec;
+  deadline.as(spec);
+
+  while (true) {
+    int ret = ::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &spec,
+        nullptr);
+    if (0 == ret) {
+      return true;
+    }
+    if (EINTR != ret) {
+      return false;
+    }
+  }
+#else
+  nanoseconds remaining = deadline - monotonic_now();
+  if (remaining <= nanoseconds(0)) {
+    return true;
+  }
+  return sleep(remaining);
+#endif
+}
+
+
+static nanoseconds
+measure_wakeup_latency()
+{
+  // Measure with the smallest timer slack possible, because the calling
+  // thread's slack is added separately.
+#if defined(TWINE_HAVE_SYS_PRCTL_H) && defined(PR_SET_TIMERSLACK)
+  int old_slack = ::prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+  ::prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+#endif
+
+  int64_t samples[LATENCY_SAMPLES];
+  for (int i = 0 ; i < LATENCY_SAMPLES ; ++i) {
+    nanoseconds deadline = monotonic_now()
+      + microseconds(20).convert<nanoseconds>();
+    block_until(deadline);
+    int64_t late = (monotonic_now() - deadline).raw();
+
+    // Insertion sort as we go.
+    int j = i;
+    for ( ; j > 0 && samples[j - 1] > late ; --j) {
+      samples[j] = samples[j - 1];
+    }
+    samples[j] = late;
+  }
+
+#if defined(TWINE_HAVE_SYS_PRCTL_H) && defined(PR_SET_TIMERSLACK)
+  if (old_slack > 0) {
+    ::prctl(PR_SET_TIMERSLACK, old_slack, 0, 0, 0);
+  }
+#endif
+
+  // Take the 75th percentile; the maximum tends to be an outlier caused by
+  // preemption, which no amount of spinning would compensate for.
+  int64_t latency = samples[(LATENCY_SAMPLES * 3) / 4];
+  if (latency < 1) {
+    latency = 1;
+  }
+  wakeup_latency.store(latency, memory_order_relaxed);
+  return nanoseconds(latency);
+}
+
+
+/**
+ * Measures the wakeup latency when the library is loaded. Measuring takes
+ * several timed sleeps; a precise sleep whose deadline is already fixed can't
+ * afford to pay for that.
+ **/
+struct latency_measurement
+{
+  latency_measurement()
+  {
+    measure_wakeup_latency();
+  }
+};
+
+static latency_measurement const startup_latency = latency_measurement();
+
+TWINE_ANONS_END
+
+
+
+nanoseconds
+precise_sleep_margin()
+{
+  // Only static initializers in other translation units can run before the
+  // latency is measured; they spin for the maximum rather than measure.
+  nanoseconds const cap = microseconds(TWINE_PRECISE_SLEEP_MAX_SPIN);
+  nanoseconds margin(TWINE_ANONS(wakeup_latency).load(memory_order_relaxed));
+  if (margin.raw() <= 0) {
+    return cap;
+  }
+  margin += TWINE_ANONS(timer_slack)();
+
+  if (margin > cap) {
+    margin = cap;
+  }
+  return margin;
+}
+
+
+
+bool
+precise_sleep_until(nanoseconds const & deadline)
+{
+  nanoseconds const wake = deadline - precise_sleep_margin();
+  if (monotonic_now() < wake && !TWINE_ANONS(block_until)(wake)) {
+    return false;
+  }
+
+  while (monotonic_now() < deadline) {
+    twine::detail::cpu_relax();
+  }
+  return true;
+}
+
+
+
+bool
+precise_sleep(nanoseconds const & nsec)
+{
+  return precise_sleep_until(monotonic_now() + nsec);
+}
+
+
+
+
+system_clock::time_point
+system_clock::now()
+{
+  return time_point(chrono::now());
+}
+
+
+
+steady_clock::time_point
+steady_clock::now()
+{
+  return time_point(monotonic_now());
+}
+
+
+
+coarse_steady_clock::time_point
+coarse_steady_clock::now()
+{
+#if defined(TWINE_HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC_COARSE)
+  return time_point(TWINE_ANONS(read_clock)(CLOCK_MONOTONIC_COARSE));
+#else
+  return time_point(monotonic_now());
+#endif
+}
+
+
+
+thread_cpu_clock::time_point
+thread_cpu_clock::now()
+{
+#if defined(TWINE_HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+  return time_point(TWINE_ANONS(read_clock)(CLOCK_THREAD_CPUTIME_ID));
+#else
+  // Per-thread accounting is not available; the process' CPU time is the
+  // closest approximation.
+  return time_point(process_cpu_clock::now().time_since_epoch());
+#endif
+}
+
+
+
+process_cpu_clock::time_point
+process_cpu_clock::now()
+{
+#if defined(TWINE_HAVE_CLOCK_GETTIME) && defined(CLOCK_PROCESS_CPUTIME_ID)
+  return time_point(TWINE_ANONS(read_clock)(CLOCK_PROCESS_CPUTIME_ID));
+#else
+  return time_point(nanoseconds(
+        (default_repr_t(::clock()) * 1000000000) / CLOCKS_PER_SEC));
+#endif
+}
+
+
+
+namespace detail {
+
+bool
+tsc_invariant()
+{
+#if defined(__i386__) || defined(__x86_64__)
+  // The "invariant TSC" bit of the advanced power management leaf.
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (edx & (1 << 8)) != 0;
+#elif defined(__aarch64__)
+  // The generic timer's virtual counter ticks at a fixed frequency by
+  // definition.
+  return true;
+#else
+  return false;
+#endif
+}
+
+} // namespace detail
+
 }} // namespace twine::chrono
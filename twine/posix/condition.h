@@ -39,13 +39,24 @@
 
 #include <twine/detail/unwrap_internals.h>
 
+// Deadlines are measured against the monotonic clock. If the condition can be
+// told to use that clock, timed waits are immune to system time changes;
+// otherwise deadlines need translating to the system clock.
+#if defined(TWINE_HAVE_PTHREAD_CONDATTR_SETCLOCK) && defined(CLOCK_MONOTONIC)
+#  define TWINE_POSIX_CONDITION_MONOTONIC 1
+#endif
+
 namespace twine {
 
 condition::condition()
   : m_handle()
+  , m_waiters(0)
 {
   pthread_condattr_t attr;
   pthread_condattr_init(&attr);
+#if defined(TWINE_POSIX_CONDITION_MONOTONIC)
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
   pthread_cond_init(&m_handle, &attr);
   pthread_condattr_destroy(&attr);
 }
@@ -63,8 +74,12 @@ template <typename lockableT>
 void
 condition::wait(lockableT & lockable)
 {
+  m_waiters.fetch_add(1);
+  detail::wait_hooks<lockableT>::before_wait(lockable);
   pthread_cond_wait(&m_handle,
       &detail::unwrap_internals<pthread_mutex_t, lockableT>::get_mutex_handle(lockable));
+  detail::wait_hooks<lockableT>::after_wait(lockable);
+  m_waiters.fetch_sub(1);
 }
 
 
@@ -73,15 +88,31 @@ template <typename lockableT, typename durationT>
 bool
 condition::timed_wait(lockableT & lockable, durationT const & duration)
 {
-  chrono::nanoseconds delay = duration.template convert<chrono::nanoseconds>();
-  delay += chrono::now();
+  return wait_until(lockable, chrono::monotonic_now()
+      + duration.template convert<chrono::nanoseconds>());
+}
+
+
+
+template <typename lockableT, typename durationT>
+bool
+condition::wait_until(lockableT & lockable, durationT const & deadline)
+{
+  chrono::nanoseconds abs = deadline.template convert<chrono::nanoseconds>();
+#if !defined(TWINE_POSIX_CONDITION_MONOTONIC)
+  abs += chrono::now() - chrono::monotonic_now();
+#endif
 
   ::timespec wakeup;
-  delay.as(wakeup);
+  abs.as(wakeup);
 
+  m_waiters.fetch_add(1);
+  detail::wait_hooks<lockableT>::before_wait(lockable);
   int ret = pthread_cond_timedwait(&m_handle,
       &detail::unwrap_internals<pthread_mutex_t, lockableT>::get_mutex_handle(lockable),
       &wakeup);
+  detail::wait_hooks<lockableT>::after_wait(lockable);
+  m_waiters.fetch_sub(1);
   return !(ret == ETIMEDOUT);
 }
 
@@ -90,7 +121,9 @@ condition::timed_wait(lockableT & lockable, durationT const & duration)
 void
 condition::notify_one()
 {
-  pthread_cond_signal(&m_handle);
+  if (m_waiters.load()) {
+    pthread_cond_signal(&m_handle);
+  }
 }
 
 
@@ -98,7 +131,9 @@ condition::notify_one()
 void
 condition::notify_all()
 {
-  pthread_cond_broadcast(&m_handle);
+  if (m_waiters.load()) {
+    pthread_cond_broadcast(&m_handle);
+  }
 }
 
 }
@@ -0,0 +1,210 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/detail/fiber.h>
+
+// Without ucontext, fibers can't be created, and tasklets fail to start on a
+// tasklet_scheduler; the rest of the library is unaffected.
+#if defined(TWINE_HAVE_UCONTEXT_H) && defined(TWINE_HAVE_MAKECONTEXT)
+#  define TWINE_POSIX_FIBERS 1
+#  include <ucontext.h>
+#endif
+
+#if defined(TWINE_HAVE_SYS_MMAN_H)
+#  include <sys/mman.h>
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <exception>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+namespace detail {
+
+#if defined(TWINE_POSIX_FIBERS)
+
+struct fiber
+{
+  ::ucontext_t    m_context;
+  void *          m_stack;
+  size_t          m_stack_size;
+  fiber_function  m_func;
+  void *          m_arg;
+
+  fiber()
+    : m_context()
+    , m_stack(nullptr)
+    , m_stack_size(0)
+    , m_func(nullptr)
+    , m_arg(nullptr)
+  {
+  }
+};
+
+
+TWINE_ANONS_START
+
+/**
+ * makecontext() only passes int arguments, so the fiber pointer is split into
+ * two halves.
+ **/
+static void fiber_trampoline(unsigned int high, unsigned int low)
+{
+  uintptr_t ptr = (uintptr_t(high) << 16) << 16;
+  ptr |= uintptr_t(low);
+  fiber * f = reinterpret_cast<fiber *>(ptr);
+
+  f->m_func(f->m_arg);
+
+  // Fiber functions must switch away instead of returning.
+  std::terminate();
+}
+
+
+static size_t page_size()
+{
+  long size = ::sysconf(_SC_PAGESIZE);
+  return size > 0 ? size_t(size) : 4096;
+}
+
+TWINE_ANONS_END
+
+
+
+fiber *
+fiber_for_thread()
+{
+  return new fiber();
+}
+
+
+
+fiber *
+fiber_create(size_t stack_size, fiber_function func, void * arg)
+{
+  fiber * f = new fiber();
+  f->m_func = func;
+  f->m_arg = arg;
+
+  // Round up to whole pages, and add a guard page at the low end so that a
+  // stack overflow faults instead of silently corrupting memory.
+  size_t page = TWINE_ANONS(page_size)();
+  stack_size = ((stack_size + page - 1) / page) * page + page;
+
+#if defined(TWINE_HAVE_SYS_MMAN_H)
+  void * stack = ::mmap(nullptr, stack_size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (MAP_FAILED == stack) {
+    delete f;
+    return nullptr;
+  }
+  ::mprotect(stack, page, PROT_NONE);
+#else
+  void * stack = ::malloc(stack_size);
+  if (!stack) {
+    delete f;
+    return nullptr;
+  }
+#endif
+  f->m_stack = stack;
+  f->m_stack_size = stack_size;
+
+  ::getcontext(&f->m_context);
+  f->m_context.uc_stack.ss_sp = f->m_stack;
+  f->m_context.uc_stack.ss_size = f->m_stack_size;
+  f->m_context.uc_link = nullptr;
+
+  uintptr_t ptr = reinterpret_cast<uintptr_t>(f);
+  ::makecontext(&f->m_context,
+      reinterpret_cast<void (*)()>(TWINE_ANONS(fiber_trampoline)), 2,
+      static_cast<unsigned int>((ptr >> 16) >> 16),
+      static_cast<unsigned int>(ptr & 0xffffffffUL));
+
+  return f;
+}
+
+
+
+void
+fiber_switch(fiber * from, fiber * to)
+{
+  ::swapcontext(&from->m_context, &to->m_context);
+}
+
+
+
+void
+fiber_destroy(fiber * f)
+{
+  if (f->m_stack) {
+#if defined(TWINE_HAVE_SYS_MMAN_H)
+    ::munmap(f->m_stack, f->m_stack_size);
+#else
+    ::free(f->m_stack);
+#endif
+  }
+  delete f;
+}
+
+#else // TWINE_POSIX_FIBERS
+
+struct fiber
+{
+};
+
+
+
+fiber *
+fiber_for_thread()
+{
+  return new fiber();
+}
+
+
+
+fiber *
+fiber_create(size_t, fiber_function, void *)
+{
+  return nullptr;
+}
+
+
+
+void
+fiber_switch(fiber *, fiber *)
+{
+  // Unreachable; there are no fibers to switch to.
+  std::terminate();
+}
+
+
+
+void
+fiber_destroy(fiber * f)
+{
+  delete f;
+}
+
+#endif // TWINE_POSIX_FIBERS
+
+}} // namespace twine::detail
@@ -36,6 +36,18 @@
 #include <sys/thr.h>
 #endif
 
+#if defined(TWINE_HAVE_SYS_RESOURCE_H)
+#include <sys/resource.h>
+#endif
+
+#if defined(TWINE_HAVE_SYS_PRCTL_H)
+#include <sys/prctl.h>
+#endif
+
+#include <sched.h>
+#include <limits.h>
+#include <unistd.h>
+
 #include <twine/detail/thread_info.h>
 #include <twine/detail/thread_wrapper.tcc>
 
@@ -82,10 +94,216 @@ thread_detach(pthread_t & handle)
 }
 
 
+TWINE_ANONS_START
+
+// Round stack sizes up to the platform minimum and to whole pages.
+static size_t
+adjust_stack_size(size_t size)
+{
+#if defined(PTHREAD_STACK_MIN)
+  if (size < size_t(PTHREAD_STACK_MIN)) {
+    size = PTHREAD_STACK_MIN;
+  }
+#endif
+
+  long page = ::sysconf(_SC_PAGESIZE);
+  if (page > 0) {
+    size = (size + size_t(page) - 1) / size_t(page) * size_t(page);
+  }
+  return size;
+}
+
+TWINE_ANONS_END
+
+
 int
 thread_create(HANDLE_T & handle, thread::thread_info * info)
 {
-  return ::pthread_create(&handle, nullptr, TWINE_ANONS(thread_wrapper), info);
+  thread::attributes const & attrs = info->m_attributes;
+  if (!attrs.stack() && !attrs.stack_size() && !attrs.has_guard_size()) {
+    return ::pthread_create(&handle, nullptr, TWINE_ANONS(thread_wrapper),
+        info);
+  }
+
+  pthread_attr_t native;
+  int ret = ::pthread_attr_init(&native);
+  if (0 != ret) {
+    return ret;
+  }
+
+  if (attrs.stack()) {
+    ret = ::pthread_attr_setstack(&native, attrs.stack(), attrs.stack_size());
+  }
+  else {
+    if (attrs.stack_size()) {
+      ret = ::pthread_attr_setstacksize(&native,
+          TWINE_ANONS(adjust_stack_size)(attrs.stack_size()));
+    }
+    if (0 == ret && attrs.has_guard_size()) {
+      ret = ::pthread_attr_setguardsize(&native, attrs.guard_size());
+    }
+  }
+
+  if (0 == ret) {
+    ret = ::pthread_create(&handle, &native, TWINE_ANONS(thread_wrapper), info);
+  }
+
+  ::pthread_attr_destroy(&native);
+  return ret;
+}
+
+
+pthread_t
+current_thread_handle()
+{
+  return ::pthread_self();
+}
+
+
+bool
+thread_set_affinity(pthread_t & handle, cpu_set const & cpus)
+{
+#if defined(TWINE_HAVE_PTHREAD_SETAFFINITY_NP)
+  cpu_set_t native;
+  CPU_ZERO(&native);
+  for (uint32_t cpu = 0 ; cpu < cpu_set::MAX_CPUS && cpu < CPU_SETSIZE ; ++cpu) {
+    if (cpus.test(cpu)) {
+      CPU_SET(cpu, &native);
+    }
+  }
+  return (0 == ::pthread_setaffinity_np(handle, sizeof(native), &native));
+#else
+  (void) handle;
+  (void) cpus;
+  return false;
+#endif
+}
+
+
+bool
+thread_get_affinity(pthread_t & handle, cpu_set & cpus)
+{
+#if defined(TWINE_HAVE_PTHREAD_SETAFFINITY_NP)
+  cpu_set_t native;
+  CPU_ZERO(&native);
+  if (0 != ::pthread_getaffinity_np(handle, sizeof(native), &native)) {
+    return false;
+  }
+
+  cpus.reset();
+  for (uint32_t cpu = 0 ; cpu < cpu_set::MAX_CPUS && cpu < CPU_SETSIZE ; ++cpu) {
+    if (CPU_ISSET(cpu, &native)) {
+      cpus.set(cpu);
+    }
+  }
+  return true;
+#else
+  (void) handle;
+  (void) cpus;
+  return false;
+#endif
+}
+
+
+int32_t
+current_cpu()
+{
+#if defined(TWINE_HAVE_SCHED_GETCPU)
+  return ::sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+
+bool
+set_scheduling(thread::scheduling_policy policy, int priority)
+{
+  int native = -1;
+  switch (policy) {
+    case thread::SCHEDULING_DEFAULT:
+    case thread::SCHEDULING_NORMAL:
+      native = SCHED_OTHER;
+      break;
+
+#if defined(SCHED_BATCH)
+    case thread::SCHEDULING_BATCH:
+      native = SCHED_BATCH;
+      break;
+#endif
+
+#if defined(SCHED_IDLE)
+    case thread::SCHEDULING_IDLE:
+      native = SCHED_IDLE;
+      break;
+#endif
+
+    case thread::SCHEDULING_FIFO:
+      native = SCHED_FIFO;
+      break;
+
+    case thread::SCHEDULING_ROUND_ROBIN:
+      native = SCHED_RR;
+      break;
+
+    default:
+      return false;
+  }
+
+  ::sched_param param;
+  param.sched_priority = priority;
+  return (0 == ::pthread_setschedparam(::pthread_self(), native, &param));
+}
+
+
+bool
+set_nice(int nice)
+{
+  // On Linux, nice levels are per thread, so we can address the thread via its
+  // kernel thread ID. Elsewhere, they'd apply to the whole process.
+#if defined(TWINE_HAVE_SYS_RESOURCE_H) && defined(TWINE_HAVE_GETTID)
+  return (0 == ::setpriority(PRIO_PROCESS, id_t(get_thread_id()), nice));
+#else
+  (void) nice;
+  return false;
+#endif
+}
+
+
+
+bool
+set_timer_slack(chrono::nanoseconds const & slack)
+{
+#if defined(TWINE_HAVE_SYS_PRCTL_H) && defined(PR_SET_TIMERSLACK)
+  // A slack of zero would reset the thread to the process default; the
+  // smallest possible slack is one nanosecond.
+  unsigned long value = 1;
+  if (slack > chrono::nanoseconds(1)) {
+    value = static_cast<unsigned long>(slack.raw());
+  }
+  return (0 == ::prctl(PR_SET_TIMERSLACK, value, 0, 0, 0));
+#else
+  (void) slack;
+  return false;
+#endif
+}
+
+
+
+bool
+get_timer_slack(chrono::nanoseconds & slack)
+{
+#if defined(TWINE_HAVE_SYS_PRCTL_H) && defined(PR_GET_TIMERSLACK)
+  int value = ::prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+  if (value < 0) {
+    return false;
+  }
+  slack = chrono::nanoseconds(value);
+  return true;
+#else
+  (void) slack;
+  return false;
+#endif
 }
 
 
@@ -0,0 +1,188 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/detail/reclaim_registry.h>
+
+#include <twine/thread.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+namespace detail {
+
+/**
+ * The calling thread's registrations with all domains.
+ **/
+struct reclaim_registry::registration
+{
+  reclaim_registry *  m_registry;
+  reclaim_record *    m_record;
+  registration *      m_next;
+};
+
+
+TWINE_ANONS_START
+
+static TWINE_THREAD_LOCAL reclaim_registry::registration * registrations = 0;
+
+// Whether an exit handler for the calling thread has been registered.
+static TWINE_THREAD_LOCAL bool exit_handler_registered = false;
+
+TWINE_ANONS_END
+
+
+
+reclaim_record::reclaim_record()
+  : m_in_use(1)
+  , m_next(nullptr)
+  , m_threshold(0)
+  , m_retired()
+{
+}
+
+
+
+reclaim_record::~reclaim_record()
+{
+}
+
+
+
+reclaim_registry::reclaim_registry(void * domain, size_t batch_size,
+    create_function create, release_function release)
+  : m_domain(domain)
+  , m_batch_size(batch_size ? batch_size : 1)
+  , m_create(create)
+  , m_release(release)
+  , m_records(nullptr)
+{
+}
+
+
+
+reclaim_registry::~reclaim_registry()
+{
+  reclaim_record * rec = m_records.load();
+  while (rec) {
+    for (size_t i = 0 ; i < rec->m_retired.size() ; ++i) {
+      rec->m_retired[i].m_deleter(rec->m_retired[i].m_ptr);
+    }
+    reclaim_record * next = rec->m_next;
+    delete rec;
+    rec = next;
+  }
+}
+
+
+
+reclaim_record *
+reclaim_registry::current() const
+{
+  for (registration * reg = TWINE_ANONS(registrations) ; reg ;
+      reg = reg->m_next)
+  {
+    if (reg->m_registry == this) {
+      return reg->m_record;
+    }
+  }
+  return nullptr;
+}
+
+
+
+reclaim_record *
+reclaim_registry::acquire()
+{
+  reclaim_record * rec = current();
+  if (rec) {
+    return rec;
+  }
+
+  // Reuse a released record, or add a new one.
+  for (rec = m_records.load(memory_order_acquire) ; rec ; rec = rec->m_next) {
+    uint32_t expected = 0;
+    if (!rec->m_in_use.load(memory_order_relaxed)
+        && rec->m_in_use.compare_exchange(expected, 1))
+    {
+      break;
+    }
+  }
+
+  if (!rec) {
+    rec = m_create();
+    reclaim_record * head = m_records.load(memory_order_relaxed);
+    do {
+      rec->m_next = head;
+    } while (!m_records.compare_exchange(head, rec));
+  }
+  rec->m_threshold = rec->m_retired.size() + m_batch_size;
+
+  registration * reg = new registration();
+  reg->m_registry = this;
+  reg->m_record = rec;
+  reg->m_next = TWINE_ANONS(registrations);
+  TWINE_ANONS(registrations) = reg;
+
+  // One handler releases the thread's records in all domains it is still
+  // registered with.
+  if (!TWINE_ANONS(exit_handler_registered)) {
+    TWINE_ANONS(exit_handler_registered) = this_thread::at_exit(
+        &reclaim_registry::thread_exit, nullptr);
+  }
+  return rec;
+}
+
+
+
+bool
+reclaim_registry::release()
+{
+  registration ** prev = &TWINE_ANONS(registrations);
+  while (*prev && (*prev)->m_registry != this) {
+    prev = &(*prev)->m_next;
+  }
+  registration * reg = *prev;
+  if (!reg) {
+    return false;
+  }
+
+  // Let the domain free what it can; the rest goes to the next thread to use
+  // the record.
+  reclaim_record * rec = reg->m_record;
+  m_release(m_domain, rec);
+
+  *prev = reg->m_next;
+  delete reg;
+  rec->m_in_use.store(0, memory_order_release);
+  return true;
+}
+
+
+
+void
+reclaim_registry::thread_exit(void *)
+{
+  while (TWINE_ANONS(registrations)) {
+    TWINE_ANONS(registrations)->m_registry->release();
+  }
+  TWINE_ANONS(exit_handler_registered) = false;
+}
+
+}} // namespace twine::detail
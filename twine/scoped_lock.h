@@ -41,6 +41,9 @@ namespace detail {
 template <typename T, typename U>
 struct unwrap_internals;
 
+template <typename T>
+struct wait_hooks;
+
 } // namespace detail
 
 /**
@@ -93,6 +96,8 @@ public:
 private:
   template <typename T, typename U>
   friend struct detail::unwrap_internals;
+  template <typename T>
+  friend struct detail::wait_hooks;
 
   mutexT & m_mutex;
 };
@@ -0,0 +1,162 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_SCOPED_SHARED_LOCK_H
+#define TWINE_SCOPED_SHARED_LOCK_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <meta/stackonly.h>
+
+#include <twine/shared_mutex.h>
+
+namespace twine {
+
+/**
+ * Scoped shared lock for shared mutexes; the shared counterpart of
+ * scoped_lock.
+ *
+ * Example:
+ * {
+ *   shared_mutex m;
+ *   scoped_shared_lock<shared_mutex> lock(m);
+ * }
+ **/
+template <
+  typename mutexT
+>
+class scoped_shared_lock : public meta::stackonly
+{
+public:
+  scoped_shared_lock(mutexT & mutex)
+    : m_mutex(mutex)
+  {
+    m_mutex.lock_shared();
+  }
+
+  ~scoped_shared_lock()
+  {
+    m_mutex.unlock_shared();
+  }
+
+  inline void lock()
+  {
+    m_mutex.lock_shared();
+  }
+
+  inline bool try_lock()
+  {
+    return m_mutex.try_lock_shared();
+  }
+
+  inline void unlock()
+  {
+    m_mutex.unlock_shared();
+  }
+
+
+private:
+  mutexT & m_mutex;
+};
+
+
+
+/**
+ * Scoped upgradeable lock for shared mutexes. The lock can be upgraded to an
+ * exclusive lock and downgraded back within its scope; it's released in
+ * whichever mode it is in when it goes out of scope.
+ *
+ * Example:
+ * {
+ *   shared_mutex m;
+ *   scoped_upgrade_lock<shared_mutex> lock(m);
+ *   if (needs_update()) {
+ *     lock.upgrade();
+ *     update();
+ *   }
+ * }
+ **/
+template <
+  typename mutexT
+>
+class scoped_upgrade_lock : public meta::stackonly
+{
+public:
+  scoped_upgrade_lock(mutexT & mutex)
+    : m_mutex(mutex)
+    , m_exclusive(false)
+  {
+    m_mutex.lock_upgrade();
+  }
+
+  ~scoped_upgrade_lock()
+  {
+    if (m_exclusive) {
+      m_mutex.unlock();
+    }
+    else {
+      m_mutex.unlock_upgrade();
+    }
+  }
+
+  inline void upgrade()
+  {
+    if (!m_exclusive) {
+      m_mutex.upgrade();
+      m_exclusive = true;
+    }
+  }
+
+  inline bool try_upgrade()
+  {
+    if (!m_exclusive) {
+      m_exclusive = m_mutex.try_upgrade();
+    }
+    return m_exclusive;
+  }
+
+  inline void downgrade()
+  {
+    if (m_exclusive) {
+      m_mutex.downgrade_to_upgrade();
+      m_exclusive = false;
+    }
+  }
+
+  inline bool exclusive() const
+  {
+    return m_exclusive;
+  }
+
+
+private:
+  mutexT &  m_mutex;
+  bool      m_exclusive;
+};
+
+
+} // namespace twine
+
+
+#endif // guard
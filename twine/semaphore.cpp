@@ -0,0 +1,137 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/semaphore.h>
+
+#include <twine/scoped_lock.h>
+
+namespace twine {
+
+semaphore::semaphore(uint32_t initial /* = 0 */)
+  : m_count(initial)
+  , m_waiters(0)
+  , m_mutex()
+  , m_cond()
+{
+}
+
+
+
+semaphore::~semaphore()
+{
+}
+
+
+
+bool
+semaphore::try_acquire()
+{
+  uint32_t count = m_count.load();
+  do {
+    if (!count) {
+      return false;
+    }
+  } while (!m_count.compare_exchange(count, count - 1));
+  return true;
+}
+
+
+
+void
+semaphore::acquire()
+{
+  if (try_acquire()) {
+    return;
+  }
+
+  scoped_lock<mutex> lock(m_mutex);
+
+  // Register before retrying, so that every release from now on notifies us.
+  m_waiters.fetch_add(1);
+  while (!try_acquire()) {
+    m_cond.wait(lock);
+  }
+  m_waiters.fetch_sub(1);
+}
+
+
+
+bool
+semaphore::timed_acquire_internal(chrono::nanoseconds const & duration)
+{
+  if (try_acquire()) {
+    return true;
+  }
+
+  chrono::nanoseconds deadline = chrono::monotonic_now() + duration;
+
+  scoped_lock<mutex> lock(m_mutex);
+
+  m_waiters.fetch_add(1);
+  bool result = true;
+  while (!try_acquire()) {
+    if (!m_cond.wait_until(lock, deadline)) {
+      result = try_acquire();
+      break;
+    }
+  }
+  m_waiters.fetch_sub(1);
+
+  return result;
+}
+
+
+
+void
+semaphore::release(uint32_t amount /* = 1 */)
+{
+  if (!amount) {
+    return;
+  }
+
+  m_count.fetch_add(amount);
+  if (m_waiters.load()) {
+    wake_waiters(amount);
+  }
+}
+
+
+
+uint32_t
+semaphore::count() const
+{
+  return m_count.load(memory_order_relaxed);
+}
+
+
+
+void
+semaphore::wake_waiters(uint32_t amount)
+{
+  scoped_lock<mutex> lock(m_mutex);
+  if (1 == amount) {
+    m_cond.notify_one();
+  }
+  else {
+    m_cond.notify_all();
+  }
+}
+
+} // namespace twine
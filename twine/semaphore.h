@@ -0,0 +1,99 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_SEMAPHORE_H
+#define TWINE_SEMAPHORE_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/chrono.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+
+namespace twine {
+
+/**
+ * Counting semaphore.
+ *
+ * The count lives in an atomic word, so acquiring while the count is positive
+ * and releasing while no thread waits are single atomic operations. Only
+ * threads that find the count exhausted block, on a condition.
+ *
+ * Example:
+ *
+ *   semaphore slots(4);
+ *
+ *   void handle()
+ *   {
+ *     slots.acquire();
+ *     // at most four threads get here at the same time
+ *     slots.release();
+ *   }
+ **/
+class semaphore
+  : public twine::noncopyable
+{
+public:
+  explicit semaphore(uint32_t initial = 0);
+  ~semaphore();
+
+  // Decrement the count, waiting for it to become positive if necessary.
+  void acquire();
+
+  // Decrement the count if it is positive; returns false otherwise.
+  bool try_acquire();
+
+  // Like acquire(), but give up after the given duration. Returns false if the
+  // count could not be decremented in time.
+  template <typename durationT>
+  inline bool timed_acquire(durationT const & duration)
+  {
+    return timed_acquire_internal(
+        duration.template convert<chrono::nanoseconds>());
+  }
+
+  // Increment the count by amount, waking up waiting threads.
+  void release(uint32_t amount = 1);
+
+  // Current count. Only a snapshot, useful mostly for diagnostics.
+  uint32_t count() const;
+
+private:
+  bool timed_acquire_internal(chrono::nanoseconds const & duration);
+  void wake_waiters(uint32_t amount);
+
+  twine::atomic<uint32_t> m_count;
+
+  // Number of threads waiting on m_cond
+  twine::atomic<uint32_t> m_waiters;
+
+  mutex                   m_mutex;
+  condition               m_cond;
+};
+
+} // namespace twine
+
+#endif // guard
@@ -0,0 +1,157 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_SHARED_MUTEX_H
+#define TWINE_SHARED_MUTEX_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+
+namespace twine {
+
+namespace detail {
+
+/**
+ * Preference policies for shared_mutex_base.
+ *
+ * With prefer_writers, a blocked writer stops new shared and upgradeable locks
+ * from being granted, so a steady stream of readers cannot starve writers.
+ * With prefer_readers, shared locks are granted whenever no writer holds the
+ * mutex, which maximizes read throughput at the risk of starving writers.
+ **/
+struct prefer_writers
+{
+  static inline bool writers_block_readers()
+  {
+    return true;
+  }
+};
+
+
+
+struct prefer_readers
+{
+  static inline bool writers_block_readers()
+  {
+    return false;
+  }
+};
+
+} // namespace detail
+
+
+/**
+ * Reader-writer mutex.
+ *
+ * Any number of threads can hold the mutex in shared mode, or a single thread
+ * can hold it exclusively. The exclusive interface is the same as mutex's, so
+ * shared mutexes can be used with scoped_lock; scoped_shared_lock and
+ * scoped_upgrade_lock cover the other modes.
+ *
+ * Additionally, a single thread can hold an upgradeable lock. It coexists with
+ * shared locks, but not with other upgradeable or exclusive locks, and can be
+ * turned into an exclusive lock with upgrade() once the other readers are
+ * gone. Since only one thread may hold an upgradeable lock, two upgrading
+ * threads cannot deadlock each other. An exclusive lock can be turned back
+ * into a shared or upgradeable lock with downgrade() or downgrade_to_upgrade()
+ * without letting writers in between.
+ *
+ * Uncontended locking and unlocking in any mode is a single atomic operation;
+ * only blocked threads use the internal mutex and condition.
+ *
+ * Shared locks are not recursive: with writer preference, a thread that tries
+ * to acquire a second shared lock while a writer waits deadlocks.
+ **/
+template <
+  typename preference_policyT
+>
+class shared_mutex_base
+  : public twine::noncopyable
+  , private preference_policyT
+{
+public:
+  typedef preference_policyT preference_policy_t;
+
+  // Constructor/destructor
+  shared_mutex_base();
+  ~shared_mutex_base();
+
+  // Exclusive locking.
+  inline void lock();
+  inline bool try_lock();
+  inline void unlock();
+
+  // Shared locking.
+  inline void lock_shared();
+  inline bool try_lock_shared();
+  inline void unlock_shared();
+
+  // Upgradeable locking.
+  inline void lock_upgrade();
+  inline bool try_lock_upgrade();
+  inline void unlock_upgrade();
+
+  // Turn an upgradeable lock held by the calling thread into an exclusive
+  // lock. upgrade() waits for the remaining shared locks to be released;
+  // try_upgrade() fails if there are any.
+  inline void upgrade();
+  inline bool try_upgrade();
+
+  // Turn an exclusive lock held by the calling thread into a shared or
+  // upgradeable lock. Neither ever blocks.
+  inline void downgrade();
+  inline void downgrade_to_upgrade();
+
+private:
+  typedef bool (shared_mutex_base::*acquire_func)();
+
+  inline void wait_for(acquire_func acquire, bool writer);
+  inline void wake_waiters();
+
+  // The state word consists of flags for exclusive and upgradeable owners and
+  // waiting writers, and the number of shared owners.
+  twine::atomic<uint32_t> m_state;
+
+  // Number of threads blocked in wait_for()
+  twine::atomic<uint32_t> m_waiters;
+
+  // Protected by m_mutex
+  uint32_t                m_waiting_writers;
+  mutex                   m_mutex;
+  condition               m_cond;
+};
+
+
+typedef shared_mutex_base<detail::prefer_writers> shared_mutex;
+typedef shared_mutex_base<detail::prefer_readers> reader_preferring_shared_mutex;
+
+} // namespace twine
+
+#include <twine/detail/shared_mutex.tcc>
+
+#endif // guard
@@ -0,0 +1,175 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_SPSC_RING_H
+#define TWINE_SPSC_RING_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/tasklet.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+
+/**
+ * Bounded single-producer, single-consumer ring buffer.
+ *
+ * Exactly one thread or tasklet may push, and exactly one may pop. Under that
+ * restriction every operation is wait-free: the producer only writes the
+ * tail index, the consumer only writes the head index, and each keeps a
+ * cached copy of the other's index on its own cache line, so that it only
+ * reads the other side's line when the cached copy says the ring is full or
+ * empty.
+ *
+ * Besides pushing and popping single values, push_n() and pop_n() transfer
+ * batches with a single index update, and reserve() and commit() let the
+ * producer write values directly into the ring's slots.
+ *
+ * A consumer tasklet can sleep until the ring has values with
+ * wait_readable(); the producer then notifies it whenever it publishes values
+ * while the tasklet is waiting:
+ *
+ *   void consume(tasklet & t, void * baton)
+ *   {
+ *     spsc_ring<int> * ring = static_cast<spsc_ring<int> *>(baton);
+ *     int buf[64];
+ *     while (ring->wait_readable(t)) {
+ *       size_t amount = ring->pop_n(buf, 64);
+ *       // Process values
+ *     }
+ *   }
+ *
+ * The value type must be default constructible and assignable. Popped slots
+ * keep a copy of their previous value until they're pushed to again.
+ **/
+template <
+  typename valueT
+>
+class spsc_ring
+  : public twine::noncopyable
+{
+public:
+  typedef valueT value_type;
+
+  /**
+   * The capacity is rounded up to the next power of two, and is at least two.
+   **/
+  explicit spsc_ring(size_t capacity);
+  ~spsc_ring();
+
+  /***************************************************************************
+   * Producer interface
+   **/
+  /**
+   * Push a value if there is room; returns false if the ring is full.
+   **/
+  bool try_push(valueT const & value);
+
+  /**
+   * Push up to count values, as many as there is room for. Returns the number
+   * of values pushed.
+   **/
+  size_t push_n(valueT const * values, size_t count);
+
+  /**
+   * Reserve up to count contiguous slots for writing, and return a pointer to
+   * the first. On return, count holds the number of slots actually reserved,
+   * which may be fewer than requested if the ring is nearly full or the
+   * slots would wrap around its end; if it is zero, nullptr is returned.
+   *
+   * commit() then publishes the first count reserved slots to the consumer.
+   * Until then, reserving again returns the same slots.
+   **/
+  valueT * reserve(size_t & count);
+  void commit(size_t count);
+
+  /***************************************************************************
+   * Consumer interface
+   **/
+  /**
+   * Pop the oldest value if there is one; returns false if the ring is empty.
+   **/
+  bool try_pop(valueT & value);
+
+  /**
+   * Pop up to count values into the given buffer, as many as there are.
+   * Returns the number of values popped.
+   **/
+  size_t pop_n(valueT * values, size_t count);
+
+  /**
+   * Sleep on the consumer tasklet until the ring has values to pop. Returns
+   * true once it does, or false if the tasklet was stopped. The ring keeps a
+   * pointer to the tasklet only while it waits, but the producer may still
+   * notify the tasklet just after it stopped waiting, so the tasklet must
+   * outlive all pushes that may race with its last wait.
+   **/
+  bool wait_readable(tasklet & consumer);
+
+  /***************************************************************************
+   * Either side
+   **/
+  /**
+   * Number of slots in the ring.
+   **/
+  inline size_t capacity() const
+  {
+    return size_t(m_mask + 1);
+  }
+
+  /**
+   * Number of values in the ring. Only a snapshot, useful mostly for
+   * diagnostics.
+   **/
+  size_t size() const;
+
+private:
+  uint64_t free_slots(uint64_t tail, size_t wanted);
+  void notify_consumer();
+
+  // Producer's cache line
+  char                    m_pad0[TWINE_CACHE_LINE_SIZE];
+  twine::atomic<uint64_t> m_tail;
+  uint64_t                m_cached_head;
+  char                    m_pad1[TWINE_CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+
+  // Consumer's cache line
+  twine::atomic<uint64_t> m_head;
+  uint64_t                m_cached_tail;
+  char                    m_pad2[TWINE_CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+
+  // Mostly read-only; the consumer only writes m_consumer when it waits.
+  twine::atomic<tasklet *>  m_consumer;
+  uint64_t                  m_mask;
+  valueT *                  m_slots;
+};
+
+} // namespace twine
+
+#include <twine/detail/spsc_ring.tcc>
+
+#endif // guard
@@ -20,6 +20,7 @@
  **/
 
 #include <twine/tasklet.h>
+#include <twine/atomic.h>
 
 namespace twine {
 
@@ -57,6 +58,17 @@ tasklet::tasklet(twine::condition * condition, twine::recursive_mutex * mutex,
   , m_condition(condition)
   , m_tasklet_mutex(mutex)
   , m_condition_owned(false)
+  , m_scheduler(nullptr)
+  , m_task(nullptr)
+  , m_timer_wheel(nullptr)
+  , m_sleep_timer()
+  , m_period(0)
+  , m_next_deadline(0)
+  , m_overrun_policy(OVERRUN_SKIP)
+  , m_period_stats()
+  , m_mailbox(nullptr)
+  , m_sleeping(0)
+  , m_notified(0)
 {
   thread::set_func(TWINE_ANONS(tasklet_wrapper), m_tasklet_info);
   if (start_now) {
@@ -74,6 +86,17 @@ tasklet::tasklet(tasklet::function func, void * baton /* = nullptr */,
   , m_condition(new twine::condition())
   , m_tasklet_mutex(&m_mutex)
   , m_condition_owned(true)
+  , m_scheduler(nullptr)
+  , m_task(nullptr)
+  , m_timer_wheel(nullptr)
+  , m_sleep_timer()
+  , m_period(0)
+  , m_next_deadline(0)
+  , m_overrun_policy(OVERRUN_SKIP)
+  , m_period_stats()
+  , m_mailbox(nullptr)
+  , m_sleeping(0)
+  , m_notified(0)
 {
   thread::set_func(TWINE_ANONS(tasklet_wrapper), m_tasklet_info);
   if (start_now) {
@@ -83,12 +106,102 @@ tasklet::tasklet(tasklet::function func, void * baton /* = nullptr */,
 
 
 
+tasklet::tasklet(twine::condition * condition, twine::recursive_mutex * mutex,
+    tasklet::function func, void * baton, thread::attributes const & attrs,
+    bool start_now /* = false */)
+  : thread()
+  , m_tasklet_info(new tasklet_info(this, func, baton))
+  , m_running(false)
+  , m_condition(condition)
+  , m_tasklet_mutex(mutex)
+  , m_condition_owned(false)
+  , m_scheduler(nullptr)
+  , m_task(nullptr)
+  , m_timer_wheel(nullptr)
+  , m_sleep_timer()
+  , m_period(0)
+  , m_next_deadline(0)
+  , m_overrun_policy(OVERRUN_SKIP)
+  , m_period_stats()
+  , m_mailbox(nullptr)
+  , m_sleeping(0)
+  , m_notified(0)
+{
+  thread::set_attributes(attrs);
+  thread::set_func(TWINE_ANONS(tasklet_wrapper), m_tasklet_info);
+  if (start_now) {
+    start();
+  }
+}
+
+
+
+tasklet::tasklet(tasklet::function func, void * baton,
+    thread::attributes const & attrs, bool start_now /* = false */)
+  : thread()
+  , m_tasklet_info(new tasklet_info(this, func, baton))
+  , m_running(false)
+  , m_condition(new twine::condition())
+  , m_tasklet_mutex(&m_mutex)
+  , m_condition_owned(true)
+  , m_scheduler(nullptr)
+  , m_task(nullptr)
+  , m_timer_wheel(nullptr)
+  , m_sleep_timer()
+  , m_period(0)
+  , m_next_deadline(0)
+  , m_overrun_policy(OVERRUN_SKIP)
+  , m_period_stats()
+  , m_mailbox(nullptr)
+  , m_sleeping(0)
+  , m_notified(0)
+{
+  thread::set_attributes(attrs);
+  thread::set_func(TWINE_ANONS(tasklet_wrapper), m_tasklet_info);
+  if (start_now) {
+    start();
+  }
+}
+
+
+
+tasklet::tasklet(tasklet_scheduler & scheduler, tasklet::function func,
+    void * baton /* = nullptr */, bool start_now /* = false */)
+  : thread()
+  , m_tasklet_info(new tasklet_info(this, func, baton))
+  , m_running(false)
+  , m_condition(new twine::condition())
+  , m_tasklet_mutex(&m_mutex)
+  , m_condition_owned(true)
+  , m_scheduler(&scheduler)
+  , m_task(scheduler.create_task(*this))
+  , m_timer_wheel(nullptr)
+  , m_sleep_timer()
+  , m_period(0)
+  , m_next_deadline(0)
+  , m_overrun_policy(OVERRUN_SKIP)
+  , m_period_stats()
+  , m_mailbox(nullptr)
+  , m_sleeping(0)
+  , m_notified(0)
+{
+  if (start_now) {
+    start();
+  }
+}
+
+
+
 tasklet::~tasklet()
 {
   stop();
   wait();
   delete m_tasklet_info;
 
+  if (m_task) {
+    m_scheduler->destroy_task(m_task);
+  }
+
   if (m_condition_owned) {
     delete m_condition;
   }
@@ -101,6 +214,18 @@ tasklet::start()
 {
   scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
 
+  if (m_task) {
+    if (m_scheduler->is_active(m_task)) {
+      return false;
+    }
+    m_running = true;
+    if (!m_scheduler->start(m_task)) {
+      m_running = false;
+      return false;
+    }
+    return true;
+  }
+
   if (thread::joinable()) {
     return false;
   }
@@ -117,6 +242,15 @@ tasklet::stop()
 {
   scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
 
+  if (m_task) {
+    if (!m_scheduler->is_active(m_task)) {
+      return false;
+    }
+    m_running = false;
+    m_scheduler->wakeup(m_task);
+    return true;
+  }
+
   if (!thread::joinable()) {
     return false;
   }
@@ -138,6 +272,14 @@ tasklet::stop()
 bool
 tasklet::wait()
 {
+  if (m_task) {
+    scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+    while (m_scheduler->is_active(m_task)) {
+      m_condition->wait(lock);
+    }
+    return true;
+  }
+
   // We ignore if it was joinable or not. That's because in the case of a tasklet,
   // you really want to wait for the tasklet to end.
   thread::join();
@@ -149,6 +291,11 @@ tasklet::wait()
 void
 tasklet::wakeup()
 {
+  if (m_task) {
+    m_scheduler->wakeup(m_task);
+    return;
+  }
+
   if (m_condition_owned) {
     m_condition->notify_one();
   }
@@ -159,25 +306,371 @@ tasklet::wakeup()
 
 
 
+void
+tasklet::notify()
+{
+  m_notified.store(1);
+  if (!m_sleeping.load()) {
+    return;
+  }
+
+  // Taking the lock guarantees the sleeping tasklet is already waiting.
+  scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+  wakeup();
+}
+
+
+
+void
+tasklet::set_timer_wheel(twine::timer_wheel * wheel)
+{
+  scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+  m_timer_wheel = wheel;
+}
+
+
+
 bool
-tasklet::nanosleep(twine::chrono::nanoseconds nsecs) const
+tasklet::nanosleep(twine::chrono::nanoseconds nsecs,
+    twine::chrono::sleep_mode mode /* = SLEEP_DEFAULT */) const
 {
+  if (twine::chrono::SLEEP_PRECISE == mode
+      && nsecs >= twine::chrono::nanoseconds(0))
+  {
+    return nanosleep_until(twine::chrono::monotonic_now() + nsecs, mode);
+  }
+
+  if (m_timer_wheel && m_condition_owned
+      && nsecs >= twine::chrono::nanoseconds(0))
+  {
+    return wheel_sleep(nsecs);
+  }
+
+  if (m_task) {
+    {
+      scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+      if (!m_running) {
+        return false;
+      }
+      if (!enter_sleep()) {
+        return true;
+      }
+      m_scheduler->prepare_sleep(m_task, nsecs);
+    }
+
+    // Give up the worker until woken, stopped or the sleep times out.
+    m_scheduler->suspend(m_task);
+
+    scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+    leave_sleep();
+    return m_running;
+  }
+
   scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
 
   if (!m_running) {
     return false;
   }
+  if (!enter_sleep()) {
+    return true;
+  }
 
   // Negative numbers mean sleep infinitely.
   if (nsecs < twine::chrono::nanoseconds(0)) {
     m_condition->wait(*m_tasklet_mutex);
+  }
+  else {
+    // Sleep for a given time period only.
+    m_condition->timed_wait(*m_tasklet_mutex, twine::chrono::nanoseconds(nsecs));
+  }
+
+  leave_sleep();
+  return m_running;
+}
+
+
+
+bool
+tasklet::nanosleep_until(twine::chrono::nanoseconds deadline,
+    twine::chrono::sleep_mode mode) const
+{
+  // Scheduled tasklets and timer wheel sleeps are driven by relative delays,
+  // and cannot sleep precisely.
+  if (m_task || (m_timer_wheel && m_condition_owned)) {
+    twine::chrono::nanoseconds nsecs = deadline - twine::chrono::monotonic_now();
+    if (nsecs < twine::chrono::nanoseconds(0)) {
+      nsecs = twine::chrono::nanoseconds(0);
+    }
+    return nanosleep(nsecs);
+  }
+
+  // For precise sleeps, wait until shortly before the deadline. Determining
+  // the margin may sleep the first time, so do it before locking.
+  twine::chrono::nanoseconds wake = deadline;
+  if (twine::chrono::SLEEP_PRECISE == mode) {
+    wake -= twine::chrono::precise_sleep_margin();
+  }
+
+  scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+
+  if (!m_running) {
+    return false;
+  }
+  if (!enter_sleep()) {
+    return true;
+  }
+
+  bool woken = m_condition->wait_until(*m_tasklet_mutex, wake);
+  leave_sleep();
+  if (woken || wake == deadline) {
     return m_running;
   }
 
-  // Sleep for a given time period only.
-  m_condition->timed_wait(*m_tasklet_mutex, twine::chrono::nanoseconds(nsecs));
+  // Spin for the remainder without holding the lock, so wakeup() and stop()
+  // don't block; they take effect once the deadline is reached.
+  lock.unlock();
+  while (twine::chrono::monotonic_now() < deadline) {
+    twine::detail::cpu_relax();
+  }
+  lock.lock();
   return m_running;
 }
 
 
+
+bool
+tasklet::wheel_sleep(twine::chrono::nanoseconds nsecs) const
+{
+  bool running = false;
+  {
+    scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+    if (!m_running) {
+      return false;
+    }
+    if (!enter_sleep()) {
+      return true;
+    }
+
+    if (m_task) {
+      // The task must be marked as sleeping before the timer can wake it.
+      m_scheduler->prepare_sleep(m_task, twine::chrono::nanoseconds(-1));
+      m_timer_wheel->schedule_wakeup(m_sleep_timer, nsecs,
+          *const_cast<tasklet *>(this));
+    }
+    else {
+      m_timer_wheel->schedule(m_sleep_timer, nsecs, &tasklet::sleep_timeout,
+          const_cast<tasklet *>(this));
+      m_condition->wait(*m_tasklet_mutex);
+      leave_sleep();
+      running = m_running;
+    }
+  }
+
+  if (m_task) {
+    m_scheduler->suspend(m_task);
+    scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+    leave_sleep();
+    running = m_running;
+  }
+
+  // Cancelling waits for a concurrently running timeout, which needs the
+  // tasklet mutex; it must not be held here.
+  m_timer_wheel->cancel(m_sleep_timer);
+  return running;
+}
+
+
+
+void
+tasklet::set_period_internal(twine::chrono::nanoseconds period,
+    overrun_policy policy)
+{
+  scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+  m_period = period;
+  m_next_deadline = twine::chrono::nanoseconds(0);
+  m_overrun_policy = policy;
+  m_period_stats = period_statistics();
+}
+
+
+
+bool
+tasklet::sleep_until_next_period(
+    twine::chrono::sleep_mode mode /* = SLEEP_DEFAULT */)
+{
+  twine::chrono::nanoseconds const zero(0);
+  twine::chrono::nanoseconds deadline(-1);
+  {
+    scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+    if (m_period > zero) {
+      twine::chrono::nanoseconds now = twine::chrono::monotonic_now();
+      if (m_next_deadline == zero) {
+        m_next_deadline = now + m_period;
+      }
+      else if (now >= m_next_deadline) {
+        // Overrun; count the deadlines that passed.
+        uint64_t passed = uint64_t(((now - m_next_deadline).raw()
+              / m_period.raw()) + 1);
+        ++m_period_stats.overruns;
+
+        switch (m_overrun_policy) {
+          case OVERRUN_CATCH_UP:
+            m_next_deadline += m_period;
+            return m_running;
+
+          case OVERRUN_COALESCE:
+            m_period_stats.missed += passed - 1;
+            m_next_deadline = now + m_period;
+            return m_running;
+
+          case OVERRUN_SKIP:
+          default:
+            m_period_stats.missed += passed;
+            m_next_deadline += twine::chrono::nanoseconds(
+                int64_t(passed) * m_period.raw());
+            break;
+        }
+      }
+      deadline = m_next_deadline;
+    }
+  }
+
+  if (deadline < zero) {
+    // Not periodic.
+    return nanosleep(deadline);
+  }
+
+  bool running = nanosleep_until(deadline, mode);
+
+  twine::chrono::nanoseconds jitter = twine::chrono::monotonic_now() - deadline;
+  if (jitter < zero) {
+    // Woken up early; keep the deadline for the next call.
+    return running;
+  }
+
+  scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+  // The period may have been reset while sleeping.
+  if (m_next_deadline != deadline) {
+    return running;
+  }
+
+  period_statistics & stats = m_period_stats;
+  if (!stats.periods || jitter < stats.min_jitter) {
+    stats.min_jitter = jitter;
+  }
+  if (jitter > stats.max_jitter) {
+    stats.max_jitter = jitter;
+  }
+  stats.total_jitter += jitter;
+  ++stats.periods;
+
+  m_next_deadline += m_period;
+  return running;
+}
+
+
+
+tasklet::period_statistics
+tasklet::get_period_statistics() const
+{
+  scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+  return m_period_stats;
+}
+
+
+
+void
+tasklet::reset_period_statistics()
+{
+  scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+  m_period_stats = period_statistics();
+}
+
+
+
+void
+tasklet::post(message * msg)
+{
+  message * head = m_mailbox.load(memory_order_relaxed);
+  do {
+    msg->next = head;
+  } while (!m_mailbox.compare_exchange(head, msg));
+
+  // If the mailbox was not empty, whoever filled it took care of waking the
+  // tasklet, or the tasklet saw the messages before going to sleep.
+  if (head || !m_sleeping.load()) {
+    return;
+  }
+
+  // Taking the lock guarantees the sleeping tasklet is already waiting.
+  scoped_lock<recursive_mutex> lock(*m_tasklet_mutex);
+  wakeup();
+}
+
+
+
+tasklet::message *
+tasklet::receive()
+{
+  message * head = m_mailbox.exchange(nullptr, memory_order_acquire);
+
+  // The mailbox is a stack; reverse it so messages come out in the order
+  // they were posted.
+  message * result = nullptr;
+  while (head) {
+    message * next = head->next;
+    head->next = result;
+    result = head;
+    head = next;
+  }
+  return result;
+}
+
+
+
+bool
+tasklet::enter_sleep() const
+{
+  // Must be called with the tasklet mutex held. Marking the tasklet as
+  // sleeping before checking the mailbox and notifications pairs with post()
+  // and notify() doing the reverse, so that one of them sees the other.
+  m_sleeping.store(1);
+  if (m_mailbox.load() || m_notified.exchange(0)) {
+    m_sleeping.store(0);
+    return false;
+  }
+  return true;
+}
+
+
+
+void
+tasklet::leave_sleep() const
+{
+  // Notifications that arrived while sleeping have served their purpose.
+  m_sleeping.store(0);
+  m_notified.exchange(0);
+}
+
+
+
+void
+tasklet::sleep_timeout(void * baton)
+{
+  tasklet * t = static_cast<tasklet *>(baton);
+
+  // Taking the lock guarantees the sleeping tasklet is already waiting.
+  scoped_lock<recursive_mutex> lock(*t->m_tasklet_mutex);
+  t->m_condition->notify_one();
+}
+
+
+
+void
+tasklet::run_function()
+{
+  m_tasklet_info->m_func(*this, m_tasklet_info->m_thread_baton);
+}
+
+
 } // namespace twine
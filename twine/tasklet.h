@@ -28,10 +28,13 @@
 #include <twine/twine.h>
 
 #include <twine/thread.h>
+#include <twine/atomic.h>
 #include <twine/mutex.h>
 #include <twine/condition.h>
 #include <twine/chrono.h>
 #include <twine/binder.h>
+#include <twine/tasklet_scheduler.h>
+#include <twine/timer_wheel.h>
 
 #include <meta/nullptr.h>
 
@@ -74,6 +77,10 @@ namespace twine {
  *     // do something
  *   }
  * }
+ *
+ * Each tasklet owns an OS thread by default. If you run many tasklets, you can
+ * construct them with a tasklet_scheduler instead, which multiplexes them onto
+ * a small set of worker threads. See tasklet_scheduler.h for details.
  **/
 class tasklet
   : public thread
@@ -94,6 +101,62 @@ public:
   {
   };
 
+  /**
+   * What sleep_until_next_period() does if the tasklet overran, i.e. it is
+   * called after the deadline it should sleep until has already passed.
+   **/
+  enum overrun_policy
+  {
+    OVERRUN_SKIP,     // Sleep until the next deadline in the future; the
+                      // deadlines in between are dropped.
+    OVERRUN_CATCH_UP, // Return immediately for every missed deadline, so that
+                      // all periods run, if late.
+    OVERRUN_COALESCE  // Return immediately once for all missed deadlines, and
+                      // measure the following periods from now.
+  };
+
+  /**
+   * Statistics for periodic tasklets; see sleep_until_next_period().
+   *
+   * Jitter is the time between a deadline and the tasklet waking up for it,
+   * and only recorded for periods the tasklet slept for. The mean jitter is
+   * total_jitter / periods.
+   **/
+  struct period_statistics
+  {
+    uint64_t                    periods;      // Periods started on time.
+    uint64_t                    overruns;     // Calls made after the deadline.
+    uint64_t                    missed;       // Deadlines skipped or coalesced.
+    twine::chrono::nanoseconds  min_jitter;
+    twine::chrono::nanoseconds  max_jitter;
+    twine::chrono::nanoseconds  total_jitter;
+
+    period_statistics()
+      : periods(0)
+      , overruns(0)
+      , missed(0)
+      , min_jitter(0)
+      , max_jitter(0)
+      , total_jitter(0)
+    {
+    }
+  };
+
+  /**
+   * Base for mailbox messages; see post(). Derive your message types from
+   * this. The tasklet neither copies nor frees messages; whoever receive()s
+   * a message owns it.
+   **/
+  struct message
+  {
+    message * next;
+
+    message()
+      : next(nullptr)
+    {
+    }
+  };
+
   /***************************************************************************
    * Constructor/destructor
    **/
@@ -115,6 +178,23 @@ public:
   tasklet(twine::condition * condition, twine::recursive_mutex * mutex,
       function func, void * baton = nullptr, bool start_now = false);
 
+  /**
+   * As above, but create the tasklet's thread with the given attributes; see
+   * thread::attributes.
+   **/
+  tasklet(function func, void * baton, thread::attributes const & attrs,
+      bool start_now = false);
+  tasklet(twine::condition * condition, twine::recursive_mutex * mutex,
+      function func, void * baton, thread::attributes const & attrs,
+      bool start_now = false);
+
+  /**
+   * Create a tasklet that is run by the given scheduler rather than on its
+   * own thread. Such tasklets always own their condition.
+   **/
+  tasklet(tasklet_scheduler & scheduler, function func, void * baton = nullptr,
+      bool start_now = false);
+
   virtual ~tasklet();
 
   /***************************************************************************
@@ -144,6 +224,15 @@ public:
    **/
   void wakeup();
 
+  /**
+   * Like wakeup(), but a notification that arrives before the tasklet goes
+   * to sleep isn't lost: the next sleep returns immediately instead. That
+   * makes it safe to notify a tasklet about state it checks before sleeping,
+   * as spsc_ring does. Unless the tasklet is sleeping, this doesn't take the
+   * tasklet's mutex.
+   **/
+  void notify();
+
   /**
    * Sleep function. Use with twine::chrono's durations. Returns true if the
    * tasklet is still supposed to be running (i.e. sleep was interrupted by
@@ -156,11 +245,17 @@ public:
    *       // Do something
    *     }
    *   }
+   *
+   * Timed sleeps with twine::chrono::SLEEP_PRECISE spin for the last few
+   * microseconds, see twine::chrono::precise_sleep(). Tasklets run by a
+   * scheduler or sleeping on a timer wheel ignore the mode.
    **/
   template <typename durationT>
-  inline bool sleep(durationT const & duration) const
+  inline bool sleep(durationT const & duration,
+      twine::chrono::sleep_mode mode = twine::chrono::SLEEP_DEFAULT) const
   {
-    return tasklet::nanosleep(duration.template convert<twine::chrono::nanoseconds>());
+    return tasklet::nanosleep(duration.template convert<twine::chrono::nanoseconds>(),
+        mode);
   }
 
   inline bool sleep() const
@@ -168,6 +263,111 @@ public:
     return tasklet::nanosleep(twine::chrono::nanoseconds(-1));
   }
 
+  /**
+   * As sleep(), but sleep until the given deadline, measured against
+   * twine::chrono::monotonic_now(), or given as a twine::chrono::steady_clock
+   * time point. Periodic tasklets can advance a deadline by their period on
+   * each iteration, so that the time spent doing work does not make the
+   * period drift.
+   **/
+  template <typename durationT>
+  inline bool sleep_until(durationT const & deadline,
+      twine::chrono::sleep_mode mode = twine::chrono::SLEEP_DEFAULT) const
+  {
+    return tasklet::nanosleep_until(deadline.template convert<twine::chrono::nanoseconds>(),
+        mode);
+  }
+
+  template <typename durationT>
+  inline bool sleep_until(
+      twine::chrono::time_point<twine::chrono::steady_clock, durationT> const & deadline,
+      twine::chrono::sleep_mode mode = twine::chrono::SLEEP_DEFAULT) const
+  {
+    return tasklet::nanosleep_until(
+        deadline.time_since_epoch().template convert<twine::chrono::nanoseconds>(),
+        mode);
+  }
+
+  /**
+   * Periodic tasklets. Rather than sleep() for the period after doing their
+   * work - which makes the period drift by the time the work takes plus the
+   * wakeup latency on every iteration - periodic tasklets sleep until absolute
+   * deadlines spaced exactly one period apart:
+   *
+   *   void func(tasklet & t, void * baton)
+   *   {
+   *     t.set_period(twine::chrono::milliseconds(10));
+   *     while (t.sleep_until_next_period()) {
+   *       // Do something
+   *     }
+   *   }
+   *
+   * set_period() sets the period and overrun policy, and resets the
+   * statistics; the first deadline is one period after the first call to
+   * sleep_until_next_period(). A period of zero or less disables periodic
+   * sleeping, in which case sleep_until_next_period() behaves like sleep().
+   *
+   * sleep_until_next_period() returns the same as sleep(). If it is woken up
+   * before the deadline, the deadline stays in place for the next call.
+   **/
+  template <typename durationT>
+  inline void set_period(durationT const & period,
+      overrun_policy policy = OVERRUN_SKIP)
+  {
+    tasklet::set_period_internal(period.template convert<twine::chrono::nanoseconds>(),
+        policy);
+  }
+
+  bool sleep_until_next_period(
+      twine::chrono::sleep_mode mode = twine::chrono::SLEEP_DEFAULT);
+
+  /**
+   * Retrieve or reset the statistics for periodic sleeps.
+   **/
+  period_statistics get_period_statistics() const;
+  void reset_period_statistics();
+
+  /**
+   * Mailbox. Every tasklet has a lock-free multi-producer, single-consumer
+   * mailbox that lets it work as an actor:
+   *
+   *   void func(tasklet & t, void * baton)
+   *   {
+   *     while (t.sleep()) {
+   *       for (tasklet::message * msg = t.receive() ; msg ; ) {
+   *         tasklet::message * next = msg->next;
+   *         // Handle and free msg
+   *         msg = next;
+   *       }
+   *     }
+   *   }
+   *
+   * post() may be called from any thread. It does not take the tasklet's
+   * mutex unless it has to wake the tasklet, which it only does if the tasklet
+   * is sleeping and the mailbox was empty. In turn, sleeps return immediately
+   * while messages are pending, as if woken by wakeup().
+   *
+   * receive() must only be called by the tasklet itself. It returns all
+   * messages posted since the last call, oldest first and linked via their
+   * next pointers, or nullptr if the mailbox is empty.
+   *
+   * Messages still in the mailbox when the tasklet is destroyed are not freed.
+   **/
+  void post(message * msg);
+  message * receive();
+
+  /**
+   * Use the given timer wheel for timed sleeps instead of a timed wait on the
+   * condition. With many periodically sleeping tasklets, that means a single
+   * timer thread instead of a kernel timer per tasklet. Pass nullptr to go
+   * back to timed waits.
+   *
+   * The timer wheel is only used for tasklets that own their condition;
+   * notifying a shared condition on every timeout would wake all tasklets
+   * sharing it.
+   **/
+  void set_timer_wheel(twine::timer_wheel * wheel);
+
 
   /***************************************************************************
    * Forward declarations
@@ -175,6 +375,8 @@ public:
   struct tasklet_info;
 
 private:
+  friend class tasklet_scheduler;
+
   /***************************************************************************
    * Make stuff private that was public in thread
    **/
@@ -187,7 +389,17 @@ private:
   /***************************************************************************
    * Implementation functions
    **/
-  bool nanosleep(twine::chrono::nanoseconds nsecs) const;
+  bool nanosleep(twine::chrono::nanoseconds nsecs,
+      twine::chrono::sleep_mode mode = twine::chrono::SLEEP_DEFAULT) const;
+  bool nanosleep_until(twine::chrono::nanoseconds deadline,
+      twine::chrono::sleep_mode mode) const;
+  bool wheel_sleep(twine::chrono::nanoseconds nsecs) const;
+  bool enter_sleep() const;
+  void leave_sleep() const;
+  void set_period_internal(twine::chrono::nanoseconds period,
+      overrun_policy policy);
+  void run_function();
+  static void sleep_timeout(void * baton);
 
   /***************************************************************************
    * Data
@@ -199,6 +411,21 @@ private:
   mutable twine::condition *        m_condition;
   mutable twine::recursive_mutex *  m_tasklet_mutex;
   bool                              m_condition_owned;
+
+  tasklet_scheduler *               m_scheduler;
+  tasklet_scheduler::task *         m_task;
+
+  twine::timer_wheel *              m_timer_wheel;
+  mutable twine::timer_wheel::timer m_sleep_timer;
+
+  twine::chrono::nanoseconds        m_period;
+  twine::chrono::nanoseconds        m_next_deadline;
+  overrun_policy                    m_overrun_policy;
+  period_statistics                 m_period_stats;
+
+  twine::atomic<message *>          m_mailbox;
+  mutable twine::atomic<uint32_t>   m_sleeping;
+  mutable twine::atomic<uint32_t>   m_notified;
 };
 
 } // namespace twine
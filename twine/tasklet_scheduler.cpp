@@ -0,0 +1,405 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/tasklet_scheduler.h>
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+
+#include <meta/nullptr.h>
+
+#include <twine/tasklet.h>
+#include <twine/scoped_lock.h>
+#include <twine/detail/fiber.h>
+
+namespace twine {
+
+/******************************************************************************
+ * Static members
+ **/
+size_t const tasklet_scheduler::DEFAULT_STACK_SIZE = 64 * 1024;
+
+
+/******************************************************************************
+ * Internal structures
+ **/
+/**
+ * Scheduler-side data for each tasklet.
+ **/
+struct tasklet_scheduler::task
+{
+  enum state
+  {
+    IDLE      = 0,  // Not started, or finished.
+    QUEUED    = 1,  // In a worker's run queue.
+    RUNNING   = 2,  // Executing on a worker.
+    SLEEPING  = 3   // Suspended in sleep().
+  };
+
+  tasklet *               m_tasklet;
+  tasklet_scheduler *     m_scheduler;
+  worker *                m_worker;
+  detail::fiber *         m_fiber;
+  twine::atomic<uint32_t> m_state;
+
+  // Guarded by the tasklet's mutex: true from start() until the tasklet
+  // function returned.
+  bool                    m_active;
+
+  // Only accessed from the worker thread the task runs on.
+  bool                    m_finished;
+  bool                    m_timed;
+  chrono::nanoseconds     m_deadline;
+  uint64_t                m_sleep_seq;
+
+  task(tasklet & t, tasklet_scheduler * scheduler)
+    : m_tasklet(&t)
+    , m_scheduler(scheduler)
+    , m_worker(nullptr)
+    , m_fiber(nullptr)
+    , m_state(IDLE)
+    , m_active(false)
+    , m_finished(false)
+    , m_timed(false)
+    , m_deadline()
+    , m_sleep_seq(0)
+  {
+  }
+};
+
+
+/**
+ * Worker threads; each runs the tasks assigned to it from its own run queue,
+ * and keeps a heap of sleep deadlines.
+ **/
+struct tasklet_scheduler::worker
+{
+  struct timer_entry
+  {
+    chrono::nanoseconds m_deadline;
+    uint64_t            m_seq;
+    task *              m_task;
+
+    // Inverted, so the standard heap functions produce a min-heap.
+    inline bool operator<(timer_entry const & other) const
+    {
+      return m_deadline > other.m_deadline;
+    }
+  };
+
+  tasklet_scheduler *       m_scheduler;
+  twine::thread             m_thread;
+  detail::fiber *           m_fiber;
+
+  twine::mutex              m_mutex;
+  twine::condition          m_condition;
+  std::deque<task *>        m_queue;
+  bool                      m_stopping;
+
+  std::vector<timer_entry>  m_timers;
+
+  explicit worker(tasklet_scheduler * scheduler)
+    : m_scheduler(scheduler)
+    , m_thread()
+    , m_fiber(nullptr)
+    , m_mutex()
+    , m_condition()
+    , m_queue()
+    , m_stopping(false)
+    , m_timers()
+  {
+  }
+
+  void enqueue(task * t)
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    m_queue.push_back(t);
+    m_condition.notify_one();
+  }
+
+  void stop()
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    m_stopping = true;
+    m_condition.notify_one();
+  }
+
+  void run(void *)
+  {
+    m_fiber = detail::fiber_for_thread();
+
+    while (true) {
+      fire_timers();
+
+      task * t = nullptr;
+      {
+        scoped_lock<mutex> lock(m_mutex);
+        if (m_queue.empty()) {
+          if (m_stopping) {
+            break;
+          }
+          if (m_timers.empty()) {
+            m_condition.wait(lock);
+          }
+          else {
+            m_condition.wait_until(lock, m_timers.front().m_deadline);
+          }
+          continue;
+        }
+
+        t = m_queue.front();
+        m_queue.pop_front();
+      }
+
+      run_task(t);
+    }
+
+    detail::fiber_destroy(m_fiber);
+    m_fiber = nullptr;
+  }
+
+  void run_task(task * t)
+  {
+    t->m_state.store(task::RUNNING);
+    detail::fiber_switch(m_fiber, t->m_fiber);
+
+    // The task either finished, or went to sleep.
+    if (t->m_finished) {
+      remove_timers(t);
+      detail::fiber_destroy(t->m_fiber);
+      t->m_fiber = nullptr;
+      m_scheduler->finished(t);
+      return;
+    }
+
+    if (t->m_timed) {
+      timer_entry entry;
+      entry.m_deadline = t->m_deadline;
+      entry.m_seq = t->m_sleep_seq;
+      entry.m_task = t;
+      m_timers.push_back(entry);
+      std::push_heap(m_timers.begin(), m_timers.end());
+    }
+  }
+
+  void fire_timers()
+  {
+    if (m_timers.empty()) {
+      return;
+    }
+
+    chrono::nanoseconds now = chrono::monotonic_now();
+    while (!m_timers.empty() && m_timers.front().m_deadline <= now) {
+      timer_entry entry = m_timers.front();
+      std::pop_heap(m_timers.begin(), m_timers.end());
+      m_timers.pop_back();
+
+      // Entries for sleeps that ended early are stale.
+      if (entry.m_seq != entry.m_task->m_sleep_seq) {
+        continue;
+      }
+      uint32_t expected = task::SLEEPING;
+      if (entry.m_task->m_state.compare_exchange(expected, task::QUEUED)) {
+        enqueue(entry.m_task);
+      }
+    }
+  }
+
+  void remove_timers(task * t)
+  {
+    size_t kept = 0;
+    for (size_t i = 0 ; i < m_timers.size() ; ++i) {
+      if (m_timers[i].m_task != t) {
+        m_timers[kept++] = m_timers[i];
+      }
+    }
+    m_timers.resize(kept);
+    std::make_heap(m_timers.begin(), m_timers.end());
+  }
+};
+
+
+
+/******************************************************************************
+ * Implementation
+ **/
+tasklet_scheduler::tasklet_scheduler(uint32_t size /* = 0 */,
+    size_t stack_size /* = DEFAULT_STACK_SIZE */)
+  : m_workers()
+  , m_stack_size(stack_size)
+  , m_next_worker(0)
+{
+  if (!size) {
+    size = thread::hardware_concurrency();
+  }
+  if (!size) {
+    size = 1;
+  }
+
+  m_workers.reserve(size);
+  for (uint32_t i = 0 ; i < size ; ++i) {
+    worker * w = new worker(this);
+    m_workers.push_back(w);
+    w->m_thread.set_func(thread::binder<worker, &worker::run>::function, w);
+    w->m_thread.start();
+  }
+}
+
+
+
+tasklet_scheduler::~tasklet_scheduler()
+{
+  for (size_t i = 0 ; i < m_workers.size() ; ++i) {
+    m_workers[i]->stop();
+  }
+  for (size_t i = 0 ; i < m_workers.size() ; ++i) {
+    m_workers[i]->m_thread.join();
+    delete m_workers[i];
+  }
+}
+
+
+
+uint32_t
+tasklet_scheduler::size() const
+{
+  return uint32_t(m_workers.size());
+}
+
+
+
+size_t
+tasklet_scheduler::stack_size() const
+{
+  return m_stack_size;
+}
+
+
+
+tasklet_scheduler::task *
+tasklet_scheduler::create_task(tasklet & t)
+{
+  return new task(t, this);
+}
+
+
+
+void
+tasklet_scheduler::destroy_task(task * t)
+{
+  delete t;
+}
+
+
+
+bool
+tasklet_scheduler::is_active(task * t) const
+{
+  return t->m_active;
+}
+
+
+
+bool
+tasklet_scheduler::start(task * t)
+{
+  t->m_fiber = detail::fiber_create(m_stack_size, &tasklet_scheduler::fiber_main, t);
+  if (!t->m_fiber) {
+    return false;
+  }
+
+  t->m_active = true;
+  t->m_finished = false;
+  t->m_worker = m_workers[m_next_worker.fetch_add(1, memory_order_relaxed)
+    % m_workers.size()];
+  t->m_state.store(task::QUEUED);
+  t->m_worker->enqueue(t);
+  return true;
+}
+
+
+
+void
+tasklet_scheduler::prepare_sleep(task * t, twine::chrono::nanoseconds nsecs)
+{
+  ++t->m_sleep_seq;
+  t->m_timed = (nsecs >= chrono::nanoseconds(0));
+  if (t->m_timed) {
+    t->m_deadline = chrono::monotonic_now() + nsecs;
+  }
+  t->m_state.store(task::SLEEPING);
+}
+
+
+
+void
+tasklet_scheduler::suspend(task * t)
+{
+  // Even if the task was woken between prepare_sleep() and now, it can only be
+  // resumed once we're back on the worker, which runs it from its queue.
+  detail::fiber_switch(t->m_fiber, t->m_worker->m_fiber);
+}
+
+
+
+void
+tasklet_scheduler::wakeup(task * t)
+{
+  uint32_t expected = task::SLEEPING;
+  if (t->m_state.compare_exchange(expected, task::QUEUED)) {
+    t->m_worker->enqueue(t);
+  }
+}
+
+
+
+void
+tasklet_scheduler::fiber_main(void * arg)
+{
+  task * t = static_cast<task *>(arg);
+
+  // Behave like threads do - terminate on any exception.
+  try {
+    t->m_tasklet->run_function();
+  } catch (...) {
+    std::terminate();
+  }
+
+  t->m_finished = true;
+  detail::fiber_switch(t->m_fiber, t->m_worker->m_fiber);
+}
+
+
+
+void
+tasklet_scheduler::finished(task * t)
+{
+  tasklet * tasklet = t->m_tasklet;
+
+  scoped_lock<recursive_mutex> lock(*tasklet->m_tasklet_mutex);
+  t->m_state.store(task::IDLE);
+  t->m_active = false;
+  tasklet->m_running = false;
+  tasklet->m_condition->notify_all();
+}
+
+
+} // namespace twine
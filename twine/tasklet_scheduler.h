@@ -0,0 +1,147 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_TASKLET_SCHEDULER_H
+#define TWINE_TASKLET_SCHEDULER_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <vector>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/chrono.h>
+
+namespace twine {
+
+/***************************************************************************
+ * Forward declarations
+ **/
+class tasklet;
+
+
+/**
+ * Tasklet scheduler class
+ *
+ * By default, every tasklet owns an OS thread that spends most of its life
+ * blocked in sleep(). A tasklet constructed with a scheduler instead runs as
+ * a fiber - a resumable unit with its own small stack - on one of the
+ * scheduler's worker threads. Calling sleep() suspends the fiber and lets the
+ * worker run other tasklets; wakeup(), stop() or an expiring sleep duration
+ * make it runnable again.
+ *
+ * The tasklet function signature does not change, so existing tasklet
+ * functions can be scheduled as they are:
+ *
+ *   tasklet_scheduler scheduler(2);
+ *   tasklet t(scheduler, my_func, my_baton);
+ *   t.start();
+ *
+ * There are a few things to be aware of:
+ * - Tasklets stay on the worker they were started on. A tasklet that blocks
+ *   in anything other than sleep() blocks all other tasklets on that worker.
+ * - Stacks are small, DEFAULT_STACK_SIZE unless specified otherwise. They
+ *   are protected by a guard page where the platform allows it.
+ * - Scheduled tasklets always use their own condition and mutex.
+ * - All tasklets must be destroyed before the scheduler is.
+ * - On POSIX systems without makecontext(), such as musl based ones, there
+ *   are no fibers; starting a scheduled tasklet fails there.
+ **/
+class tasklet_scheduler
+  : public twine::noncopyable
+{
+public:
+  /***************************************************************************
+   * Constants
+   **/
+  static size_t const DEFAULT_STACK_SIZE;
+
+  /***************************************************************************
+   * Constructor/destructor
+   **/
+  /**
+   * Create a scheduler with the given number of worker threads. If the
+   * number is zero, thread::hardware_concurrency() workers are started (or a
+   * single one, if that number cannot be determined).
+   **/
+  explicit tasklet_scheduler(uint32_t size = 0,
+      size_t stack_size = DEFAULT_STACK_SIZE);
+
+  ~tasklet_scheduler();
+
+  /***************************************************************************
+   * Main interface
+   **/
+  /**
+   * Returns the number of worker threads.
+   **/
+  uint32_t size() const;
+
+  /**
+   * Returns the stack size of tasklets run by this scheduler.
+   **/
+  size_t stack_size() const;
+
+  /***************************************************************************
+   * Forward declarations
+   **/
+  struct worker;
+  struct task;
+
+private:
+  friend class tasklet;
+  friend struct worker;
+
+  /***************************************************************************
+   * Interface for tasklets
+   **/
+  task * create_task(tasklet & t);
+  void destroy_task(task * t);
+
+  // Called with the tasklet's mutex held.
+  bool is_active(task * t) const;
+  bool start(task * t);
+  void prepare_sleep(task * t, twine::chrono::nanoseconds nsecs);
+
+  // Called without locks held.
+  void suspend(task * t);
+  void wakeup(task * t);
+
+  /***************************************************************************
+   * Implementation functions
+   **/
+  static void fiber_main(void * arg);
+  void finished(task * t);
+
+  /***************************************************************************
+   * Data
+   **/
+  std::vector<worker *>   m_workers;
+  size_t                  m_stack_size;
+  twine::atomic<uint32_t> m_next_worker;
+};
+
+} // namespace twine
+
+#endif // guard
@@ -53,6 +53,181 @@ thread::id const thread::bad_thread_id = -1;
 
 
 
+/******************************************************************************
+ * Exit handlers
+ **/
+namespace detail {
+
+TWINE_ANONS_START
+
+struct exit_handler
+{
+  void          (*m_func)(void *);
+  void *        m_baton;
+  exit_handler * m_next;
+};
+
+// Marks the end of the list; the list is only non-null in threads started
+// by twine::thread.
+static exit_handler EXIT_HANDLERS_END = { nullptr, nullptr, nullptr };
+
+static TWINE_THREAD_LOCAL exit_handler * exit_handlers = 0;
+
+TWINE_ANONS_END
+
+
+void
+begin_exit_handlers()
+{
+  TWINE_ANONS(exit_handlers) = &TWINE_ANONS(EXIT_HANDLERS_END);
+}
+
+
+
+void
+run_exit_handlers()
+{
+  exit_handler * handler = nullptr;
+  while ((handler = TWINE_ANONS(exit_handlers))
+      && handler != &TWINE_ANONS(EXIT_HANDLERS_END))
+  {
+    TWINE_ANONS(exit_handlers) = handler->m_next;
+    handler->m_func(handler->m_baton);
+    delete handler;
+  }
+  TWINE_ANONS(exit_handlers) = nullptr;
+}
+
+} // namespace detail
+
+
+
+/******************************************************************************
+ * Attributes
+ **/
+thread::attributes::attributes()
+  : m_stack_size(0)
+  , m_guard_size(0)
+  , m_has_guard_size(false)
+  , m_stack(nullptr)
+  , m_policy(SCHEDULING_DEFAULT)
+  , m_priority(0)
+  , m_nice(0)
+  , m_has_nice(false)
+{
+}
+
+
+
+void
+thread::attributes::set_stack_size(size_t size)
+{
+  m_stack_size = size;
+}
+
+
+
+size_t
+thread::attributes::stack_size() const
+{
+  return m_stack_size;
+}
+
+
+
+void
+thread::attributes::set_guard_size(size_t size)
+{
+  m_guard_size = size;
+  m_has_guard_size = true;
+}
+
+
+
+bool
+thread::attributes::has_guard_size() const
+{
+  return m_has_guard_size;
+}
+
+
+
+size_t
+thread::attributes::guard_size() const
+{
+  return m_guard_size;
+}
+
+
+
+void
+thread::attributes::set_stack(void * buffer, size_t size)
+{
+  m_stack = buffer;
+  m_stack_size = buffer ? size : 0;
+}
+
+
+
+void *
+thread::attributes::stack() const
+{
+  return m_stack;
+}
+
+
+
+void
+thread::attributes::set_scheduling(scheduling_policy policy,
+    int priority /* = 0 */)
+{
+  m_policy = policy;
+  m_priority = priority;
+}
+
+
+
+thread::scheduling_policy
+thread::attributes::policy() const
+{
+  return m_policy;
+}
+
+
+
+int
+thread::attributes::priority() const
+{
+  return m_priority;
+}
+
+
+
+void
+thread::attributes::set_nice(int nice)
+{
+  m_nice = nice;
+  m_has_nice = true;
+}
+
+
+
+bool
+thread::attributes::has_nice() const
+{
+  return m_has_nice;
+}
+
+
+
+int
+thread::attributes::nice() const
+{
+  return m_nice;
+}
+
+
+
 /******************************************************************************
  * Implementation
  **/
@@ -61,6 +236,8 @@ thread::thread()
   : m_mutex()
   , m_info(nullptr)
   , m_is_attached(false)
+  , m_affinity()
+  , m_attributes()
   , m_handle(INVALID_HANDLE_VALUE)
 {
 }
@@ -72,6 +249,30 @@ thread::thread(thread::function func, void * baton,
   : m_mutex()
   , m_info(nullptr)
   , m_is_attached(false)
+  , m_affinity()
+  , m_attributes()
+  , m_handle(INVALID_HANDLE_VALUE)
+{
+  scoped_lock<recursive_mutex> lock(m_mutex);
+
+  if (!set_func(func, baton)) {
+    return;
+  }
+
+  if (start_now) {
+    start(detach_now);
+  }
+}
+
+
+
+thread::thread(thread::function func, void * baton, attributes const & attrs,
+    bool start_now /* = true */, bool detach_now /* = false */)
+  : m_mutex()
+  , m_info(nullptr)
+  , m_is_attached(false)
+  , m_affinity()
+  , m_attributes(attrs)
   , m_handle(INVALID_HANDLE_VALUE)
 {
   scoped_lock<recursive_mutex> lock(m_mutex);
@@ -176,6 +377,8 @@ thread::start(bool detach_now /* = false */)
 
   // If we're supposed to detach immediately, we'll do so.
   thread_info * tmp_info = const_cast<thread_info *>(m_info);
+  tmp_info->m_affinity = m_affinity;
+  tmp_info->m_attributes = m_attributes;
   if (detach_now) {
     tmp_info = new thread_info(*tmp_info);
     tmp_info->m_thread = nullptr;
@@ -192,6 +395,63 @@ thread::start(bool detach_now /* = false */)
 }
 
 
+
+bool
+thread::set_attributes(attributes const & attrs)
+{
+  scoped_lock<recursive_mutex> lock(m_mutex);
+
+  if (m_is_attached) {
+    return false;
+  }
+
+  m_attributes = attrs;
+  return true;
+}
+
+
+
+thread::attributes
+thread::get_attributes() const
+{
+  scoped_lock<recursive_mutex> lock(m_mutex);
+  return m_attributes;
+}
+
+
+
+bool
+thread::set_affinity(cpu_set const & cpus)
+{
+  scoped_lock<recursive_mutex> lock(m_mutex);
+
+  if (m_is_attached) {
+    if (cpus.empty() || !detail::thread_set_affinity(m_handle, cpus)) {
+      return false;
+    }
+  }
+
+  m_affinity = cpus;
+  return true;
+}
+
+
+
+bool
+thread::get_affinity(cpu_set & cpus) const
+{
+  scoped_lock<recursive_mutex> lock(m_mutex);
+
+  if (m_is_attached) {
+    return detail::thread_get_affinity(
+        const_cast<thread *>(this)->m_handle, cpus);
+  }
+
+  cpus = m_affinity;
+  return true;
+}
+
+
 thread::id
 thread::get_id() const
 {
@@ -263,6 +523,77 @@ void yield()
 #endif
 }
 
+
+
+int32_t get_cpu()
+{
+  return detail::current_cpu();
+}
+
+
+
+bool set_affinity(cpu_set const & cpus)
+{
+  if (cpus.empty()) {
+    return false;
+  }
+  HANDLE_T handle = detail::current_thread_handle();
+  return detail::thread_set_affinity(handle, cpus);
+}
+
+
+
+bool get_affinity(cpu_set & cpus)
+{
+  HANDLE_T handle = detail::current_thread_handle();
+  return detail::thread_get_affinity(handle, cpus);
+}
+
+
+
+bool set_scheduling(thread::scheduling_policy policy, int priority /* = 0 */)
+{
+  return detail::set_scheduling(policy, priority);
+}
+
+
+
+bool set_nice(int nice)
+{
+  return detail::set_nice(nice);
+}
+
+
+
+bool set_timer_slack(chrono::nanoseconds const & slack)
+{
+  return detail::set_timer_slack(slack);
+}
+
+
+
+bool get_timer_slack(chrono::nanoseconds & slack)
+{
+  return detail::get_timer_slack(slack);
+}
+
+
+
+bool at_exit(void (*func)(void *), void * baton)
+{
+  if (!func || !detail::TWINE_ANONS(exit_handlers)) {
+    return false;
+  }
+
+  detail::TWINE_ANONS(exit_handler) * handler
+    = new detail::TWINE_ANONS(exit_handler)();
+  handler->m_func = func;
+  handler->m_baton = baton;
+  handler->m_next = detail::TWINE_ANONS(exit_handlers);
+  detail::TWINE_ANONS(exit_handlers) = handler;
+  return true;
+}
+
 } // namespace this_thread
 
 
@@ -32,6 +32,7 @@
 #include <twine/mutex.h>
 #include <twine/chrono.h>
 #include <twine/binder.h>
+#include <twine/cpu_set.h>
 
 #include <meta/nullptr.h>
 
@@ -97,12 +98,75 @@ public:
   // Thread ID
   typedef int64_t id;
 
+  // Scheduling policies; not all are available on all platforms.
+  enum scheduling_policy
+  {
+    SCHEDULING_DEFAULT,     // Inherit from the creating thread.
+    SCHEDULING_NORMAL,      // Time sharing, e.g. SCHED_OTHER
+    SCHEDULING_BATCH,       // CPU bound, non-interactive
+    SCHEDULING_IDLE,        // Only run when nothing else wants to
+    SCHEDULING_FIFO,        // Real-time, first in first out
+    SCHEDULING_ROUND_ROBIN  // Real-time, round robin
+  };
+
+  /**
+   * Attributes for creating threads. Default constructed attributes leave
+   * everything to the platform defaults.
+   *
+   * Stack options are applied when the thread gets created; stack sizes are
+   * rounded up to the platform's minimum and page size. If a stack buffer is
+   * provided, it must stay valid until the thread ends, and the stack and
+   * guard sizes are ignored.
+   *
+   * Scheduling options and the nice level are applied by the new thread
+   * before its thread function runs. They're best effort: if the process
+   * lacks the privileges for them (e.g. real-time policies, or negative nice
+   * levels for unprivileged users), the thread runs with its defaults. Use
+   * this_thread::set_scheduling() and this_thread::set_nice() from within the
+   * thread if you need to know whether they succeeded.
+   **/
+  class attributes
+  {
+  public:
+    attributes();
+
+    void set_stack_size(size_t size);
+    size_t stack_size() const;
+
+    void set_guard_size(size_t size);
+    bool has_guard_size() const;
+    size_t guard_size() const;
+
+    void set_stack(void * buffer, size_t size);
+    void * stack() const;
+
+    void set_scheduling(scheduling_policy policy, int priority = 0);
+    scheduling_policy policy() const;
+    int priority() const;
+
+    void set_nice(int nice);
+    bool has_nice() const;
+    int nice() const;
+
+  private:
+    size_t            m_stack_size;   // 0 means default
+    size_t            m_guard_size;
+    bool              m_has_guard_size;
+    void *            m_stack;
+    scheduling_policy m_policy;
+    int               m_priority;
+    int               m_nice;
+    bool              m_has_nice;
+  };
+
   /***************************************************************************
    * Constructor/destructor
    **/
   thread();
   thread(function func, void * baton, bool start_now = true,
       bool detach_now = false);
+  thread(function func, void * baton, attributes const & attrs,
+      bool start_now = true, bool detach_now = false);
 
   virtual ~thread();
 
@@ -157,6 +221,13 @@ public:
    **/
   bool set_func(function func, void * baton);
 
+  /**
+   * Set the attributes to create the thread with; see attributes above. Like
+   * set_func(), this fails if the thread object is currently joinable.
+   **/
+  bool set_attributes(attributes const & attrs);
+  attributes get_attributes() const;
+
   /**
    * If the thread was constructed with start_now = false, or was joined and
    * made joinable again via set_func, then you can start the thread via this
@@ -166,6 +237,25 @@ public:
    **/
   void start(bool detach_now = false);
 
+  /**
+   * Restrict the thread to the given set of CPUs. If the thread is not
+   * running, the set is applied when it gets started (before the thread
+   * function runs), otherwise it is applied immediately. Returns false if
+   * the affinity could not be applied to a running thread, or if affinity is
+   * not supported on the platform.
+   *
+   * An empty set removes a restriction that has not been applied yet; it
+   * cannot be applied to a running thread.
+   **/
+  bool set_affinity(cpu_set const & cpus);
+
+  /**
+   * Retrieve the CPUs the thread may run on. For threads that aren't
+   * running, this is the set that start() will apply, which is empty if no
+   * restriction was set.
+   **/
+  bool get_affinity(cpu_set & cpus) const;
+
 
   /***************************************************************************
    * Forward declarations
@@ -181,6 +271,8 @@ private:
   mutable recursive_mutex       m_mutex;
   volatile struct thread_info * m_info;
   volatile bool                 m_is_attached;
+  cpu_set                       m_affinity;
+  attributes                    m_attributes;
 
 #if defined(TWINE_WIN32)
   HANDLE      m_handle;
@@ -204,15 +296,63 @@ thread::id get_id();
  **/
 void yield();
 
+/**
+ * Returns the CPU the calling thread currently runs on, or -1 if that cannot
+ * be determined. Unless the thread is pinned to a single CPU, the result may
+ * be outdated by the time it is returned.
+ **/
+int32_t get_cpu();
+
+/**
+ * Restrict the calling thread to the given set of CPUs, or retrieve the set of
+ * CPUs it may run on. Both return false on failure, or if the platform does
+ * not support affinity.
+ **/
+bool set_affinity(cpu_set const & cpus);
+bool get_affinity(cpu_set & cpus);
+
+/**
+ * Change the scheduling policy and priority, or the nice level, of the calling
+ * thread. Both return false if the platform does not support the setting, or
+ * the process lacks the privileges for it.
+ **/
+bool set_scheduling(thread::scheduling_policy policy, int priority = 0);
+bool set_nice(int nice);
+
+/**
+ * Change or retrieve the calling thread's timer slack, i.e. by how much the
+ * kernel may delay timed wakeups in order to group them. Lower values make
+ * sleeps and timed waits more precise, at the cost of more wakeups. Both
+ * return false if the platform does not support timer slack; only Linux
+ * does.
+ **/
+bool set_timer_slack(chrono::nanoseconds const & slack);
+bool get_timer_slack(chrono::nanoseconds & slack);
+
+/**
+ * Register a function to be called with the given baton when the calling
+ * thread's function returns. Handlers run on the exiting thread, most
+ * recently registered first; they may register further handlers. Returns
+ * false if the calling thread was not started by a twine::thread, in which
+ * case the function is never called.
+ **/
+bool at_exit(void (*func)(void *), void * baton);
+
 /**
  * Put the calling thread to sleep for the duration given in the period. Returns
  * false on unexpected errors, true otherwise. Note that sleep_for() will ignore
  * signals.
+ *
+ * With chrono::SLEEP_PRECISE, this uses chrono::precise_sleep(); see there.
  **/
 template <typename periodT>
 bool
-sleep_for(periodT const & period)
+sleep_for(periodT const & period,
+    chrono::sleep_mode mode = chrono::SLEEP_DEFAULT)
 {
+  if (chrono::SLEEP_PRECISE == mode) {
+    return chrono::precise_sleep(period.template convert<chrono::nanoseconds>());
+  }
   return chrono::sleep(period.template convert<chrono::nanoseconds>());
 }
 
@@ -241,6 +381,26 @@ void thread_detach(HANDLE_T &);
 
 int thread_create(HANDLE_T &, thread::thread_info *);
 
+HANDLE_T current_thread_handle();
+
+bool thread_set_affinity(HANDLE_T &, cpu_set const &);
+
+bool thread_get_affinity(HANDLE_T &, cpu_set &);
+
+int32_t current_cpu();
+
+bool set_scheduling(thread::scheduling_policy policy, int priority);
+
+bool set_nice(int nice);
+
+bool set_timer_slack(chrono::nanoseconds const & slack);
+
+bool get_timer_slack(chrono::nanoseconds & slack);
+
+void begin_exit_handlers();
+
+void run_exit_handlers();
+
 
 } // namespace detail
 #endif // TWINE_THREAD_DETAILS
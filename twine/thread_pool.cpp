@@ -0,0 +1,352 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/thread_pool.h>
+
+#include <exception>
+
+#include <twine/scoped_lock.h>
+#include <twine/detail/work_stealing_deque.h>
+
+namespace twine {
+
+/**
+ * Per-worker data.
+ **/
+struct thread_pool::worker
+{
+  thread_pool *               m_pool;
+  detail::work_stealing_deque m_deque;
+  twine::thread               m_thread;
+  uint32_t                    m_random;
+
+  worker(thread_pool * pool, uint32_t index)
+    : m_pool(pool)
+    , m_deque()
+    , m_thread()
+    , m_random((index + 1) * 2654435761U)
+  {
+  }
+
+  void run(void *)
+  {
+    m_pool->worker_loop(*this);
+  }
+
+  // xorshift32; only used to pick steal victims, so quality does not matter
+  // much.
+  inline uint32_t next_random()
+  {
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random;
+  }
+};
+
+
+TWINE_ANONS_START
+
+// The worker the current thread runs, if any. Thread-local storage needs a
+// constant initializer, which meta::nullptr is not before C++11.
+static TWINE_THREAD_LOCAL thread_pool::worker * current_worker = 0;
+
+// Number of times an idle worker looks for work before going to sleep.
+static int const SPIN_ROUNDS = 64;
+
+// Number of times a thief retries a victim after losing a race.
+static int const STEAL_RETRIES = 4;
+
+TWINE_ANONS_END
+
+
+
+thread_pool::thread_pool(uint32_t size /* = 0 */)
+  : m_workers()
+  , m_queue_mutex()
+  , m_queue()
+  , m_queue_size(0)
+  , m_sleep_mutex()
+  , m_sleep_condition()
+  , m_idle_condition()
+  , m_sleepers(0)
+  , m_pending(0)
+  , m_stopping(0)
+{
+  if (!size) {
+    size = thread::hardware_concurrency();
+  }
+  if (!size) {
+    size = 1;
+  }
+
+  // All workers must exist before the first one starts stealing.
+  m_workers.reserve(size);
+  for (uint32_t i = 0 ; i < size ; ++i) {
+    m_workers.push_back(new worker(this, i));
+  }
+
+  for (uint32_t i = 0 ; i < size ; ++i) {
+    worker * w = m_workers[i];
+    w->m_thread.set_func(thread::binder<worker, &worker::run>::function, w);
+    w->m_thread.start();
+  }
+}
+
+
+
+thread_pool::~thread_pool()
+{
+  m_stopping.store(1);
+  {
+    scoped_lock<mutex> lock(m_sleep_mutex);
+    m_sleep_condition.notify_all();
+  }
+
+  for (size_t i = 0 ; i < m_workers.size() ; ++i) {
+    m_workers[i]->m_thread.join();
+  }
+  for (size_t i = 0 ; i < m_workers.size() ; ++i) {
+    delete m_workers[i];
+  }
+}
+
+
+
+bool
+thread_pool::submit(function func, void * baton /* = nullptr */)
+{
+  if (!func) {
+    return false;
+  }
+
+  detail::job j;
+  j.m_func = func;
+  j.m_baton = baton;
+
+  worker * w = TWINE_ANONS(current_worker);
+  if (w && w->m_pool == this) {
+    // Fast path: push onto the worker's own deque.
+    m_pending.fetch_add(1, memory_order_relaxed);
+    w->m_deque.push(j);
+  }
+  else {
+    if (m_stopping.load()) {
+      return false;
+    }
+
+    m_pending.fetch_add(1, memory_order_relaxed);
+    scoped_lock<mutex> lock(m_queue_mutex);
+    m_queue.push_back(j);
+    m_queue_size.fetch_add(1, memory_order_release);
+  }
+
+  signal_work();
+  return true;
+}
+
+
+
+void
+thread_pool::wait()
+{
+  scoped_lock<mutex> lock(m_sleep_mutex);
+  while (m_pending.load() > 0) {
+    m_idle_condition.wait(lock);
+  }
+}
+
+
+
+bool
+thread_pool::run_one()
+{
+  worker * w = TWINE_ANONS(current_worker);
+  if (w && w->m_pool != this) {
+    w = nullptr;
+  }
+
+  detail::job j;
+  if (!find_job(w, j)) {
+    return false;
+  }
+  run_job(j);
+  return true;
+}
+
+
+
+uint32_t
+thread_pool::size() const
+{
+  return uint32_t(m_workers.size());
+}
+
+
+
+bool
+thread_pool::is_worker() const
+{
+  worker * w = TWINE_ANONS(current_worker);
+  return (w && w->m_pool == this);
+}
+
+
+
+void
+thread_pool::worker_loop(worker & w)
+{
+  TWINE_ANONS(current_worker) = &w;
+
+  detail::job j;
+  while (true) {
+    // Look for work a few times before going to sleep; jobs often come in
+    // bursts.
+    bool found = false;
+    for (int i = 0 ; i < TWINE_ANONS(SPIN_ROUNDS) && !found ; ++i) {
+      found = find_job(&w, j);
+      if (!found) {
+        detail::cpu_relax();
+      }
+    }
+    if (found) {
+      run_job(j);
+      continue;
+    }
+
+    // Announce that we're going to sleep before the final check for work;
+    // submit() checks for sleepers after publishing work, so one of the two
+    // sides is guaranteed to see the other.
+    scoped_lock<mutex> lock(m_sleep_mutex);
+    m_sleepers.fetch_add(1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!have_work()) {
+      if (m_stopping.load()) {
+        m_sleepers.fetch_sub(1);
+        break;
+      }
+      m_sleep_condition.wait(lock);
+    }
+    m_sleepers.fetch_sub(1);
+  }
+
+  TWINE_ANONS(current_worker) = nullptr;
+}
+
+
+
+bool
+thread_pool::find_job(worker * w, detail::job & j)
+{
+  // Our own deque first; it's the cheapest and has the warmest caches.
+  if (w && w->m_deque.take(j)) {
+    return true;
+  }
+
+  // Then the shared queue.
+  if (m_queue_size.load(memory_order_acquire) > 0) {
+    scoped_lock<mutex> lock(m_queue_mutex);
+    if (!m_queue.empty()) {
+      j = m_queue.front();
+      m_queue.pop_front();
+      m_queue_size.fetch_sub(1, memory_order_relaxed);
+      return true;
+    }
+  }
+
+  // Finally, steal.
+  return steal_job(w, j);
+}
+
+
+
+bool
+thread_pool::steal_job(worker * w, detail::job & j)
+{
+  size_t count = m_workers.size();
+  size_t start = w ? w->next_random() : size_t(this_thread::get_id());
+
+  for (size_t i = 0 ; i < count ; ++i) {
+    worker * victim = m_workers[(start + i) % count];
+    if (victim == w) {
+      continue;
+    }
+
+    for (int retry = 0 ; retry < TWINE_ANONS(STEAL_RETRIES) ; ++retry) {
+      detail::work_stealing_deque::steal_result res = victim->m_deque.steal(j);
+      if (detail::work_stealing_deque::STEAL_SUCCESS == res) {
+        return true;
+      }
+      if (detail::work_stealing_deque::STEAL_EMPTY == res) {
+        break;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+
+bool
+thread_pool::have_work() const
+{
+  if (m_queue_size.load() > 0) {
+    return true;
+  }
+  for (size_t i = 0 ; i < m_workers.size() ; ++i) {
+    if (!m_workers[i]->m_deque.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+
+void
+thread_pool::run_job(detail::job const & j)
+{
+  // Behave like threads do - terminate on any exception.
+  try {
+    j.m_func(j.m_baton);
+  } catch (...) {
+    std::terminate();
+  }
+
+  if (1 == m_pending.fetch_sub(1)) {
+    scoped_lock<mutex> lock(m_sleep_mutex);
+    m_idle_condition.notify_all();
+  }
+}
+
+
+
+void
+thread_pool::signal_work()
+{
+  atomic_thread_fence(memory_order_seq_cst);
+  if (m_sleepers.load(memory_order_relaxed) > 0) {
+    scoped_lock<mutex> lock(m_sleep_mutex);
+    m_sleep_condition.notify_one();
+  }
+}
+
+} // namespace twine
@@ -0,0 +1,170 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_THREAD_POOL_H
+#define TWINE_THREAD_POOL_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <deque>
+#include <vector>
+
+#include <twine/noncopyable.h>
+#include <twine/atomic.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+#include <twine/thread.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+
+/**
+ * Forward declarations
+ **/
+namespace detail {
+struct job;
+} // namespace detail
+
+
+/**
+ * Thread pool class
+ *
+ * A thread pool runs jobs on a fixed set of long-lived worker threads rather
+ * than starting a thread of execution per job. Jobs are the same function and
+ * baton pairs that a thread runs, so anything you'd pass to a thread (including
+ * thread::binder functions) can be submitted to a pool instead:
+ *
+ *   thread_pool pool;
+ *   pool.submit(my_func, my_baton);
+ *   pool.submit(thread::binder<foo, &foo::bar>::function, &my_foo);
+ *   pool.wait();
+ *
+ * Each worker owns a work stealing deque. Jobs submitted from within a worker
+ * go onto that worker's own deque, which costs no more than a few atomic
+ * operations. Idle workers steal from the deques of randomly chosen victims.
+ * Jobs submitted from other threads go through a shared queue, from which all
+ * workers pick up work.
+ *
+ * Workers that find no work go to sleep; they're only woken when work gets
+ * submitted, and the submitting side only signals when it knows a worker
+ * sleeps.
+ *
+ * Jobs must not throw; as with threads, an exception escaping a job
+ * terminates the program.
+ **/
+class thread_pool
+  : public twine::noncopyable
+{
+public:
+  /***************************************************************************
+   * Typedefs
+   **/
+  // Jobs are functions of the same type threads run.
+  typedef thread::function function;
+
+  /***************************************************************************
+   * Constructor/destructor
+   **/
+  /**
+   * Create a thread pool with the given number of worker threads. If the
+   * number is zero, thread::hardware_concurrency() workers are started (or a
+   * single one, if that number cannot be determined).
+   **/
+  explicit thread_pool(uint32_t size = 0);
+
+  /**
+   * The destructor runs all jobs still queued before joining the workers.
+   **/
+  ~thread_pool();
+
+  /***************************************************************************
+   * Main interface
+   **/
+  /**
+   * Submit a job to the pool. Returns false if the function is a null pointer
+   * or the pool is shutting down, true otherwise.
+   **/
+  bool submit(function func, void * baton = nullptr);
+
+  /**
+   * Block until all submitted jobs have finished. Must not be called from
+   * within a job; use run_one() to help out instead.
+   **/
+  void wait();
+
+  /**
+   * Run a single pending job on the calling thread, if there is one. Returns
+   * true if a job was run. This lets threads that wait for the pool's results
+   * - including the pool's own workers - contribute instead of blocking.
+   **/
+  bool run_one();
+
+  /**
+   * Returns the number of worker threads.
+   **/
+  uint32_t size() const;
+
+  /**
+   * Returns true if the calling thread is one of this pool's workers.
+   **/
+  bool is_worker() const;
+
+  /***************************************************************************
+   * Forward declarations
+   **/
+  struct worker;
+
+private:
+  friend struct worker;
+
+  void worker_loop(worker & w);
+  bool find_job(worker * w, detail::job & j);
+  bool steal_job(worker * w, detail::job & j);
+  bool have_work() const;
+  void run_job(detail::job const & j);
+  void signal_work();
+
+  /***************************************************************************
+   * Data
+   **/
+  std::vector<worker *>         m_workers;
+
+  // Jobs submitted from outside the pool
+  twine::mutex                  m_queue_mutex;
+  std::deque<detail::job>       m_queue;
+  twine::atomic<uint32_t>       m_queue_size;
+
+  // Sleeping and idle state
+  twine::mutex                  m_sleep_mutex;
+  twine::condition              m_sleep_condition;
+  twine::condition              m_idle_condition;
+  twine::atomic<uint32_t>       m_sleepers;
+  twine::atomic<uint32_t>       m_pending;
+  twine::atomic<uint32_t>       m_stopping;
+};
+
+} // namespace twine
+
+#endif // guard
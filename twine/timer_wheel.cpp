@@ -0,0 +1,414 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/timer_wheel.h>
+
+#include <twine/scoped_lock.h>
+#include <twine/tasklet.h>
+
+namespace twine {
+
+TWINE_ANONS_START
+
+static uint64_t const NO_EVENT = ~uint64_t(0);
+
+TWINE_ANONS_END
+
+
+/******************************************************************************
+ * Timer entries
+ **/
+timer_wheel::timer::timer()
+  : m_wheel(nullptr)
+  , m_prev(this)
+  , m_next(this)
+  , m_expires(0)
+  , m_func(nullptr)
+  , m_baton(nullptr)
+{
+}
+
+
+
+timer_wheel::timer::~timer()
+{
+  timer_wheel * wheel = m_wheel.load();
+  if (wheel) {
+    wheel->cancel(*this);
+  }
+}
+
+
+
+bool
+timer_wheel::timer::pending() const
+{
+  timer_wheel * wheel = m_wheel.load();
+  if (!wheel) {
+    return false;
+  }
+
+  scoped_lock<mutex> lock(wheel->m_mutex);
+  return (m_next != this);
+}
+
+
+
+/******************************************************************************
+ * Timer wheel
+ **/
+timer_wheel::timer_wheel(chrono::nanoseconds const & resolution
+    /* = chrono::milliseconds(1) */)
+  : m_resolution(resolution)
+  , m_start(chrono::monotonic_now())
+  , m_tick(0)
+  , m_size(0)
+  , m_expired()
+  , m_mutex()
+  , m_condition()
+  , m_callback_done()
+  , m_running(nullptr)
+  , m_next_event(TWINE_ANONS(NO_EVENT))
+  , m_stopping(false)
+  , m_thread()
+  , m_thread_id(thread::bad_thread_id)
+{
+  if (m_resolution <= chrono::nanoseconds(0)) {
+    m_resolution = chrono::nanoseconds(1);
+  }
+
+  m_thread.set_func(thread::binder<timer_wheel, &timer_wheel::run>::function,
+      this);
+  m_thread.start();
+}
+
+
+
+timer_wheel::~timer_wheel()
+{
+  {
+    scoped_lock<mutex> lock(m_mutex);
+    m_stopping = true;
+    m_condition.notify_one();
+  }
+  m_thread.join();
+
+  // Orphan all pending timers.
+  scoped_lock<mutex> lock(m_mutex);
+  for (int level = 0 ; level < LEVELS ; ++level) {
+    for (int slot = 0 ; slot < LEVEL_SIZE ; ++slot) {
+      timer & head = m_slots[level][slot];
+      while (head.m_next != &head) {
+        timer * t = head.m_next;
+        unlink(*t);
+        t->m_wheel.store(nullptr);
+      }
+    }
+  }
+  while (m_expired.m_next != &m_expired) {
+    timer * t = m_expired.m_next;
+    unlink(*t);
+    t->m_wheel.store(nullptr);
+  }
+  m_size = 0;
+}
+
+
+
+bool
+timer_wheel::cancel(timer & t)
+{
+  scoped_lock<mutex> lock(m_mutex);
+
+  if (t.m_wheel.load() != this) {
+    return false;
+  }
+
+  // If the timer's callback is running right now, wait for it. The timer
+  // thread itself cannot wait for its own callback, of course; instead the
+  // callback must not touch the timer any longer once it returns.
+  if (this_thread::get_id() == m_thread_id) {
+    if (m_running == &t) {
+      m_running = nullptr;
+    }
+  }
+  else {
+    while (m_running == &t) {
+      m_callback_done.wait(lock);
+    }
+  }
+
+  // The callback may have rescheduled the timer.
+  bool pending = (t.m_next != &t);
+  if (pending) {
+    unlink(t);
+    --m_size;
+  }
+  t.m_wheel.store(nullptr);
+  return pending;
+}
+
+
+
+chrono::nanoseconds
+timer_wheel::resolution() const
+{
+  return m_resolution;
+}
+
+
+
+size_t
+timer_wheel::size() const
+{
+  scoped_lock<mutex> lock(m_mutex);
+  return m_size;
+}
+
+
+
+bool
+timer_wheel::schedule_nsecs(timer & t, chrono::nanoseconds const & delay,
+    callback func, void * baton)
+{
+  if (!func) {
+    return false;
+  }
+
+  scoped_lock<mutex> lock(m_mutex);
+
+  timer_wheel * wheel = t.m_wheel.load();
+  if (wheel && wheel != this) {
+    return false;
+  }
+  if (t.m_next != &t) {
+    unlink(t);
+    --m_size;
+  }
+
+  // An empty wheel may have fallen behind; nothing needs processing between
+  // the last processed tick and now.
+  uint64_t now_tick = current_tick();
+  if (!m_size && m_tick < now_tick) {
+    m_tick = now_tick;
+  }
+
+  // The timer must not fire before delay has elapsed, so round up to the
+  // next tick boundary.
+  chrono::nanoseconds offset = chrono::monotonic_now() - m_start;
+  if (delay > chrono::nanoseconds(0)) {
+    offset += delay;
+  }
+  uint64_t expires = uint64_t((offset.raw() + m_resolution.raw() - 1)
+      / m_resolution.raw());
+  if (expires < m_tick) {
+    expires = m_tick;
+  }
+
+  t.m_expires = expires;
+  t.m_func = func;
+  t.m_baton = baton;
+  t.m_wheel.store(this);
+  insert(t);
+  ++m_size;
+
+  // Only wake the timer thread if it would otherwise sleep past this timer.
+  if (expires < m_next_event) {
+    m_condition.notify_one();
+  }
+  return true;
+}
+
+
+
+void
+timer_wheel::run(void *)
+{
+  scoped_lock<mutex> lock(m_mutex);
+  m_thread_id = this_thread::get_id();
+
+  while (!m_stopping) {
+    // Process all ticks up to now.
+    uint64_t now_tick = current_tick();
+    while (m_size && m_tick <= now_tick) {
+      advance();
+    }
+
+    // Fire expired timers one at a time, so that cancel() can still catch
+    // those that haven't fired yet.
+    while (m_expired.m_next != &m_expired) {
+      timer * t = m_expired.m_next;
+      unlink(*t);
+      --m_size;
+
+      callback func = t->m_func;
+      void * baton = t->m_baton;
+      m_running = t;
+
+      lock.unlock();
+      func(baton);
+      lock.lock();
+
+      // Unless the callback cancelled, destroyed or rescheduled the timer, it
+      // is done now.
+      if (m_running == t && t->m_next == t) {
+        t->m_wheel.store(nullptr);
+      }
+      m_running = nullptr;
+      m_callback_done.notify_all();
+    }
+
+    // Sleep until the next event.
+    m_next_event = next_event();
+    if (TWINE_ANONS(NO_EVENT) == m_next_event) {
+      m_condition.wait(lock);
+    }
+    else {
+      chrono::nanoseconds wake = m_start + chrono::nanoseconds(
+          chrono::default_repr_t(m_next_event) * m_resolution.raw());
+      m_condition.wait_until(lock, wake);
+    }
+    m_next_event = TWINE_ANONS(NO_EVENT);
+  }
+}
+
+
+
+uint64_t
+timer_wheel::current_tick() const
+{
+  chrono::nanoseconds offset = chrono::monotonic_now() - m_start;
+  if (offset < chrono::nanoseconds(0)) {
+    return 0;
+  }
+  return uint64_t(offset.raw() / m_resolution.raw());
+}
+
+
+
+void
+timer_wheel::insert(timer & t)
+{
+  uint64_t delta = t.m_expires - m_tick;
+  uint64_t expires = t.m_expires;
+
+  int level = 0;
+  while (level < LEVELS - 1 && delta >= (uint64_t(1) << (LEVEL_BITS * (level + 1)))) {
+    ++level;
+  }
+
+  // Timers beyond the wheel's range wait in the last slot of the top level,
+  // and get re-inserted when that slot is cascaded.
+  uint64_t range = uint64_t(1) << (LEVEL_BITS * LEVELS);
+  if (delta >= range) {
+    expires = m_tick + range - 1;
+  }
+
+  timer & head = m_slots[level][(expires >> (LEVEL_BITS * level)) & LEVEL_MASK];
+  t.m_prev = head.m_prev;
+  t.m_next = &head;
+  head.m_prev->m_next = &t;
+  head.m_prev = &t;
+}
+
+
+
+void
+timer_wheel::unlink(timer & t)
+{
+  t.m_prev->m_next = t.m_next;
+  t.m_next->m_prev = t.m_prev;
+  t.m_prev = &t;
+  t.m_next = &t;
+}
+
+
+
+void
+timer_wheel::cascade(int level)
+{
+  timer & head = m_slots[level][(m_tick >> (LEVEL_BITS * level)) & LEVEL_MASK];
+  while (head.m_next != &head) {
+    timer * t = head.m_next;
+    unlink(*t);
+    insert(*t);
+  }
+}
+
+
+
+void
+timer_wheel::advance()
+{
+  // Whenever a level wraps around, the next slot of the level above gets
+  // distributed over the levels below.
+  for (int level = 1 ; level < LEVELS ; ++level) {
+    if (m_tick & ((uint64_t(1) << (LEVEL_BITS * level)) - 1)) {
+      break;
+    }
+    cascade(level);
+  }
+
+  // Move everything in the current slot to the expired list.
+  timer & head = m_slots[0][m_tick & LEVEL_MASK];
+  while (head.m_next != &head) {
+    timer * t = head.m_next;
+    unlink(*t);
+    t->m_prev = m_expired.m_prev;
+    t->m_next = &m_expired;
+    m_expired.m_prev->m_next = t;
+    m_expired.m_prev = t;
+  }
+
+  ++m_tick;
+}
+
+
+
+uint64_t
+timer_wheel::next_event() const
+{
+  if (!m_size) {
+    return TWINE_ANONS(NO_EVENT);
+  }
+
+  // The next non-empty slot in the lowest level, or else the point at which
+  // the lowest level wraps and higher levels need to be cascaded.
+  uint64_t tick = m_tick;
+  do {
+    timer const & head = m_slots[0][tick & LEVEL_MASK];
+    if (head.m_next != &head) {
+      return tick;
+    }
+    ++tick;
+  } while (tick & LEVEL_MASK);
+
+  return tick;
+}
+
+
+
+void
+timer_wheel::wakeup_tasklet(void * baton)
+{
+  static_cast<tasklet *>(baton)->wakeup();
+}
+
+} // namespace twine
@@ -0,0 +1,231 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_TIMER_WHEEL_H
+#define TWINE_TIMER_WHEEL_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/noncopyable.h>
+#include <twine/mutex.h>
+#include <twine/condition.h>
+#include <twine/chrono.h>
+#include <twine/thread.h>
+#include <twine/atomic.h>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+
+/***************************************************************************
+ * Forward declarations
+ **/
+class tasklet;
+
+
+/**
+ * Timer wheel class
+ *
+ * A hierarchical timing wheel that fires callbacks after a delay. All timers
+ * of a wheel are driven by a single timer thread, so the number of kernel
+ * timers does not grow with the number of pending timers; the timer thread
+ * only wakes up when timers expire or need to be moved between levels.
+ *
+ * Timers are kept in intrusive lists, one per wheel slot, so scheduling and
+ * cancelling are O(1) operations that do not allocate. The timer objects
+ * themselves are owned by the caller:
+ *
+ *   void on_timeout(void * baton) { ... }
+ *
+ *   timer_wheel wheel;
+ *   timer_wheel::timer t;
+ *   wheel.schedule(t, chrono::milliseconds(100), on_timeout, baton);
+ *   ...
+ *   wheel.cancel(t);
+ *
+ * Callbacks run on the timer thread, and should therefore be short. They
+ * may (re-)schedule timers, including their own.
+ *
+ * The wheel's resolution determines the length of a tick; delays are rounded
+ * up to whole ticks. Timers never fire early, but may fire up to a tick late.
+ **/
+class timer_wheel
+  : public twine::noncopyable
+{
+public:
+  /***************************************************************************
+   * Typedefs
+   **/
+  // Callback type
+  typedef void (*callback)(void *);
+
+  /**
+   * Timer entries. A timer can be scheduled with at most one wheel at a time.
+   * Destroying a scheduled timer cancels it, and waits for its callback to
+   * finish if it is running on another thread.
+   **/
+  class timer
+    : public twine::noncopyable
+  {
+  public:
+    timer();
+    ~timer();
+
+    /**
+     * Returns true if the timer is scheduled and has not fired yet.
+     **/
+    bool pending() const;
+
+  private:
+    friend class timer_wheel;
+
+    // Set while the timer is scheduled or its callback runs.
+    twine::atomic<timer_wheel *>  m_wheel;
+    timer *                       m_prev;
+    timer *                       m_next;
+    uint64_t                      m_expires;
+    callback                      m_func;
+    void *                        m_baton;
+  };
+
+  /***************************************************************************
+   * Constructor/destructor
+   **/
+  /**
+   * Create a timer wheel with the given tick length, and start its timer
+   * thread.
+   **/
+  explicit timer_wheel(chrono::nanoseconds const & resolution
+      = chrono::milliseconds(1));
+
+  /**
+   * Stops the timer thread. Timers that are still pending are cancelled
+   * without firing.
+   **/
+  ~timer_wheel();
+
+  /***************************************************************************
+   * Main interface
+   **/
+  /**
+   * Schedule the timer to invoke func with the given baton after the delay
+   * has elapsed. If the timer was already pending, it is rescheduled. Returns
+   * false if func is a null pointer, or the timer is pending in a different
+   * wheel.
+   **/
+  template <typename durationT>
+  inline bool schedule(timer & t, durationT const & delay, callback func,
+      void * baton = nullptr)
+  {
+    return schedule_nsecs(t,
+        delay.template convert<twine::chrono::nanoseconds>(), func, baton);
+  }
+
+  /**
+   * Schedule the timer to call the tasklet's wakeup() function after the
+   * delay has elapsed.
+   **/
+  template <typename durationT>
+  inline bool schedule_wakeup(timer & t, durationT const & delay,
+      tasklet & tasklet)
+  {
+    return schedule_nsecs(t,
+        delay.template convert<twine::chrono::nanoseconds>(),
+        &timer_wheel::wakeup_tasklet, &tasklet);
+  }
+
+  /**
+   * Cancel the timer. Returns true if the timer was pending and is now
+   * cancelled, false if it was not pending. If the timer's callback is
+   * running on the timer thread at this time, cancel() waits for it to
+   * complete (unless called from that callback).
+   **/
+  bool cancel(timer & t);
+
+  /**
+   * Returns the wheel's tick length.
+   **/
+  chrono::nanoseconds resolution() const;
+
+  /**
+   * Returns the number of pending timers.
+   **/
+  size_t size() const;
+
+private:
+  friend class timer;
+
+  /***************************************************************************
+   * Constants
+   **/
+  enum
+  {
+    LEVEL_BITS  = 8,
+    LEVEL_SIZE  = 1 << LEVEL_BITS,
+    LEVEL_MASK  = LEVEL_SIZE - 1,
+    LEVELS      = 4
+  };
+
+  /***************************************************************************
+   * Implementation functions
+   **/
+  bool schedule_nsecs(timer & t, chrono::nanoseconds const & delay,
+      callback func, void * baton);
+
+  void run(void *);
+
+  uint64_t current_tick() const;
+  void insert(timer & t);
+  void unlink(timer & t);
+  void cascade(int level);
+  void advance();
+  uint64_t next_event() const;
+
+  static void wakeup_tasklet(void * baton);
+
+  /***************************************************************************
+   * Data
+   **/
+  chrono::nanoseconds   m_resolution;
+  chrono::nanoseconds   m_start;
+  uint64_t              m_tick;     // All ticks before this one are processed.
+  size_t                m_size;
+
+  timer                 m_slots[LEVELS][LEVEL_SIZE];
+  timer                 m_expired;
+
+  mutable twine::mutex  m_mutex;
+  twine::condition      m_condition;
+  twine::condition      m_callback_done;
+  timer *               m_running;  // Timer whose callback currently runs.
+  uint64_t              m_next_event; // Tick the timer thread sleeps until.
+  bool                  m_stopping;
+
+  twine::thread         m_thread;
+  thread::id            m_thread_id;
+};
+
+} // namespace twine
+
+#endif // guard
@@ -0,0 +1,183 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/tsc_clock.h>
+
+namespace twine {
+namespace chrono {
+
+namespace detail {
+
+tsc_calibration tsc_calibration_data;
+
+} // namespace detail
+
+
+TWINE_ANONS_START
+
+typedef detail::tsc_calibration calibration;
+
+static int const SAMPLE_ATTEMPTS = 5;
+
+/**
+ * Samples the counter and the monotonic clock as closely together as
+ * possible, taking the counter value halfway through reading the clock. If
+ * the thread gets preempted while sampling, the error easily dominates the
+ * calibration, so keep the tightest of several attempts.
+ **/
+static void
+sample(uint64_t & ticks, nanoseconds & nsecs)
+{
+  uint64_t best_window = ~uint64_t(0);
+  for (int i = 0 ; i < SAMPLE_ATTEMPTS ; ++i) {
+    uint64_t const before = detail::read_tsc();
+    nanoseconds const now = monotonic_now();
+    uint64_t const after = detail::read_tsc();
+
+    if (after - before < best_window) {
+      best_window = after - before;
+      ticks = before + (best_window / 2);
+      nsecs = now;
+    }
+  }
+}
+
+
+/**
+ * Takes the reference point when the library is loaded.
+ **/
+struct reference_point
+{
+  reference_point()
+  {
+    calibration & cal = detail::tsc_calibration_data;
+
+    if (!detail::read_tsc() || !detail::tsc_invariant()) {
+      cal.m_state.store(calibration::TSC_UNUSABLE);
+      return;
+    }
+
+    nanoseconds nsecs;
+    sample(cal.m_base_ticks, nsecs);
+    cal.m_base_nsecs = nsecs.raw();
+    cal.m_state.store(calibration::TSC_REFERENCED);
+  }
+};
+
+static reference_point const startup_reference = reference_point();
+
+TWINE_ANONS_END
+
+
+
+namespace detail {
+
+nanoseconds
+tsc_calibrate()
+{
+  calibration & cal = tsc_calibration_data;
+
+  // Without a reference point, or while another thread is calibrating, there
+  // is nothing to do.
+  if (cal.m_state.load() != calibration::TSC_REFERENCED) {
+    return monotonic_now();
+  }
+
+  uint64_t ticks = 0;
+  nanoseconds now;
+  TWINE_ANONS(sample)(ticks, now);
+
+  default_repr_t const elapsed = now.raw() - cal.m_base_nsecs;
+  if (elapsed < milliseconds(TWINE_TSC_CALIBRATION_PERIOD).as<nanoseconds>()) {
+    return now;
+  }
+
+  uint32_t expected = calibration::TSC_REFERENCED;
+  if (!cal.m_state.compare_exchange(expected, calibration::TSC_CALIBRATING)) {
+    return now;
+  }
+
+  // A counter that did not advance, or went backwards, is of no use.
+  if (ticks <= cal.m_base_ticks) {
+    cal.m_state.store(calibration::TSC_UNUSABLE);
+    return now;
+  }
+
+  // Nanoseconds per tick in 32.32 fixed point. The calculation happens once,
+  // so floating point is fine here.
+  double const nsecs_per_tick = double(elapsed)
+    / double(ticks - cal.m_base_ticks);
+  cal.m_mult = uint64_t(nsecs_per_tick * 4294967296.0);
+
+  cal.m_state.store(calibration::TSC_CALIBRATED, memory_order_release);
+  return now;
+}
+
+} // namespace detail
+
+
+
+bool
+tsc_clock::usable()
+{
+  return detail::tsc_calibration_data.m_state.load(memory_order_acquire)
+    == calibration::TSC_CALIBRATED;
+}
+
+
+
+bool
+tsc_clock::calibrate()
+{
+  calibration & cal = detail::tsc_calibration_data;
+
+  while (true) {
+    uint32_t state = cal.m_state.load(memory_order_acquire);
+    if (calibration::TSC_CALIBRATED == state
+        || calibration::TSC_UNUSABLE == state
+        || calibration::TSC_UNINITIALIZED == state)
+    {
+      return calibration::TSC_CALIBRATED == state;
+    }
+
+    detail::tsc_calibrate();
+    if (cal.m_state.load(memory_order_acquire) == state) {
+      // Still waiting for the calibration period to pass, or for another
+      // thread to finish calibrating.
+      sleep(milliseconds(1).convert<nanoseconds>());
+    }
+  }
+}
+
+
+
+uint64_t
+tsc_clock::frequency()
+{
+  if (!usable()) {
+    return 0;
+  }
+
+  // m_mult is nanoseconds per tick in 32.32 fixed point.
+  calibration const & cal = detail::tsc_calibration_data;
+  return uint64_t((1000000000.0 * 4294967296.0) / double(cal.m_mult));
+}
+
+}} // namespace twine::chrono
@@ -0,0 +1,207 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_TSC_CLOCK_H
+#define TWINE_TSC_CLOCK_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/twine.h>
+
+#include <twine/chrono.h>
+#include <twine/atomic.h>
+
+/**
+ * How long the time stamp counter is observed against the monotonic clock
+ * before it is trusted, in milliseconds. Longer periods make for a more
+ * precise conversion factor.
+ **/
+#if !defined(TWINE_TSC_CALIBRATION_PERIOD)
+#  define TWINE_TSC_CALIBRATION_PERIOD 10
+#endif
+
+namespace twine {
+namespace chrono {
+
+/**
+ * Clock based on the CPU's time stamp counter; that is the TSC on x86, and
+ * the virtual counter (CNTVCT) on 64 bit ARM. Reading it does not involve the
+ * kernel or the vDSO, which makes it considerably cheaper than now() or
+ * monotonic_now() when timestamps are needed at a high rate, e.g. for latency
+ * accounting.
+ *
+ * The counter is calibrated against monotonic_now(): a reference point is
+ * taken when the library is loaded, and the first call to now() made
+ * TWINE_TSC_CALIBRATION_PERIOD milliseconds or more later derives the
+ * conversion factor. Ticks are converted to nanoseconds with that factor in
+ * 32.32 fixed point, so that now() needs neither division nor floating point.
+ *
+ * Until calibration is complete, and on CPUs without an invariant counter -
+ * one that ticks at a constant rate regardless of frequency scaling or sleep
+ * states - now() falls back to monotonic_now(). Timestamps share the epoch of
+ * monotonic_now() either way, but may drift from it very slightly over time;
+ * use them for measuring intervals, not for comparing against other clocks.
+ **/
+class tsc_clock
+{
+public:
+  /**
+   * The raw counter value, or 0 if no counter is available.
+   **/
+  static inline uint64_t ticks();
+
+  /**
+   * The current time in nanoseconds; see above.
+   **/
+  static inline nanoseconds now();
+
+  /**
+   * Returns true if the counter is calibrated, i.e. now() no longer falls
+   * back to monotonic_now().
+   **/
+  static bool usable();
+
+  /**
+   * Wait until the calibration completes, if it has not yet. Returns the same
+   * as usable() afterwards.
+   **/
+  static bool calibrate();
+
+  /**
+   * The calibrated counter frequency in ticks per second, or 0 if the counter
+   * is not usable.
+   **/
+  static uint64_t frequency();
+};
+
+
+/**
+ * Shorthand for tsc_clock::now().
+ **/
+inline nanoseconds fast_now();
+
+
+namespace detail {
+
+/**
+ * Calibration data. The state is only ever advanced, and the remaining fields
+ * are written before the state becomes TSC_CALIBRATED.
+ **/
+struct tsc_calibration
+{
+  enum state
+  {
+    TSC_UNINITIALIZED = 0,  // No reference point yet.
+    TSC_REFERENCED,         // Reference point taken.
+    TSC_CALIBRATING,        // Some thread is calculating the factor.
+    TSC_CALIBRATED,         // The counter is usable.
+    TSC_UNUSABLE            // The counter is not invariant.
+  };
+
+  twine::atomic<uint32_t> m_state;
+  uint64_t                m_base_ticks;
+  default_repr_t          m_base_nsecs;
+  uint64_t                m_mult;
+};
+
+extern tsc_calibration tsc_calibration_data;
+
+/**
+ * Platform functions; read_tsc() returns 0 if there is no counter, and
+ * tsc_invariant() returns true if the counter ticks at a constant rate.
+ **/
+inline uint64_t read_tsc();
+bool tsc_invariant();
+
+/**
+ * Slow path of tsc_clock::now(); completes the calibration if the calibration
+ * period has passed. Returns monotonic_now().
+ **/
+nanoseconds tsc_calibrate();
+
+/**
+ * Returns (ticks * mult) >> 32 without overflowing for any result that fits
+ * into 64 bits.
+ **/
+inline uint64_t
+tsc_scale(uint64_t ticks, uint64_t mult)
+{
+  uint64_t const t_hi = ticks >> 32;
+  uint64_t const t_lo = ticks & 0xffffffffULL;
+  uint64_t const m_hi = mult >> 32;
+  uint64_t const m_lo = mult & 0xffffffffULL;
+
+  return ((t_hi * m_hi) << 32) + (t_hi * m_lo) + (t_lo * m_hi)
+    + ((t_lo * m_lo) >> 32);
+}
+
+} // namespace detail
+
+
+
+uint64_t
+tsc_clock::ticks()
+{
+  return detail::read_tsc();
+}
+
+
+
+nanoseconds
+tsc_clock::now()
+{
+  detail::tsc_calibration const & cal = detail::tsc_calibration_data;
+  if (cal.m_state.load(memory_order_acquire)
+      != detail::tsc_calibration::TSC_CALIBRATED)
+  {
+    return detail::tsc_calibrate();
+  }
+
+  // Counters on different cores may be a few ticks apart; never go back
+  // before the reference point.
+  int64_t delta = int64_t(detail::read_tsc() - cal.m_base_ticks);
+  if (delta < 0) {
+    delta = 0;
+  }
+
+  return nanoseconds(cal.m_base_nsecs
+      + default_repr_t(detail::tsc_scale(uint64_t(delta), cal.m_mult)));
+}
+
+
+
+nanoseconds
+fast_now()
+{
+  return tsc_clock::now();
+}
+
+}} // namespace twine::chrono
+
+
+#if defined(TWINE_WIN32)
+  #include <twine/win32/tsc_clock.h>
+#elif defined(TWINE_POSIX)
+  #include <twine/posix/tsc_clock.h>
+#endif
+
+#endif // guard
@@ -77,4 +77,14 @@
 #  define TWINE_ANONS_END }
 #endif
 
+// Thread-local storage class specifier; C++98 compilers don't know about
+// thread_local, but all supported ones have an extension for it.
+#if !defined(TWINE_THREAD_LOCAL)
+#  if defined(_MSC_VER)
+#    define TWINE_THREAD_LOCAL __declspec(thread)
+#  else
+#    define TWINE_THREAD_LOCAL __thread
+#  endif
+#endif
+
 #endif // guard
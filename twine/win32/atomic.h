@@ -0,0 +1,249 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#ifndef TWINE_WIN32_ATOMIC_H
+#define TWINE_WIN32_ATOMIC_H
+
+#ifndef __cplusplus
+#error You are trying to include a C++ only header file
+#endif
+
+#include <twine/atomic.h>
+
+#include <string.h>
+
+namespace twine {
+namespace detail {
+
+/**
+ * The Interlocked family of functions are full barriers, so the memory order
+ * is ignored throughout. They operate on LONG or LONGLONG, so we dispatch on
+ * the size of the value type.
+ **/
+template <size_t SIZE>
+struct interlocked;
+
+template <>
+struct interlocked<4>
+{
+  typedef LONG type;
+
+  static inline type exchange(type volatile * target, type value)
+  {
+    return InterlockedExchange(target, value);
+  }
+
+  static inline type compare_exchange(type volatile * target, type desired,
+      type expected)
+  {
+    return InterlockedCompareExchange(target, desired, expected);
+  }
+};
+
+template <>
+struct interlocked<8>
+{
+  typedef LONGLONG type;
+
+  static inline type exchange(type volatile * target, type value)
+  {
+    return InterlockedExchange64(target, value);
+  }
+
+  static inline type compare_exchange(type volatile * target, type desired,
+      type expected)
+  {
+    return InterlockedCompareExchange64(target, desired, expected);
+  }
+};
+
+
+
+template <typename valueT>
+struct interlocked_value
+{
+  typedef interlocked<sizeof(valueT)>   ops;
+  typedef typename ops::type            type;
+
+  static inline type to(valueT value)
+  {
+    type result = type();
+    memcpy(&result, &value, sizeof(valueT));
+    return result;
+  }
+
+  static inline valueT from(type value)
+  {
+    valueT result;
+    memcpy(&result, &value, sizeof(valueT));
+    return result;
+  }
+};
+
+
+
+void
+cpu_relax()
+{
+  YieldProcessor();
+}
+
+} // namespace detail
+
+
+
+template <
+  typename valueT
+>
+atomic<valueT>::atomic(valueT const & value /* = valueT() */)
+  : m_value(value)
+{
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::load(memory_order /* = memory_order_seq_cst */) const
+{
+  MemoryBarrier();
+  valueT result = m_value;
+  MemoryBarrier();
+  return result;
+}
+
+
+
+template <
+  typename valueT
+>
+void
+atomic<valueT>::store(valueT value,
+    memory_order /* = memory_order_seq_cst */)
+{
+  exchange(value);
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::exchange(valueT value,
+    memory_order /* = memory_order_seq_cst */)
+{
+  typedef detail::interlocked_value<valueT> iv;
+  return iv::from(iv::ops::exchange(
+        reinterpret_cast<typename iv::type volatile *>(&m_value),
+        iv::to(value)));
+}
+
+
+
+template <
+  typename valueT
+>
+bool
+atomic<valueT>::compare_exchange(valueT & expected, valueT desired,
+    memory_order /* = memory_order_seq_cst */)
+{
+  typedef detail::interlocked_value<valueT> iv;
+  typename iv::type prev = iv::ops::compare_exchange(
+      reinterpret_cast<typename iv::type volatile *>(&m_value),
+      iv::to(desired), iv::to(expected));
+  if (prev == iv::to(expected)) {
+    return true;
+  }
+  expected = iv::from(prev);
+  return false;
+}
+
+
+
+// The arithmetic operations are implemented as compare-and-swap loops; that
+// keeps the number of required Interlocked variants small.
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::fetch_add(valueT value,
+    memory_order /* = memory_order_seq_cst */)
+{
+  valueT expected = load();
+  while (!compare_exchange(expected, valueT(expected + value))) {}
+  return expected;
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::fetch_sub(valueT value,
+    memory_order /* = memory_order_seq_cst */)
+{
+  valueT expected = load();
+  while (!compare_exchange(expected, valueT(expected - value))) {}
+  return expected;
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::fetch_or(valueT value,
+    memory_order /* = memory_order_seq_cst */)
+{
+  valueT expected = load();
+  while (!compare_exchange(expected, valueT(expected | value))) {}
+  return expected;
+}
+
+
+
+template <
+  typename valueT
+>
+valueT
+atomic<valueT>::fetch_and(valueT value,
+    memory_order /* = memory_order_seq_cst */)
+{
+  valueT expected = load();
+  while (!compare_exchange(expected, valueT(expected & value))) {}
+  return expected;
+}
+
+
+
+void
+atomic_thread_fence(memory_order /* = memory_order_seq_cst */)
+{
+  MemoryBarrier();
+}
+
+} // namespace twine
+
+#endif // guard
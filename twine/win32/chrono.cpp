@@ -18,6 +18,8 @@
  * PARTICULAR PURPOSE.
  **/
 #include <twine/chrono.h>
+#include <twine/tsc_clock.h>
+#include <twine/atomic.h>
 
 #include <meta/nullptr.h>
 
@@ -127,6 +129,24 @@ now()
 
 
 
+nanoseconds
+monotonic_now()
+{
+  // The performance counter is monotonic already; we only need to convert
+  // ticks to nanoseconds. Split into seconds and remainder, so that the
+  // multiplication cannot overflow for large counter values.
+  LARGE_INTEGER qpc;
+  QueryPerformanceCounter(&qpc);
+
+  int64_t const freq = global_reference.m_frequency.QuadPart;
+  int64_t const secs = qpc.QuadPart / freq;
+  int64_t const rem = qpc.QuadPart % freq;
+
+  return nanoseconds((secs * 1000000000) + ((rem * 1000000000) / freq));
+}
+
+
+
 bool
 sleep(nanoseconds const & nsec)
 {
@@ -150,4 +170,127 @@ sleep(nanoseconds const & nsec)
 }
 
 
+
+nanoseconds
+precise_sleep_margin()
+{
+  // Sleep() only has the resolution of the system timer, so the margin cannot
+  // be measured meaningfully; always spin for the maximum.
+  return microseconds(TWINE_PRECISE_SLEEP_MAX_SPIN);
+}
+
+
+
+bool
+precise_sleep_until(nanoseconds const & deadline)
+{
+  nanoseconds const block = deadline - precise_sleep_margin() - monotonic_now();
+  if (block > nanoseconds(0)) {
+    ::Sleep(DWORD(block.as<milliseconds>()));
+  }
+
+  while (monotonic_now() < deadline) {
+    twine::detail::cpu_relax();
+  }
+  return true;
+}
+
+
+
+bool
+precise_sleep(nanoseconds const & nsec)
+{
+  return precise_sleep_until(monotonic_now() + nsec);
+}
+
+
+
+system_clock::time_point
+system_clock::now()
+{
+  return time_point(chrono::now());
+}
+
+
+
+steady_clock::time_point
+steady_clock::now()
+{
+  return time_point(monotonic_now());
+}
+
+
+
+coarse_steady_clock::time_point
+coarse_steady_clock::now()
+{
+  // The tick count only has the resolution of the system timer, but is much
+  // cheaper to read than the performance counter.
+  return time_point(milliseconds(default_repr_t(GetTickCount64())));
+}
+
+
+
+TWINE_ANONS_START
+
+// FILETIME durations are in 100ns increments.
+static nanoseconds
+cpu_time(FILETIME const & kernel, FILETIME const & user)
+{
+  uint64_t total = ((uint64_t) kernel.dwLowDateTime)
+    + (((uint64_t) kernel.dwHighDateTime) << 32)
+    + ((uint64_t) user.dwLowDateTime)
+    + (((uint64_t) user.dwHighDateTime) << 32);
+  return nanoseconds(default_repr_t(total) * 100);
+}
+
+TWINE_ANONS_END
+
+
+
+thread_cpu_clock::time_point
+thread_cpu_clock::now()
+{
+  FILETIME creation, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+    return time_point();
+  }
+  return time_point(TWINE_ANONS(cpu_time)(kernel, user));
+}
+
+
+
+process_cpu_clock::time_point
+process_cpu_clock::now()
+{
+  FILETIME creation, exit, kernel, user;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+    return time_point();
+  }
+  return time_point(TWINE_ANONS(cpu_time)(kernel, user));
+}
+
+
+
+namespace detail {
+
+bool
+tsc_invariant()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+  // The "invariant TSC" bit of the advanced power management leaf.
+  int regs[4];
+  __cpuid(regs, 0x80000000);
+  if (unsigned(regs[0]) < 0x80000007) {
+    return false;
+  }
+  __cpuid(regs, 0x80000007);
+  return (regs[3] & (1 << 8)) != 0;
+#else
+  return false;
+#endif
+}
+
+} // namespace detail
+
 }} // namespace twine::chrono
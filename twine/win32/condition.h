@@ -111,6 +111,22 @@ condition::timed_wait(lockableT & lockable, durationT const & duration)
 }
 
 
+
+template <typename lockableT, typename durationT>
+bool
+condition::wait_until(lockableT & lockable, durationT const & deadline)
+{
+  // WaitForMultipleObjects() only takes relative timeouts.
+  twine::chrono::nanoseconds remaining =
+    deadline.template convert<twine::chrono::nanoseconds>()
+    - twine::chrono::monotonic_now();
+  if (remaining < twine::chrono::nanoseconds(0)) {
+    remaining = twine::chrono::nanoseconds(0);
+  }
+  return timed_wait(lockable, remaining);
+}
+
+
 void
 condition::notify_internal(int event)
 {
@@ -0,0 +1,115 @@
+/**
+ * This file is part of twine.
+ *
+ * Author(s): Jens Finkhaeuser <jens@finkhaeuser.de>
+ *
+ * Copyright (c) 2014 Unwesen Ltd.
+ * Copyright (c) 2015-2017 Jens Finkhaeuser.
+ *
+ * This software is licensed under the terms of the GNU GPLv3 for personal,
+ * educational and non-profit use. For all other uses, alternative license
+ * options are available. Please contact the copyright holder for additional
+ * information, stating your intended usage.
+ *
+ * You can find the full text of the GPLv3 in the COPYING file in this code
+ * distribution.
+ *
+ * This software is distributed on an "AS IS" BASIS, WITHOUT ANY WARRANTY;
+ * without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.
+ **/
+#include <twine/detail/fiber.h>
+
+#include <exception>
+
+#include <meta/nullptr.h>
+
+namespace twine {
+namespace detail {
+
+struct fiber
+{
+  LPVOID          m_handle;
+  bool            m_converted;
+  fiber_function  m_func;
+  void *          m_arg;
+
+  fiber()
+    : m_handle(nullptr)
+    , m_converted(false)
+    , m_func(nullptr)
+    , m_arg(nullptr)
+  {
+  }
+};
+
+
+TWINE_ANONS_START
+
+static VOID CALLBACK fiber_trampoline(LPVOID arg)
+{
+  fiber * f = static_cast<fiber *>(arg);
+  f->m_func(f->m_arg);
+
+  // Fiber functions must switch away instead of returning.
+  std::terminate();
+}
+
+TWINE_ANONS_END
+
+
+
+fiber *
+fiber_for_thread()
+{
+  fiber * f = new fiber();
+  f->m_handle = ConvertThreadToFiber(nullptr);
+  f->m_converted = true;
+  if (!f->m_handle) {
+    // Already a fiber.
+    f->m_handle = GetCurrentFiber();
+    f->m_converted = false;
+  }
+  return f;
+}
+
+
+
+fiber *
+fiber_create(size_t stack_size, fiber_function func, void * arg)
+{
+  fiber * f = new fiber();
+  f->m_func = func;
+  f->m_arg = arg;
+  f->m_handle = CreateFiber(stack_size, TWINE_ANONS(fiber_trampoline), f);
+  if (!f->m_handle) {
+    delete f;
+    return nullptr;
+  }
+  return f;
+}
+
+
+
+void
+fiber_switch(fiber *, fiber * to)
+{
+  SwitchToFiber(to->m_handle);
+}
+
+
+
+void
+fiber_destroy(fiber * f)
+{
+  if (f->m_converted) {
+    ConvertFiberToThread();
+  }
+  else if (f->m_func) {
+    DeleteFiber(f->m_handle);
+  }
+  delete f;
+}
+
+
+}} // namespace twine::detail
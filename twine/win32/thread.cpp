@@ -60,10 +60,17 @@ thread_detach(HANDLE & handle)
 }
 
 
+// Only the stack size is supported; Windows neither allows caller provided
+// stacks nor configurable guard pages.
 int
 thread_create(HANDLE & handle, thread::thread_info * info)
 {
-  handle = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, 0,
+  unsigned stack_size = 0;
+  if (!info->m_attributes.stack()) {
+    stack_size = unsigned(info->m_attributes.stack_size());
+  }
+
+  handle = reinterpret_cast<HANDLE>(_beginthreadex(nullptr, stack_size,
         detail:: TWINE_ANONS(thread_wrapper), info, 0, nullptr));
   if (0 != handle) {
     return 0;
@@ -73,6 +80,129 @@ thread_create(HANDLE & handle, thread::thread_info * info)
 }
 
 
+HANDLE
+current_thread_handle()
+{
+  return ::GetCurrentThread();
+}
+
+
+// Windows affinity masks cover the CPUs in the thread's processor group, up to
+// 64 of them.
+bool
+thread_set_affinity(HANDLE & handle, cpu_set const & cpus)
+{
+  DWORD_PTR mask = 0;
+  for (uint32_t cpu = 0 ; cpu < sizeof(DWORD_PTR) * 8 ; ++cpu) {
+    if (cpus.test(cpu)) {
+      mask |= DWORD_PTR(1) << cpu;
+    }
+  }
+  if (!mask) {
+    return false;
+  }
+  return (0 != ::SetThreadAffinityMask(handle, mask));
+}
+
+
+bool
+thread_get_affinity(HANDLE & handle, cpu_set & cpus)
+{
+  // There is no getter; setting the mask returns the previous one, so set the
+  // process mask and restore the previous one.
+  DWORD_PTR process_mask = 0;
+  DWORD_PTR system_mask = 0;
+  if (!::GetProcessAffinityMask(::GetCurrentProcess(), &process_mask,
+        &system_mask))
+  {
+    return false;
+  }
+
+  DWORD_PTR mask = ::SetThreadAffinityMask(handle, process_mask);
+  if (!mask) {
+    return false;
+  }
+  ::SetThreadAffinityMask(handle, mask);
+
+  cpus.reset();
+  for (uint32_t cpu = 0 ; cpu < sizeof(DWORD_PTR) * 8 ; ++cpu) {
+    if (mask & (DWORD_PTR(1) << cpu)) {
+      cpus.set(cpu);
+    }
+  }
+  return true;
+}
+
+
+int32_t
+current_cpu()
+{
+  return int32_t(::GetCurrentProcessorNumber());
+}
+
+
+// Windows has no scheduling policies, only thread priorities. The policies map
+// to the idle, normal and time critical priorities, and the priority is
+// ignored.
+bool
+set_scheduling(thread::scheduling_policy policy, int)
+{
+  int native = THREAD_PRIORITY_NORMAL;
+  switch (policy) {
+    case thread::SCHEDULING_IDLE:
+      native = THREAD_PRIORITY_IDLE;
+      break;
+
+    case thread::SCHEDULING_FIFO:
+    case thread::SCHEDULING_ROUND_ROBIN:
+      native = THREAD_PRIORITY_TIME_CRITICAL;
+      break;
+
+    default:
+      break;
+  }
+  return (0 != ::SetThreadPriority(::GetCurrentThread(), native));
+}
+
+
+// Nice levels map to the thread priorities between lowest and highest.
+bool
+set_nice(int nice)
+{
+  int native = THREAD_PRIORITY_NORMAL;
+  if (nice <= -10) {
+    native = THREAD_PRIORITY_HIGHEST;
+  }
+  else if (nice < 0) {
+    native = THREAD_PRIORITY_ABOVE_NORMAL;
+  }
+  else if (nice >= 10) {
+    native = THREAD_PRIORITY_LOWEST;
+  }
+  else if (nice > 0) {
+    native = THREAD_PRIORITY_BELOW_NORMAL;
+  }
+  return (0 != ::SetThreadPriority(::GetCurrentThread(), native));
+}
+
+
+
+bool
+set_timer_slack(chrono::nanoseconds const &)
+{
+  // Windows has no per-thread timer slack.
+  return false;
+}
+
+
+
+bool
+get_timer_slack(chrono::nanoseconds &)
+{
+  return false;
+}
+
+
 
 } // namespace detail
 } // namespace twine